@@ -0,0 +1,189 @@
+#include "encoder.h"
+
+#include "constants.h"
+#include "esp_log.h"
+#include "esp_mac.h"
+#include "esp_random.h"
+
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+
+#define _ENCODER_LOG_NAME "encoder"
+
+namespace bthome
+{
+    void Encoder::doInit(char const* const name, bool encrypt)
+    {
+        m_dataIdx       = 0;
+        m_nFields       = 0;
+        m_serviceUuid   = constants::SERVICE_UUID;
+        m_encryptEnable = encrypt;
+
+        // Write the BLE flags
+        this->writeByte(2);
+        this->writeByte(constants::BLE_ADVERT_DATA_TYPE::TYPE);
+        this->writeByte(constants::BLE_FLAGS_DATA_TYPE::BREDR_NOT_SUPPORTED |
+                        constants::BLE_FLAGS_DATA_TYPE::GENERAL_DISCOVERY);
+
+        size_t const nameLen = strlen(name);
+        if (nameLen > 0)
+        {
+            this->writeByte(nameLen + 1);
+            this->writeByte(constants::BLE_ADVERT_DATA_TYPE::COMPLETE_NAME);
+            for (size_t idx = 0; idx < nameLen; idx++)
+            {
+                this->writeByte(name[idx]);
+            }
+        }
+
+        // Service data UUID. The size grows with every field added.
+        this->m_serviceDataSizeIdx = this->m_dataIdx;
+        this->writeByte(3);
+        this->writeByte(constants::BLE_ADVERT_DATA_TYPE::SERVICE_DATA);
+        this->writeByte(this->m_serviceUuid & 0xff);
+        this->writeByte((this->m_serviceUuid >> 8) & 0xff);
+
+        // BTHome device info
+        this->m_deviceInfo = (this->m_encryptEnable << constants::BTHOME_DEVICE_INFO_SHIFTS::ENCRYPTED) |
+                             (constants::BTHOME_V2 << constants::BTHOME_DEVICE_INFO_SHIFTS::VERSION);
+        this->writeByte(this->m_deviceInfo);
+        this->m_data[this->m_serviceDataSizeIdx] += 1;
+
+        this->m_sensorDataIdx = this->m_dataIdx;
+    }
+
+    Encoder::Encoder(char const* const name) : m_encryptCount(0), m_macAddr {0}
+    {
+        doInit(name, false);
+    }
+
+    Encoder::Encoder(char const* const name, bool encrypt, uint8_t const* const key) : m_encryptCount(0), m_macAddr {0}
+    {
+        if (encrypt)
+        {
+            m_encryptCount = esp_random() % 0x427;
+            mbedtls_ccm_init(&this->m_encryptCTX);
+            mbedtls_ccm_setkey(&m_encryptCTX, MBEDTLS_CIPHER_ID_AES, key, constants::BIND_KEY_LEN * 8);
+            ESP_ERROR_CHECK(esp_read_mac(&m_macAddr[0], ESP_MAC_BT));
+        }
+        doInit(name, encrypt);
+    }
+
+    Encoder::~Encoder(void)
+    {
+        if (this->m_encryptEnable)
+        {
+            mbedtls_ccm_free(&this->m_encryptCTX);
+        }
+    }
+
+    inline void Encoder::writeByte(uint8_t const data)
+    {
+        if (this->m_dataIdx < constants::BLE_ADVERT_MAX_LEN)
+        {
+            this->m_data[this->m_dataIdx] = data;
+            this->m_dataIdx++;
+        }
+        else
+        {
+            ESP_LOGE(_ENCODER_LOG_NAME, "Discarding data");
+        }
+    }
+
+    int8_t Encoder::addField(enum constants::ObjectId const objectId)
+    {
+        assert(objectId < constants::LAST_DEFINED_ID);
+        constants::BTHomeDataTypeInfo const* const infoPtr = &constants::InfoLookup[objectId];
+
+        uint8_t const trailer = this->m_encryptEnable ? constants::COUNTER_LEN + constants::MIC_LEN : 0;
+        if ((this->m_nFields >= MAX_FIELDS) ||
+            (this->m_dataIdx + 1 + infoPtr->length + trailer > constants::BLE_ADVERT_MAX_LEN) || (infoPtr->length > 4))
+        {
+            ESP_LOGE(_ENCODER_LOG_NAME, "Unable to add field");
+            return -1;
+        }
+
+        int8_t const slot           = this->m_nFields++;
+        this->m_fieldIdx[slot]      = this->m_dataIdx + 1;
+        this->m_fieldLen[slot]      = infoPtr->length;
+        this->m_fieldFactor[slot]   = infoPtr->factor;
+        this->m_data[this->m_dataIdx] = static_cast<uint8_t>(objectId);
+        memset(&this->m_data[this->m_dataIdx + 1], 0, infoPtr->length);
+        this->m_dataIdx += 1 + infoPtr->length;
+        this->m_data[this->m_serviceDataSizeIdx] += 1 + infoPtr->length;
+        return slot;
+    }
+
+    void Encoder::setValue(int8_t const slot, int32_t const scaledValue)
+    {
+        if (slot < 0 || slot >= this->m_nFields)
+        {
+            return;
+        }
+        uint8_t* const dst = &this->m_data[this->m_fieldIdx[slot]];
+        uint32_t const v   = static_cast<uint32_t>(scaledValue);
+        switch (this->m_fieldLen[slot])
+        {
+        case 4:
+            dst[3] = (v >> 24) & 0xff;
+            [[fallthrough]];
+        case 3:
+            dst[2] = (v >> 16) & 0xff;
+            [[fallthrough]];
+        case 2:
+            dst[1] = (v >> 8) & 0xff;
+            [[fallthrough]];
+        default:
+            dst[0] = v & 0xff;
+        }
+    }
+
+    void Encoder::setValue(int8_t const slot, float const value)
+    {
+        if (slot < 0 || slot >= this->m_nFields)
+        {
+            return;
+        }
+        this->setValue(slot, static_cast<int32_t>(value * this->m_fieldFactor[slot]));
+    }
+
+    void Encoder::buildNonce(uint8_t* buf, uint32_t countId) const
+    {
+        memcpy(&buf[0], m_macAddr, 6);
+        memcpy(&buf[6], &this->m_serviceUuid, 2);
+        buf[8] = m_deviceInfo;
+        memcpy(&buf[9], &countId, 4);
+    }
+
+    const uint8_t* Encoder::getPayload(void)
+    {
+        if (!this->m_encryptEnable)
+        {
+            return &this->m_data[0];
+        }
+
+        size_t const textLen = this->m_dataIdx - this->m_sensorDataIdx;
+        uint8_t nonce[constants::NONCE_LEN];
+        buildNonce(nonce, m_encryptCount);
+
+        // Header and prefix are copied as is, the measurement data is encrypted behind it
+        memcpy(&this->m_encrypted[0], &this->m_data[0], this->m_sensorDataIdx);
+        uint8_t* const counterPtr = &this->m_encrypted[this->m_dataIdx];
+        uint8_t* const micPtr     = counterPtr + constants::COUNTER_LEN;
+        mbedtls_ccm_encrypt_and_tag(&m_encryptCTX, textLen, nonce, constants::NONCE_LEN, 0, 0,
+                                    &this->m_data[m_sensorDataIdx], &this->m_encrypted[m_sensorDataIdx], micPtr,
+                                    constants::MIC_LEN);
+        memcpy(counterPtr, &m_encryptCount, constants::COUNTER_LEN);
+        this->m_encrypted[this->m_serviceDataSizeIdx] += constants::COUNTER_LEN + constants::MIC_LEN;
+        m_encryptCount++;
+
+        return &this->m_encrypted[0];
+    }
+
+    uint32_t Encoder::getPayloadSize(void) const
+    {
+        return this->m_dataIdx + (this->m_encryptEnable ? constants::COUNTER_LEN + constants::MIC_LEN : 0);
+    }
+
+}; // namespace bthome
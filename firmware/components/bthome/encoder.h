@@ -0,0 +1,69 @@
+#ifndef _BTHOME_ENCODER_H_
+#define _BTHOME_ENCODER_H_
+
+#include "constants.h"
+#include "mbedtls/ccm.h"
+
+#include <cstdint>
+
+namespace bthome
+{
+
+    // A reusable BTHome advertisement encoder. Unlike Advertisement, which is built from scratch for every payload,
+    // the encoder keeps its state between adverts: the header, name, UUID and device info are written once, the
+    // measurement fields are declared once, and the AES key schedule is computed once. For each new sample only the
+    // measurement bytes are patched in place. No heap memory is used.
+    class Encoder
+    {
+      public:
+        static constexpr uint8_t MAX_FIELDS {8};
+
+        Encoder(char const* const name);
+        Encoder(char const* const name, bool encrypt, uint8_t const* const key);
+        ~Encoder();
+
+        // Declares a measurement field. Returns its slot, to be used with setValue, or -1 if the advert is full.
+        // All fields must be declared before the first call to setValue.
+        int8_t addField(enum constants::ObjectId const objectId);
+
+        // Sets the value of a field. The float overload applies the BTHome scaling factor of the field's object ID.
+        void setValue(int8_t const slot, int32_t const scaledValue);
+        void setValue(int8_t const slot, float const value);
+
+        // Returns the payload with the current field values. Encrypts it first if encryption is enabled.
+        const uint8_t* getPayload(void);
+        uint32_t getPayloadSize(void) const;
+
+      private:
+        void doInit(char const* const name, bool encrypt);
+        void writeByte(uint8_t const data);
+        void buildNonce(uint8_t* buf, uint32_t countId) const;
+
+        bool m_encryptEnable;
+        uint32_t m_encryptCount;
+        mbedtls_ccm_context m_encryptCTX;
+        uint8_t m_macAddr[6];
+
+        uint8_t m_deviceInfo;
+        uint16_t m_serviceUuid;
+        // Where the service data size is located in the data
+        uint8_t m_serviceDataSizeIdx;
+        // Index where the measurement data starts, following header, name, UUID and device info
+        uint8_t m_sensorDataIdx;
+        // Where in the data buffer the next byte goes
+        uint8_t m_dataIdx;
+
+        uint8_t m_nFields;
+        uint8_t m_fieldIdx[MAX_FIELDS];
+        uint8_t m_fieldLen[MAX_FIELDS];
+        uint16_t m_fieldFactor[MAX_FIELDS];
+
+        // The advert, with the measurement data in plain text
+        uint8_t m_data[constants::BLE_ADVERT_MAX_LEN];
+        // The advert with encrypted measurement data, counter and MIC. Only used when encryption is enabled.
+        uint8_t m_encrypted[constants::BLE_ADVERT_MAX_LEN];
+    };
+
+}; // namespace bthome
+
+#endif
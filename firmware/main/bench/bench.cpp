@@ -0,0 +1,289 @@
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <esp_err.h>
+#include <esp_attr.h>
+#include <esp_cpu.h>
+#include <esp_heap_caps.h>
+#include "sdkconfig.h"
+#include "advertisement.h"
+#include "encoder.h"
+#include "measurement.h"
+#include "../types.h"
+#include "../controller/controller.h"
+#include "../scd40/scd40.h"
+#include "../trace/trace.h"
+#include "bench.h"
+extern "C" {
+#include "../config/config.h"
+#include "../serial/serial_out.h"
+}
+
+using bthome::constants::ObjectId;
+
+constexpr uint8_t BENCH_KEY[] = {0x23, 0x1d, 0x39, 0xc1, 0xd7, 0xcc, 0x1a, 0xb1,
+                                 0xaa, 0xe9, 0x5c, 0x4e, 0x0b, 0x2d, 0x1e, 0x4f};
+
+static const SCD40measurement bench_meas = {.co2 = 812, .temp_cdeg = 2137, .hum_cpct = 4521};
+
+static volatile bool bench_counting = false;
+static volatile uint32_t bench_allocs = 0;
+
+#if CONFIG_HEAP_USE_HOOKS
+// Called by the heap on every allocation, also with the flash cache disabled, so it must not call into flash. The 
+// benchmark task runs above the application tasks, so the allocations counted while it runs are its own.
+extern "C" IRAM_ATTR void esp_heap_trace_alloc_hook(void *ptr, size_t size, uint32_t caps)
+{
+    if (bench_counting){
+        bench_allocs = bench_allocs + 1;
+    }
+}
+
+extern "C" IRAM_ATTR void esp_heap_trace_free_hook(void *ptr)
+{
+}
+#endif
+
+// State of the benchmarks, apart from that of the application tasks
+static const struct led_cfg_s bench_limits = {.brightness = 0.3, .limit_medium = 1000, .limit_high = 1500, 
+                                              .limit_critical = 2000};
+static char bench_str[1024];
+
+static void bench_empty(void)
+{
+}
+
+static void bench_measurement_ctor(void)
+{
+    bthome::Measurement m(ObjectId::TEMPERATURE_PRECISE, (uint64_t)bench_meas.temp_cdeg);
+    asm volatile("" : : "r"(m.getPayload()) : "memory");
+}
+
+// With the name of the device, the three fields and the counter and MIC of the encryption take 34 bytes, more than an
+// advert holds, so the encrypted adverts have a shorter name
+static const char *bench_name(bool encrypt)
+{
+    return encrypt ? "CO2" : "MINICO2";
+}
+
+static void bench_advert(bool encrypt)
+{
+    bthome::Advertisement advert(bench_name(encrypt), encrypt, BENCH_KEY);
+    advert.addMeasurement(bthome::Measurement(ObjectId::TEMPERATURE_PRECISE, (uint64_t)bench_meas.temp_cdeg));
+    advert.addMeasurement(bthome::Measurement(ObjectId::HUMIDITY_PRECISE, (uint64_t)bench_meas.hum_cpct));
+    advert.addMeasurement(bthome::Measurement(ObjectId::CO2, (uint64_t)bench_meas.co2));
+    asm volatile("" : : "r"(advert.getPayload()) : "memory");
+}
+
+static void bench_advert_plain(void){bench_advert(false);}
+static void bench_advert_encrypted(void){bench_advert(true);}
+
+static void bench_encoder(bthome::Encoder &encoder, int8_t *slots)
+{
+    encoder.setValue(slots[0], (int32_t)bench_meas.temp_cdeg);
+    encoder.setValue(slots[1], (int32_t)bench_meas.hum_cpct);
+    encoder.setValue(slots[2], (int32_t)bench_meas.co2);
+    asm volatile("" : : "r"(encoder.getPayload()) : "memory");
+}
+
+// The same fields as the advert of build_data_advert
+static void bench_encoder_plain(void)
+{
+    static bthome::Encoder encoder("MINICO2", false, BENCH_KEY);
+    static int8_t slots[] = {encoder.addField(ObjectId::TEMPERATURE_PRECISE), encoder.addField(ObjectId::HUMIDITY_PRECISE), 
+                             encoder.addField(ObjectId::CO2)};
+    bench_encoder(encoder, slots);
+}
+
+static void bench_encoder_encrypted(void)
+{
+    static bthome::Encoder encoder(bench_name(true), true, BENCH_KEY);
+    static int8_t slots[] = {encoder.addField(ObjectId::TEMPERATURE_PRECISE), encoder.addField(ObjectId::HUMIDITY_PRECISE), 
+                             encoder.addField(ObjectId::CO2)};
+    bench_encoder(encoder, slots);
+}
+
+static void bench_led_state_for_co2(void)
+{
+    volatile enum LED_STATES state = led_state_for_co2(bench_meas.co2, &bench_limits);
+    (void)state;
+}
+
+static void bench_config_to_str(void)
+{
+    struct minico2_cfg_s config;
+    config_snapshot(&config);
+    config_to_str(bench_str, sizeof(bench_str), &config);
+}
+
+// The text line of a measurement, formatted from integers as the serial output does
+static void bench_text_fixed(void)
+{
+    serial_out_format_text(bench_str, sizeof(bench_str), &bench_meas);
+}
+
+// The same line formatted from floats, as before the measurement held integers
+static void bench_text_float(void)
+{
+    snprintf(bench_str, sizeof(bench_str), "{CO2: %u, TEMP: %.1f, HUM: %.1f}\n", bench_meas.co2, 
+             bench_meas.temp_cdeg / 100.0f, bench_meas.hum_cpct / 100.0f);
+}
+
+// The arithmetic done on every sample, from the raw words of the sensor to the units of BLE, Zigbee, the serial frame,
+// the history and the flash log. The inputs are volatile, so that the compiler cannot fold the conversions.
+static volatile uint16_t bench_ticks[3] = {812, 26214, 29491};
+static volatile int32_t bench_sink;
+static volatile float bench_sink_f;
+
+static void bench_units_fixed(void)
+{
+    int16_t temp = scd4x_ticks_to_cdeg(bench_ticks[1]);
+    uint16_t hum = scd4x_ticks_to_cpct(bench_ticks[2]);
+    bench_sink = temp;                         // BLE, Zigbee and the serial frame, as they are
+    bench_sink = hum;
+    bench_sink_f = bench_ticks[0] * 1E-6f;     // Zigbee CO2
+    bench_sink = temp / 10;                    // History and flash log
+    bench_sink = hum / 10;
+}
+
+// The same with the float measurement of before: the conversion of the scd4x driver, then each consumer's scaling
+static void bench_units_float(void)
+{
+    float temp = -45 + 175 * (float)bench_ticks[1] / 65536;
+    float hum = 100 * (float)bench_ticks[2] / 65536;
+    bench_sink = (int32_t)(temp * 100);        // BLE
+    bench_sink = (int32_t)(hum * 100);
+    bench_sink = (int16_t)(temp * 100);        // Zigbee
+    bench_sink = (int16_t)(hum * 100);
+    bench_sink_f = (float)(bench_ticks[0] * 1E-6);
+    float temp_c = temp * 100;                 // Serial frame
+    float hum_c = hum * 100;
+    bench_sink = (int16_t)(temp_c < 0 ? temp_c - 0.5f : temp_c + 0.5f);
+    bench_sink = (uint16_t)(hum_c + 0.5f);
+    bench_sink = (int32_t)(temp * 10);         // History
+    bench_sink = (int32_t)(hum * 10);
+    bench_sink = (int16_t)(temp * 10);         // Flash log
+    bench_sink = (uint16_t)(hum * 10);
+}
+
+#if TRACE_ENABLED
+// One event of the binary trace, as TRACE() records it on the hot paths
+static void bench_trace_event(void)
+{
+    trace_record(TRACE_BENCH, 0);
+}
+#endif
+
+struct bench {
+    const char *name;
+    void (*fn)(void);
+    uint32_t calls;
+};
+
+static const struct bench BENCHES[] = {
+    {"empty", bench_empty, 1000},
+    {"measurement_ctor", bench_measurement_ctor, 1000},
+    {"advert_plain", bench_advert_plain, 200},
+    {"advert_encrypted", bench_advert_encrypted, 200},
+    {"encoder_plain", bench_encoder_plain, 1000},
+    {"encoder_encrypted", bench_encoder_encrypted, 200},
+    {"led_state_for_co2", bench_led_state_for_co2, 1000},
+    {"config_to_str", bench_config_to_str, 100},
+    {"text_fixed", bench_text_fixed, 200},
+    {"text_float", bench_text_float, 200},
+    {"units_fixed", bench_units_fixed, 1000},
+    {"units_float", bench_units_float, 1000},
+#if TRACE_ENABLED
+    {"trace_event", bench_trace_event, 1000},
+#endif
+};
+
+struct bench_result {
+    uint32_t cycles_min;
+    uint64_t cycles_sum;
+    uint32_t allocs;
+    uint32_t stack_used;
+};
+
+struct bench_job {
+    const struct bench *bench;
+    struct bench_result result;
+    TaskHandle_t caller;
+};
+
+static void bench_task(void *pvParameters)
+{
+    struct bench_job *job = (struct bench_job *)pvParameters;
+    const struct bench *b = job->bench;
+    struct bench_result *r = &job->result;
+
+    // Warm up the caches and any lazily initialised state, such as the static encoders
+    b->fn();
+
+    r->cycles_min = UINT32_MAX;
+    r->cycles_sum = 0;
+    bench_allocs = 0;
+    bench_counting = true;
+    for (uint32_t i = 0; i < b->calls; i++){
+        uint32_t start = esp_cpu_get_cycle_count();
+        b->fn();
+        uint32_t cycles = esp_cpu_get_cycle_count() - start;
+        r->cycles_sum += cycles;
+        if (cycles < r->cycles_min){r->cycles_min = cycles;}
+    }
+    bench_counting = false;
+    r->allocs = bench_allocs;
+    r->stack_used = BENCH_STACK_SIZE - uxTaskGetStackHighWaterMark(NULL);
+
+    xTaskNotifyGive(job->caller);
+    vTaskDelete(NULL);
+}
+
+static esp_err_t run_one(const struct bench *b, struct bench_result *result)
+{
+    struct bench_job job = {.bench = b, .result = {}, .caller = xTaskGetCurrentTaskHandle()};
+    if (xTaskCreate(bench_task, "bench_task", BENCH_STACK_SIZE, &job, BENCH_PRIORITY, NULL) != pdPASS){
+        return ESP_ERR_NO_MEM;
+    }
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    *result = job.result;
+    return ESP_OK;
+}
+
+esp_err_t bench_run(const char *filter)
+{
+    // The cost of reading the cycle counter is measured with the empty benchmark and subtracted from the others
+    struct bench_result overhead;
+    esp_err_t err = run_one(&BENCHES[0], &overhead);
+
+    printf("%-24s %8s %10s %10s %8s %8s\n", "benchmark", "calls", "cyc_min", "cyc_mean", "allocs", "stack");
+    for (size_t i = 0; i < sizeof(BENCHES) / sizeof(BENCHES[0]) && err == ESP_OK; i++){
+        const struct bench *b = &BENCHES[i];
+        if (filter != NULL && strstr(b->name, filter) == NULL){continue;}
+
+        struct bench_result r;
+        err = run_one(b, &r);
+        if (err != ESP_OK){break;}
+        uint32_t mean = r.cycles_sum / b->calls;
+        uint32_t min = r.cycles_min > overhead.cycles_min ? r.cycles_min - overhead.cycles_min : 0;
+        mean = mean > overhead.cycles_min ? mean - overhead.cycles_min : 0;
+#if CONFIG_HEAP_USE_HOOKS
+        char allocs[16];
+        snprintf(allocs, sizeof(allocs), "%" PRIu32 ".%02" PRIu32, r.allocs / b->calls, (r.allocs % b->calls) * 100 / b->calls);
+#else
+        const char *allocs = "-";
+#endif
+        printf("%-24s %8" PRIu32 " %10" PRIu32 " %10" PRIu32 " %8s %8" PRIu32 "\n", b->name, b->calls, min, mean, allocs, r.stack_used);
+#if TRACE_ENABLED
+        // The trace must cost less than 1 us per event, the cycles of 1 us at the CPU clock
+        if (b->fn == bench_trace_event){
+            printf("Trace: %" PRIu32 " cycles per event, %" PRIu32 " ns at %d MHz, target under 1000 ns\n", mean, 
+                   mean * 1000 / CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ, CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ);
+        }
+#endif
+    }
+
+    return err;
+}
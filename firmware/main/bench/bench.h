@@ -0,0 +1,36 @@
+#ifndef _BENCH_H
+#define _BENCH_H
+
+#include <esp_err.h>
+
+/*
+On-target micro benchmarks of the per-measurement code paths. Every benchmark runs in a fresh task, so that the stack
+high water mark is that of the benchmark alone. Cycles are read from the CPU cycle counter around each call, and the
+cost of reading the counter is subtracted. Heap allocations are counted with the heap hooks (CONFIG_HEAP_USE_HOOKS).
+The benchmarks only touch state of their own, never that of the application tasks.
+
+Only built with MINICO2_BENCH set in the top level CMakeLists.txt, which sets BENCH_ENABLED.
+
+The output is a fixed-format table, to be diffed between firmware versions. test/bench_measurement_paths.cpp runs the
+same benchmarks on the host.
+*/
+
+#ifndef BENCH_ENABLED
+#define BENCH_ENABLED 0
+#endif
+
+#define BENCH_STACK_SIZE 8192
+#define BENCH_PRIORITY 15  // Above the application tasks, so they do not disturb the timing
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Runs the benchmarks whose name contains 'filter', or all of them if 'filter' is NULL, and prints the results
+esp_err_t bench_run(const char *filter);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -1,5 +1,5 @@
-#include "advertisement.h"
 #include "constants.h"
+#include "encoder.h"
 #include "esp_bt.h"
 #include "esp_bt_defs.h"
 #include "esp_bt_main.h"
@@ -9,19 +9,46 @@
 #include <esp_log.h>
 #include <esp_err.h>
 #include <esp_check.h>
+#include <esp_timer.h>
 #include "esp_sleep.h"
+#include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
-#include "measurement.h"
-#include "nvs_flash.h"
 
+#include <cinttypes>
 #include <cstdint>
 #include <cstring>
 
 // Project files
 #include "../types.h"
+extern "C" {
+#include "../bus/measurement_bus.h"
+#include "../latency/latency.h"
+#include "../trace/trace.h"
+#include "../boot/boot.h"
+#include "../stats/rollstats.h"
+}
+#include "ble.h"
 
 static const char *BLE_TAG = "ble";
 
+// Advertising policy. Each sample is advertised for BLE_ADV_ADVERTS_PER_SAMPLE advertising intervals, after which 
+// the radio is turned off until the next sample. If BLE_ADV_CONTINUOUS is true, the radio is never turned off, and 
+// each new sample replaces the previous one in the advert.
+#define BLE_ADV_ADVERTS_PER_SAMPLE 38
+#define BLE_ADV_CONTINUOUS false
+
+// Rolling statistics of the CO2 over BLE_ADV_STATS_WINDOW, opt-in. BTHome has no objects for statistics, so they are 
+// not in the advert, which is the same with or without them. They go in the scan response instead, as manufacturer 
+// specific data under BLE_ADV_STATS_COMPANY_ID, which the Bluetooth SIG reserves for tests and BTHome receivers 
+// ignore. The device becomes scannable for it. Layout after the company ID, little endian: uint16 window in minutes, 
+// then uint16 mean, minimum, maximum and standard deviation, all in PPM.
+#define BLE_ADV_STATS false
+#define BLE_ADV_STATS_WINDOW ROLLSTATS_1H
+#define BLE_ADV_STATS_COMPANY_ID 0xFFFF
+
+// Upper bound of the advertising interval, used to estimate the number of adverts sent. Matches adv_int_max below.
+#define BLE_ADV_INTERVAL_US (0x40 * 625)
+
 
 constexpr uint8_t BIND_KEY[] = {0x23, 0x1d, 0x39, 0xc1, 0xd7, 0xcc, 0x1a, 0xb1,
                                 0xae, 0xe2, 0x24, 0xcd, 0x09, 0x6d, 0xb9, 0x32};
@@ -30,7 +57,7 @@ constexpr uint8_t BIND_KEY[] = {0x23, 0x1d, 0x39, 0xc1, 0xd7, 0xcc, 0x1a, 0xb1,
 static esp_ble_adv_params_t ble_adv_params = {
     .adv_int_min       = 0x20,
     .adv_int_max       = 0x40,
-    .adv_type          = ADV_TYPE_NONCONN_IND,
+    .adv_type          = BLE_ADV_STATS ? ADV_TYPE_SCAN_IND : ADV_TYPE_NONCONN_IND,
     .own_addr_type     = BLE_ADDR_TYPE_PUBLIC,
     .peer_addr         = 0,
     .peer_addr_type    = BLE_ADDR_TYPE_PUBLIC,
@@ -38,27 +65,179 @@ static esp_ble_adv_params_t ble_adv_params = {
     .adv_filter_policy = ADV_FILTER_ALLOW_SCAN_ANY_CON_ANY,
 };
 
+// The states of the advertising state machine. Transitions happen in the GAP event callback.
+enum BLE_ADV_STATES {
+    BLE_ADV_IDLE,         // Not advertising
+    BLE_ADV_STARTING,     // Advertising start requested
+    BLE_ADV_ADVERTISING,  // Advertising
+    BLE_ADV_STOPPING      // Advertising stop requested
+};
+
+static enum BLE_ADV_STATES adv_state = BLE_ADV_IDLE;
+static bool adv_restart_pending = false;   // New data arrived while stopping, so advertising must be restarted
+static int64_t adv_sample_start_us = 0;    // When the current sample started being advertised
+static esp_timer_handle_t adv_burst_timer;
+static struct ble_adv_stats adv_stats = {};
+static portMUX_TYPE adv_lock = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t adv_data_read_us = 0;      // Read time of the sample in the advert data, for latency tracking
+
+// Accounts the adverts sent for the current sample up to 'now_us'. Must be called with 'adv_lock' held.
+static void finish_advertised_sample(int64_t now_us)
+{
+    uint32_t adverts = (now_us - adv_sample_start_us) / BLE_ADV_INTERVAL_US;
+    adv_stats.radio_on_us += now_us - adv_sample_start_us;
+    adv_stats.last_sample_adverts = adverts;
+    adv_stats.adverts += adverts;
+    adv_stats.samples++;
+    adv_sample_start_us = now_us;
+}
+
+// Starts or restarts the burst timer that ends advertising of a sample
+static void restart_burst_timer(void)
+{
+    if (BLE_ADV_CONTINUOUS){return;}
+    esp_timer_stop(adv_burst_timer);  // Fails harmlessly if the timer is not running
+    ESP_ERROR_CHECK_WITHOUT_ABORT(esp_timer_start_once(adv_burst_timer, (uint64_t)BLE_ADV_ADVERTS_PER_SAMPLE * BLE_ADV_INTERVAL_US));
+}
+
+static void adv_burst_timer_callback(void *arg)
+{
+    taskENTER_CRITICAL(&adv_lock);
+    bool advertising = adv_state == BLE_ADV_ADVERTISING;
+    if (advertising){adv_state = BLE_ADV_STOPPING;}
+    taskEXIT_CRITICAL(&adv_lock);
+
+    if (advertising){
+        TRACE(TRACE_GAP_ADV_STOP, 0);
+        esp_err_t err = esp_ble_gap_stop_advertising();
+        if (err != ESP_OK){
+            ESP_LOGE(BLE_TAG, "Stopping advertising failed: %s", esp_err_to_name(err));
+        }
+    }
+}
+
+static void start_advertising(void)
+{
+    TRACE(TRACE_GAP_ADV_START, 0);
+    esp_err_t err = esp_ble_gap_start_advertising(&ble_adv_params);
+    if (err != ESP_OK){
+        ESP_LOGE(BLE_TAG, "Starting advertising failed: %s", esp_err_to_name(err));
+        taskENTER_CRITICAL(&adv_lock);
+        adv_state = BLE_ADV_IDLE;
+        taskEXIT_CRITICAL(&adv_lock);
+    }
+}
+
+static void gap_event_handler(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t *param)
+{
+    int64_t now_us = esp_timer_get_time();
+    uint32_t read_us;
+    switch (event)
+    {
+    case ESP_GAP_BLE_ADV_DATA_RAW_SET_COMPLETE_EVT: {
+        // New sample data is in place. Advertise it, or keep advertising with the new data.
+        if (param->adv_data_raw_cmpl.status != ESP_BT_STATUS_SUCCESS){
+            ESP_LOGE(BLE_TAG, "Setting advert data failed, status %d", param->adv_data_raw_cmpl.status);
+            break;
+        }
+        taskENTER_CRITICAL(&adv_lock);
+        enum BLE_ADV_STATES state = adv_state;
+        read_us = adv_data_read_us;
+        if (state == BLE_ADV_IDLE){
+            adv_state = BLE_ADV_STARTING;
+        } else if (state == BLE_ADV_ADVERTISING){
+            finish_advertised_sample(now_us);
+        } else if (state == BLE_ADV_STOPPING){
+            adv_restart_pending = true;
+        }
+        taskEXIT_CRITICAL(&adv_lock);
+
+        latency_record(LATENCY_BLE_PAYLOAD_CONFIGURED, read_us);
+        if (state == BLE_ADV_IDLE){
+            start_advertising();
+        } else if (state == BLE_ADV_ADVERTISING){
+            ESP_LOGD(BLE_TAG, "Advert data updated while advertising");
+            latency_record(LATENCY_BLE_ADVERT_STARTED, read_us);  // The new data goes out with the next advert
+            restart_burst_timer();
+        }
+        break;
+    }
+    case ESP_GAP_BLE_ADV_START_COMPLETE_EVT:
+        TRACE(TRACE_GAP_ADV_STARTED, param->adv_start_cmpl.status);
+        if (param->adv_start_cmpl.status != ESP_BT_STATUS_SUCCESS){
+            ESP_LOGE(BLE_TAG, "Advertising start failed, status %d", param->adv_start_cmpl.status);
+            taskENTER_CRITICAL(&adv_lock);
+            adv_state = BLE_ADV_IDLE;
+            taskEXIT_CRITICAL(&adv_lock);
+            break;
+        }
+        taskENTER_CRITICAL(&adv_lock);
+        adv_state = BLE_ADV_ADVERTISING;
+        adv_sample_start_us = now_us;
+        read_us = adv_data_read_us;
+        taskEXIT_CRITICAL(&adv_lock);
+        latency_record(LATENCY_BLE_ADVERT_STARTED, read_us);
+        restart_burst_timer();
+        break;
+    case ESP_GAP_BLE_ADV_STOP_COMPLETE_EVT: {
+        TRACE(TRACE_GAP_ADV_STOPPED, param->adv_stop_cmpl.status);
+        if (param->adv_stop_cmpl.status != ESP_BT_STATUS_SUCCESS){
+            ESP_LOGE(BLE_TAG, "Advertising stop failed, status %d", param->adv_stop_cmpl.status);
+        }
+        taskENTER_CRITICAL(&adv_lock);
+        finish_advertised_sample(now_us);
+        bool restart = adv_restart_pending;
+        adv_restart_pending = false;
+        adv_state = restart ? BLE_ADV_STARTING : BLE_ADV_IDLE;
+        uint32_t adverts = adv_stats.last_sample_adverts;
+        taskEXIT_CRITICAL(&adv_lock);
+
+        ESP_LOGD(BLE_TAG, "Advertising stopped after ~%" PRIu32 " adverts", adverts);
+        if (restart){start_advertising();}
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+void ble_get_adv_stats(struct ble_adv_stats *stats)
+{
+    taskENTER_CRITICAL(&adv_lock);
+    *stats = adv_stats;
+    taskEXIT_CRITICAL(&adv_lock);
+}
+
 esp_err_t ble_init(void)
 {
     uint8_t N_init_tasks = 6;
     ESP_LOGI(BLE_TAG, "Initializing BLE...");
-    ESP_LOGI(BLE_TAG, "1/%u Initializing NVS flash", N_init_tasks);
-    ESP_RETURN_ON_ERROR(nvs_flash_init(), BLE_TAG, "NVS flash init failed");
-    ESP_LOGI(BLE_TAG, "2/%u Releasing controller memory", N_init_tasks);
+    ESP_LOGI(BLE_TAG, "1/%u Releasing controller memory", N_init_tasks);
     ESP_RETURN_ON_ERROR(esp_bt_controller_mem_release(ESP_BT_MODE_CLASSIC_BT), BLE_TAG, "Releasing controller memory failed");
 
-    ESP_LOGI(BLE_TAG, "3/%u Initializing BT controller", N_init_tasks);
+    ESP_LOGI(BLE_TAG, "2/%u Initializing BT controller", N_init_tasks);
     esp_bt_controller_config_t bt_cfg = BT_CONTROLLER_INIT_CONFIG_DEFAULT();
     ESP_RETURN_ON_ERROR(esp_bt_controller_init(&bt_cfg), BLE_TAG, "BT controller init failed");
 
-    ESP_LOGI(BLE_TAG, "4/%u Enabling BT controller", N_init_tasks);
+    ESP_LOGI(BLE_TAG, "3/%u Enabling BT controller", N_init_tasks);
     ESP_RETURN_ON_ERROR(esp_bt_controller_enable(ESP_BT_MODE_BLE), BLE_TAG, "Enabling BT controller failed");
 
-    ESP_LOGI(BLE_TAG, "5/%u Initializing bluedroid", N_init_tasks);
+    ESP_LOGI(BLE_TAG, "4/%u Initializing bluedroid", N_init_tasks);
     ESP_RETURN_ON_ERROR(esp_bluedroid_init(), BLE_TAG, "Bluedroid init failed");
-    ESP_LOGI(BLE_TAG, "6/%u Enabling bluedroid", N_init_tasks);
+    ESP_LOGI(BLE_TAG, "5/%u Enabling bluedroid", N_init_tasks);
     ESP_RETURN_ON_ERROR(esp_bluedroid_enable(), BLE_TAG, "Enabling bluedroid failed");
 
+    ESP_LOGI(BLE_TAG, "6/%u Registering GAP callback", N_init_tasks);
+    ESP_RETURN_ON_ERROR(esp_ble_gap_register_callback(gap_event_handler), BLE_TAG, "Registering GAP callback failed");
+    const esp_timer_create_args_t burst_timer_args = {
+        .callback = &adv_burst_timer_callback,
+        .arg = NULL,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "ble_adv_burst",
+        .skip_unhandled_events = true,
+    };
+    ESP_RETURN_ON_ERROR(esp_timer_create(&burst_timer_args, &adv_burst_timer), BLE_TAG, "Creating advertising burst timer failed");
+
     ESP_LOGI(BLE_TAG, "BLE initialized successfully");
     return ESP_OK;
 }
@@ -73,78 +252,119 @@ void ble_deinit(void)
     ESP_LOGI(BLE_TAG, "BLE deinitialized sucesfully");
 }
 
-uint8_t build_data_advert(uint8_t data[], SCD40measurement meas)
+// The advert encoder is built once. For every measurement only the measurement bytes are updated.
+static bthome::Encoder advert_encoder("MINICO2", false, BIND_KEY);
+static int8_t temp_slot = advert_encoder.addField(bthome::constants::ObjectId::TEMPERATURE_PRECISE);
+static int8_t humid_slot = advert_encoder.addField(bthome::constants::ObjectId::HUMIDITY_PRECISE);
+static int8_t co2_slot = advert_encoder.addField(bthome::constants::ObjectId::CO2);
+
+// Encodes a measurement into the advert. Returns a pointer to the advert payload, and its size in 'size'.
+const uint8_t* build_data_advert(SCD40measurement meas, uint8_t *size)
 {
-    bthome::Measurement temp(bthome::constants::ObjectId::TEMPERATURE_PRECISE, meas.temperature);
-    bthome::Measurement humid(bthome::constants::ObjectId::HUMIDITY_PRECISE, meas.humidity);
-    bthome::Measurement co2(bthome::constants::ObjectId::CO2, (uint64_t)meas.co2);
+    // The _PRECISE objects are in hundredths, the units of the measurement, so no scaling is needed
+    advert_encoder.setValue(temp_slot, (int32_t)meas.temp_cdeg);
+    advert_encoder.setValue(humid_slot, (int32_t)meas.hum_cpct);
+    advert_encoder.setValue(co2_slot, (int32_t)meas.co2);
 
-    bthome::Advertisement advertisement("MINICO2", false, BIND_KEY);
-    advertisement.addMeasurement(temp);
-    advertisement.addMeasurement(humid);
-    advertisement.addMeasurement(co2);
+    const uint8_t *payload = advert_encoder.getPayload();
+    *size = advert_encoder.getPayloadSize();
+    return payload;
+}
 
-    memcpy(&data[0], advertisement.getPayload(), advertisement.getPayloadSize());
+#if BLE_ADV_STATS
+static void put_u16(uint8_t *dst, int32_t value)
+{
+    uint16_t v = value < 0 ? 0 : value > UINT16_MAX ? UINT16_MAX : value;
+    dst[0] = v & 0xff;
+    dst[1] = v >> 8;
+}
 
-    return advertisement.getPayloadSize();
+// Encodes the rolling statistics into the scan response. Returns a pointer to it, and its size in 'size'.
+static const uint8_t* build_stats_scan_rsp(uint8_t *size)
+{
+    static uint8_t scan_rsp[] = {13, 0xff, BLE_ADV_STATS_COMPANY_ID & 0xff, BLE_ADV_STATS_COMPANY_ID >> 8,
+                                 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+    struct rollstats_result stats;
+    rollstats_get(BLE_ADV_STATS_WINDOW, ROLLSTATS_CO2, &stats);
+    put_u16(&scan_rsp[4], rollstats_window_s(BLE_ADV_STATS_WINDOW) / 60);
+    put_u16(&scan_rsp[6], stats.mean);
+    put_u16(&scan_rsp[8], stats.min);
+    put_u16(&scan_rsp[10], stats.max);
+    put_u16(&scan_rsp[12], stats.sd);
+    *size = sizeof(scan_rsp);
+    return scan_rsp;
 }
+#endif
 
-void ble_task(void* pvParameters)
+void ble_task(const ble_channels *channels)
 {
-    // Get the queues from the pvParameters pointer
-    QueueHandle_t *queues = (QueueHandle_t *)pvParameters;
-    QueueHandle_t ble_queue = queues[0];
-    QueueHandle_t errors_queue = queues[1];
-
-    // If any of the queues failed at being created, we go into an infinite loop
-    if ((ble_queue == 0) || (errors_queue == 0)){
-        ESP_LOGD(BLE_TAG, "BLE queue or errors queue is 0, entering infinite loop");
+    // If any of the channels failed at being created, we go into an infinite loop
+    if (!channels->errors.valid()){
+        ESP_LOGD(BLE_TAG, "Errors queue is 0, entering infinite loop");
         while (1){
             vTaskDelay(pdMS_TO_TICKS(1000));
         }
     }
 
-    // Init the BLE
+    // Init the BLE. The controller reads its PHY calibration data from NVS.
+    boot_wait(BOOT_BIT(BOOT_NVS_READY), portMAX_DELAY);
     esp_err_t ble_init_err = ble_init();
     if (ble_init_err){
         // Log the error, put it on the errors queue, and enter an infinite loop
         ESP_ERROR_CHECK_WITHOUT_ABORT(ble_init_err);
-        xQueueSendToBack(errors_queue, &ble_init_err, (TickType_t)0);
+        channels->errors.send(ble_init_err);
         while (1){
             vTaskDelay(pdMS_TO_TICKS(1000));
         }
     }
 
+    boot_mark(BOOT_BLE_READY);
+
     vTaskDelay(200 / portTICK_PERIOD_MS);
 
+    static struct measurement_bus_subscriber bus_sub;
+    ESP_ERROR_CHECK(measurement_bus_subscribe(&bus_sub));
 
     struct SCD40measurement meas;
     while(1){
-        // Wait for sensor data to be received
-        if (xQueueReceive(ble_queue, &( meas), (TickType_t) 10)){
-            ESP_LOGD(BLE_TAG, "Sensor data received on BLE queue");
+        // Wait for sensor data to be published
+        measurement_bus_wait(portMAX_DELAY);
+
+        // Catch up to the most recent measurement. Older ones are superseded, so only the newest is advertised.
+        bool received = false;
+        while (measurement_bus_read(&bus_sub, &meas)){
+            received = true;
+        }
+        if (received){
+            ESP_LOGD(BLE_TAG, "Sensor data received on measurement bus (%" PRIu32 " dropped)", bus_sub.dropped);
+
+            taskENTER_CRITICAL(&adv_lock);
+            adv_data_read_us = meas.read_us;
+            taskEXIT_CRITICAL(&adv_lock);
 
             // Encode sensor data
-            static uint8_t advertData[64];
-            uint8_t const dataLength = build_data_advert(&advertData[0], meas);
+            uint8_t dataLength;
+            const uint8_t *advertData = build_data_advert(meas, &dataLength);
 
             if (dataLength > bthome::constants::BLE_ADVERT_MAX_LEN){
                 ESP_LOGE(BLE_TAG, "Advert size %i is too big, can't send it", dataLength);
             }
             else{
-                // Configure advertising data
-                ESP_ERROR_CHECK(esp_ble_gap_config_adv_data_raw(&advertData[0], dataLength));
-
-                // Begin advertising
-                ESP_ERROR_CHECK(esp_ble_gap_start_advertising(&ble_adv_params));
-
-                // Wait 1500ms for a few advertisement to go out
-                // The minimum time is 1s, the maximum time is 1.28s, so waiting
-                // 320ms beyond that
-                vTaskDelay(1500 / portTICK_PERIOD_MS);
-
-                // Stop advertising data
-                ESP_ERROR_CHECK(esp_ble_gap_stop_advertising());
+#if BLE_ADV_STATS
+                // The scan response goes first, so that it is in place when the advert data completes
+                uint8_t rspLength;
+                const uint8_t *rspData = build_stats_scan_rsp(&rspLength);
+                esp_err_t rsp_err = esp_ble_gap_config_scan_rsp_data_raw((uint8_t *)rspData, rspLength);
+                if (rsp_err != ESP_OK){
+                    ESP_LOGE(BLE_TAG, "Configuring scan response failed: %s", esp_err_to_name(rsp_err));
+                }
+#endif
+                // Configure advertising data. The GAP callback starts advertising once the data is set, or updates 
+                // the advert in place if advertising is already ongoing. The burst timer stops it again.
+                esp_err_t err = esp_ble_gap_config_adv_data_raw((uint8_t *)advertData, dataLength);
+                if (err != ESP_OK){
+                    ESP_LOGE(BLE_TAG, "Configuring advert data failed: %s", esp_err_to_name(err));
+                }
             }
         }
     }
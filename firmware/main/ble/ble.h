@@ -1,6 +1,37 @@
 #ifndef _BLE_H
 #define _BLE_H
 
-void ble_task(void *pvParameters);
+#include <stdint.h>
 
-#endif
\ No newline at end of file
+// Advertising statistics. Advert counts are estimated from the advertising time and the maximum advertising interval.
+struct ble_adv_stats {
+    uint32_t samples;              // Number of samples that were advertised
+    uint32_t adverts;              // Total number of adverts sent
+    uint32_t last_sample_adverts;  // Number of adverts sent for the most recent sample
+    int64_t radio_on_us;           // Total time spent advertising
+};
+
+#ifdef __cplusplus
+#include <esp_err.h>
+#include "../types.h"
+#include "../topology/channel.h"
+
+struct ble_channels {
+    ChannelHandle<esp_err_t> errors;  // To the controller
+};
+
+void ble_task(const ble_channels *channels);
+const uint8_t* build_data_advert(SCD40measurement meas, uint8_t *size);
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void ble_get_adv_stats(struct ble_adv_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
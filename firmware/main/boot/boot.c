@@ -0,0 +1,62 @@
+#include <inttypes.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+#include "boot.h"
+
+static const char *BOOT_TAG = "boot";
+
+_Static_assert(BOOT_N_PHASES <= 24, "An event group holds 24 bits");
+
+static StaticEventGroup_t phases_buffer;
+static EventGroupHandle_t phases = NULL;
+static int64_t phase_time_us[BOOT_N_PHASES];
+
+void boot_init(void)
+{
+    phases = xEventGroupCreateStatic(&phases_buffer);
+    boot_mark(BOOT_APP_MAIN);
+}
+
+void boot_mark(enum BOOT_PHASES phase)
+{
+    if (phase >= BOOT_N_PHASES || (xEventGroupGetBits(phases) & BOOT_BIT(phase))){return;}
+    phase_time_us[phase] = esp_timer_get_time();
+    xEventGroupSetBits(phases, BOOT_BIT(phase));
+
+    if (phase == BOOT_FIRST_SAMPLE_PUBLISHED){
+        ESP_LOGI(BOOT_TAG, "First sample published %" PRId64 " ms after startup (sensor ready at %" PRId64 " ms)",
+                 phase_time_us[phase] / 1000, boot_phase_time_us(BOOT_SENSOR_READY) / 1000);
+    }
+}
+
+bool boot_wait(uint32_t wanted, TickType_t timeout)
+{
+    EventBits_t bits = xEventGroupWaitBits(phases, wanted, pdFALSE, pdTRUE, timeout);
+    return (bits & wanted) == wanted;
+}
+
+int64_t boot_phase_time_us(enum BOOT_PHASES phase)
+{
+    if (phase >= BOOT_N_PHASES || !(xEventGroupGetBits(phases) & BOOT_BIT(phase))){return -1;}
+    return phase_time_us[phase];
+}
+
+const char *boot_phase_to_str(enum BOOT_PHASES phase)
+{
+    switch (phase)
+    {
+    case BOOT_APP_MAIN: return "app_main";
+    case BOOT_NVS_READY: return "nvs_ready";
+    case BOOT_TASKS_LAUNCHED: return "tasks_launched";
+    case BOOT_CONFIG_LOADED: return "config_loaded";
+    case BOOT_CONSOLE_READY: return "console_ready";
+    case BOOT_SENSOR_READY: return "sensor_ready";
+    case BOOT_BLE_READY: return "ble_ready";
+    case BOOT_ZIGBEE_READY: return "zigbee_ready";
+    case BOOT_FIRST_SAMPLE_READ: return "first_sample_read";
+    case BOOT_FIRST_SAMPLE_PUBLISHED: return "first_sample_published";
+    default: return "unknown";
+    }
+}
@@ -0,0 +1,45 @@
+#ifndef _BOOT_H
+#define _BOOT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+
+/*
+Boot phases. Each phase is marked once when it is reached, with the time since startup. Tasks that depend on a phase
+wait for it with boot_wait(), so that the sensor, BLE and ZigBee can initialise in parallel and only block where they
+need something from another part of the firmware. The report is logged when the first sample is published, and 
+printed by the 'boot' console command.
+*/
+
+enum BOOT_PHASES {
+    BOOT_APP_MAIN,               // app_main entered
+    BOOT_NVS_READY,              // NVS initialised
+    BOOT_TASKS_LAUNCHED,         // All tasks of the task table created
+    BOOT_CONFIG_LOADED,          // Configuration loaded from NVS
+    BOOT_CONSOLE_READY,          // Console REPL started
+    BOOT_SENSOR_READY,           // SCD40 initialised and sampling scheduled
+    BOOT_BLE_READY,              // BT controller and Bluedroid enabled
+    BOOT_ZIGBEE_READY,           // ZigBee stack started
+    BOOT_FIRST_SAMPLE_READ,      // First sample read from the sensor
+    BOOT_FIRST_SAMPLE_PUBLISHED, // First sample published on the measurement bus
+    BOOT_N_PHASES
+};
+
+#define BOOT_BIT(phase) (1UL << (phase))
+
+// Must be called first thing in app_main
+void boot_init(void);
+
+// Marks 'phase' as reached. Only the first call for a phase is recorded.
+void boot_mark(enum BOOT_PHASES phase);
+
+// Waits until all phases in 'phases' (a mask of BOOT_BIT) are reached. Returns false on timeout.
+bool boot_wait(uint32_t phases, TickType_t timeout);
+
+// Time 'phase' was reached in microseconds since startup, or -1 if it was not reached yet
+int64_t boot_phase_time_us(enum BOOT_PHASES phase);
+
+const char *boot_phase_to_str(enum BOOT_PHASES phase);
+
+#endif
@@ -0,0 +1,90 @@
+#include <stdatomic.h>
+#include <esp_err.h>
+#include <esp_log.h>
+#include "measurement_bus.h"
+
+_Static_assert((MEASUREMENT_BUS_LEN & (MEASUREMENT_BUS_LEN - 1)) == 0, "MEASUREMENT_BUS_LEN must be a power of two");
+
+// The ring has twice the slots of the measurements a subscriber may fall behind, so that the slot of a subscriber
+// MEASUREMENT_BUS_LEN behind is not the one being written by the next publish
+#define BUS_SLOTS (2 * MEASUREMENT_BUS_LEN)
+
+static const char *BUS_TAG = "bus";
+
+static struct SCD40measurement slots[BUS_SLOTS];
+static atomic_uint_least32_t head = 0;  // Sequence number of the next measurement to be written
+
+static struct measurement_bus_subscriber *subscribers[MEASUREMENT_BUS_MAX_SUBSCRIBERS];
+static atomic_uint_least32_t n_subscribers = 0;
+static portMUX_TYPE subscribe_lock = portMUX_INITIALIZER_UNLOCKED;
+
+esp_err_t measurement_bus_subscribe(struct measurement_bus_subscriber *sub){
+    esp_err_t err = ESP_OK;
+    sub->task = xTaskGetCurrentTaskHandle();
+    sub->cursor = atomic_load_explicit(&head, memory_order_acquire);
+    sub->dropped = 0;
+
+    taskENTER_CRITICAL(&subscribe_lock);
+    uint32_t n = atomic_load_explicit(&n_subscribers, memory_order_relaxed);
+    if (n < MEASUREMENT_BUS_MAX_SUBSCRIBERS){
+        subscribers[n] = sub;
+        atomic_store_explicit(&n_subscribers, n + 1, memory_order_release);
+    } else {
+        err = ESP_ERR_NO_MEM;
+    }
+    taskEXIT_CRITICAL(&subscribe_lock);
+
+    if (err != ESP_OK){
+        ESP_LOGE(BUS_TAG, "Too many subscribers, max is %d", MEASUREMENT_BUS_MAX_SUBSCRIBERS);
+    }
+    return err;
+}
+
+void measurement_bus_publish(const struct SCD40measurement *meas){
+    uint32_t seq = atomic_load_explicit(&head, memory_order_relaxed);
+    slots[seq & (BUS_SLOTS - 1)] = *meas;
+    atomic_store_explicit(&head, seq + 1, memory_order_release);
+
+    uint32_t n = atomic_load_explicit(&n_subscribers, memory_order_acquire);
+    for (uint32_t i = 0; i < n; i++){
+        xTaskNotifyGive(subscribers[i]->task);
+    }
+}
+
+bool measurement_bus_read(struct measurement_bus_subscriber *sub, struct SCD40measurement *meas){
+    while (1){
+        uint32_t h = atomic_load_explicit(&head, memory_order_acquire);
+        if (h == sub->cursor){
+            return false;
+        }
+
+        // Skip ahead if the producer has lapped us
+        if (h - sub->cursor > MEASUREMENT_BUS_LEN){
+            sub->dropped += h - sub->cursor - MEASUREMENT_BUS_LEN;
+            sub->cursor = h - MEASUREMENT_BUS_LEN;
+        }
+
+        *meas = slots[sub->cursor & (BUS_SLOTS - 1)];
+
+        // The slot may have been overwritten while it was copied, if the publish of the measurement BUS_SLOTS after it
+        // had begun. In that case, count it as dropped and retry.
+        atomic_thread_fence(memory_order_acquire);
+        h = atomic_load_explicit(&head, memory_order_relaxed);
+        if (h - sub->cursor >= BUS_SLOTS){
+            sub->dropped++;
+            sub->cursor++;
+            continue;
+        }
+
+        sub->cursor++;
+        return true;
+    }
+}
+
+void measurement_bus_wait(TickType_t timeout){
+    ulTaskNotifyTake(pdTRUE, timeout);
+}
+
+uint32_t measurement_bus_head(void){
+    return atomic_load_explicit(&head, memory_order_acquire);
+}
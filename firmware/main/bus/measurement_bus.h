@@ -0,0 +1,44 @@
+#ifndef _MEASUREMENT_BUS_H
+#define _MEASUREMENT_BUS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <esp_err.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "../types.h"
+
+/*
+Single-producer, multi-consumer bus for sensor measurements. The controller publishes each measurement once into a
+ring buffer, and every consumer reads it from there with its own cursor. A consumer that falls more than 
+MEASUREMENT_BUS_LEN samples behind loses the oldest ones, which is counted in its 'dropped' counter.
+
+Subscribers are owned by the consuming task (usually as a static variable), so adding a consumer costs no queue and
+no heap. Subscribers are woken with a task notification whenever a new measurement is published.
+*/
+
+#define MEASUREMENT_BUS_LEN 8               // Measurements a subscriber may fall behind by. Must be a power of two.
+#define MEASUREMENT_BUS_MAX_SUBSCRIBERS 4   // Maximum number of consumers of the bus
+
+struct measurement_bus_subscriber {
+    TaskHandle_t task;  // Task that is notified when a measurement is published
+    uint32_t cursor;    // Sequence number of the next measurement to read
+    uint32_t dropped;   // Number of measurements that were overwritten before they could be read
+};
+
+// Registers the calling task as a subscriber. Only measurements published after this call are read.
+esp_err_t measurement_bus_subscribe(struct measurement_bus_subscriber *sub);
+
+// Publishes a measurement to all subscribers. Must only be called from a single task.
+void measurement_bus_publish(const struct SCD40measurement *meas);
+
+// Reads the next unread measurement into 'meas'. Returns false if the subscriber has caught up.
+bool measurement_bus_read(struct measurement_bus_subscriber *sub, struct SCD40measurement *meas);
+
+// Blocks the calling task until a measurement is published or the timeout expires
+void measurement_bus_wait(TickType_t timeout);
+
+// Sequence number of the next measurement to be published, i.e. the number of measurements published so far
+uint32_t measurement_bus_head(void);
+
+#endif
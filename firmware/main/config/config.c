@@ -1,7 +1,11 @@
 #include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
 #include <string.h>
 #include "config.h"
 #include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "seqlock.h"
 #include "../globals.h"
 #include "../types.h"
 
@@ -11,16 +15,70 @@ If the MINICO2CONFIG struct is modified directly, code that relies on its value
 notified of the change. Also, no log statements will be produced.
 
 Every config change is published to the default event loop.
+
+Tasks read the configuration through config_snapshot(), which gives a consistent copy even while a setter is updating
+several fields. The setters serialise with a spinlock and bump the configuration version under a seqlock. Readers
+never block, and can compare config_version() with the version of their copy to skip work when nothing changed.
 */
 
 static const char *CONFIG_TAG = "config";
 
 ESP_EVENT_DEFINE_BASE(CONFIG_EVENTS);
 
+static struct seqlock config_lock = SEQLOCK_INITIALIZER;
+static portMUX_TYPE config_write_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static void config_write_begin(void)
+{
+    taskENTER_CRITICAL(&config_write_mux);
+    seqlock_write_begin(&config_lock);
+}
+
+static void config_write_end(void)
+{
+    seqlock_write_end(&config_lock);
+    taskEXIT_CRITICAL(&config_write_mux);
+}
+
+/* Returns the version of the configuration. It changes with every setter call. */
+uint32_t config_version(void){
+    return seqlock_version(&config_lock);
+}
+
+/* Copies the configuration into 'cfg' and returns the version of the copy */
+uint32_t config_snapshot(struct minico2_cfg_s *cfg){
+    uint32_t version;
+    do {
+        version = seqlock_read_begin(&config_lock);
+        *cfg = MINICO2CONFIG;
+    } while (seqlock_read_retry(&config_lock, version));
+    return version;
+}
+
+/* Refreshes 'cfg' only if the configuration changed since 'version', which is then updated. Returns true if it did. 
+Initialise 'version' to CONFIG_VERSION_NONE to force the first refresh. */
+bool config_snapshot_if_changed(struct minico2_cfg_s *cfg, uint32_t *version){
+    if (config_version() == *version){
+        return false;
+    }
+    *version = config_snapshot(cfg);
+    return true;
+}
+
+/* Replaces the whole configuration with 'cfg' as one change, which readers see as a new version. Used to publish the
+configuration loaded from NVS. Posts no events. */
+void config_replace(const struct minico2_cfg_s *cfg){
+    config_write_begin();
+    MINICO2CONFIG = *cfg;
+    config_write_end();
+}
+
 /* Enable or disable the printing of sensor measurements to the USB port */
 void set_print_sensor_readings(bool enabled){
+    config_write_begin();
     MINICO2CONFIG.serial_print_enabled = enabled;
-    if (MINICO2CONFIG.serial_print_enabled){
+    config_write_end();
+    if (enabled){
         ESP_LOGI(CONFIG_TAG, "Printing of measurements to the serial port ENABLED");
     }else{
         ESP_LOGI(CONFIG_TAG, "Printing of measurements to the serial port DISABLED");
@@ -28,6 +86,19 @@ void set_print_sensor_readings(bool enabled){
     ESP_ERROR_CHECK(esp_event_post(CONFIG_EVENTS, PRINT_SENSOR_READINGS_EVENT, NULL, 0, portMAX_DELAY));
 }
 
+/* Set the format of the sensor readings printed to the USB port */
+void set_serial_format(enum SERIAL_FORMATS format){
+    if (format != SERIAL_FORMAT_TEXT && format != SERIAL_FORMAT_BINARY){
+        ESP_LOGE(CONFIG_TAG, "Invalid serial format %d", format);
+        return;
+    }
+    config_write_begin();
+    MINICO2CONFIG.serial_format = format;
+    config_write_end();
+    ESP_LOGI(CONFIG_TAG, "Measurements are printed as %s", format == SERIAL_FORMAT_BINARY ? "BINARY frames" : "TEXT");
+    ESP_ERROR_CHECK(esp_event_post(CONFIG_EVENTS, SERIAL_FORMAT_EVENT, NULL, 0, portMAX_DELAY));
+}
+
 /* Set the nickname of the MiniCO2 */
 void set_nickname(char *nickname){
     if (strlen(nickname) > 128){
@@ -35,18 +106,23 @@ void set_nickname(char *nickname){
         return;
     }
 
-    snprintf(MINICO2CONFIG.name, 128, nickname);
-    ESP_LOGI(CONFIG_TAG, "Nickname set to '%s'", MINICO2CONFIG.name);
+    char name [sizeof(MINICO2CONFIG.name)];
+    snprintf(name, sizeof(name), "%s", nickname);
+    config_write_begin();
+    memcpy(MINICO2CONFIG.name, name, sizeof(name));
+    config_write_end();
+    ESP_LOGI(CONFIG_TAG, "Nickname set to '%s'", name);
     ESP_ERROR_CHECK(esp_event_post(CONFIG_EVENTS, NICKNAME_EVENT, NULL, 0, portMAX_DELAY));
 }
 
-/* Set the measurement period in seconds. The value is clamped to the range (5 seconds, 1 year). */
+/* Set the measurement period in seconds. The value is clamped to the range (5 seconds, 65535 seconds). */
 void set_measurement_period(int period){
     if (period < 5){period = 5;}
-    if (period > 60*60*24*365){period = 60*60*24*365;}
+    if (period > UINT16_MAX){period = UINT16_MAX;}  // The widest the field holds, about 18 hours
+    config_write_begin();
     MINICO2CONFIG.measurement_period = period;
-    int p = MINICO2CONFIG.measurement_period;
-    ESP_LOGI(CONFIG_TAG, "Measurement period set to %d hours, %d minutes, %d seconds.", p / 3600, (p % 3600) / 60, p % 60);
+    config_write_end();
+    ESP_LOGI(CONFIG_TAG, "Measurement period set to %d hours, %d minutes, %d seconds.", period / 3600, (period % 3600) / 60, period % 60);
     ESP_ERROR_CHECK(esp_event_post(CONFIG_EVENTS, MEASUREMENT_PERIOD_EVENT, NULL, 0, portMAX_DELAY));
 }
 
@@ -54,8 +130,10 @@ void set_measurement_period(int period){
 void set_led_brightness(float brightness){
     if (brightness < 0.0){brightness = 0;}
     if (brightness > 1.0){brightness = 1;}
+    config_write_begin();
     MINICO2CONFIG.led_cfg.brightness = brightness;
-    ESP_LOGI(CONFIG_TAG, "LED brightness set to %d percent", (int)(MINICO2CONFIG.led_cfg.brightness * 100));
+    config_write_end();
+    ESP_LOGI(CONFIG_TAG, "LED brightness set to %d percent", (int)(brightness * 100));
     ESP_ERROR_CHECK(esp_event_post(CONFIG_EVENTS, LED_BRIGHTNESS_EVENT, NULL, 0, portMAX_DELAY));
 }
 
@@ -69,53 +147,100 @@ void set_led_co2_limits(uint16_t medium_limit, uint16_t high_limit, uint16_t cri
         medium_limit = high_limit;
         ESP_LOGE(CONFIG_TAG, "CO2 medium limit forced to high limit %d", high_limit);
     }
+    config_write_begin();
     MINICO2CONFIG.led_cfg.limit_medium = medium_limit;
     MINICO2CONFIG.led_cfg.limit_high = high_limit;
     MINICO2CONFIG.led_cfg.limit_critical = critical_limit;
+    config_write_end();
     ESP_LOGI(CONFIG_TAG, "LED CO2 limit set to MEDIUM: %d PPM, HIGH: %d PPM, CRITICAL: %d PPM", 
-    MINICO2CONFIG.led_cfg.limit_medium, MINICO2CONFIG.led_cfg.limit_high, MINICO2CONFIG.led_cfg.limit_critical);
+    medium_limit, high_limit, critical_limit);
     ESP_ERROR_CHECK(esp_event_post(CONFIG_EVENTS, CO2_LIMITS_EVENT, NULL, 0, portMAX_DELAY));
 }
 
+/* Set the outdoor CO2 concentration in PPM, towards which the ventilation estimator fits the decay. The value is 
+clamped to the range (OUTDOOR_CO2_MIN, OUTDOOR_CO2_MAX). */
+void set_outdoor_co2(int ppm){
+    if (ppm < OUTDOOR_CO2_MIN){ppm = OUTDOOR_CO2_MIN;}
+    if (ppm > OUTDOOR_CO2_MAX){ppm = OUTDOOR_CO2_MAX;}
+    config_write_begin();
+    MINICO2CONFIG.outdoor_co2 = ppm;
+    config_write_end();
+    ESP_LOGI(CONFIG_TAG, "Outdoor CO2 baseline set to %d PPM", ppm);
+    ESP_ERROR_CHECK(esp_event_post(CONFIG_EVENTS, OUTDOOR_CO2_EVENT, NULL, 0, portMAX_DELAY));
+}
+
+/* Enable or disable adaptive sampling. When enabled, the measurement period is the longest period. */
+void set_adaptive_sampling(bool enabled){
+    config_write_begin();
+    MINICO2CONFIG.adaptive_sampling = enabled;
+    config_write_end();
+    if (enabled){
+        ESP_LOGI(CONFIG_TAG, "Adaptive sampling ENABLED");
+    }else{
+        ESP_LOGI(CONFIG_TAG, "Adaptive sampling DISABLED");
+    }
+    ESP_ERROR_CHECK(esp_event_post(CONFIG_EVENTS, ADAPTIVE_SAMPLING_EVENT, NULL, 0, portMAX_DELAY));
+}
+
+#define CONFIG_LINES 12
+#define CONFIG_LINE_MAX 160  // The nickname and its label
+
+// Places line 'line' of the string representation of 'config' into the buffer 'str'
+static void config_line(char *str, size_t len, const struct minico2_cfg_s *config, int line)
+{
+    switch (line){
+    case 0: snprintf(str, len, "Nickname                 : %s", config->name); break;
+    case 1: snprintf(str, len, "Measurement period       : %d seconds", config->measurement_period); break;
+    case 2: snprintf(str, len, "Print measurements       : %s", 
+                     config->serial_print_enabled ? "ENABLED" : "DISABLED"); break;
+    case 3: snprintf(str, len, "Print format             : %s", 
+                     config->serial_format == SERIAL_FORMAT_BINARY ? "BINARY" : "TEXT"); break;
+    case 4: snprintf(str, len, "BLE                      : %s", config->ble_enabled ? "ENABLED" : "DISABLED"); break;
+    case 5: snprintf(str, len, "Zigbee                   : %s", config->zigbee_enabled ? "ENABLED" : "DISABLED"); break;
+    case 6: snprintf(str, len, "LED - brightness         : %d percent", (int)(config->led_cfg.brightness*100)); break;
+    case 7: snprintf(str, len, "LED - Medium CO2 limit   : %d PPM", config->led_cfg.limit_medium); break;
+    case 8: snprintf(str, len, "LED - High CO2 limit     : %d PPM", config->led_cfg.limit_high); break;
+    case 9: snprintf(str, len, "LED - Critical CO2 limit : %d PPM", config->led_cfg.limit_critical); break;
+    case 10: snprintf(str, len, "Outdoor CO2 baseline     : %d PPM", config->outdoor_co2); break;
+    case 11: snprintf(str, len, "Adaptive sampling        : %s", config->adaptive_sampling ? "ENABLED" : "DISABLED"); break;
+    default: str[0] = '\0'; break;
+    }
+}
+
 // Places the string representation of a minico2_cfg_s configuration struct into the buffer 'str'.
 void config_to_str(char *str, size_t len, struct minico2_cfg_s *config)
 {
-    snprintf(str, len,
-    "Nickname                 : %s\n"
-    "Measurement period       : %d seconds\n"
-    "Print measurements       : %s\n"
-    "BLE                      : %s\n"
-    "Zigbee                   : %s\n"
-    "LED - brightness         : %d percent\n"
-    "LED - Medium CO2 limit   : %d PPM\n"
-    "LED - High CO2 limit     : %d PPM\n"
-    "LED - Critical CO2 limit : %d PPM", 
-    config->name, 
-    config->measurement_period, 
-    config->serial_print_enabled ? "ENABLED" : "DISABLED",
-    config->ble_enabled ? "ENABLED" : "DISABLED",
-    config->zigbee_enabled ? "ENABLED" : "DISABLED",
-    (int)(config->led_cfg.brightness*100),
-    config->led_cfg.limit_medium,
-    config->led_cfg.limit_high,
-    config->led_cfg.limit_critical
-    );
-}
-
-// Logs the configuration struct 'config' to the serial port
+    char line[CONFIG_LINE_MAX];
+    size_t used = 0;
+    if (len > 0){str[0] = '\0';}
+    for (int i = 0; i < CONFIG_LINES && used < len; i++){
+        config_line(line, sizeof(line), config, i);
+        int n = snprintf(str + used, len - used, i == 0 ? "%s" : "\n%s", line);
+        if (n < 0){break;}
+        used += n;
+    }
+}
+
+// Logs the configuration struct 'config' to the serial port, one line at a time, so that no line is longer than a
+// log line of the serial output (see serial/serial_out.h)
 void log_config(struct minico2_cfg_s *config)
 {
-    char config_str [1024] = "";
-    config_to_str(config_str, sizeof(config_str), config);
-    ESP_LOGI(CONFIG_TAG, "\n%s", config_str);
+    char line[CONFIG_LINE_MAX];
+    for (int i = 0; i < CONFIG_LINES; i++){
+        config_line(line, sizeof(line), config, i);
+        ESP_LOGI(CONFIG_TAG, "%s", line);
+    }
 }
 
 // Resets the configuration to default values
 void reset_config(){
     set_print_sensor_readings(MINICO2CONFIG_DEFAULT.serial_print_enabled);
+    set_serial_format(MINICO2CONFIG_DEFAULT.serial_format);
     set_nickname(&MINICO2CONFIG_DEFAULT.name);
     set_measurement_period(MINICO2CONFIG_DEFAULT.measurement_period);
     struct led_cfg_s led_cfg = MINICO2CONFIG_DEFAULT.led_cfg;
     set_led_brightness(led_cfg.brightness);
     set_led_co2_limits(led_cfg.limit_medium, led_cfg.limit_high, led_cfg.limit_critical);
+    set_outdoor_co2(MINICO2CONFIG_DEFAULT.outdoor_co2);
+    set_adaptive_sampling(MINICO2CONFIG_DEFAULT.adaptive_sampling);
 }
\ No newline at end of file
@@ -3,13 +3,27 @@
 
 #include <esp_event.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include "../types.h"
 
+#define CONFIG_VERSION_NONE 1  // Never a valid config version
+
+#define OUTDOOR_CO2_MIN 300
+#define OUTDOOR_CO2_MAX 1000
+
+uint32_t config_version(void);
+uint32_t config_snapshot(struct minico2_cfg_s *cfg);
+bool config_snapshot_if_changed(struct minico2_cfg_s *cfg, uint32_t *version);
+void config_replace(const struct minico2_cfg_s *cfg);
+
 void set_print_sensor_readings(bool enabled);
+void set_serial_format(enum SERIAL_FORMATS format);
 void set_nickname(char *nickname);
 void set_measurement_period(int period);
 void set_led_brightness(float brightness);
 void set_led_co2_limits(uint16_t medium_limit, uint16_t high_limit, uint16_t critical_limit);
+void set_outdoor_co2(int ppm);
+void set_adaptive_sampling(bool enabled);
 
 void config_to_str(char *str, size_t len, struct minico2_cfg_s *config);
 void log_config(struct minico2_cfg_s *config);
@@ -22,7 +36,10 @@ enum {                                  // Declaration of the specific config ev
     NICKNAME_EVENT,                     // Sensor nickname changed
     MEASUREMENT_PERIOD_EVENT,           // Measurement period changed
     LED_BRIGHTNESS_EVENT,               // LED brightness changed
-    CO2_LIMITS_EVENT                    // CO2 LED limits changed
+    CO2_LIMITS_EVENT,                   // CO2 LED limits changed
+    SERIAL_FORMAT_EVENT,                // Format of the printed sensor readings changed
+    OUTDOOR_CO2_EVENT,                  // Outdoor CO2 baseline changed
+    ADAPTIVE_SAMPLING_EVENT             // Adaptive sampling setting changed
 };
 
 #endif
\ No newline at end of file
@@ -1,69 +1,294 @@
 /* Functions for the saving and loading of the minico2 configuration to non-volatile storage (NVS) */
+#include <string.h>
 #include <nvs_flash.h>
 #include <nvs.h>
 #include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_system.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
 #include "../globals.h"
 #include "../types.h"
 #include "config.h"
 #include "loadsave.h"
+#include "../trace/trace.h"
+#include "../diag/diag.h"
+
+/*
+Every config field is stored under its own NVS key. A config change only marks its fields dirty. The save task writes 
+them once the changes have settled for CONFIG_SAVE_DEBOUNCE_MS, so a burst of changes (like 'config -reset') costs 
+a single commit. Fields whose value matches what is already in NVS are not written at all. flush_config() writes 
+pending changes immediately, and runs on every esp_restart().
+*/
 
 static const char* LOADSAVE_TAG = "config_save&load";
 static const char* STORAGE_NAMESPACE = "minico2";
+static const char* LEGACY_BLOB_KEY = "config";  // Whole-struct blob written by earlier firmware
 
-esp_err_t save_config() {
-    nvs_handle_t nvs_handle;
-    esp_err_t err;
+#define CONFIG_SAVE_TASK_STACK (configMINIMAL_STACK_SIZE * 4)
+static StackType_t save_task_stack[CONFIG_SAVE_TASK_STACK];
+static StaticTask_t save_task_buffer;
+static StaticSemaphore_t flush_mutex_buffer;
 
-    // Open NVS handle
-    err = nvs_open(STORAGE_NAMESPACE, NVS_READWRITE, &nvs_handle);
-    if (err != ESP_OK) {
-        ESP_LOGE(LOADSAVE_TAG, "Error opening NVS handle for writing: %s", esp_err_to_name(err));
-        return err;
+enum CONFIG_FIELDS {
+    FIELD_NAME          = 1 << 0,
+    FIELD_PERIOD        = 1 << 1,
+    FIELD_PRINT         = 1 << 2,
+    FIELD_BLE           = 1 << 3,
+    FIELD_ZIGBEE        = 1 << 4,
+    FIELD_BRIGHTNESS    = 1 << 5,
+    FIELD_LIMITS        = 1 << 6,
+    FIELD_FORMAT        = 1 << 7,
+    FIELD_OUTDOOR_CO2   = 1 << 8,
+    FIELD_ADAPTIVE      = 1 << 9,
+    FIELD_ALL           = (1 << 10) - 1
+};
+
+static struct minico2_cfg_s saved;  // The config as it is stored in NVS
+static uint32_t stored = 0;         // Fields that have a key in NVS
+static uint32_t dirty = 0;          // Fields changed since the last flush
+static portMUX_TYPE dirty_lock = portMUX_INITIALIZER_UNLOCKED;
+static SemaphoreHandle_t flush_mutex = NULL;
+static TaskHandle_t save_task_handle = NULL;
+static struct config_storage_stats stats = {0};
+
+static uint32_t fields_of_event(int32_t id)
+{
+    switch (id){
+        case PRINT_SENSOR_READINGS_EVENT: return FIELD_PRINT;
+        case NICKNAME_EVENT: return FIELD_NAME;
+        case MEASUREMENT_PERIOD_EVENT: return FIELD_PERIOD;
+        case LED_BRIGHTNESS_EVENT: return FIELD_BRIGHTNESS;
+        case CO2_LIMITS_EVENT: return FIELD_LIMITS;
+        case SERIAL_FORMAT_EVENT: return FIELD_FORMAT;
+        case OUTDOOR_CO2_EVENT: return FIELD_OUTDOOR_CO2;
+        case ADAPTIVE_SAMPLING_EVENT: return FIELD_ADAPTIVE;
+        default: return FIELD_ALL;
     }
+}
 
-    // Write configuration blob
-    err = nvs_set_blob(nvs_handle, "config", &MINICO2CONFIG, sizeof(MINICO2CONFIG));
+static void mark_dirty(uint32_t fields)
+{
+    taskENTER_CRITICAL(&dirty_lock);
+    dirty |= fields;
+    taskEXIT_CRITICAL(&dirty_lock);
+}
+
+// Returns the fields of 'fields' whose value differs from what is in NVS
+static uint32_t changed_fields(uint32_t fields, const struct minico2_cfg_s *cfg)
+{
+    uint32_t changed = fields & ~stored;
+    if (strcmp(cfg->name, saved.name) != 0){changed |= FIELD_NAME;}
+    if (cfg->measurement_period != saved.measurement_period){changed |= FIELD_PERIOD;}
+    if (cfg->serial_print_enabled != saved.serial_print_enabled){changed |= FIELD_PRINT;}
+    if (cfg->ble_enabled != saved.ble_enabled){changed |= FIELD_BLE;}
+    if (cfg->zigbee_enabled != saved.zigbee_enabled){changed |= FIELD_ZIGBEE;}
+    if (cfg->led_cfg.brightness != saved.led_cfg.brightness){changed |= FIELD_BRIGHTNESS;}
+    if ((cfg->led_cfg.limit_medium != saved.led_cfg.limit_medium) || (cfg->led_cfg.limit_high != saved.led_cfg.limit_high) ||
+        (cfg->led_cfg.limit_critical != saved.led_cfg.limit_critical)){changed |= FIELD_LIMITS;}
+    if (cfg->serial_format != saved.serial_format){changed |= FIELD_FORMAT;}
+    if (cfg->outdoor_co2 != saved.outdoor_co2){changed |= FIELD_OUTDOOR_CO2;}
+    if (cfg->adaptive_sampling != saved.adaptive_sampling){changed |= FIELD_ADAPTIVE;}
+    return changed & fields;
+}
+
+static esp_err_t write_fields(nvs_handle_t h, uint32_t fields, const struct minico2_cfg_s *cfg)
+{
+    esp_err_t err = ESP_OK;
+    if ((fields & FIELD_NAME) && err == ESP_OK){
+        err = nvs_set_str(h, "name", cfg->name);
+        stats.writes++;
+    }
+    if ((fields & FIELD_PERIOD) && err == ESP_OK){
+        err = nvs_set_u16(h, "period", cfg->measurement_period);
+        stats.writes++;
+    }
+    if ((fields & FIELD_PRINT) && err == ESP_OK){
+        err = nvs_set_u8(h, "print", cfg->serial_print_enabled);
+        stats.writes++;
+    }
+    if ((fields & FIELD_BLE) && err == ESP_OK){
+        err = nvs_set_u8(h, "ble", cfg->ble_enabled);
+        stats.writes++;
+    }
+    if ((fields & FIELD_ZIGBEE) && err == ESP_OK){
+        err = nvs_set_u8(h, "zigbee", cfg->zigbee_enabled);
+        stats.writes++;
+    }
+    if ((fields & FIELD_BRIGHTNESS) && err == ESP_OK){
+        uint32_t bits;  // NVS has no float type
+        memcpy(&bits, &cfg->led_cfg.brightness, sizeof(bits));
+        err = nvs_set_u32(h, "led_bright", bits);
+        stats.writes++;
+    }
+    if ((fields & FIELD_LIMITS) && err == ESP_OK){
+        uint16_t limits[3] = {cfg->led_cfg.limit_medium, cfg->led_cfg.limit_high, cfg->led_cfg.limit_critical};
+        err = nvs_set_blob(h, "co2_limits", limits, sizeof(limits));
+        stats.writes++;
+    }
+    if ((fields & FIELD_FORMAT) && err == ESP_OK){
+        err = nvs_set_u8(h, "serial_fmt", cfg->serial_format);
+        stats.writes++;
+    }
+    if ((fields & FIELD_OUTDOOR_CO2) && err == ESP_OK){
+        err = nvs_set_u16(h, "outdoor_co2", cfg->outdoor_co2);
+        stats.writes++;
+    }
+    if ((fields & FIELD_ADAPTIVE) && err == ESP_OK){
+        err = nvs_set_u8(h, "adaptive", cfg->adaptive_sampling);
+        stats.writes++;
+    }
+    return err;
+}
+
+esp_err_t flush_config(void)
+{
+    if (flush_mutex == NULL){return ESP_ERR_INVALID_STATE;}
+    xSemaphoreTake(flush_mutex, portMAX_DELAY);
+
+    taskENTER_CRITICAL(&dirty_lock);
+    uint32_t fields = dirty;
+    dirty = 0;
+    taskEXIT_CRITICAL(&dirty_lock);
+
+    struct minico2_cfg_s cfg;
+    config_snapshot(&cfg);
+    fields = changed_fields(fields, &cfg);
+    if (fields == 0){
+        xSemaphoreGive(flush_mutex);
+        return ESP_OK;
+    }
+
+    int64_t start = esp_timer_get_time();
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open(STORAGE_NAMESPACE, NVS_READWRITE, &nvs_handle);
     if (err != ESP_OK) {
-        ESP_LOGE(LOADSAVE_TAG, "Error writing config to NVS: %s", esp_err_to_name(err));
+        ESP_LOGE(LOADSAVE_TAG, "Error opening NVS handle for writing: %s", esp_err_to_name(err));
+    } else {
+        err = write_fields(nvs_handle, fields, &cfg);
+        if (err != ESP_OK) {
+            ESP_LOGE(LOADSAVE_TAG, "Error writing config to NVS: %s", esp_err_to_name(err));
+        } else {
+            TRACE(TRACE_NVS_COMMIT_BEGIN, 0);
+            err = nvs_commit(nvs_handle);
+            TRACE(TRACE_NVS_COMMIT_END, err);
+            stats.commits++;
+            if (err != ESP_OK) {
+                ESP_LOGE(LOADSAVE_TAG, "Error committing NVS changes: %s", esp_err_to_name(err));
+            }
+        }
         nvs_close(nvs_handle);
-        return err;
     }
 
-    // Commit changes
-    err = nvs_commit(nvs_handle);
-    if (err != ESP_OK) {
-        ESP_LOGE(LOADSAVE_TAG, "Error committing NVS changes: %s", esp_err_to_name(err));
+    if (err == ESP_OK){
+        saved = cfg;
+        stored |= fields;
+    } else {
+        mark_dirty(fields);  // Retried on the next flush
     }
 
-    nvs_close(nvs_handle);
+    int64_t duration = esp_timer_get_time() - start;
+    stats.flushes++;
+    stats.flush_us_total += duration;
+    if (duration > stats.flush_us_max){stats.flush_us_max = duration;}
+    ESP_LOGD(LOADSAVE_TAG, "Flushed config fields 0x%02x in %d us", (unsigned)fields, (int)duration);
+
+    xSemaphoreGive(flush_mutex);
     return err;
 }
 
+void config_storage_get_stats(struct config_storage_stats *out)
+{
+    xSemaphoreTake(flush_mutex, portMAX_DELAY);
+    *out = stats;
+    xSemaphoreGive(flush_mutex);
+}
+
+// Reads every field that has a key in NVS into 'cfg'. Fields without a key keep their value and are marked dirty.
+static void read_fields(nvs_handle_t h, struct minico2_cfg_s *cfg)
+{
+    size_t len = sizeof(cfg->name);
+    if (nvs_get_str(h, "name", cfg->name, &len) == ESP_OK){stored |= FIELD_NAME;}
+    if (nvs_get_u16(h, "period", &cfg->measurement_period) == ESP_OK){stored |= FIELD_PERIOD;}
+    uint8_t flag;
+    if (nvs_get_u8(h, "print", &flag) == ESP_OK){
+        cfg->serial_print_enabled = flag;
+        stored |= FIELD_PRINT;
+    }
+    if (nvs_get_u8(h, "ble", &flag) == ESP_OK){
+        cfg->ble_enabled = flag;
+        stored |= FIELD_BLE;
+    }
+    if (nvs_get_u8(h, "zigbee", &flag) == ESP_OK){
+        cfg->zigbee_enabled = flag;
+        stored |= FIELD_ZIGBEE;
+    }
+    uint32_t bits;
+    if (nvs_get_u32(h, "led_bright", &bits) == ESP_OK){
+        memcpy(&cfg->led_cfg.brightness, &bits, sizeof(bits));
+        stored |= FIELD_BRIGHTNESS;
+    }
+    uint16_t limits[3];
+    len = sizeof(limits);
+    if (nvs_get_blob(h, "co2_limits", limits, &len) == ESP_OK && len == sizeof(limits)){
+        cfg->led_cfg.limit_medium = limits[0];
+        cfg->led_cfg.limit_high = limits[1];
+        cfg->led_cfg.limit_critical = limits[2];
+        stored |= FIELD_LIMITS;
+    }
+    if (nvs_get_u8(h, "serial_fmt", &flag) == ESP_OK){
+        cfg->serial_format = flag;
+        stored |= FIELD_FORMAT;
+    }
+    if (nvs_get_u16(h, "outdoor_co2", &cfg->outdoor_co2) == ESP_OK){stored |= FIELD_OUTDOOR_CO2;}
+    if (nvs_get_u8(h, "adaptive", &flag) == ESP_OK){
+        cfg->adaptive_sampling = flag;
+        stored |= FIELD_ADAPTIVE;
+    }
+    mark_dirty(FIELD_ALL & ~stored);
+}
+
 esp_err_t load_config() {
     nvs_handle_t nvs_handle;
     esp_err_t err;
 
-    // Open NVS handle
-    err = nvs_open(STORAGE_NAMESPACE, NVS_READONLY, &nvs_handle);
+    // The fields are read into a copy, which is published as one new version of the config once loaded. Tasks that 
+    // took a snapshot of the defaults before then see it change.
+    struct minico2_cfg_s cfg = MINICO2CONFIG_DEFAULT;
+    config_replace(&cfg);
+    saved = cfg;
+
+    // Open NVS handle. Read-write, as a read-only open fails while the namespace does not exist yet.
+    err = nvs_open(STORAGE_NAMESPACE, NVS_READWRITE, &nvs_handle);
     if (err != ESP_OK) {
         ESP_LOGE(LOADSAVE_TAG, "Error opening NVS handle for reading: %s. Using defaults", esp_err_to_name(err));
-        MINICO2CONFIG = MINICO2CONFIG_DEFAULT;
-        return save_config();
+        mark_dirty(FIELD_ALL);
+        return flush_config();
     }
 
-    // Read configuration
-    size_t required_size = sizeof(MINICO2CONFIG);
-    err = nvs_get_blob(nvs_handle, "config", &MINICO2CONFIG, &required_size);
-    
-    if (err != ESP_OK) {
-        ESP_LOGI(LOADSAVE_TAG, "No saved config found. Using defaults");
-        MINICO2CONFIG = MINICO2CONFIG_DEFAULT;
-        nvs_close(nvs_handle);
-        save_config();
+    // Migrate the config blob of earlier firmware to per-field keys
+    size_t required_size = sizeof(cfg);
+    if (nvs_get_blob(nvs_handle, LEGACY_BLOB_KEY, &cfg, &required_size) == ESP_OK) {
+        ESP_LOGI(LOADSAVE_TAG, "Migrating saved config to per-field keys");
+        config_replace(&cfg);
+        mark_dirty(FIELD_ALL);
+        err = flush_config();
+        if (err == ESP_OK){
+            nvs_erase_key(nvs_handle, LEGACY_BLOB_KEY);
+            nvs_commit(nvs_handle);
+        }
     } else {
-        ESP_LOGI(LOADSAVE_TAG, "Loaded config");
-        log_config(&MINICO2CONFIG);
+        read_fields(nvs_handle, &cfg);
+        config_replace(&cfg);
+        saved = cfg;
+        if (stored == 0){
+            ESP_LOGI(LOADSAVE_TAG, "No saved config found. Using defaults");
+        }
+        err = flush_config();  // Writes the defaults of fields not stored yet
     }
+    ESP_LOGI(LOADSAVE_TAG, "Loaded config");
+    log_config(&cfg);
 
     nvs_close(nvs_handle);
     return err;
@@ -71,12 +296,35 @@ esp_err_t load_config() {
 
 static void config_state_change_handler(void* handler_args, esp_event_base_t base, int32_t id, void* event_data)
 {
+    // Runs on the default event loop, so it only records the change. The save task does the writing.
     ESP_LOGD(LOADSAVE_TAG, "config_state_change_handler received event");
-    ESP_ERROR_CHECK(save_config());
+    taskENTER_CRITICAL(&dirty_lock);
+    dirty |= fields_of_event(id);
+    stats.events++;
+    taskEXIT_CRITICAL(&dirty_lock);
+    xTaskNotifyGive(save_task_handle);
 }
 
-esp_err_t init_config_storage(void) {
-    // Initialize NVS and load the configuration. Connect to the event loop to save the config whenever it changes.
+static void config_save_task(void *pvParameters)
+{
+    while (1){
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        // Wait until no change arrived for the debounce window, or the maximum delay has passed
+        TickType_t first_change = xTaskGetTickCount();
+        while ((xTaskGetTickCount() - first_change < pdMS_TO_TICKS(CONFIG_SAVE_MAX_DELAY_MS)) &&
+               (ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(CONFIG_SAVE_DEBOUNCE_MS)) > 0)){}
+
+        ESP_ERROR_CHECK_WITHOUT_ABORT(flush_config());
+    }
+}
+
+static void flush_config_on_shutdown(void)
+{
+    flush_config();
+}
+
+esp_err_t init_nvs(void) {
     esp_err_t err = nvs_flash_init();
     
     // Handle case where NVS partition was truncated
@@ -92,13 +340,31 @@ esp_err_t init_config_storage(void) {
         }
     }
     ESP_LOGI(LOADSAVE_TAG, "Initialized NVS flash");
+    return ESP_OK;
+}
+
+esp_err_t init_config_storage(void) {
+    // Load the configuration. Connect to the event loop to save the config whenever it changes.
+    esp_err_t err;
+    flush_mutex = xSemaphoreCreateMutexStatic(&flush_mutex_buffer);
+    if (flush_mutex == NULL){
+        return ESP_ERR_NO_MEM;
+    }
+
     err = load_config();
     if (err != ESP_OK) {
         return err;
     }
 
-    // Register event handler to save the config to NVS whenever it changes
+    // Start the task that saves changes, then register the event handler that feeds it
+    save_task_handle = xTaskCreateStatic(config_save_task, "config_save_task", CONFIG_SAVE_TASK_STACK, NULL, 5, 
+                                         save_task_stack, &save_task_buffer);
+    diag_register_task(save_task_handle, CONFIG_SAVE_TASK_STACK);
+    err = esp_register_shutdown_handler(flush_config_on_shutdown);
+    if (err != ESP_OK) {
+        return err;
+    }
     err = esp_event_handler_instance_register(CONFIG_EVENTS, ESP_EVENT_ANY_ID, config_state_change_handler, NULL, NULL);
 
     return err;
-}
\ No newline at end of file
+}
@@ -1,2 +1,29 @@
+#ifndef _LOADSAVE_H
+#define _LOADSAVE_H
+
 #include <esp_log.h>
-esp_err_t init_config_storage(void);
\ No newline at end of file
+#include <stdint.h>
+
+// Changes are written to NVS once no further change arrived for this long...
+#define CONFIG_SAVE_DEBOUNCE_MS 2000
+// ...but never later than this after the first unsaved change
+#define CONFIG_SAVE_MAX_DELAY_MS 10000
+
+struct config_storage_stats {
+    uint32_t events;         // Config change events received
+    uint32_t flushes;        // Flushes that had dirty fields
+    uint32_t writes;         // NVS keys written
+    uint32_t commits;        // NVS commits
+    int64_t flush_us_max;    // Longest flush
+    int64_t flush_us_total;  // Total time spent flushing
+};
+
+// Initializes NVS for the whole firmware, erasing it if its layout is outdated. Call once, before anything uses NVS.
+esp_err_t init_nvs(void);
+
+// Loads the configuration from NVS and starts saving it on changes. Requires init_nvs().
+esp_err_t init_config_storage(void);
+esp_err_t flush_config(void);
+void config_storage_get_stats(struct config_storage_stats *stats);
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef _SEQLOCK_H
+#define _SEQLOCK_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+Sequence lock. Lets readers take a consistent copy of data that is shared with a writer without blocking the writer or
+each other. The sequence number is odd while a write is in progress and is incremented by two for every write, so it 
+doubles as a version number of the data. Writers must be serialised by the caller. 
+
+Reader:
+    uint32_t seq;
+    do {
+        seq = seqlock_read_begin(&lock);
+        copy = data;
+    } while (seqlock_read_retry(&lock, seq));
+*/
+
+struct seqlock {
+    uint32_t seq;
+};
+
+#define SEQLOCK_INITIALIZER {0}
+
+// Returns the current version of the data. Odd while a write is in progress.
+static inline uint32_t seqlock_version(const struct seqlock *lock)
+{
+    return __atomic_load_n(&lock->seq, __ATOMIC_ACQUIRE);
+}
+
+static inline uint32_t seqlock_read_begin(const struct seqlock *lock)
+{
+    uint32_t seq;
+    while ((seq = seqlock_version(lock)) & 1){}
+    return seq;
+}
+
+// Returns true if the data was written while it was being read, in which case the read must be repeated
+static inline bool seqlock_read_retry(const struct seqlock *lock, uint32_t seq)
+{
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(&lock->seq, __ATOMIC_RELAXED) != seq;
+}
+
+static inline void seqlock_write_begin(struct seqlock *lock)
+{
+    __atomic_store_n(&lock->seq, lock->seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static inline void seqlock_write_end(struct seqlock *lock)
+{
+    __atomic_store_n(&lock->seq, lock->seq + 1, __ATOMIC_RELEASE);
+}
+
+#endif
@@ -1,14 +1,34 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <inttypes.h>
 #include "esp_system.h"
 #include "esp_log.h"
 #include "esp_err.h"
 #include "esp_console.h"
+#include "esp_timer.h"
 #include "argtable3/argtable3.h"
 #include "cmd_system_common.h"
 #include "../types.h"
 #include "../globals.h"
 #include "../config/config.h"
+#include "../config/loadsave.h"
+#include "../scd40/scd40.h"
+#include "../scd40/adaptive_sampling.h"
+#include "../ble/ble.h"
+#include "../history/history.h"
+#include "../tslog/tslog.h"
+#include "../bench/bench.h"
+#include "../latency/latency.h"
+#include "../trace/trace.h"
+#include "../diag/diag.h"
+#include "../boot/boot.h"
+#include "../serial/serial_out.h"
+#include "../stats/rollstats.h"
+#include "../stats/ventilation.h"
+#if SIMULATE_SCD4X
+#include "../scd40/scd4x_sim.h"
+#endif
 
 /*
  * We warn if a secondary serial console is enabled. A secondary serial console is always output-only and
@@ -26,7 +46,9 @@ static const char *CONSOLE_TAG = "MINICO2";
 
 static int console_toggle_print_readings(int argc, char **argv)
 {
-    set_print_sensor_readings(!MINICO2CONFIG.serial_print_enabled);
+    struct minico2_cfg_s config;
+    config_snapshot(&config);
+    set_print_sensor_readings(!config.serial_print_enabled);
     return 0;
 }
 
@@ -48,6 +70,61 @@ static void register_toggle_print_readings(void){
 }
 
 
+/** Arguments used by 'console_serial_format' function */
+static struct {
+    struct arg_str *format;
+    struct arg_end *end;
+} serial_format_args;
+
+static int console_serial_format(int argc, char **argv)
+{
+    int nerrors = arg_parse(argc, argv, (void **) &serial_format_args);
+    if (nerrors != 0) {
+        arg_print_errors(stderr, serial_format_args.end, argv[0]);
+        return 1;
+    }
+    if (serial_format_args.format->count > 0){
+        const char *format = serial_format_args.format->sval[0];
+        if (strcmp(format, "text") == 0){
+            set_serial_format(SERIAL_FORMAT_TEXT);
+        } else if (strcmp(format, "binary") == 0){
+            set_serial_format(SERIAL_FORMAT_BINARY);
+        } else {
+            printf("Invalid serial format '%s'\n", format);
+            return 1;
+        }
+        return 0;
+    }
+
+    struct minico2_cfg_s config;
+    config_snapshot(&config);
+    struct serial_out_stats stats;
+    serial_out_get_stats(&stats);
+    printf("Format                   : %s\n", config.serial_format == SERIAL_FORMAT_BINARY ? "binary" : "text");
+    printf("Text lines               : %" PRIu32 "\n", stats.lines);
+    printf("Binary frames            : %" PRIu32 " (%" PRIu32 " dropped)\n", stats.frames, stats.frames_dropped);
+    printf("Writes                   : %" PRIu32 " (%" PRIu32 " dropped)\n", stats.writes, stats.writes_dropped);
+    printf("Bytes written            : %" PRIu32 " (%" PRIu32 " dropped)\n", stats.bytes_written, stats.bytes_dropped);
+    printf("Ring high water          : %" PRIu32 " of %d bytes\n", stats.ring_high_water, SERIAL_OUT_RING_SIZE);
+    return 0;
+}
+
+static void register_serial_format(void){
+    serial_format_args.format = arg_str0(NULL, NULL, "text|binary", "Print measurements as text lines or as binary frames for tools/serial_decode");
+    serial_format_args.end = arg_end(1);
+
+    const esp_console_cmd_t serial_format_cmd = {
+        .command = "serial_format",
+        .help = "Set the format of the measurements printed with toggle_print, or show it and the statistics of the serial output",
+        .hint = NULL,
+        .func = &console_serial_format,
+        .argtable = &serial_format_args
+    };
+
+    ESP_ERROR_CHECK(esp_console_cmd_register(&serial_format_cmd) );
+}
+
+
 /** Arguments used by 'console_set_led_brightness' function */
 static struct {
     struct arg_int *brightness;
@@ -143,7 +220,7 @@ static void register_set_period(void){
     set_period_args.period = arg_int1(NULL, NULL, "<period>", "Measurement period in seconds");
     set_period_args.end = arg_end(1);
     snprintf(help_str_set_period, sizeof(help_str_set_period), 
-    "Set the measurement period. This is the time in seconds between each CO2 measurement. \\The lowest possible value is 5 seconds. Default: %d seconds", 
+    "Set the measurement period. This is the time in seconds between each CO2 measurement. \\The lowest possible value is 5 seconds, the highest 65535 seconds (about 18 hours). With adaptive_sampling, the longest period. Default: %d seconds", 
     MINICO2CONFIG_DEFAULT.measurement_period);
 
     const esp_console_cmd_t set_period_cmd = {
@@ -175,23 +252,38 @@ static int console_config(int argc, char **argv)
         const char *option = config_args.option->sval[0];
         if (option != NULL && strcmp(option, "-reset") == 0){
             reset_config();
+        } else if (option != NULL && strcmp(option, "-flush") == 0){
+            return flush_config() == ESP_OK ? 0 : 1;
+        } else if (option != NULL && strcmp(option, "-stats") == 0){
+            struct config_storage_stats stats;
+            config_storage_get_stats(&stats);
+            printf("Change events            : %" PRIu32 "\n", stats.events);
+            printf("Flushes                  : %" PRIu32 "\n", stats.flushes);
+            printf("NVS keys written         : %" PRIu32 "\n", stats.writes);
+            printf("NVS commits              : %" PRIu32 "\n", stats.commits);
+            printf("Longest flush            : %" PRId64 " us\n", stats.flush_us_max);
+            printf("Total flush time         : %" PRId64 " us\n", stats.flush_us_total);
         } else {
             printf("Invalid config option '%s'", option);
             return 1;
         }
     } else {
-        log_config(&MINICO2CONFIG);
+        struct minico2_cfg_s config;
+        config_snapshot(&config);
+        log_config(&config);
     }
     return 0;
 }
 
 static void register_config(void){
-    config_args.option = arg_str0(NULL, NULL, "-reset", "Reset the configuration to default values");
+    config_args.option = arg_str0(NULL, NULL, "-reset|-flush|-stats", 
+        "Reset the configuration to default values, save pending changes now, or print storage statistics");
     config_args.end = arg_end(1);
 
     const esp_console_cmd_t console_config_cmd = {
         .command = "config",
-        .help = "Print the current configuration as an INFO log statement or reset to the default configuration",
+        .help = "Print the current configuration as an INFO log statement, reset to the default configuration, "
+                "save pending changes to NVS or print NVS write statistics",
         .hint = NULL,
         .func = &console_config,
         .argtable = &config_args
@@ -214,9 +306,11 @@ static int console_set_led_co2_limits(int argc, char **argv)
         arg_print_errors(stderr, set_led_co2_limits_args.end, argv[0]);
         return 1;
     }
-    uint16_t medium_limit = MINICO2CONFIG.led_cfg.limit_medium;
-    uint16_t high_limit = MINICO2CONFIG.led_cfg.limit_high;
-    uint16_t critical_limit = MINICO2CONFIG.led_cfg.limit_critical;
+    struct minico2_cfg_s config;
+    config_snapshot(&config);
+    uint16_t medium_limit = config.led_cfg.limit_medium;
+    uint16_t high_limit = config.led_cfg.limit_high;
+    uint16_t critical_limit = config.led_cfg.limit_critical;
 
     const int lim_val = set_led_co2_limits_args.lim_val->ival[0];
     const char *lim_type = set_led_co2_limits_args.lim_type->sval[0];
@@ -250,6 +344,625 @@ static void register_set_led_co2_limits(void){
     ESP_ERROR_CHECK(esp_console_cmd_register(&set_led_co2_limits_cmd) );
 }
 
+/** Arguments used by 'set_outdoor_co2' function */
+static struct {
+    struct arg_int *ppm;
+    struct arg_end *end;
+} set_outdoor_co2_args;
+
+static int console_set_outdoor_co2(int argc, char **argv)
+{
+    int nerrors = arg_parse(argc, argv, (void **) &set_outdoor_co2_args);
+    if (nerrors != 0) {
+        arg_print_errors(stderr, set_outdoor_co2_args.end, argv[0]);
+        return 1;
+    }
+    set_outdoor_co2(set_outdoor_co2_args.ppm->ival[0]);
+    return 0;
+}
+
+static char help_str_set_outdoor_co2 [256];
+static void register_set_outdoor_co2(void){
+    set_outdoor_co2_args.ppm = arg_int1(NULL, NULL, "<ppm>", "Outdoor CO2 concentration in PPM");
+    set_outdoor_co2_args.end = arg_end(1);
+    snprintf(help_str_set_outdoor_co2, sizeof(help_str_set_outdoor_co2), 
+    "Set the outdoor CO2 concentration, towards which the CO2 decays when the room is ventilated. Used by the "
+    "'ventilation' estimate. Range: %d to %d PPM. Default: %d PPM", 
+    OUTDOOR_CO2_MIN, OUTDOOR_CO2_MAX, MINICO2CONFIG_DEFAULT.outdoor_co2);
+
+    const esp_console_cmd_t set_outdoor_co2_cmd = {
+        .command = "set_outdoor_co2",
+        .help = help_str_set_outdoor_co2,
+        .hint = NULL,
+        .func = &console_set_outdoor_co2,
+        .argtable = &set_outdoor_co2_args
+    };
+
+    ESP_ERROR_CHECK(esp_console_cmd_register(&set_outdoor_co2_cmd) );
+}
+
+static int console_sampling(int argc, char **argv)
+{
+    struct scd40_sampling_stats stats;
+    scd40_get_sampling_stats(&stats);
+    if (stats.samples == 0){
+        printf("No samples taken yet\n");
+        return 0;
+    }
+    printf("Samples                  : %" PRIu32 "\n", stats.samples);
+    printf("Trigger jitter min       : %" PRId32 " us\n", stats.jitter_min_us);
+    printf("Trigger jitter max       : %" PRId32 " us\n", stats.jitter_max_us);
+    printf("Trigger jitter mean abs. : %" PRIu64 " us\n", stats.jitter_abs_sum_us / stats.samples);
+    printf("Resyncs to the sensor    : %" PRIu32 "\n", stats.resyncs);
+
+    struct scd40_mode_stats modes;
+    scd40_get_mode_stats(&modes);
+    printf("Sensor mode              : %s (%" PRIu32 " mode changes)\n", scd40_mode_to_str(modes.mode), modes.mode_changes);
+    printf("%-24s %10s %8s %12s\n", "Mode", "Time [s]", "Samples", "Latency [ms]");
+    for (int mode = 0; mode < SCD40_N_MODES; mode++){
+        int64_t latency_ms = modes.samples[mode] ? modes.latency_us[mode] / modes.samples[mode] / 1000 : 0;
+        printf("%-24s %10" PRId64 " %8" PRIu32 " %12" PRId64 "\n", scd40_mode_to_str(mode), modes.time_us[mode] / 1000000, 
+               modes.samples[mode], latency_ms);
+    }
+    return 0;
+}
+
+static void register_sampling(void){
+    const esp_console_cmd_t sampling_cmd = {
+        .command = "sampling",
+        .help = "Print statistics of the sensor sampling schedule and of the time spent in each sensor mode",
+        .hint = NULL,
+        .func = &console_sampling
+    };
+
+    ESP_ERROR_CHECK(esp_console_cmd_register(&sampling_cmd) );
+}
+
+/** Arguments used by 'console_adaptive_sampling' function */
+static struct {
+    struct arg_str *state;
+    struct arg_end *end;
+} adaptive_sampling_args;
+
+static int console_adaptive_sampling(int argc, char **argv)
+{
+    int nerrors = arg_parse(argc, argv, (void **) &adaptive_sampling_args);
+    if (nerrors != 0) {
+        arg_print_errors(stderr, adaptive_sampling_args.end, argv[0]);
+        return 1;
+    }
+    if (adaptive_sampling_args.state->count > 0){
+        const char *state = adaptive_sampling_args.state->sval[0];
+        if (strcmp(state, "on") == 0){
+            set_adaptive_sampling(true);
+        } else if (strcmp(state, "off") == 0){
+            set_adaptive_sampling(false);
+        } else {
+            printf("Invalid state '%s'. Choose from [on|off]\n", state);
+            return 1;
+        }
+        return 0;
+    }
+
+    struct adaptive_sampling_stats stats;
+    adaptive_sampling_get_stats(&stats);
+    printf("Adaptive sampling        : %s\n", stats.enabled ? "ENABLED" : "DISABLED");
+    printf("Effective period         : %u seconds (%d to %u)\n", stats.period_s, ADAPTIVE_SAMPLING_FLOOR_S, 
+           stats.ceiling_s);
+    printf("CO2 rate of change       : %" PRIu32 " PPM per hour\n", stats.rate_ppm_h);
+    printf("Period changes           : %" PRIu32 "\n", stats.period_changes);
+    if (stats.elapsed_s < 60 * 60){
+        printf("Samples per day          : not known before an hour of sampling\n");
+        return 0;
+    }
+    // The configured period is the ceiling, so the saving is against sampling at the floor all the time, which is the
+    // fixed period that reacts as fast
+    uint32_t per_day = (uint64_t)stats.samples * 24 * 60 * 60 / stats.elapsed_s;
+    uint32_t at_period = 24 * 60 * 60 / stats.ceiling_s;
+    uint32_t at_floor = 24 * 60 * 60 / ADAPTIVE_SAMPLING_FLOOR_S;
+    printf("Samples per day          : %" PRIu32 " (%" PRIu32 " at the configured %u seconds)\n", per_day, at_period, 
+           stats.ceiling_s);
+    printf("Samples saved per day    : %" PRIu32 " (against a fixed %d seconds)\n", 
+           per_day < at_floor ? at_floor - per_day : 0, ADAPTIVE_SAMPLING_FLOOR_S);
+    return 0;
+}
+
+static char help_str_adaptive_sampling [256];
+static void register_adaptive_sampling(void){
+    adaptive_sampling_args.state = arg_str0(NULL, NULL, "on|off", "Enable or disable adaptive sampling");
+    adaptive_sampling_args.end = arg_end(1);
+    snprintf(help_str_adaptive_sampling, sizeof(help_str_adaptive_sampling), 
+    "Shorten the measurement period down to %d seconds while the CO2 changes fast or is near an LED limit, or show the "
+    "effective period and the samples saved per day. The sensor mode follows the period. Default: %s", 
+    ADAPTIVE_SAMPLING_FLOOR_S, MINICO2CONFIG_DEFAULT.adaptive_sampling ? "ENABLED" : "DISABLED");
+
+    const esp_console_cmd_t adaptive_sampling_cmd = {
+        .command = "adaptive_sampling",
+        .help = help_str_adaptive_sampling,
+        .hint = NULL,
+        .func = &console_adaptive_sampling,
+        .argtable = &adaptive_sampling_args
+    };
+
+    ESP_ERROR_CHECK(esp_console_cmd_register(&adaptive_sampling_cmd) );
+}
+
+static int console_ble_stats(int argc, char **argv)
+{
+    struct ble_adv_stats stats;
+    ble_get_adv_stats(&stats);
+    printf("Samples advertised       : %" PRIu32 "\n", stats.samples);
+    printf("Adverts sent (estimated) : %" PRIu32 "\n", stats.adverts);
+    printf("Adverts for last sample  : %" PRIu32 "\n", stats.last_sample_adverts);
+    printf("Radio on time            : %" PRId64 " ms\n", stats.radio_on_us / 1000);
+    return 0;
+}
+
+static void register_ble_stats(void){
+    const esp_console_cmd_t ble_stats_cmd = {
+        .command = "ble_stats",
+        .help = "Print BLE advertising statistics",
+        .hint = NULL,
+        .func = &console_ble_stats
+    };
+
+    ESP_ERROR_CHECK(esp_console_cmd_register(&ble_stats_cmd) );
+}
+
+/** Arguments used by 'console_history' function */
+static struct {
+    struct arg_int *from;
+    struct arg_int *to;
+    struct arg_end *end;
+} history_args;
+
+static int console_history(int argc, char **argv)
+{
+    int nerrors = arg_parse(argc, argv, (void **) &history_args);
+    if (nerrors != 0) {
+        arg_print_errors(stderr, history_args.end, argv[0]);
+        return 1;
+    }
+    uint32_t from = history_args.from->count ? history_args.from->ival[0] : 0;
+    uint32_t to = history_args.to->count ? history_args.to->ival[0] : UINT32_MAX;
+
+    struct history_iter it;
+    struct history_sample sample;
+    history_range(&it, from, to);
+    printf("time_s,co2_ppm,temp_c,hum_pct\n");
+    while (history_next(&it, &sample)){
+        printf("%" PRIu32 ",%u,%s%d.%d,%u.%u\n", sample.time_s, sample.co2, sample.temp_dc < 0 ? "-" : "",
+               abs(sample.temp_dc) / 10, abs(sample.temp_dc) % 10, sample.hum_dpct / 10, sample.hum_dpct % 10);
+    }
+    printf("# %" PRIu32 " of %" PRIu32 " samples stored\n", history_size(), history_capacity());
+    return 0;
+}
+
+static void register_history(void){
+    history_args.from = arg_int0(NULL, NULL, "<from>", "Start of the time range in seconds since boot. Default: oldest sample");
+    history_args.to = arg_int0(NULL, NULL, "<to>", "End of the time range in seconds since boot. Default: newest sample");
+    history_args.end = arg_end(2);
+
+    const esp_console_cmd_t history_cmd = {
+        .command = "history",
+        .help = "Print the measurement history in a time range as CSV",
+        .hint = NULL,
+        .func = &console_history,
+        .argtable = &history_args
+    };
+
+    ESP_ERROR_CHECK(esp_console_cmd_register(&history_cmd) );
+}
+
+/** Arguments used by 'console_flash_log' function */
+static struct {
+    struct arg_lit *dump;
+    struct arg_end *end;
+} flash_log_args;
+
+static int console_flash_log(int argc, char **argv)
+{
+    int nerrors = arg_parse(argc, argv, (void **) &flash_log_args);
+    if (nerrors != 0) {
+        arg_print_errors(stderr, flash_log_args.end, argv[0]);
+        return 1;
+    }
+
+    if (flash_log_args.dump->count > 0){
+        struct tslog_iter it;
+        struct tslog_sample sample;
+        tslog_begin(&it);
+        printf("time_s,co2_ppm,temp_c,hum_pct\n");
+        while (tslog_next(&it, &sample)){
+            printf("%" PRIu32 ",%u,%s%d.%d,%u.%u\n", sample.time_s, sample.co2, sample.temp_dc < 0 ? "-" : "",
+                   abs(sample.temp_dc) / 10, abs(sample.temp_dc) % 10, sample.hum_dpct / 10, sample.hum_dpct % 10);
+        }
+        return 0;
+    }
+
+    struct tslog_stats stats;
+    tslog_get_stats(&stats);
+    printf("Pages used               : %" PRIu32 " of %" PRIu32 "\n", stats.pages_used, stats.pages);
+    printf("Samples                  : %" PRIu32 "\n", stats.samples);
+    printf("Bytes used               : %" PRIu32 "\n", stats.bytes);
+    if (stats.samples > 0){
+        printf("Bytes per sample         : %" PRIu32 ".%02" PRIu32 "\n", stats.bytes / stats.samples, 
+               (stats.bytes % stats.samples) * 100 / stats.samples);
+    }
+    printf("Appended since boot      : %" PRIu32 "\n", stats.appended);
+    printf("Pages erased since boot  : %" PRIu32 "\n", stats.pages_erased);
+    return 0;
+}
+
+static void register_flash_log(void){
+    flash_log_args.dump = arg_lit0("d", "dump", "Print all samples in the log as CSV");
+    flash_log_args.end = arg_end(1);
+
+    const esp_console_cmd_t flash_log_cmd = {
+        .command = "flash_log",
+        .help = "Print statistics of the flash measurement log, or dump it",
+        .hint = NULL,
+        .func = &console_flash_log,
+        .argtable = &flash_log_args
+    };
+
+    ESP_ERROR_CHECK(esp_console_cmd_register(&flash_log_cmd) );
+}
+
+/** Arguments used by 'console_latency' function */
+static struct {
+    struct arg_lit *reset;
+    struct arg_end *end;
+} latency_args;
+
+static int console_latency(int argc, char **argv)
+{
+    int nerrors = arg_parse(argc, argv, (void **) &latency_args);
+    if (nerrors != 0) {
+        arg_print_errors(stderr, latency_args.end, argv[0]);
+        return 1;
+    }
+    if (latency_args.reset->count > 0){
+        latency_reset();
+        return 0;
+    }
+
+    printf("Latency in us since the sample was read (sensor_read: since the sampling trigger)\n");
+    printf("%-26s %8s %10s %10s %10s %10s %10s %10s\n", "stage", "count", "min", "mean", "p50", "p90", "p99", "max");
+    for (int stage = 0; stage < LATENCY_N_STAGES; stage++){
+        struct latency_stage_stats stats;
+        latency_get_stats((enum LATENCY_STAGES)stage, &stats);
+        uint32_t mean = stats.count ? stats.sum_us / stats.count : 0;
+        printf("%-26s %8" PRIu32 " %10" PRIu32 " %10" PRIu32 " %10" PRIu32 " %10" PRIu32 " %10" PRIu32 " %10" PRIu32 "\n",
+               latency_stage_to_str((enum LATENCY_STAGES)stage), stats.count, stats.min_us, mean, 
+               stats.p50_us, stats.p90_us, stats.p99_us, stats.max_us);
+    }
+    return 0;
+}
+
+static void register_latency(void){
+    latency_args.reset = arg_lit0("r", "reset", "Clear the latency histograms");
+    latency_args.end = arg_end(1);
+
+    const esp_console_cmd_t latency_cmd = {
+        .command = "latency",
+        .help = "Print latency percentiles of each pipeline stage, from sensor read to the radios",
+        .hint = NULL,
+        .func = &console_latency,
+        .argtable = &latency_args
+    };
+
+    ESP_ERROR_CHECK(esp_console_cmd_register(&latency_cmd) );
+}
+
+#if BENCH_ENABLED
+/** Arguments used by 'console_bench' function */
+static struct {
+    struct arg_str *filter;
+    struct arg_end *end;
+} bench_args;
+
+static int console_bench(int argc, char **argv)
+{
+    int nerrors = arg_parse(argc, argv, (void **) &bench_args);
+    if (nerrors != 0) {
+        arg_print_errors(stderr, bench_args.end, argv[0]);
+        return 1;
+    }
+    const char *filter = bench_args.filter->count ? bench_args.filter->sval[0] : NULL;
+    esp_err_t err = bench_run(filter);
+    if (err != ESP_OK){
+        printf("Benchmark failed: %s\n", esp_err_to_name(err));
+        return 1;
+    }
+    return 0;
+}
+
+static void register_bench(void){
+    bench_args.filter = arg_str0(NULL, NULL, "<name>", "Only run the benchmarks whose name contains this string");
+    bench_args.end = arg_end(1);
+
+    const esp_console_cmd_t bench_cmd = {
+        .command = "bench",
+        .help = "Benchmark the per-measurement code paths: CPU cycles, heap allocations and stack use per call",
+        .hint = NULL,
+        .func = &console_bench,
+        .argtable = &bench_args
+    };
+
+    ESP_ERROR_CHECK(esp_console_cmd_register(&bench_cmd) );
+}
+#endif
+
+/** Arguments used by 'console_diag' function */
+static struct {
+    struct arg_lit *sample;
+    struct arg_end *end;
+} diag_args;
+
+static int console_diag(int argc, char **argv)
+{
+    int nerrors = arg_parse(argc, argv, (void **) &diag_args);
+    if (nerrors != 0) {
+        arg_print_errors(stderr, diag_args.end, argv[0]);
+        return 1;
+    }
+    if (diag_args.sample->count > 0){
+        diag_sample();
+    }
+
+    printf("%-18s %8s %8s %8s %6s\n", "task", "stack", "peak", "free", "used");
+    for (uint32_t i = 0; i < diag_task_count(); i++){
+        struct diag_task_stats stats;
+        diag_get_task_stats(i, &stats);
+        uint32_t peak = stats.stack_bytes > stats.headroom_bytes ? stats.stack_bytes - stats.headroom_bytes : 0;
+        printf("%-18s %8" PRIu32 " %8" PRIu32 " %8" PRIu32 " %5" PRIu32 "%%%s\n", stats.name, stats.stack_bytes, peak, 
+               stats.headroom_bytes, stats.stack_bytes ? peak * 100 / stats.stack_bytes : 0,
+               stats.headroom_bytes < DIAG_HEADROOM_WARN_BYTES ? "  LOW" : "");
+    }
+
+    struct diag_heap_stats heap;
+    diag_get_heap_stats(&heap);
+    printf("Heap free                : %" PRIu32 " bytes, lowest %" PRIu32 " bytes\n", heap.free_bytes, heap.min_free_bytes);
+    printf("Largest free block       : %" PRIu32 " bytes, lowest %" PRIu32 " bytes\n", 
+           heap.largest_block_bytes, heap.min_largest_block_bytes);
+    return 0;
+}
+
+static void register_diag(void){
+    diag_args.sample = arg_lit0("s", "sample", "Sample the stacks and the heap now instead of using the last periodic sample");
+    diag_args.end = arg_end(1);
+
+    const esp_console_cmd_t diag_cmd = {
+        .command = "diag",
+        .help = "Print the peak stack use of every task, and the heap low-water marks",
+        .hint = NULL,
+        .func = &console_diag,
+        .argtable = &diag_args
+    };
+
+    ESP_ERROR_CHECK(esp_console_cmd_register(&diag_cmd) );
+}
+
+static int console_boot(int argc, char **argv)
+{
+    printf("%-24s %10s %10s\n", "phase", "ms", "delta_ms");
+    int64_t previous_us = 0;
+    for (int phase = 0; phase < BOOT_N_PHASES; phase++){
+        int64_t t_us = boot_phase_time_us((enum BOOT_PHASES)phase);
+        if (t_us < 0){
+            printf("%-24s %10s\n", boot_phase_to_str((enum BOOT_PHASES)phase), "-");
+            continue;
+        }
+        printf("%-24s %10" PRIu32 " %10" PRIu32 "\n", boot_phase_to_str((enum BOOT_PHASES)phase), 
+               (uint32_t)(t_us / 1000), (uint32_t)((t_us - previous_us) / 1000));
+        previous_us = t_us;
+    }
+    return 0;
+}
+
+static void register_boot(void){
+    const esp_console_cmd_t boot_cmd = {
+        .command = "boot",
+        .help = "Print the time since startup at which each boot phase was reached",
+        .hint = NULL,
+        .func = &console_boot
+    };
+
+    ESP_ERROR_CHECK(esp_console_cmd_register(&boot_cmd) );
+}
+
+// Formats a value in hundredths with two decimals
+static const char *centi_to_str(char *buf, size_t len, int32_t centi)
+{
+    uint32_t abs_centi = centi < 0 ? -centi : centi;
+    snprintf(buf, len, "%s%" PRIu32 ".%02" PRIu32, centi < 0 ? "-" : "", abs_centi / 100, abs_centi % 100);
+    return buf;
+}
+
+static int console_stats(int argc, char **argv)
+{
+    printf("%-6s %-5s %8s %9s %9s %9s %9s\n", "window", "value", "samples", "mean", "min", "max", "sd");
+    for (int w = 0; w < ROLLSTATS_N_WINDOWS; w++){
+        for (int c = 0; c < ROLLSTATS_N_CHANNELS; c++){
+            struct rollstats_result r;
+            rollstats_get((enum ROLLSTATS_WINDOWS)w, (enum ROLLSTATS_CHANNELS)c, &r);
+            if (c == ROLLSTATS_CO2){
+                printf("%-6s %-5s %8" PRIu32 " %9" PRId32 " %9" PRId32 " %9" PRId32 " %9" PRId32 "\n", 
+                       rollstats_window_to_str((enum ROLLSTATS_WINDOWS)w), "co2", r.count, r.mean, r.min, r.max, r.sd);
+                continue;
+            }
+            char mean[12], min[12], max[12], sd[12];
+            printf("%-6s %-5s %8" PRIu32 " %9s %9s %9s %9s\n", rollstats_window_to_str((enum ROLLSTATS_WINDOWS)w),
+                   rollstats_channel_to_str((enum ROLLSTATS_CHANNELS)c), r.count, 
+                   centi_to_str(mean, sizeof(mean), r.mean), centi_to_str(min, sizeof(min), r.min), 
+                   centi_to_str(max, sizeof(max), r.max), centi_to_str(sd, sizeof(sd), r.sd));
+        }
+    }
+    printf("# co2 in PPM, temp in degrees Celsius, hum in percent\n");
+    return 0;
+}
+
+static int console_ventilation(int argc, char **argv)
+{
+    struct ventilation_stats stats;
+    struct ventilation_estimate e;
+    ventilation_get_stats(&stats);
+    ventilation_get(&e);
+    printf("Decay episodes           : %" PRIu32 " (%" PRIu32 " with an estimate)\n", stats.episodes, stats.estimates);
+    printf("Episode in progress      : %s\n", stats.in_episode ? "YES" : "NO");
+    if (!e.valid){
+        printf("No estimate yet. It needs the CO2 to decay from at least %d PPM above the outdoor CO2.\n", 
+               VENTILATION_START_EXCESS_PPM);
+        return 0;
+    }
+    uint32_t now_s = esp_timer_get_time() / 1000000;
+    printf("Air changes per hour     : %" PRIu32 ".%02" PRIu32 "%s\n", e.ach_centi / 100, e.ach_centi % 100, 
+           e.final ? "" : " (episode in progress)");
+    printf("Confidence (R^2)         : %u percent\n", e.confidence_pct);
+    printf("Fitted over              : %" PRIu32 " samples, %" PRIu32 " seconds\n", e.samples, e.duration_s);
+    printf("Outdoor CO2 baseline     : %u PPM\n", e.baseline);
+    printf("Age                      : %" PRIu32 " seconds\n", now_s - e.time_s);
+    return 0;
+}
+
+static void register_ventilation(void){
+    const esp_console_cmd_t ventilation_cmd = {
+        .command = "ventilation",
+        .help = "Print the latest estimate of the air changes per hour, fitted to the last decay of the CO2 towards "
+                "the outdoor CO2 (see set_outdoor_co2)",
+        .hint = NULL,
+        .func = &console_ventilation
+    };
+
+    ESP_ERROR_CHECK(esp_console_cmd_register(&ventilation_cmd) );
+}
+
+static void register_stats(void){
+    const esp_console_cmd_t stats_cmd = {
+        .command = "stats",
+        .help = "Print the mean, minimum, maximum and standard deviation of the measurements over the last minute, "
+                "15 minutes, hour and 24 hours",
+        .hint = NULL,
+        .func = &console_stats
+    };
+
+    ESP_ERROR_CHECK(esp_console_cmd_register(&stats_cmd) );
+}
+
+#if TRACE_ENABLED
+/** Arguments used by 'console_trace' function */
+static struct {
+    struct arg_str *option;
+    struct arg_end *end;
+} trace_args;
+
+static int console_trace(int argc, char **argv)
+{
+    int nerrors = arg_parse(argc, argv, (void **) &trace_args);
+    if (nerrors != 0) {
+        arg_print_errors(stderr, trace_args.end, argv[0]);
+        return 1;
+    }
+    const char *option = trace_args.option->count ? trace_args.option->sval[0] : "-dump";
+    if (strcmp(option, "-dump") == 0){
+        trace_dump();
+    } else if (strcmp(option, "-on") == 0){
+        trace_set_enabled(true);
+    } else if (strcmp(option, "-off") == 0){
+        trace_set_enabled(false);
+    } else {
+        printf("Invalid trace option '%s'", option);
+        return 1;
+    }
+    return 0;
+}
+
+static void register_trace(void){
+    trace_args.option = arg_str0(NULL, NULL, "-dump|-on|-off", "Print and clear the trace buffer (default), or pause and resume tracing");
+    trace_args.end = arg_end(1);
+
+    const esp_console_cmd_t trace_cmd = {
+        .command = "trace",
+        .help = "Print the binary event trace for tools/trace_to_chrome, or pause and resume tracing",
+        .hint = NULL,
+        .func = &console_trace,
+        .argtable = &trace_args
+    };
+
+    ESP_ERROR_CHECK(esp_console_cmd_register(&trace_cmd) );
+}
+#endif
+
+#if SIMULATE_SCD4X
+/** Arguments used by 'console_sensor_sim' function */
+static struct {
+    struct arg_str *trace;
+    struct arg_int *nack;
+    struct arg_int *zero;
+    struct arg_int *stale;
+    struct arg_end *end;
+} sensor_sim_args;
+
+static int console_sensor_sim(int argc, char **argv)
+{
+    int nerrors = arg_parse(argc, argv, (void **) &sensor_sim_args);
+    if (nerrors != 0) {
+        arg_print_errors(stderr, sensor_sim_args.end, argv[0]);
+        return 1;
+    }
+
+    if (sensor_sim_args.trace->count > 0){
+        esp_err_t err = scd4x_sim_push_trace_line(sensor_sim_args.trace->sval[0]);
+        if (err != ESP_OK){
+            printf("Trace sample not queued: %s\n", esp_err_to_name(err));
+            return 1;
+        }
+    }
+
+    struct scd4x_sim_faults faults;
+    scd4x_sim_get_faults(&faults);
+    if (sensor_sim_args.nack->count > 0 || sensor_sim_args.zero->count > 0 || sensor_sim_args.stale->count > 0){
+        if (sensor_sim_args.nack->count > 0){faults.nack_every = sensor_sim_args.nack->ival[0];}
+        if (sensor_sim_args.zero->count > 0){faults.zero_co2_every = sensor_sim_args.zero->ival[0];}
+        if (sensor_sim_args.stale->count > 0){faults.stale_data_ready = sensor_sim_args.stale->ival[0] != 0;}
+        scd4x_sim_set_faults(&faults);
+    }
+    if (argc > 1){return 0;}
+
+    struct scd4x_sim_stats stats;
+    scd4x_sim_get_stats(&stats);
+    printf("I2C transfers            : %" PRIu32 "\n", stats.transfers);
+    printf("Commands                 : %" PRIu32 "\n", stats.commands);
+    printf("NACKs                    : %" PRIu32 "\n", stats.nacks);
+    printf("CRC errors               : %" PRIu32 "\n", stats.crc_errors);
+    printf("Samples taken            : %" PRIu32 "\n", stats.samples);
+    printf("Samples read             : %" PRIu32 "\n", stats.reads);
+    printf("Trace samples queued     : %" PRIu32 "\n", stats.trace_queued);
+    printf("Faults                   : NACK every %" PRIu32 ", 0 ppm every %" PRIu32 ", stale data ready %s\n",
+           faults.nack_every, faults.zero_co2_every, faults.stale_data_ready ? "ON" : "OFF");
+    return 0;
+}
+
+static void register_sensor_sim(void){
+    sensor_sim_args.trace = arg_str0("t", "trace", "<json>", "Queue a sample as printed on the serial port, e.g. \"{CO2: 612, TEMP: 21.3, HUM: 45.2}\"");
+    sensor_sim_args.nack = arg_int0("n", "nack", "<N>", "NACK every Nth I2C transfer, 0 to disable");
+    sensor_sim_args.zero = arg_int0("z", "zero", "<N>", "Read 0 ppm CO2 every Nth sample, 0 to disable");
+    sensor_sim_args.stale = arg_int0("s", "stale", "<0|1>", "Always report data ready, so stale samples are read");
+    sensor_sim_args.end = arg_end(4);
+
+    const esp_console_cmd_t sensor_sim_cmd = {
+        .command = "sensor_sim",
+        .help = "Feed the simulated SCD4x a trace sample, inject faults, or print its statistics",
+        .hint = NULL,
+        .func = &console_sensor_sim,
+        .argtable = &sensor_sim_args
+    };
+
+    ESP_ERROR_CHECK(esp_console_cmd_register(&sensor_sim_cmd) );
+}
+#endif
+
 
 void start_console(void)
 {
@@ -264,16 +977,38 @@ void start_console(void)
     /* Register commands */
     esp_console_register_help_command();
     register_toggle_print_readings();
+    register_serial_format();
     register_set_led_brightness();
     register_set_led_co2_limits();
+    register_set_outdoor_co2();
     register_set_nickname();
     register_set_period();
     register_system_common();
     register_config();
+    register_sampling();
+    register_adaptive_sampling();
+    register_ble_stats();
+    register_history();
+    register_stats();
+    register_ventilation();
+    register_flash_log();
+    register_latency();
+    register_diag();
+    register_boot();
+#if BENCH_ENABLED
+    register_bench();
+#endif
+#if TRACE_ENABLED
+    register_trace();
+#endif
+#if SIMULATE_SCD4X
+    register_sensor_sim();
+#endif
 
 #if defined(CONFIG_ESP_CONSOLE_USB_SERIAL_JTAG)
     esp_console_dev_usb_serial_jtag_config_t hw_config = ESP_CONSOLE_DEV_USB_SERIAL_JTAG_CONFIG_DEFAULT();
     ESP_ERROR_CHECK(esp_console_new_repl_usb_serial_jtag(&hw_config, &repl_config, &repl));
+    diag_register_task(xTaskGetHandle("console_repl"), repl_config.task_stack_size);
 
 #else
 #error Unsupported console type
@@ -1,4 +1,5 @@
 #include <stdio.h>
+#include <inttypes.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
 #include <freertos/queue.h>
@@ -7,54 +8,91 @@
 #include <esp_check.h>
 #include <esp_log.h>
 #include <esp_event.h>
+#include <esp_timer.h>
 #include "sdkconfig.h"
 #include "../types.h"
+#include "controller.h"
 extern "C" {
-#include "../console/console.h"
 #include "../globals.h"
 #include "../config/config.h"
+#include "../bus/measurement_bus.h"
+#include "../history/history.h"
+#include "../latency/latency.h"
+#include "../boot/boot.h"
+#include "../serial/serial_out.h"
+#include "../stats/rollstats.h"
+#include "../stats/ventilation.h"
 }
 
+// Set to true to log how many times the controller woke up between two measurements
+#define COUNT_CONTROLLER_WAKEUPS false
+
 static const char *CONTROLLER_TAG = "MINICO2";
 static enum DEVICE_STATES DEVICE_STATE = BOOTING; 
 struct SCD40measurement most_recent_measurement = {0};
 
-void set_led_state_from_co2(uint16_t co2, QueueHandle_t led_state_queue){
-    enum LED_STATES state;
-    if (co2 < MINICO2CONFIG.led_cfg.limit_medium){
-        state = LOW_CO2;
-    }else if (co2 < MINICO2CONFIG.led_cfg.limit_high){
-        state = MEDIUM_CO2;
-    }else{
-        state = HIGH_CO2;
+// The controller's copy of the configuration. Refreshed only when the config version changes.
+static struct minico2_cfg_s config;
+static uint32_t config_version_seen = CONFIG_VERSION_NONE;
+
+// The LED state for a CO2 concentration, given the limits of the LED configuration
+enum LED_STATES led_state_for_co2(uint16_t co2, const struct led_cfg_s *limits){
+    if (co2 < limits->limit_medium){
+        return LOW_CO2;
+    }else if (co2 < limits->limit_high){
+        return MEDIUM_CO2;
     }
-    xQueueSendToBack(led_state_queue, &state, (TickType_t)0);
+    return HIGH_CO2;
 }
 
-void handle_measurement(struct SCD40measurement meas, QueueHandle_t led_state_queue, QueueHandle_t ble_queue, QueueHandle_t zigbee_queue){
-    // Print the measurement in JSON on the serial connection
-    if (MINICO2CONFIG.serial_print_enabled) {
-        printf("{CO2: %u, TEMP: %.1f, HUM: %.1f}\n", meas.co2, meas.temperature, meas.humidity);
+void set_led_state_from_co2(uint16_t co2, ChannelHandle<LED_STATES> led_states){
+    config_snapshot_if_changed(&config, &config_version_seen);
+    led_states.send(led_state_for_co2(co2, &config.led_cfg));
+}
+
+void handle_measurement(struct SCD40measurement meas, ChannelHandle<LED_STATES> led_states){
+    latency_record(LATENCY_CONTROLLER_RECEIVE, meas.read_us);
+
+    // Print the measurement on the serial connection, as text or as a binary frame
+    config_snapshot_if_changed(&config, &config_version_seen);
+    if (config.serial_print_enabled) {
+        serial_out_measurement(&meas, config.serial_format);
     }
     most_recent_measurement = meas;
+    uint32_t time_s = esp_timer_get_time() / 1000000;
+    history_append(&meas, time_s);
+    rollstats_add(&meas, time_s);  // Before publishing, so that BLE and Zigbee send statistics that include 'meas'
+    ventilation_add(&meas, time_s, config.outdoor_co2);
     
     // Set the LED color based on the CO2 level
-    set_led_state_from_co2(meas.co2, led_state_queue);
+    set_led_state_from_co2(meas.co2, led_states);
+    latency_record(LATENCY_LED_STATE_SENT, meas.read_us);
 
-    // Send the measurement to the BLE task for transmission
-    xQueueSendToBack(ble_queue, &meas, (TickType_t)0);
+    // Publish the measurement to the consumers on the measurement bus (BLE, Zigbee)
+    measurement_bus_publish(&meas);
+    boot_mark(BOOT_FIRST_SAMPLE_PUBLISHED);
+}
 
-    // Send the measurement to the zigbee task for transmission
-    xQueueSendToBack(zigbee_queue, &meas, (TickType_t)0);
+// Forwards config events to the controller task, so that they are handled there and not on the event loop
+static void config_event_forwarder(void* handler_args, esp_event_base_t base, int32_t id, void* event_data){
+    auto config_events_queue = (QueueHandle_t)(handler_args);
+    if (xQueueSendToBack(config_events_queue, &id, (TickType_t)0) != pdPASS){
+        ESP_LOGW(CONTROLLER_TAG, "Config events queue full, dropping event %" PRId32, id);
+    }
 }
 
-// Handler for changes to the LED CO2 limits 
-static void co2_limits_handler(void* handler_args, esp_event_base_t base, int32_t id, void* event_data){
-    auto led_state_queue = (QueueHandle_t)(handler_args);
-    set_led_state_from_co2(most_recent_measurement.co2, led_state_queue);
+void handle_config_event(int32_t id, ChannelHandle<LED_STATES> led_states){
+    switch (id)
+    {
+    case CO2_LIMITS_EVENT:
+        set_led_state_from_co2(most_recent_measurement.co2, led_states);
+        break;
+    default:
+        break;
+    }
 }
 
-esp_err_t set_device_state(enum DEVICE_STATES state, QueueHandle_t led_state_queue){
+esp_err_t set_device_state(enum DEVICE_STATES state, ChannelHandle<LED_STATES> led_states){
     enum DEVICE_STATES old_state = DEVICE_STATE;
     DEVICE_STATE = state;
     LED_STATES led_state;
@@ -63,11 +101,11 @@ esp_err_t set_device_state(enum DEVICE_STATES state, QueueHandle_t led_state_que
     {
     case BOOTING:
         led_state = BOOTING_L;
-        xQueueSendToBack(led_state_queue, &led_state, (TickType_t)0);
+        led_states.send(led_state);
         break;
     case ERROR:
         led_state = ERROR_L;
-        xQueueSendToBack(led_state_queue, &led_state, (TickType_t)0);
+        led_states.send(led_state);
         while (1){
             ESP_LOGE(CONTROLLER_TAG, "MINICO2 is in ERROR mode");
             vTaskDelay(pdMS_TO_TICKS(10000));
@@ -80,51 +118,57 @@ esp_err_t set_device_state(enum DEVICE_STATES state, QueueHandle_t led_state_que
 }
 
 
-void controller_task(void *pvParameters){
-
-    // Get the queues from the pvParameters pointer
-    QueueHandle_t *queues = (QueueHandle_t *)pvParameters;
-    QueueHandle_t measurements_queue = queues[0];
-    QueueHandle_t led_state_queue = queues[1];
-    QueueHandle_t errors_queue = queues[2];
-    QueueHandle_t ble_queue = queues[3];
-    QueueHandle_t zigbee_queue = queues[4];
-
+void controller_task(const controller_channels *channels){
+    ChannelHandle<LED_STATES> led_states = channels->led_states;
+    QueueSetHandle_t queue_set = channels->queue_set;
 
-    // If the led state queue failed at being created, we go into an infinite loop
-    if (led_state_queue == 0){
+    // If the led state channel failed at being created, we go into an infinite loop
+    if (!led_states.valid()){
         ESP_LOGE(CONTROLLER_TAG, "Led state queue is 0, entering infinite loop");
         while (1){
             vTaskDelay(pdMS_TO_TICKS(1000));
         }
     }
 
-    // If any of the other queues failed at being created, the device is set to an unrecoverable ERROR mode
-    if ((measurements_queue == 0) || (errors_queue == 0) || (ble_queue == 0)){set_device_state(ERROR, led_state_queue);}
+    // If any of the other channels failed at being created, the device is set to an unrecoverable ERROR mode
+    if (!channels->measurements.valid() || !channels->errors.valid() || !channels->config_events.valid() || (queue_set == 0)){
+        set_device_state(ERROR, led_states);
+    }
 
-    set_device_state(BOOTING, led_state_queue);
+    set_device_state(BOOTING, led_states);
 
     // Connect event handlers
-    ESP_ERROR_CHECK(esp_event_handler_instance_register(CONFIG_EVENTS, CO2_LIMITS_EVENT, co2_limits_handler, led_state_queue, NULL));
+    ESP_ERROR_CHECK(esp_event_handler_instance_register(CONFIG_EVENTS, CO2_LIMITS_EVENT, config_event_forwarder, channels->config_events.queue(), NULL));
 
-    // Give the device time to boot and then launch the console
-    vTaskDelay(pdMS_TO_TICKS(1000));
-    start_console();
+    // The CO2 limits of the LED states come from the configuration
+    boot_wait(BOOT_BIT(BOOT_CONFIG_LOADED), portMAX_DELAY);
 
-    //Begin the infinite loop
+    //Begin the infinite loop. The task sleeps until one of the queues in the set has an item.
     struct SCD40measurement meas;
     esp_err_t err;
+    int32_t config_event;
+    uint32_t wakeups = 0;
     while (1){
-        // Check for errors
-        if (xQueueReceive(errors_queue, &( err), (TickType_t) 10)){
-            set_device_state(ERROR, led_state_queue);
-        }
-
-        // Check for a new measurement
-        if (xQueueReceive(measurements_queue, &( meas), (TickType_t) 10)){
-            handle_measurement(meas, led_state_queue, ble_queue, zigbee_queue);
+        QueueSetMemberHandle_t active = xQueueSelectFromSet(queue_set, portMAX_DELAY);
+        wakeups++;
+
+        if (active == channels->errors.queue()){
+            if (channels->errors.receive(err, 0)){
+                set_device_state(ERROR, led_states);
+            }
+        } else if (active == channels->measurements.queue()){
+            if (channels->measurements.receive(meas, 0)){
+                if (COUNT_CONTROLLER_WAKEUPS){
+                    ESP_LOGI(CONTROLLER_TAG, "Controller woke up %" PRIu32 " times for this measurement", wakeups);
+                }
+                wakeups = 0;
+                handle_measurement(meas, led_states);
+            }
+        } else if (active == channels->config_events.queue()){
+            if (channels->config_events.receive(config_event, 0)){
+                handle_config_event(config_event, led_states);
+            }
         }
-
     }
 }
 
@@ -1,6 +1,25 @@
 #ifndef _CONTROLLER_H
 #define _CONTROLLER_H
 
-void controller_task(void *pvParameters);
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include <esp_err.h>
+#include "../types.h"
+#include "../topology/channel.h"
 
-#endif
\ No newline at end of file
+#define CONFIG_EVENTS_QUEUE_LEN 4  // Number of config events the controller can have pending
+
+struct controller_channels {
+    ChannelHandle<SCD40measurement> measurements;  // From the SCD40 task
+    ChannelHandle<LED_STATES> led_states;          // To the LED task
+    ChannelHandle<esp_err_t> errors;               // Fatal errors from all tasks
+    ChannelHandle<int32_t> config_events;          // Config event ids, forwarded from the event loop
+    QueueSetHandle_t queue_set;                    // Set of the measurements, errors and config events channels
+};
+
+void controller_task(const controller_channels *channels);
+void set_led_state_from_co2(uint16_t co2, ChannelHandle<LED_STATES> led_states);
+enum LED_STATES led_state_for_co2(uint16_t co2, const struct led_cfg_s *limits);
+
+#endif
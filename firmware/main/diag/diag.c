@@ -0,0 +1,150 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <esp_log.h>
+#include <esp_check.h>
+#include <esp_timer.h>
+#include <esp_heap_caps.h>
+#include "sdkconfig.h"
+#include "diag.h"
+
+static const char *DIAG_TAG = "diag";
+
+struct diag_task {
+    TaskHandle_t handle;
+    uint32_t stack_bytes;
+    uint32_t headroom_bytes;
+};
+
+// Tasks started by ESP-IDF and the radio stacks, found by name. The radio stacks start their tasks after boot, so the
+// sampler keeps looking for the ones that are not running yet.
+static const struct {
+    const char *name;
+    uint32_t stack_bytes;
+} SYSTEM_TASKS[] = {
+    {"IDLE", CONFIG_FREERTOS_IDLE_TASK_STACKSIZE},
+    {"esp_timer", CONFIG_ESP_TIMER_TASK_STACK_SIZE},
+    {"sys_evt", CONFIG_ESP_SYSTEM_EVENT_TASK_STACK_SIZE},
+    {"BTC_TASK", CONFIG_BT_BTC_TASK_STACK_SIZE},
+    {"BTU_TASK", CONFIG_BT_BTU_TASK_STACK_SIZE},
+    {"bt_controller", CONFIG_BT_LE_CONTROLLER_TASK_STACK_SIZE},
+};
+
+#define N_SYSTEM_TASKS (sizeof(SYSTEM_TASKS) / sizeof(SYSTEM_TASKS[0]))
+
+static struct diag_task tasks[DIAG_MAX_TASKS];
+static uint32_t system_tasks_found = 0;  // Bit i is set once SYSTEM_TASKS[i] has been registered
+static uint32_t n_tasks = 0;
+static uint32_t min_largest_block = UINT32_MAX;
+static portMUX_TYPE diag_lock = portMUX_INITIALIZER_UNLOCKED;
+static esp_timer_handle_t sample_timer = NULL;
+
+void diag_register_task(TaskHandle_t task, uint32_t stack_bytes)
+{
+    if (task == NULL){return;}
+    taskENTER_CRITICAL(&diag_lock);
+    for (uint32_t i = 0; i < n_tasks; i++){
+        if (tasks[i].handle == task){
+            taskEXIT_CRITICAL(&diag_lock);
+            return;
+        }
+    }
+    bool full = n_tasks == DIAG_MAX_TASKS;
+    if (!full){
+        tasks[n_tasks].handle = task;
+        tasks[n_tasks].stack_bytes = stack_bytes;
+        tasks[n_tasks].headroom_bytes = stack_bytes;
+        n_tasks++;
+    }
+    taskEXIT_CRITICAL(&diag_lock);
+    if (full){
+        ESP_LOGW(DIAG_TAG, "Task table full, not watching %s", pcTaskGetName(task));
+    }
+}
+
+static void find_system_tasks(void)
+{
+    for (uint32_t i = 0; i < N_SYSTEM_TASKS; i++){
+        if (system_tasks_found & (1 << i)){continue;}
+        TaskHandle_t task = xTaskGetHandle(SYSTEM_TASKS[i].name);
+        if (task != NULL){
+            diag_register_task(task, SYSTEM_TASKS[i].stack_bytes);
+            system_tasks_found |= 1 << i;
+        }
+    }
+}
+
+void diag_sample(void)
+{
+    find_system_tasks();
+
+    // The high water mark is in bytes on ESP-IDF, and only ever decreases
+    taskENTER_CRITICAL(&diag_lock);
+    uint32_t n = n_tasks;
+    taskEXIT_CRITICAL(&diag_lock);
+    for (uint32_t i = 0; i < n; i++){
+        uint32_t headroom = uxTaskGetStackHighWaterMark(tasks[i].handle);
+        tasks[i].headroom_bytes = headroom;
+#ifdef STACK_HEADROOM_MIN_BYTES
+        if (headroom < STACK_HEADROOM_MIN_BYTES){
+            ESP_LOGE(DIAG_TAG, "%s has %" PRIu32 " bytes of stack headroom left, the minimum is %d", 
+                     pcTaskGetName(tasks[i].handle), headroom, STACK_HEADROOM_MIN_BYTES);
+            abort();
+        }
+#endif
+    }
+
+    uint32_t largest = heap_caps_get_largest_free_block(MALLOC_CAP_DEFAULT);
+    taskENTER_CRITICAL(&diag_lock);
+    if (largest < min_largest_block){min_largest_block = largest;}
+    taskEXIT_CRITICAL(&diag_lock);
+}
+
+static void sample_timer_callback(void *arg)
+{
+    diag_sample();
+}
+
+esp_err_t diag_init(void)
+{
+    const esp_timer_create_args_t timer_args = {
+        .callback = &sample_timer_callback,
+        .arg = NULL,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "diag_sample",
+        .skip_unhandled_events = true,
+    };
+    ESP_RETURN_ON_ERROR(esp_timer_create(&timer_args, &sample_timer), DIAG_TAG, "Creating sampling timer failed");
+    ESP_RETURN_ON_ERROR(esp_timer_start_periodic(sample_timer, DIAG_SAMPLE_PERIOD_MS * 1000), DIAG_TAG, 
+                        "Starting sampling timer failed");
+    return ESP_OK;
+}
+
+uint32_t diag_task_count(void)
+{
+    taskENTER_CRITICAL(&diag_lock);
+    uint32_t n = n_tasks;
+    taskEXIT_CRITICAL(&diag_lock);
+    return n;
+}
+
+void diag_get_task_stats(uint32_t index, struct diag_task_stats *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+    if (index >= diag_task_count()){return;}
+    snprintf(stats->name, sizeof(stats->name), "%s", pcTaskGetName(tasks[index].handle));
+    stats->stack_bytes = tasks[index].stack_bytes;
+    stats->headroom_bytes = tasks[index].headroom_bytes;
+}
+
+void diag_get_heap_stats(struct diag_heap_stats *stats)
+{
+    stats->free_bytes = heap_caps_get_free_size(MALLOC_CAP_DEFAULT);
+    stats->min_free_bytes = heap_caps_get_minimum_free_size(MALLOC_CAP_DEFAULT);
+    stats->largest_block_bytes = heap_caps_get_largest_free_block(MALLOC_CAP_DEFAULT);
+    taskENTER_CRITICAL(&diag_lock);
+    if (stats->largest_block_bytes < min_largest_block){min_largest_block = stats->largest_block_bytes;}
+    stats->min_largest_block_bytes = min_largest_block;
+    taskEXIT_CRITICAL(&diag_lock);
+}
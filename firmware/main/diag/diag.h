@@ -0,0 +1,51 @@
+#ifndef _DIAG_H
+#define _DIAG_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <esp_err.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+/*
+Stack and heap diagnostics. Tasks are registered with the stack size they were created with, and a timer samples the
+high water mark of every registered task and the state of the heap. The results show how much of each stack was never
+used, so that stack sizes can be reduced and the RAM given to the history and the radios.
+
+With STACK_HEADROOM_CHECK set in main/CMakeLists.txt, the device aborts as soon as a task has less than
+STACK_HEADROOM_MIN_BYTES of unused stack, so that test runs fail when stack sizes are cut too far.
+*/
+
+#define DIAG_MAX_TASKS 24
+#define DIAG_SAMPLE_PERIOD_MS 5000
+#define DIAG_HEADROOM_WARN_BYTES 512  // Tasks with less unused stack than this are flagged by the console
+
+struct diag_task_stats {
+    char name[configMAX_TASK_NAME_LEN];
+    uint32_t stack_bytes;     // Stack size the task was created with
+    uint32_t headroom_bytes;  // Stack that was never used since the task started
+};
+
+struct diag_heap_stats {
+    uint32_t free_bytes;                // Free heap now
+    uint32_t min_free_bytes;            // Lowest free heap since boot
+    uint32_t largest_block_bytes;       // Largest free block now
+    uint32_t min_largest_block_bytes;   // Lowest largest free block seen by the sampler
+};
+
+// Starts the sampling timer. The tasks of ESP-IDF and the radio stacks are registered by the sampler as they appear.
+esp_err_t diag_init(void);
+
+// Registers a task that runs until reboot. Tasks that are deleted must not be registered.
+void diag_register_task(TaskHandle_t task, uint32_t stack_bytes);
+
+// Samples all registered tasks and the heap now, instead of waiting for the timer
+void diag_sample(void);
+
+// Returns the number of registered tasks
+uint32_t diag_task_count(void);
+
+void diag_get_task_stats(uint32_t index, struct diag_task_stats *stats);
+void diag_get_heap_stats(struct diag_heap_stats *stats);
+
+#endif
@@ -13,5 +13,8 @@ struct minico2_cfg_s MINICO2CONFIG_DEFAULT = {
     .led_cfg.brightness = 0.3,
     .led_cfg.limit_medium = 1000,
     .led_cfg.limit_high = 1500,
-    .led_cfg.limit_critical = 2000
+    .led_cfg.limit_critical = 2000,
+    .serial_format = SERIAL_FORMAT_TEXT,
+    .outdoor_co2 = 420,
+    .adaptive_sampling = false
 };
\ No newline at end of file
@@ -0,0 +1,134 @@
+#include <stdlib.h>
+#include <inttypes.h>
+#include <esp_heap_caps.h>
+#include <esp_log.h>
+#include "freertos/FreeRTOS.h"
+#include "history.h"
+
+static const char *HISTORY_TAG = "history";
+
+// Temperatures are stored with this offset, so that they fit in an unsigned field
+#define TEMP_OFFSET_DC (-450)
+
+// A sample packed into 8 bytes
+struct history_record {
+    uint64_t time_s : 26;    // Seconds since boot, wraps after 2 years
+    uint64_t co2 : 16;       // PPM
+    uint64_t temp : 11;      // Deci-degrees Celsius, minus TEMP_OFFSET_DC. Covers -45 to 159.7 degrees.
+    uint64_t hum_dpct : 11;  // Deci-percent relative humidity
+};
+_Static_assert(sizeof(struct history_record) == 8, "History records must be 8 bytes");
+
+static struct history_record *records = NULL;
+static uint32_t capacity = 0;
+static uint32_t head = 0;  // Sequence number of the next record to write
+static portMUX_TYPE history_lock = portMUX_INITIALIZER_UNLOCKED;
+
+esp_err_t history_init(size_t max_bytes)
+{
+    size_t bytes = heap_caps_get_free_size(MALLOC_CAP_DEFAULT) / HISTORY_HEAP_DIVISOR;
+    if (bytes > max_bytes){bytes = max_bytes;}
+    uint32_t n = bytes / sizeof(struct history_record);
+    if (n < HISTORY_MIN_RECORDS){
+        ESP_LOGE(HISTORY_TAG, "Not enough free heap for the history");
+        return ESP_ERR_NO_MEM;
+    }
+
+    records = heap_caps_malloc(n * sizeof(struct history_record), MALLOC_CAP_DEFAULT);
+    if (records == NULL){
+        ESP_LOGE(HISTORY_TAG, "Allocating %" PRIu32 " history records failed", n);
+        return ESP_ERR_NO_MEM;
+    }
+    capacity = n;
+    ESP_LOGI(HISTORY_TAG, "History holds %" PRIu32 " samples (%u bytes)", n, (unsigned)(n * sizeof(struct history_record)));
+    return ESP_OK;
+}
+
+static uint16_t clamp_u(int32_t v, int32_t max)
+{
+    if (v < 0){return 0;}
+    if (v > max){return max;}
+    return v;
+}
+
+void history_append(const struct SCD40measurement *meas, uint32_t time_s)
+{
+    if (capacity == 0){return;}
+
+    struct history_record rec = {
+        .time_s = time_s,
+        .co2 = meas->co2,
+        .temp = clamp_u(meas->temp_cdeg / 10 - TEMP_OFFSET_DC, 0x7ff),
+        .hum_dpct = clamp_u(meas->hum_cpct / 10, 0x7ff),
+    };
+
+    taskENTER_CRITICAL(&history_lock);
+    records[head % capacity] = rec;
+    head++;
+    taskEXIT_CRITICAL(&history_lock);
+}
+
+uint32_t history_size(void)
+{
+    return head < capacity ? head : capacity;
+}
+
+uint32_t history_capacity(void)
+{
+    return capacity;
+}
+
+// Sequence number of the oldest record still in the ring. Must be called with 'history_lock' held.
+static uint32_t oldest(void)
+{
+    return head < capacity ? 0 : head - capacity;
+}
+
+// Returns the sequence number of the first record with a time not before 'time_s'
+static uint32_t lower_bound(uint32_t time_s)
+{
+    taskENTER_CRITICAL(&history_lock);
+    uint32_t lo = oldest();
+    uint32_t hi = head;
+    while (lo < hi){
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (records[mid % capacity].time_s < time_s){
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    taskEXIT_CRITICAL(&history_lock);
+    return lo;
+}
+
+void history_range(struct history_iter *it, uint32_t from_s, uint32_t to_s)
+{
+    if (capacity == 0 || to_s < from_s){
+        it->next = it->end = 0;
+        return;
+    }
+    it->next = lower_bound(from_s);
+    it->end = to_s == UINT32_MAX ? head : lower_bound(to_s + 1);
+}
+
+bool history_next(struct history_iter *it, struct history_sample *sample)
+{
+    if (it->next >= it->end){return false;}
+
+    taskENTER_CRITICAL(&history_lock);
+    // Records that were overwritten since the range was set up are skipped
+    if (it->next < oldest()){it->next = oldest();}
+    bool valid = it->next < it->end;
+    struct history_record rec;
+    if (valid){rec = records[it->next % capacity];}
+    taskEXIT_CRITICAL(&history_lock);
+
+    if (!valid){return false;}
+    it->next++;
+    sample->time_s = rec.time_s;
+    sample->co2 = rec.co2;
+    sample->temp_dc = (int16_t)rec.temp + TEMP_OFFSET_DC;
+    sample->hum_dpct = rec.hum_dpct;
+    return true;
+}
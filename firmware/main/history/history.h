@@ -0,0 +1,48 @@
+#ifndef _HISTORY_H
+#define _HISTORY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <esp_err.h>
+#include "../types.h"
+
+/*
+In-RAM history of the most recent measurements. Samples are stored in a ring of packed 8-byte records, so at a 30 
+second measurement period 24 hours of history fit in 23 KB. When the ring is full, the oldest samples are overwritten.
+*/
+
+#define HISTORY_MAX_BYTES (24 * 1024)  // Upper limit of the history size
+#define HISTORY_HEAP_DIVISOR 8         // The history uses at most this fraction of the free heap at boot
+#define HISTORY_MIN_RECORDS 120        // Lower limit of the history size
+
+// One sample of the history, unpacked
+struct history_sample {
+    uint32_t time_s;     // Seconds since boot
+    uint16_t co2;        // PPM
+    int16_t temp_dc;     // Deci-degrees Celsius
+    uint16_t hum_dpct;   // Deci-percent relative humidity
+};
+
+// Iterator over a time range of the history
+struct history_iter {
+    uint32_t next;  // Sequence number of the next record to read
+    uint32_t end;   // Sequence number one past the last record in the range
+};
+
+// Allocates the history. Its capacity is the smaller of 'max_bytes' and the free heap divided by HISTORY_HEAP_DIVISOR.
+esp_err_t history_init(size_t max_bytes);
+
+// Appends a measurement taken at 'time_s' seconds since boot. Times must not decrease.
+void history_append(const struct SCD40measurement *meas, uint32_t time_s);
+
+// Number of samples in the history, and the number it can hold
+uint32_t history_size(void);
+uint32_t history_capacity(void);
+
+// Sets up 'it' to iterate over the samples taken from 'from_s' to 'to_s', both inclusive
+void history_range(struct history_iter *it, uint32_t from_s, uint32_t to_s);
+
+// Reads the next sample of the range into 'sample'. Returns false at the end of the range.
+bool history_next(struct history_iter *it, struct history_sample *sample);
+
+#endif
@@ -0,0 +1,109 @@
+#include <string.h>
+#include <esp_timer.h>
+#include "freertos/FreeRTOS.h"
+#include "latency.h"
+
+struct latency_histogram {
+    uint32_t count;
+    uint32_t min_us;
+    uint32_t max_us;
+    uint64_t sum_us;
+    uint32_t buckets[LATENCY_N_BUCKETS];
+};
+
+static struct latency_histogram histograms[LATENCY_N_STAGES];
+static portMUX_TYPE latency_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static uint32_t bucket_of(uint32_t us)
+{
+    if (us < LATENCY_SUB_BUCKETS){return us;}
+    uint32_t msb = 31 - __builtin_clz(us);
+    uint32_t bucket = (msb - 1) * LATENCY_SUB_BUCKETS + ((us >> (msb - 2)) & (LATENCY_SUB_BUCKETS - 1));
+    return bucket < LATENCY_N_BUCKETS ? bucket : LATENCY_N_BUCKETS - 1;
+}
+
+// Returns the largest latency that falls into 'bucket'
+static uint32_t bucket_upper_us(uint32_t bucket)
+{
+    if (bucket < LATENCY_SUB_BUCKETS){return bucket;}
+    uint32_t msb = bucket / LATENCY_SUB_BUCKETS + 1;
+    uint32_t sub = bucket % LATENCY_SUB_BUCKETS;
+    return ((LATENCY_SUB_BUCKETS + sub + 1) << (msb - 2)) - 1;
+}
+
+uint32_t latency_now(void)
+{
+    return (uint32_t)esp_timer_get_time();
+}
+
+void latency_record(enum LATENCY_STAGES stage, uint32_t origin_us)
+{
+    if (stage >= LATENCY_N_STAGES){return;}
+    uint32_t us = latency_now() - origin_us;  // Wraps correctly for latencies under 71 minutes
+
+    taskENTER_CRITICAL(&latency_lock);
+    struct latency_histogram *h = &histograms[stage];
+    if (h->count == 0 || us < h->min_us){h->min_us = us;}
+    if (us > h->max_us){h->max_us = us;}
+    h->count++;
+    h->sum_us += us;
+    h->buckets[bucket_of(us)]++;
+    taskEXIT_CRITICAL(&latency_lock);
+}
+
+// Returns the upper bound of the bucket that holds the 'percent' percentile
+static uint32_t percentile(const struct latency_histogram *h, uint32_t percent)
+{
+    uint32_t rank = (h->count * percent + 99) / 100;
+    uint32_t seen = 0;
+    for (uint32_t b = 0; b < LATENCY_N_BUCKETS; b++){
+        seen += h->buckets[b];
+        if (seen >= rank && seen > 0){
+            uint32_t upper = bucket_upper_us(b);
+            return upper < h->max_us ? upper : h->max_us;
+        }
+    }
+    return h->max_us;
+}
+
+void latency_get_stats(enum LATENCY_STAGES stage, struct latency_stage_stats *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+    if (stage >= LATENCY_N_STAGES){return;}
+
+    static struct latency_histogram h;  // Too large for the caller's stack, and only the console reads the stats
+    taskENTER_CRITICAL(&latency_lock);
+    h = histograms[stage];
+    taskEXIT_CRITICAL(&latency_lock);
+
+    stats->count = h.count;
+    stats->min_us = h.min_us;
+    stats->max_us = h.max_us;
+    stats->sum_us = h.sum_us;
+    if (h.count > 0){
+        stats->p50_us = percentile(&h, 50);
+        stats->p90_us = percentile(&h, 90);
+        stats->p99_us = percentile(&h, 99);
+    }
+}
+
+void latency_reset(void)
+{
+    taskENTER_CRITICAL(&latency_lock);
+    memset(histograms, 0, sizeof(histograms));
+    taskEXIT_CRITICAL(&latency_lock);
+}
+
+const char *latency_stage_to_str(enum LATENCY_STAGES stage)
+{
+    switch (stage)
+    {
+    case LATENCY_SENSOR_READ: return "sensor_read";
+    case LATENCY_CONTROLLER_RECEIVE: return "controller_receive";
+    case LATENCY_LED_STATE_SENT: return "led_state_sent";
+    case LATENCY_BLE_PAYLOAD_CONFIGURED: return "ble_payload_configured";
+    case LATENCY_BLE_ADVERT_STARTED: return "ble_advert_started";
+    case LATENCY_ZIGBEE_ATTRIBUTE_WRITTEN: return "zigbee_attribute_written";
+    default: return "unknown";
+    }
+}
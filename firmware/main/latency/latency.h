@@ -0,0 +1,48 @@
+#ifndef _LATENCY_H
+#define _LATENCY_H
+
+#include <stdint.h>
+
+/*
+Latency of each sample through the pipeline, from the sensor read to the radios. Every measurement carries the time 
+it was read from the sensor ('read_us' in SCD40measurement), and each stage records how long after that it handled 
+the sample. The sensor read stage itself records the time from the sampling trigger to the read.
+
+Latencies go into per-stage log-linear histograms of fixed size: 4 buckets per power of two, so percentiles are 
+accurate to within 25 percent, up to 2^28 us (268 s).
+*/
+
+enum LATENCY_STAGES {
+    LATENCY_SENSOR_READ,            // Sampling trigger to data read from the sensor
+    LATENCY_CONTROLLER_RECEIVE,     // Measurement received by the controller
+    LATENCY_LED_STATE_SENT,         // LED state sent to the LED task
+    LATENCY_BLE_PAYLOAD_CONFIGURED, // Advert data set in the BLE controller
+    LATENCY_BLE_ADVERT_STARTED,     // Advert with the sample on air
+    LATENCY_ZIGBEE_ATTRIBUTE_WRITTEN, // ZCL attributes updated
+    LATENCY_N_STAGES
+};
+
+#define LATENCY_SUB_BUCKETS 4
+#define LATENCY_N_BUCKETS 108
+
+struct latency_stage_stats {
+    uint32_t count;
+    uint32_t min_us;
+    uint32_t max_us;
+    uint64_t sum_us;
+    uint32_t p50_us;
+    uint32_t p90_us;
+    uint32_t p99_us;
+};
+
+// Returns the current time in the time base of 'read_us'
+uint32_t latency_now(void);
+
+// Records that 'stage' was reached for a sample that originated at 'origin_us'
+void latency_record(enum LATENCY_STAGES stage, uint32_t origin_us);
+
+void latency_get_stats(enum LATENCY_STAGES stage, struct latency_stage_stats *stats);
+void latency_reset(void);
+const char *latency_stage_to_str(enum LATENCY_STAGES stage);
+
+#endif
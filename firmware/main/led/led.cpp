@@ -2,6 +2,7 @@
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
 #include <freertos/queue.h>
+#include <freertos/semphr.h>
 #include "driver/gpio.h"
 #include <esp_err.h>
 #include <esp_check.h>
@@ -10,19 +11,42 @@
 #include "led_strip.h"
 #include "sdkconfig.h"
 #include "../types.h"
+extern "C" {
 #include "../config/config.h"
-#include "../globals.h"
+#include "../boot/boot.h"
+}
 #include "led.h"
 
 static const char *LED_TAG = "led";
 
-static int64_t time0 = 0;
+// Frame rate of the PULSING and FLASHING animations
+#define LED_FRAME_RATE_HZ 50
+
+// One period of the pulse waveform: a raised cosine with a 2.2 gamma curve applied, from 0 to 255.
+static const uint8_t PULSE_LUT[] = {
+      0,   0,   0,   0,   0,   1,   1,   2,   4,   6,   9,  14,  19,  26,  34,  44,
+     55,  68,  82,  97, 113, 130, 147, 164, 180, 196, 210, 223, 234, 243, 250, 254,
+    255, 254, 250, 243, 234, 223, 210, 196, 180, 164, 147, 130, 113,  97,  82,  68,
+     55,  44,  34,  26,  19,  14,   9,   6,   4,   2,   1,   1,   0,   0,   0,   0
+};
+#define PULSE_LUT_LEN (sizeof(PULSE_LUT) / sizeof(PULSE_LUT[0]))
 
 static led_strip_handle_t led;
+static esp_timer_handle_t frame_timer;
+static SemaphoreHandle_t frame_semaphore;  // Given by the frame timer and when the output must be re-rendered
+static StaticSemaphore_t frame_semaphore_buffer;
+static QueueSet<1 + 1> led_queue_set;      // The LED state channel and the frame semaphore
+
+static int64_t animation_start_us = 0;
+static uint8_t led_brightness = 0;  // Global brightness from the configuration, 0 to 255
+
+// The last color pushed to the LED. The LED is only refreshed when the rendered color differs from this.
+static uint8_t led_out_r = 0, led_out_g = 0, led_out_b = 0;
+static bool led_out_valid = false;
 
 // Create a struct to hold the state of the LED
-struct RGBA led_clr = {0, 0, 0, 0};
-struct LED_VISUAL_STATE led_visual_state = {led_clr, STATIC, 1};
+struct RGBA led_clr = {0, 0, 0, 255};
+struct LED_VISUAL_STATE led_visual_state = {led_clr, STATIC, 1000};
 
 
 esp_err_t initiate_led(void)
@@ -42,7 +66,9 @@ esp_err_t initiate_led(void)
         .mem_block_symbols = 0,
         .flags = {.with_dma = false},
     };
-    led_visual_state.clr.a = 255*MINICO2CONFIG.led_cfg.brightness;
+    struct minico2_cfg_s config;
+    config_snapshot(&config);
+    led_brightness = 255*config.led_cfg.brightness;
 
     ESP_LOGI(LED_TAG, "1/2 - Creating new led_strip_handle_t object");
     ESP_RETURN_ON_ERROR(led_strip_new_rmt_device(&strip_config, &rmt_config, &led), LED_TAG, "LED initialization failed");
@@ -54,11 +80,41 @@ esp_err_t initiate_led(void)
     return ESP_OK;
 }
 
-// Sets the color of the LED from an RGBA struct.
-void set_led_from_RGBA(struct RGBA clr){
-    float a_f = clr.a / 255.0;
-    ESP_ERROR_CHECK(led_strip_set_pixel(led, 0, clr.r * a_f, clr.g * a_f, clr.b * a_f));
+// Scales 'x' by 's'/255
+static inline uint8_t scale8(uint16_t x, uint8_t s){
+    return (x * (s + 1)) >> 8;
+}
+
+// Pushes a color to the LED, unless it is already showing it
+static void push_led(uint8_t r, uint8_t g, uint8_t b){
+    if (led_out_valid && r == led_out_r && g == led_out_g && b == led_out_b){
+        return;
+    }
+    ESP_ERROR_CHECK(led_strip_set_pixel(led, 0, r, g, b));
     ESP_ERROR_CHECK(led_strip_refresh(led));
+    led_out_r = r;
+    led_out_g = g;
+    led_out_b = b;
+    led_out_valid = true;
+}
+
+// Returns the level of the animation from 0 to 255, for the current point in its period
+static uint8_t animation_level(struct LED_VISUAL_STATE state){
+    if (state.mode == STATIC || state.period_ms == 0){
+        return 255;
+    }
+    uint32_t ms_since_start = (esp_timer_get_time() - animation_start_us) / 1000;
+    uint32_t progress_ms = ms_since_start % state.period_ms;
+    if (state.mode == FLASHING){
+        return progress_ms < state.period_ms / 2 ? 255 : 0;
+    }
+    return PULSE_LUT[progress_ms * PULSE_LUT_LEN / state.period_ms];
+}
+
+// Renders the current 'led_visual_state' to the LED
+static void render_led(){
+    uint8_t level = scale8(scale8(led_visual_state.clr.a, led_brightness), animation_level(led_visual_state));
+    push_led(scale8(led_visual_state.clr.r, level), scale8(led_visual_state.clr.g, level), scale8(led_visual_state.clr.b, level));
 }
 
 void set_visual_led_state_from_state(enum LED_STATES state, struct LED_VISUAL_STATE* led_visual_state){
@@ -82,59 +138,74 @@ void set_visual_led_state_from_state(enum LED_STATES state, struct LED_VISUAL_ST
         led_visual_state->clr.g = 255;
         led_visual_state->clr.b = 255;
         led_visual_state->mode = PULSING;
-        led_visual_state->period = 2;
+        led_visual_state->period_ms = 2000;
     }else if (state == ERROR_L){
         led_visual_state->clr.r = 255;
         led_visual_state->clr.g = 0;
         led_visual_state->clr.b = 0;
         led_visual_state->mode = PULSING;
-        led_visual_state->period = 1;
+        led_visual_state->period_ms = 1000;
     }else{
         ESP_LOGW(LED_TAG, "Invalid LED state %u", state);
     }
 }
 
-// Updates the LED brightness based on the pulsing period.
-void progress_led_pulse(struct LED_VISUAL_STATE state){
-    uint64_t ms_since_pulsing_began = (esp_timer_get_time() - time0)/1E3;
-    
-    int32_t period_ms = state.period * 1000;
-    int32_t pulse_progress = ms_since_pulsing_began % period_ms;
-    float alpha = abs(pulse_progress - period_ms/2)/(float)period_ms/2;
-
-    struct RGBA new_clr = state.clr;
-    new_clr.a = new_clr.a * alpha;
-    set_led_from_RGBA(new_clr);
+// Starts the frame timer for animated modes and stops it for STATIC
+static void update_frame_timer(){
+    esp_timer_stop(frame_timer);  // Fails harmlessly if the timer is not running
+    if (led_visual_state.mode != STATIC){
+        animation_start_us = esp_timer_get_time();
+        ESP_ERROR_CHECK(esp_timer_start_periodic(frame_timer, 1000000 / LED_FRAME_RATE_HZ));
+    }
 }
 
-// Calls an update of the LED. The LED is set to the current value of the 'led_visual_state' struct.
-void update_led(){
-    if (led_visual_state.mode == STATIC) {
-        set_led_from_RGBA(led_visual_state.clr);
-    } else if (led_visual_state.mode == PULSING) {
-        progress_led_pulse(led_visual_state);
-    }
+static void frame_timer_callback(void *arg){
+    xSemaphoreGive(frame_semaphore);
 }
 
 // Updates the LED when the LED brightness setting changes.
 static void led_brightness_handler(void* handler_args, esp_event_base_t base, int32_t id, void* event_data)
 {
     ESP_LOGD(LED_TAG, "led_brightness_handler received event");
-    led_visual_state.clr.a = 255*MINICO2CONFIG.led_cfg.brightness;
+    struct minico2_cfg_s config;
+    config_snapshot(&config);
+    led_brightness = 255*config.led_cfg.brightness;
+    xSemaphoreGive(frame_semaphore);
 }
 
-void led_task(void *pvParameters)
+void led_task(const led_channels *channels)
 {
-    // Get the queues from the pvParameters pointer
-    QueueHandle_t *queues = (QueueHandle_t *)pvParameters;
-    QueueHandle_t led_state_queue = queues[0];
-    QueueHandle_t errors_queue = queues[1];
+    QueueHandle_t led_state_queue = channels->led_states.queue();
+
+    // The task blocks on both the LED state channel and the frame semaphore. The set must be populated while the 
+    // channel is empty, which is why this is done before anything else. The controller is launched after this task.
+    QueueSetHandle_t queue_set = NULL;
+    frame_semaphore = xSemaphoreCreateBinaryStatic(&frame_semaphore_buffer);
+    if (led_state_queue != 0 && frame_semaphore != NULL){
+        queue_set = led_queue_set.create();
+        if (queue_set != NULL){
+            xQueueAddToSet(led_state_queue, queue_set);
+            xQueueAddToSet(frame_semaphore, queue_set);
+        }
+    }
 
+    const esp_timer_create_args_t frame_timer_args = {
+        .callback = &frame_timer_callback,
+        .arg = NULL,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "led_frame",
+        .skip_unhandled_events = true,
+    };
+    // The brightness comes from the configuration
+    boot_wait(BOOT_BIT(BOOT_CONFIG_LOADED), portMAX_DELAY);
     esp_err_t led_init_err = initiate_led();
+    if (led_init_err == ESP_OK){
+        led_init_err = esp_timer_create(&frame_timer_args, &frame_timer);
+    }
     if (led_init_err){
         // Log the error, put it on the errors queue, and enter an infinite loop
         ESP_ERROR_CHECK_WITHOUT_ABORT(led_init_err);
-        xQueueSendToBack(errors_queue, &led_init_err, (TickType_t) 0);
+        channels->errors.send(led_init_err);
         while (1){
             vTaskDelay(pdMS_TO_TICKS(1000));
         }
@@ -142,8 +213,8 @@ void led_task(void *pvParameters)
     
     // If led_state_queue is 0 (meaning it failed at being created), we put the LED state to ERROR 
     // and enter an infinite loop
-    if (led_state_queue == 0){
-        ESP_LOGE(LED_TAG, "Led state queue is 0, entering infinite loop");
+    if (led_state_queue == 0 || queue_set == NULL){
+        ESP_LOGE(LED_TAG, "Led state queue or queue set is 0, entering infinite loop");
         set_visual_led_state_from_state(ERROR_L, &led_visual_state);
         while (1){
             vTaskDelay(pdMS_TO_TICKS(1000));
@@ -153,13 +224,25 @@ void led_task(void *pvParameters)
     // Register the event handlers
     ESP_ERROR_CHECK(esp_event_handler_instance_register(CONFIG_EVENTS, LED_BRIGHTNESS_EVENT, led_brightness_handler, NULL, NULL));
 
+    // The task only wakes up for new LED states, animation frames and brightness changes. In STATIC mode the frame 
+    // timer is stopped, so the task sleeps until the next state change.
     enum LED_STATES state;
     while (1){
-        if (xQueueReceive(led_state_queue, &( state), (TickType_t) 10)){
-            ESP_LOGD(LED_TAG, "Received LED state %u", state);
-            set_visual_led_state_from_state(state, &led_visual_state);
-            ESP_LOGD(LED_TAG, "LED set to R: %u, G: %u, B: %u, A: %u, State: %s", led_visual_state.clr.r, led_visual_state.clr.g, led_visual_state.clr.b, led_visual_state.clr.a, str(led_visual_state.mode));
+        QueueSetMemberHandle_t active = xQueueSelectFromSet(queue_set, portMAX_DELAY);
+        if (active == led_state_queue){
+            if (channels->led_states.receive(state, 0)){
+                ESP_LOGD(LED_TAG, "Received LED state %u", state);
+                enum LED_MODES old_mode = led_visual_state.mode;
+                uint16_t old_period_ms = led_visual_state.period_ms;
+                set_visual_led_state_from_state(state, &led_visual_state);
+                if (led_visual_state.mode != old_mode || led_visual_state.period_ms != old_period_ms){
+                    update_frame_timer();
+                }
+                ESP_LOGD(LED_TAG, "LED set to R: %u, G: %u, B: %u, A: %u, State: %s", led_visual_state.clr.r, led_visual_state.clr.g, led_visual_state.clr.b, led_visual_state.clr.a, str(led_visual_state.mode));
+            }
+        } else if (active == frame_semaphore){
+            xSemaphoreTake(frame_semaphore, (TickType_t) 0);
         }
-        update_led();
+        render_led();
     }
 }
\ No newline at end of file
@@ -2,8 +2,17 @@
 #ifndef _LED_H
 #define _LED_H
 
+#include <esp_err.h>
+#include "../types.h"
+#include "../topology/channel.h"
+
 #define LED_GPIO 23
 
-void led_task(void *pvParameters);
+struct led_channels {
+    ChannelHandle<LED_STATES> led_states;  // From the controller
+    ChannelHandle<esp_err_t> errors;       // To the controller
+};
+
+void led_task(const led_channels *channels);
 
 #endif
\ No newline at end of file
@@ -23,9 +23,16 @@
 #include "led/led.h"
 #include "controller/controller.h"
 #include "ble/ble.h"
+#include "topology/topology.h"
 extern "C" {
 #include "zigbee/zigbee.h"
 #include "config/loadsave.h"
+#include "history/history.h"
+#include "tslog/tslog.h"
+#include "diag/diag.h"
+#include "boot/boot.h"
+#include "console/console.h"
+#include "serial/serial_out.h"
 }
 
 #ifndef APP_CPU_NUM
@@ -37,14 +44,6 @@ extern "C" {
 #error Define ZB_ED_ROLE in idf.py menuconfig to compile sensor (End Device) source code.
 #endif
 
-static constexpr const char *MAIN_TAG = "main";
-
-TaskHandle_t scd40_task_handle = NULL;
-TaskHandle_t led_task_handle = NULL;
-TaskHandle_t controller_task_handle = NULL;
-TaskHandle_t ble_task_handle = NULL;
-TaskHandle_t zigbee_task_handle = NULL;
-
 // Global scope configuration variable
 minico2_cfg_s CONFIGURATION;
 
@@ -92,50 +91,36 @@ extern "C" {
 
 void app_main(void)
 {   
+    boot_init();
     boot();  //Print ESP32 chip info to the serial port.
     
     // Initialize the default event loop
     esp_event_loop_create_default();
 
-    // Initialize NVS and load the minico2 config
-    ESP_ERROR_CHECK(init_config_storage());
-
-    // Init the queues
-    struct SCD40measurement meas;
-    QueueHandle_t measurements_queue = xQueueCreate(1, sizeof(meas));
-    if (measurements_queue == 0){ESP_LOGE(MAIN_TAG, "Failed at creating measurements queue");}
-
-    enum LED_STATES state;
-    QueueHandle_t led_state_queue = xQueueCreate(1, sizeof(state));
-    if (led_state_queue == 0){ESP_LOGE(MAIN_TAG, "Failed at creating LED state queue");}
+    // Initialize NVS, once for the config, BLE and ZigBee
+    ESP_ERROR_CHECK(init_nvs());
+    boot_mark(BOOT_NVS_READY);
 
-    esp_err_t error;
-    QueueHandle_t errors_queue = xQueueCreate(1, sizeof(error));
-    if (errors_queue == 0){ESP_LOGE(MAIN_TAG, "Failed at creating error queue");}
+    // Allocate the measurement history. The device works without it, so a failure is not fatal. This is done before 
+    // the radio stacks start, so that the share of the heap it takes does not depend on how far they got.
+    ESP_ERROR_CHECK_WITHOUT_ABORT(history_init(HISTORY_MAX_BYTES));
 
-    QueueHandle_t ble_queue = xQueueCreate(1, sizeof(meas));
-    if (ble_queue == 0){ESP_LOGE(MAIN_TAG, "Failed at creating BLE queue");}
+    // Create the channels and launch the tasks
+    topology_start();
+    boot_mark(BOOT_TASKS_LAUNCHED);
 
-    QueueHandle_t zigbee_queue = xQueueCreate(1, sizeof(meas));
-    if (zigbee_queue == 0){ESP_LOGE(MAIN_TAG, "Failed at creating ZigBee queue");}
-
-    // Launch the LED task
-    QueueHandle_t led_queues[] = {led_state_queue, errors_queue}; 
-    xTaskCreate(led_task, "LED_task", 4096, led_queues, 10, &led_task_handle);
-
-    // Launch the controller task
-    QueueHandle_t controller_queues[] = {measurements_queue, led_state_queue, errors_queue, ble_queue, zigbee_queue};
-    xTaskCreate(controller_task, "controller_task", configMINIMAL_STACK_SIZE * 8, controller_queues, 10, &controller_task_handle);
+    // Load the minico2 config while the tasks initialize the sensor and the radios. The tasks that need the config 
+    // wait for BOOT_CONFIG_LOADED.
+    ESP_ERROR_CHECK(init_config_storage());
+    boot_mark(BOOT_CONFIG_LOADED);
 
-    // Launch the SCD40 sensor reader task
-    QueueHandle_t scd40_queues[] = {measurements_queue, errors_queue}; 
-    xTaskCreate(scd40_task, "SCD40_task", configMINIMAL_STACK_SIZE * 8, scd40_queues, 10, &scd40_task_handle);
+    // The console commands only need the config and the history
+    start_console();
+    boot_mark(BOOT_CONSOLE_READY);
 
-    // Launch the BLE task
-    QueueHandle_t ble_queues[] = {ble_queue, errors_queue}; 
-    xTaskCreate(ble_task, "BLE_task", configMINIMAL_STACK_SIZE * 8, ble_queues, 10, &ble_task_handle);
+    // The serial output and the log go through the USB serial JTAG driver that the console installed
+    ESP_ERROR_CHECK_WITHOUT_ABORT(serial_out_start());
 
-    // Launch the ZigBee task
-    QueueHandle_t zigbee_queues[] = {zigbee_queue, errors_queue}; 
-    xTaskCreate(zigbee_task, "ZigBee_task", configMINIMAL_STACK_SIZE * 8, zigbee_queues, 10, &zigbee_task_handle);
-}
\ No newline at end of file
+    // Watch the stacks of the tasks and the heap
+    ESP_ERROR_CHECK_WITHOUT_ABORT(diag_init());
+}
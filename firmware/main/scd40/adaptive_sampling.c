@@ -0,0 +1,128 @@
+#include <stdbool.h>
+#include "../sync/spinlock.h"
+#include "adaptive_sampling.h"
+
+struct sample {
+    uint32_t time_s;
+    uint16_t co2;
+};
+
+// The last samples, for the rate of change. Only the SCD40 task touches these.
+static struct sample recent[ADAPTIVE_SAMPLING_RATE_SAMPLES];
+static uint8_t recent_next = 0;
+static uint8_t recent_count = 0;
+static uint8_t hold = 0;          // Samples in a row whose target allowed the next longer step
+static uint32_t first_time_s = 0;
+
+static struct adaptive_sampling_stats stats = {0};
+static spinlock_t adaptive_lock = SPINLOCK_INITIALIZER;
+
+void adaptive_sampling_reset(uint16_t ceiling_s, bool enabled)
+{
+    hold = 0;
+    spinlock_take(&adaptive_lock);
+    stats.enabled = enabled;
+    stats.ceiling_s = ceiling_s;
+    stats.period_s = ceiling_s;
+    spinlock_give(&adaptive_lock);
+}
+
+// Rate of change in PPM per hour, from the newest sample at least ADAPTIVE_SAMPLING_RATE_WINDOW_S older than the
+// last one, or from the oldest one there is
+static uint32_t rate_ppm_h(void)
+{
+    if (recent_count < 2){return 0;}
+    const struct sample *last = &recent[(recent_next + ADAPTIVE_SAMPLING_RATE_SAMPLES - 1) % ADAPTIVE_SAMPLING_RATE_SAMPLES];
+    const struct sample *ref = NULL;
+    for (int i = 2; i <= recent_count; i++){
+        ref = &recent[(recent_next + ADAPTIVE_SAMPLING_RATE_SAMPLES - i) % ADAPTIVE_SAMPLING_RATE_SAMPLES];
+        if (last->time_s - ref->time_s >= ADAPTIVE_SAMPLING_RATE_WINDOW_S){break;}
+    }
+
+    uint32_t span_s = last->time_s - ref->time_s;
+    uint32_t change = last->co2 > ref->co2 ? last->co2 - ref->co2 : ref->co2 - last->co2;
+    if (span_s == 0 || change <= ADAPTIVE_SAMPLING_NOISE_PPM){return 0;}
+    return (change - ADAPTIVE_SAMPLING_NOISE_PPM) * 3600 / span_s;
+}
+
+// The period the rate and the distance to the LED limits call for, between the floor and 'ceiling'
+static uint32_t target_period(uint16_t co2, uint32_t rate, const struct led_cfg_s *limits, uint16_t ceiling)
+{
+    uint32_t target = ceiling;
+    if (rate > 0 && ADAPTIVE_SAMPLING_CHANGE_PPM * 3600 / rate < target){
+        target = ADAPTIVE_SAMPLING_CHANGE_PPM * 3600 / rate;
+    }
+
+    const uint16_t limit[3] = {limits->limit_medium, limits->limit_high, limits->limit_critical};
+    uint32_t distance = UINT32_MAX;
+    for (int i = 0; i < 3; i++){
+        uint32_t d = co2 > limit[i] ? co2 - limit[i] : limit[i] - co2;
+        if (d < distance){distance = d;}
+    }
+    distance = distance > ADAPTIVE_SAMPLING_NOISE_PPM ? distance - ADAPTIVE_SAMPLING_NOISE_PPM : 0;
+    if (distance < ADAPTIVE_SAMPLING_NEAR_LIMIT_PPM){
+        uint32_t near = ADAPTIVE_SAMPLING_FLOOR_S +
+                        (ceiling - ADAPTIVE_SAMPLING_FLOOR_S) * distance / ADAPTIVE_SAMPLING_NEAR_LIMIT_PPM;
+        if (near < target){target = near;}
+    }
+    return target < ADAPTIVE_SAMPLING_FLOOR_S ? ADAPTIVE_SAMPLING_FLOOR_S : target;
+}
+
+// The longest step that is no longer than 'target'
+static uint16_t step_for(uint32_t target, uint16_t ceiling)
+{
+    uint32_t step = ADAPTIVE_SAMPLING_FLOOR_S;
+    while (step * 2 <= target && step * 2 < ceiling){step *= 2;}
+    return step;
+}
+
+uint16_t adaptive_sampling_update(const struct SCD40measurement *meas, uint32_t time_s, const struct led_cfg_s *limits)
+{
+    recent[recent_next] = (struct sample){.time_s = time_s, .co2 = meas->co2};
+    recent_next = (recent_next + 1) % ADAPTIVE_SAMPLING_RATE_SAMPLES;
+    if (recent_count < ADAPTIVE_SAMPLING_RATE_SAMPLES){recent_count++;}
+    uint32_t rate = rate_ppm_h();
+
+    spinlock_take(&adaptive_lock);
+    bool enabled = stats.enabled;
+    uint16_t ceiling = stats.ceiling_s;
+    uint16_t period = stats.period_s;
+    spinlock_give(&adaptive_lock);
+
+    uint16_t next_period = ceiling;
+    if (enabled && ceiling > ADAPTIVE_SAMPLING_FLOOR_S){
+        uint32_t target = target_period(meas->co2, rate, limits, ceiling);
+        uint16_t longer = period * 2 >= ceiling ? ceiling : period * 2;
+        next_period = period;
+        if (target * 3 < period * 2){
+            next_period = step_for(target, ceiling);
+            hold = 0;
+        } else if (period < ceiling && target >= longer){
+            if (++hold >= ADAPTIVE_SAMPLING_HOLD_SAMPLES){
+                next_period = longer;
+                hold = 0;
+            }
+        } else {
+            hold = 0;
+        }
+    }
+
+    spinlock_take(&adaptive_lock);
+    if (stats.samples == 0){first_time_s = time_s;}
+    stats.samples++;
+    stats.elapsed_s = time_s - first_time_s;
+    stats.rate_ppm_h = rate;
+    if (next_period != stats.period_s){
+        stats.period_s = next_period;
+        stats.period_changes++;
+    }
+    spinlock_give(&adaptive_lock);
+    return next_period;
+}
+
+void adaptive_sampling_get_stats(struct adaptive_sampling_stats *out)
+{
+    spinlock_take(&adaptive_lock);
+    *out = stats;
+    spinlock_give(&adaptive_lock);
+}
@@ -0,0 +1,55 @@
+#ifndef _ADAPTIVE_SAMPLING_H
+#define _ADAPTIVE_SAMPLING_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "../types.h"
+
+/*
+Adaptive sampling policy. After every sample it picks the measurement period, between ADAPTIVE_SAMPLING_FLOOR_S and
+the configured measurement period, which is the ceiling.
+
+Two things shorten the period. The rate of change of the CO2: the period is the time the CO2 takes to change
+ADAPTIVE_SAMPLING_CHANGE_PPM at the current rate. The rate is measured over the last ADAPTIVE_SAMPLING_RATE_WINDOW_S,
+less ADAPTIVE_SAMPLING_NOISE_PPM for the noise of the sensor. And the distance to the nearest LED CO2 limit, less the
+same allowance: within ADAPTIVE_SAMPLING_NEAR_LIMIT_PPM of a limit, the period shrinks linearly from the ceiling to
+the floor, so that the LED changes close to when the limit is crossed.
+
+The periods are steps of floor * 2^n, and the ceiling. Once the target falls below 2/3 of the period, the period
+shortens at once to the step that meets it. It lengthens one step at a time, and only after the target allowed the
+next step for ADAPTIVE_SAMPLING_HOLD_SAMPLES samples in a row. Any target in between keeps the period, so the noise
+of the sensor does not make it oscillate between two steps.
+
+The SCD40 task puts the sensor in the cheapest mode for the period: periodic mode only below 30 s, down to powered
+down between single shots at the longest periods. A steady room then costs the sensor the energy of the configured
+period, and the pipeline and the radios the work of its samples.
+*/
+
+#define ADAPTIVE_SAMPLING_FLOOR_S 5           // The shortest period of the SCD40 (periodic mode)
+#define ADAPTIVE_SAMPLING_CHANGE_PPM 20
+#define ADAPTIVE_SAMPLING_NOISE_PPM 10        // About the repeatability of the SCD40 at indoor levels
+#define ADAPTIVE_SAMPLING_RATE_WINDOW_S 120
+#define ADAPTIVE_SAMPLING_RATE_SAMPLES 32     // At the floor, covers the rate window
+#define ADAPTIVE_SAMPLING_NEAR_LIMIT_PPM 100
+#define ADAPTIVE_SAMPLING_HOLD_SAMPLES 4
+
+struct adaptive_sampling_stats {
+    bool enabled;
+    uint16_t period_s;        // The effective measurement period
+    uint16_t ceiling_s;       // The configured measurement period
+    uint32_t rate_ppm_h;      // Last rate of change of the CO2, in PPM per hour, less the noise allowance
+    uint32_t period_changes;
+    uint32_t samples;         // Samples taken since boot
+    uint32_t elapsed_s;       // From the first of them to the last
+};
+
+// Starts over with the period at the ceiling, for a new measurement period or a change of the setting
+void adaptive_sampling_reset(uint16_t ceiling_s, bool enabled);
+
+// Accounts a sample taken at 'time_s' seconds since boot, and returns the period until the next one. 'limits' are
+// the LED CO2 limits of the configuration.
+uint16_t adaptive_sampling_update(const struct SCD40measurement *meas, uint32_t time_s, const struct led_cfg_s *limits);
+
+void adaptive_sampling_get_stats(struct adaptive_sampling_stats *stats);
+
+#endif
@@ -1,19 +1,75 @@
 #include "scd40.h"
 #include "scd4x.h"
+#include <inttypes.h>
 #include <esp_err.h>
 #include <esp_check.h>
 #include <esp_timer.h>
 #include <esp_log.h>
+#include <esp_event.h>
 #include <freertos/queue.h>
 #include "../types.h"
+extern "C" {
+#include "../globals.h"
+#include "../config/config.h"
+#include "../latency/latency.h"
+#include "../boot/boot.h"
+#include "adaptive_sampling.h"
+#include "sensor_clock.h"
+}
 
 #define SELF_TEST_SENSOR false
 
+// Polling interval of the data ready flag, and the extra time to wait for it if the sensor is slower than specified
+#define DATA_READY_RETRY_MS 100
+#define DATA_READY_MARGIN_MS 500
+// Time the sensor takes to wake up, from the SCD4x datasheet. The driver does not wait it, as the sensor does not
+// acknowledge the wake up command.
+#define WAKE_UP_MS 30
+
+// Measurement intervals of the periodic modes, from the SCD4x datasheet
+#define PERIODIC_INTERVAL_MS 5000
+#define LOW_POWER_PERIODIC_INTERVAL_MS 30000
+
+// Measurement periods in seconds from which the sensor mode changes. Below LOW_POWER_PERIODIC_MIN_PERIOD the sensor
+// runs in periodic mode. From SINGLE_SHOT_MIN_PERIOD, single shots use less energy than low power periodic mode. From 
+// POWER_DOWN_MIN_PERIOD, the idle current between single shots costs more than the extra discarded single shot that 
+// is needed after a wake up.
+#define LOW_POWER_PERIODIC_MIN_PERIOD 30
+#define SINGLE_SHOT_MIN_PERIOD 60
+#define POWER_DOWN_MIN_PERIOD 600
+// Samples in a row the adapted period must allow a cheaper sensor mode for, before the mode is changed to it
+#define CHEAPER_MODE_HOLD_SAMPLES 4
+
+// Task notification bits used by the sampling scheduler
+#define SAMPLE_BIT (1 << 0)  // A sampling period boundary was reached
+#define REARM_BIT  (1 << 1)  // The measurement period or the adaptive sampling setting changed
+
 static constexpr const char *SCD40_TAG = "scd40";
-static int MEASURE_INTERVAL = 10;
 
 i2c_dev_t SCD40DEV;
 
+static TaskHandle_t scd40_task_handle_self = NULL;
+static esp_timer_handle_t sampling_timer = NULL;
+static int64_t sampling_arm_time_us = 0;  // Time of the first period boundary after the timer was (re)armed
+static int64_t sampling_period_us = 0;
+static struct scd40_sampling_stats sampling_stats = {};
+
+static enum SCD40_MODES sensor_mode = SCD40_MODE_IDLE;
+static int64_t sensor_mode_entered_us = 0;
+static struct scd40_mode_stats mode_stats = {};
+static uint32_t cheaper_mode_samples = 0;  // Samples in a row the adapted period allowed a cheaper mode for
+
+// The task's copy of the configuration, for the period and the LED limits of the adaptive sampling
+static struct minico2_cfg_s config;
+static uint32_t config_version_seen = CONFIG_VERSION_NONE;
+
+// Wakes the sensor up if it was powered down, and waits until it takes commands
+static void wake_up(void)
+{
+    scd4x_wake_up(&SCD40DEV); // Raises a false positive error, so we don't error check it
+    sensor_clock_delay_ms(WAKE_UP_MS);
+}
+
 esp_err_t init_scd40(void)
 {
     uint8_t N_init_tasks = 6;
@@ -22,7 +78,7 @@ esp_err_t init_scd40(void)
 
     ESP_LOGI(SCD40_TAG, "Initializing sensor...");
     ESP_LOGI(SCD40_TAG, "1/%u - Waking up sensor", N_init_tasks);
-    scd4x_wake_up(&SCD40DEV); // Raises a false positive error, so we don't error check it
+    wake_up();  // The sensor stays powered down over a reset of the MCU
 
     ESP_LOGI(SCD40_TAG, "2/%u - Stopping periodic sensor measurements", N_init_tasks);
     ESP_RETURN_ON_ERROR(scd4x_stop_periodic_measurement(&SCD40DEV), SCD40_TAG, "SCD40 stop periodic measurements failed");
@@ -56,60 +112,344 @@ esp_err_t init_scd40(void)
     return ESP_OK;
 }
 
-void scd40_task(void *pvParameters)
+// Records how far the trigger time 't_us' is from the nearest period boundary
+static void update_jitter_stats(int64_t t_us)
+{
+    if (sampling_period_us <= 0){return;}  // The timer was never armed
+    int64_t since_arm = t_us - sampling_arm_time_us;
+    int64_t boundary = sampling_arm_time_us + ((since_arm + sampling_period_us / 2) / sampling_period_us) * sampling_period_us;
+    int32_t jitter = (int32_t)(t_us - boundary);
+    uint32_t abs_jitter = jitter < 0 ? -jitter : jitter;
+
+    if (sampling_stats.samples == 0 || jitter < sampling_stats.jitter_min_us){sampling_stats.jitter_min_us = jitter;}
+    if (sampling_stats.samples == 0 || jitter > sampling_stats.jitter_max_us){sampling_stats.jitter_max_us = jitter;}
+    sampling_stats.jitter_abs_sum_us += abs_jitter;
+    sampling_stats.samples++;
+}
+
+void scd40_get_sampling_stats(struct scd40_sampling_stats *stats)
+{
+    *stats = sampling_stats;
+}
+
+const char *scd40_mode_to_str(enum SCD40_MODES mode)
+{
+    switch (mode)
+    {
+    case SCD40_MODE_IDLE:               return "idle";
+    case SCD40_MODE_PERIODIC:           return "periodic";
+    case SCD40_MODE_LOW_POWER_PERIODIC: return "low power periodic";
+    case SCD40_MODE_SINGLE_SHOT:        return "single shot";
+    case SCD40_MODE_POWER_DOWN:         return "single shot, power down";
+    default:                            return "unknown";
+    }
+}
+
+// Returns the lowest-energy sensor mode that still delivers a fresh sample every 'period' seconds
+static enum SCD40_MODES mode_for_period(uint16_t period)
+{
+    if (period < LOW_POWER_PERIODIC_MIN_PERIOD){return SCD40_MODE_PERIODIC;}
+    if (period < SINGLE_SHOT_MIN_PERIOD){return SCD40_MODE_LOW_POWER_PERIODIC;}
+    if (period < POWER_DOWN_MIN_PERIOD){return SCD40_MODE_SINGLE_SHOT;}
+    return SCD40_MODE_POWER_DOWN;
+}
+
+// Accounts the time spent in the current mode up to 'now_us'
+static void account_mode_time(int64_t now_us)
+{
+    mode_stats.time_us[sensor_mode] += now_us - sensor_mode_entered_us;
+    sensor_mode_entered_us = now_us;
+}
+
+void scd40_get_mode_stats(struct scd40_mode_stats *stats)
+{
+    *stats = mode_stats;
+    stats->mode = sensor_mode;
+    stats->time_us[sensor_mode] += sensor_clock_now_us() - sensor_mode_entered_us;
+}
+
+// Brings the sensor from its current mode back to idle, and from there into 'mode'
+static esp_err_t set_sensor_mode(enum SCD40_MODES mode)
+{
+    if (mode == sensor_mode){return ESP_OK;}
+
+    switch (sensor_mode)
+    {
+    case SCD40_MODE_PERIODIC:
+    case SCD40_MODE_LOW_POWER_PERIODIC:
+        ESP_RETURN_ON_ERROR(scd4x_stop_periodic_measurement(&SCD40DEV), SCD40_TAG, "Stopping periodic measurement failed");
+        break;
+    case SCD40_MODE_POWER_DOWN:
+        wake_up();
+        break;
+    default:
+        break;
+    }
+
+    switch (mode)
+    {
+    case SCD40_MODE_PERIODIC:
+        ESP_RETURN_ON_ERROR(scd4x_start_periodic_measurement(&SCD40DEV), SCD40_TAG, "Starting periodic measurement failed");
+        break;
+    case SCD40_MODE_LOW_POWER_PERIODIC:
+        ESP_RETURN_ON_ERROR(scd4x_start_low_power_periodic_measurement(&SCD40DEV), SCD40_TAG, "Starting low power periodic measurement failed");
+        break;
+    case SCD40_MODE_POWER_DOWN:
+        ESP_RETURN_ON_ERROR(scd4x_power_down(&SCD40DEV), SCD40_TAG, "Powering down sensor failed");
+        break;
+    default:
+        break;
+    }
+
+    account_mode_time(sensor_clock_now_us());
+    mode_stats.mode_changes++;
+    ESP_LOGI(SCD40_TAG, "Sensor mode changed from %s to %s", scd40_mode_to_str(sensor_mode), scd40_mode_to_str(mode));
+    sensor_mode = mode;
+    return ESP_OK;
+}
+
+// Polls the data ready flag of the sensor until it is set, for up to 'timeout_ms'. Sets 'waited', if given, when the
+// flag was not set at the first poll.
+static esp_err_t wait_for_data_ready(int64_t timeout_ms, bool *waited)
+{
+    bool data_ready = false;
+    for (int64_t polled_ms = 0; ; polled_ms += DATA_READY_RETRY_MS){
+        ESP_RETURN_ON_ERROR(scd4x_get_data_ready_status(&SCD40DEV, &data_ready), SCD40_TAG, "Getting data ready status failed");
+        if (data_ready || polled_ms >= timeout_ms){break;}
+        if (waited){*waited = true;}
+        sensor_clock_delay_ms(DATA_READY_RETRY_MS);
+    }
+    if (!data_ready){
+        ESP_LOGW(SCD40_TAG, "Sensor data not ready after %s measurement", scd40_mode_to_str(sensor_mode));
+        return ESP_ERR_TIMEOUT;
+    }
+    return ESP_OK;
+}
+
+// Triggers a single shot measurement. The driver sleeps for the 5 s of the conversion before it returns.
+static esp_err_t single_shot(void)
+{
+    ESP_RETURN_ON_ERROR(scd4x_measure_single_shot(&SCD40DEV), SCD40_TAG, "Single shot measurement failed");
+    return wait_for_data_ready(DATA_READY_MARGIN_MS, NULL);
+}
+
+// Called by esp_timer on every sampling period boundary
+static void sampling_timer_callback(void *arg)
+{
+    xTaskNotify(scd40_task_handle_self, SAMPLE_BIT, eSetBits);
+}
+
+// Restarts the sampling timer with the current period. The first boundary is now, the sample of which is being taken.
+static void resync_sampling_timer(void)
+{
+    esp_timer_stop(sampling_timer);
+    sampling_arm_time_us = sensor_clock_now_us();
+    ESP_ERROR_CHECK_WITHOUT_ABORT(esp_timer_start_periodic(sampling_timer, sampling_period_us));
+    ulTaskNotifyValueClear(NULL, SAMPLE_BIT);  // A boundary of the old phase that passed while polling
+    sampling_stats.resyncs++;
+}
+
+// Reads the sample of the sensor as raw words, and converts them without floats
+static esp_err_t read_measurement(struct SCD40measurement *meas)
+{
+    uint16_t temp_ticks, hum_ticks;
+    esp_err_t err = scd4x_read_measurement_ticks(&SCD40DEV, &meas->co2, &temp_ticks, &hum_ticks);
+    if (err == ESP_OK){
+        meas->temp_cdeg = scd4x_ticks_to_cdeg(temp_ticks);
+        meas->hum_cpct = scd4x_ticks_to_cpct(hum_ticks);
+    }
+    return err;
+}
+
+// Takes a measurement in the current sensor mode
+static esp_err_t measure(struct SCD40measurement *meas)
+{
+    int64_t t0 = sensor_clock_now_us();
+    update_jitter_stats(t0);
+
+    switch (sensor_mode)
+    {
+    case SCD40_MODE_PERIODIC:
+    case SCD40_MODE_LOW_POWER_PERIODIC: {
+        // The sensor measures by itself, on its own clock, which drifts against the sampling timer. Right after the 
+        // mode was entered, wait for the first result. Otherwise the next result may be up to one interval away if the
+        // last one was already read, so the flag is polled for that long. If the sample had to be waited for, the 
+        // sampling timer was ahead of the sensor. It is then restarted now, just behind the result, so that the 
+        // following boundaries find a result waiting.
+        int64_t interval_ms = sensor_mode == SCD40_MODE_PERIODIC ? PERIODIC_INTERVAL_MS : LOW_POWER_PERIODIC_INTERVAL_MS;
+        int64_t first_result_ms = (sensor_mode_entered_us - t0) / 1000 + interval_ms;
+        bool waited = first_result_ms > 0;
+        if (waited){sensor_clock_delay_ms(first_result_ms);}
+        ESP_RETURN_ON_ERROR(wait_for_data_ready(interval_ms + DATA_READY_MARGIN_MS, &waited), SCD40_TAG, 
+                            "Periodic measurement not ready");
+        if (waited){resync_sampling_timer();}
+        break;
+    }
+    case SCD40_MODE_POWER_DOWN:
+        // The first single shot after waking up the sensor must be discarded
+        wake_up();
+        ESP_RETURN_ON_ERROR(single_shot(), SCD40_TAG, "Discarded single shot measurement failed");
+        ESP_RETURN_ON_ERROR(read_measurement(meas), SCD40_TAG, "Reading discarded measurement failed");
+        ESP_RETURN_ON_ERROR(single_shot(), SCD40_TAG, "Single shot measurement failed");
+        break;
+    default:
+        ESP_RETURN_ON_ERROR(single_shot(), SCD40_TAG, "Single shot measurement failed");
+        break;
+    }
+
+    esp_err_t err = read_measurement(meas);
+    meas->read_us = latency_now();
+    if (err == ESP_OK){latency_record(LATENCY_SENSOR_READ, (uint32_t)t0);}
+    if (sensor_mode == SCD40_MODE_POWER_DOWN){
+        ESP_RETURN_ON_ERROR(scd4x_power_down(&SCD40DEV), SCD40_TAG, "Powering down sensor failed");
+    }
+    mode_stats.latency_us[sensor_mode] += sensor_clock_now_us() - t0;
+    mode_stats.samples[sensor_mode]++;
+    return err;
+}
+
+
+// Called on the default event loop when the measurement period or the adaptive sampling setting changes
+static void measurement_period_handler(void* handler_args, esp_event_base_t base, int32_t id, void* event_data)
+{
+    xTaskNotify(scd40_task_handle_self, REARM_BIT, eSetBits);
+}
+
+// (Re)starts the sampling timer with a period of 'period' seconds. The first boundary is now. The sensor mode is left 
+// as it is.
+static esp_err_t arm_sampling_timer(uint16_t period)
+{
+    ESP_RETURN_ON_FALSE(period > 0, ESP_ERR_INVALID_ARG, SCD40_TAG, "Sampling period of 0 seconds");
+    esp_timer_stop(sampling_timer);  // Fails harmlessly if the timer is not running
+    sampling_period_us = (int64_t)period * 1000000;
+    sampling_arm_time_us = sensor_clock_now_us();
+    ESP_RETURN_ON_ERROR(esp_timer_start_periodic(sampling_timer, sampling_period_us), SCD40_TAG, "Starting sampling timer failed");
+    ESP_LOGI(SCD40_TAG, "Sampling every %u seconds", period);
+    return ESP_OK;
+}
+
+// Puts the sensor in the mode for the configured measurement period, and (re)starts the sampling timer with that 
+// period, from which adaptive sampling starts over
+static esp_err_t arm_configured_period(void)
 {
-    // Get the queues from the pvParameters pointer
-    QueueHandle_t *queues = (QueueHandle_t *)pvParameters;
-    QueueHandle_t measurements_queue = queues[0];
-    QueueHandle_t errors_queue = queues[1];
+    config_snapshot_if_changed(&config, &config_version_seen);
+    uint16_t period = config.measurement_period;
+    ESP_RETURN_ON_ERROR(set_sensor_mode(mode_for_period(period)), SCD40_TAG, "Changing sensor mode failed");
+    cheaper_mode_samples = 0;
+    adaptive_sampling_reset(period, config.adaptive_sampling);
+    return arm_sampling_timer(period);
+}
+
+// Returns the sensor mode for the adapted 'period'. The modes are declared from the fastest to the cheapest. A faster
+// mode is entered at once, as the period needs it. A cheaper one only after the period allowed it for 
+// CHEAPER_MODE_HOLD_SAMPLES samples in a row, as a mode change costs a stop of the periodic measurement and up to one
+// interval of the new mode to its first result.
+static enum SCD40_MODES mode_for_adapted_period(uint16_t period)
+{
+    enum SCD40_MODES mode = mode_for_period(period);
+    if (mode > sensor_mode){
+        if (++cheaper_mode_samples < CHEAPER_MODE_HOLD_SAMPLES){return sensor_mode;}
+    }
+    cheaper_mode_samples = 0;
+    return mode;
+}
+
+// Lets adaptive sampling pick the period after 'meas', and puts the sensor in the mode for it. The timer is rearmed 
+// if the period changed, so that the next sample is one new period after now.
+static void adapt_period(const struct SCD40measurement *meas)
+{
+    config_snapshot_if_changed(&config, &config_version_seen);
+    uint16_t period = adaptive_sampling_update(meas, sensor_clock_now_us() / 1000000, &config.led_cfg);
+    ESP_ERROR_CHECK_WITHOUT_ABORT(set_sensor_mode(mode_for_adapted_period(period)));
+    if ((int64_t)period * 1000000 == sampling_period_us){return;}
+    ESP_ERROR_CHECK_WITHOUT_ABORT(arm_sampling_timer(period));
+    ulTaskNotifyValueClear(NULL, SAMPLE_BIT);  // A boundary of the old period that passed during the measurement
+}
 
-    // If any of the queues failed at being created, we go into an infinite loop
-    if ((measurements_queue == 0) || (errors_queue == 0)){
+static esp_err_t init_sampling_scheduler(void)
+{
+    scd40_task_handle_self = xTaskGetCurrentTaskHandle();
+    const esp_timer_create_args_t timer_args = {
+        .callback = &sampling_timer_callback,
+        .arg = NULL,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "scd40_sampling",
+        .skip_unhandled_events = true,
+    };
+    ESP_RETURN_ON_ERROR(esp_timer_create(&timer_args, &sampling_timer), SCD40_TAG, "Creating sampling timer failed");
+    ESP_RETURN_ON_ERROR(esp_event_handler_instance_register(CONFIG_EVENTS, MEASUREMENT_PERIOD_EVENT, measurement_period_handler, NULL, NULL), 
+                        SCD40_TAG, "Registering measurement period handler failed");
+    ESP_RETURN_ON_ERROR(esp_event_handler_instance_register(CONFIG_EVENTS, ADAPTIVE_SAMPLING_EVENT, measurement_period_handler, NULL, NULL), 
+                        SCD40_TAG, "Registering adaptive sampling handler failed");
+    return ESP_OK;
+}
+
+// Takes a measurement and puts it on the measurements queue. Returns whether it was valid.
+static bool take_sample(const scd40_channels *channels, struct SCD40measurement *meas)
+{
+    esp_err_t res = measure(meas);
+    if (res != ESP_OK){
+        ESP_LOGE(SCD40_TAG, "Error reading results %d (%s)", res, esp_err_to_name(res));
+        return false;
+    }
+    if (meas->co2 == 0){
+        ESP_LOGW(SCD40_TAG, "Invalid sample detected, skipping");
+        return false;
+    }
+    ESP_LOGD(SCD40_TAG, "Sending measurement on the queue");
+    boot_mark(BOOT_FIRST_SAMPLE_READ);
+    channels->measurements.send(*meas);
+    return true;
+}
+
+void scd40_task(const scd40_channels *channels)
+{
+    // If any of the channels failed at being created, we go into an infinite loop
+    if (!channels->measurements.valid() || !channels->errors.valid()){
         ESP_LOGE(SCD40_TAG, "Measurements queue or errors queue is 0, entering infinite loop");
         while (1){
             vTaskDelay(pdMS_TO_TICKS(1000));
         }
     }
 
-    // Init the sensor
+    // Init the sensor while the configuration loads. The sampling scheduler needs the measurement period.
+    struct SCD40measurement meas;
     esp_err_t scd40_init_err = init_scd40();
+    if (scd40_init_err == ESP_OK){
+        boot_wait(BOOT_BIT(BOOT_CONFIG_LOADED), portMAX_DELAY);
+        scd40_init_err = init_sampling_scheduler();
+    }
+    if (scd40_init_err == ESP_OK){
+        boot_mark(BOOT_SENSOR_READY);
+        // The first sample is a single shot taken right away, while the sensor is still idle. In low power periodic
+        // mode it would only come one interval, 30 s, after the sensor is ready. The sensor then goes into the mode of
+        // the period, and the first period boundary is now.
+        take_sample(channels, &meas);
+        scd40_init_err = arm_configured_period();
+    }
     if (scd40_init_err){
         // Log the error, put it on the errors queue, and enter an infinite loop
         ESP_ERROR_CHECK_WITHOUT_ABORT(scd40_init_err);
-        xQueueSendToBack(errors_queue, &scd40_init_err, (TickType_t)0);
+        channels->errors.send(scd40_init_err);
         while (1){
             vTaskDelay(pdMS_TO_TICKS(1000));
         }
     }
 
-    // Begin infinite loop of taking measurements 
-    static int64_t time0 = 0;
-    struct SCD40measurement meas;
-    bool data_ready;
+    // Begin infinite loop of taking measurements, from the first period boundary after the first sample
+    uint32_t notification = 0;
     while (1)
     {
-        if ((esp_timer_get_time() - time0)/1E6 > MEASURE_INTERVAL - 0.25){
-            time0 = esp_timer_get_time();
-            scd4x_measure_single_shot(&SCD40DEV);
-        }
-        vTaskDelay(pdMS_TO_TICKS(500));
-        scd4x_get_data_ready_status(&SCD40DEV, &data_ready);
-        if (!data_ready){continue;}
-        
-        esp_err_t res = scd4x_read_measurement(&SCD40DEV, &meas.co2, &meas.temperature, &meas.humidity);
-        if (res != ESP_OK)
-        {
-            ESP_LOGE(SCD40_TAG, "Error reading results %d (%s)", res, esp_err_to_name(res));
-            continue;
-        }
+        // Sleep until the next period boundary or a change of the period setting
+        xTaskNotifyWait(0, UINT32_MAX, &notification, portMAX_DELAY);
 
-        if (meas.co2 == 0)
-        {
-            ESP_LOGW(SCD40_TAG, "Invalid sample detected, skipping");
-            continue;
+        if (notification & REARM_BIT){
+            ESP_ERROR_CHECK_WITHOUT_ABORT(arm_configured_period());
+            notification |= SAMPLE_BIT;
         }
 
-        ESP_LOGD(SCD40_TAG, "Sending measurement on the queue");
-        xQueueSendToBack(measurements_queue, &meas, (TickType_t)0);
+        if ((notification & SAMPLE_BIT) && take_sample(channels, &meas)){
+            adapt_period(&meas);
+        }
     }
 }
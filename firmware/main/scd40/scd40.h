@@ -7,10 +7,72 @@
 #define SCD40_SDA GPIO_NUM_18
 #define SCD40_SCL GPIO_NUM_20
 
+// The operating modes of the sensor. The mode is chosen from the measurement period.
+enum SCD40_MODES {
+    SCD40_MODE_IDLE,                // Not measuring
+    SCD40_MODE_PERIODIC,            // Periodic measurement, one sample every 5 seconds
+    SCD40_MODE_LOW_POWER_PERIODIC,  // Low power periodic measurement, one sample every 30 seconds
+    SCD40_MODE_SINGLE_SHOT,         // Idle between single shot measurements
+    SCD40_MODE_POWER_DOWN,          // Powered down between single shot measurements
+    SCD40_N_MODES
+};
+
+// Time spent in each sensor mode, and the latency of the samples taken in each mode
+struct scd40_mode_stats {
+    enum SCD40_MODES mode;              // Current mode
+    uint32_t mode_changes;
+    int64_t time_us[SCD40_N_MODES];     // Total time spent in each mode
+    uint32_t samples[SCD40_N_MODES];    // Number of samples taken in each mode
+    int64_t latency_us[SCD40_N_MODES];  // Sum of the time from trigger to data read, per mode
+};
+
+// Statistics of how far sample triggers are from the exact period boundaries
+struct scd40_sampling_stats {
+    uint32_t samples;
+    int32_t jitter_min_us;
+    int32_t jitter_max_us;
+    uint64_t jitter_abs_sum_us;  // Divide by 'samples' for the mean absolute jitter
+    uint32_t resyncs;            // Restarts of the timer behind a periodic result it had got ahead of
+};
+
+// Conversions of the raw words of the sensor to the units of SCD40measurement, after the formulas of the SCD4x 
+// datasheet, rounded to the nearest hundredth. The products fit in 32 bits.
+static inline int16_t scd4x_ticks_to_cdeg(uint16_t ticks)
+{
+    return (int16_t)(-4500 + (int32_t)((17500u * ticks + 32768) >> 16));
+}
+
+static inline uint16_t scd4x_ticks_to_cpct(uint16_t ticks)
+{
+    return (uint16_t)((10000u * ticks + 32768) >> 16);
+}
+
 extern i2c_dev_t SCD40DEV;
 
 esp_err_t init_scd40(void);
 
-void scd40_task(void *pvParameters);
+#ifdef __cplusplus
+#include "../types.h"
+#include "../topology/channel.h"
+
+struct scd40_channels {
+    ChannelHandle<SCD40measurement> measurements;  // To the controller
+    ChannelHandle<esp_err_t> errors;               // To the controller
+};
+
+void scd40_task(const scd40_channels *channels);
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void scd40_get_sampling_stats(struct scd40_sampling_stats *stats);
+void scd40_get_mode_stats(struct scd40_mode_stats *stats);
+const char *scd40_mode_to_str(enum SCD40_MODES mode);
+
+#ifdef __cplusplus
+}
+#endif
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,375 @@
+// Only built into the firmware when SIMULATE_SCD4X is set in main/CMakeLists.txt
+#if SIMULATE_SCD4X
+
+#include <stdio.h>
+#include <string.h>
+#include <esp_log.h>
+#include "freertos/FreeRTOS.h"
+#include "scd4x.h"
+#include "scd4x_sim.h"
+#include "sensor_clock.h"
+#include "../trace/trace.h"
+
+static const char *SIM_TAG = "scd4x_sim";
+
+#define SCD4X_I2C_ADDR 0x62
+
+// Commands of the SCD4x, from the datasheet
+#define CMD_START_PERIODIC_MEASUREMENT           0x21b1
+#define CMD_READ_MEASUREMENT                     0xec05
+#define CMD_STOP_PERIODIC_MEASUREMENT            0x3f86
+#define CMD_SET_TEMPERATURE_OFFSET               0x241d
+#define CMD_GET_TEMPERATURE_OFFSET               0x2318
+#define CMD_SET_SENSOR_ALTITUDE                  0x2427
+#define CMD_GET_SENSOR_ALTITUDE                  0x2322
+#define CMD_SET_AMBIENT_PRESSURE                 0xe000
+#define CMD_PERFORM_FORCED_RECALIBRATION         0x362f
+#define CMD_SET_AUTOMATIC_SELF_CALIBRATION       0x2416
+#define CMD_GET_AUTOMATIC_SELF_CALIBRATION       0x2313
+#define CMD_START_LOW_POWER_PERIODIC_MEASUREMENT 0x21ac
+#define CMD_GET_DATA_READY_STATUS                0xe4b8
+#define CMD_PERSIST_SETTINGS                     0x3615
+#define CMD_GET_SERIAL_NUMBER                    0x3682
+#define CMD_PERFORM_SELF_TEST                    0x3639
+#define CMD_PERFORM_FACTORY_RESET                0x3632
+#define CMD_REINIT                               0x3646
+#define CMD_MEASURE_SINGLE_SHOT                  0x219d
+#define CMD_MEASURE_SINGLE_SHOT_RHT_ONLY         0x2196
+#define CMD_POWER_DOWN                           0x36e0
+#define CMD_WAKE_UP                              0x36f6
+
+// Measurement intervals and conversion times, from the datasheet
+#define PERIODIC_INTERVAL_US (5000 * 1000LL)
+#define LOW_POWER_PERIODIC_INTERVAL_US (30000 * 1000LL)
+#define SINGLE_SHOT_US (5000 * 1000LL)
+#define SINGLE_SHOT_RHT_ONLY_US (50 * 1000LL)
+
+enum sim_state {SIM_IDLE, SIM_PERIODIC, SIM_LOW_POWER_PERIODIC, SIM_POWER_DOWN};
+
+struct sim_sample {
+    uint16_t co2;
+    uint16_t temp_raw;
+    uint16_t hum_raw;
+};
+
+static portMUX_TYPE sim_lock = portMUX_INITIALIZER_UNLOCKED;
+static enum sim_state state = SIM_IDLE;
+static int64_t next_sample_us = 0;      // Time of the next sample in the periodic modes, or of a pending single shot
+static bool single_shot_pending = false;
+static bool data_ready = false;
+static int64_t busy_until_us = 0;       // End of the execution time of the last command
+static uint16_t response[3];            // Response words of the last command
+static size_t response_words = 0;
+static bool asc_enabled = true;
+static uint16_t temperature_offset = 0;
+static uint16_t altitude = 0;
+
+static struct sim_sample last_sample = {.co2 = 600, .temp_raw = 0x6667, .hum_raw = 0x7333};  // 600 ppm, 25 C, 45 %
+static struct sim_sample measured;      // Sample in the sensor's output register
+static struct sim_sample trace[SCD4X_SIM_TRACE_LEN];
+static uint32_t trace_head = 0;
+static uint32_t trace_tail = 0;
+
+static struct scd4x_sim_faults faults = {0};
+static struct scd4x_sim_stats stats = {0};
+
+static uint8_t crc8(const uint8_t *data, size_t len)
+{
+    uint8_t crc = 0xff;
+    for (size_t i = 0; i < len; i++){
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++){
+            crc = (crc & 0x80) ? (crc << 1) ^ 0x31 : crc << 1;
+        }
+    }
+    return crc;
+}
+
+// Takes a sample: the next one of the trace, or the previous one again
+static void take_sample(void)
+{
+    if (trace_tail != trace_head){
+        last_sample = trace[trace_tail % SCD4X_SIM_TRACE_LEN];
+        trace_tail++;
+    }
+    measured = last_sample;
+    stats.samples++;
+    if (faults.zero_co2_every > 0 && stats.samples % faults.zero_co2_every == 0){
+        measured.co2 = 0;
+    }
+    data_ready = true;
+}
+
+// Takes the samples that are due by 'now'
+static void advance(int64_t now)
+{
+    if (state == SIM_PERIODIC || state == SIM_LOW_POWER_PERIODIC){
+        int64_t interval = state == SIM_PERIODIC ? PERIODIC_INTERVAL_US : LOW_POWER_PERIODIC_INTERVAL_US;
+        while (next_sample_us <= now){
+            take_sample();
+            next_sample_us += interval;
+        }
+    } else if (single_shot_pending && next_sample_us <= now){
+        single_shot_pending = false;
+        take_sample();
+    }
+}
+
+static void respond(const uint16_t *words, size_t n)
+{
+    memcpy(response, words, n * sizeof(uint16_t));
+    response_words = n;
+}
+
+// Executes a command. Returns false if the sensor does not acknowledge it.
+static bool execute(uint16_t cmd, const uint16_t *args, size_t n_args, int64_t now)
+{
+    bool periodic = state == SIM_PERIODIC || state == SIM_LOW_POWER_PERIODIC;
+    response_words = 0;
+
+    // A powered down sensor only reacts to the wake up command, which it does not acknowledge
+    if (state == SIM_POWER_DOWN){
+        if (cmd == CMD_WAKE_UP){
+            state = SIM_IDLE;
+            busy_until_us = now + 30 * 1000;
+        }
+        return false;
+    }
+    // In the periodic modes only these commands are accepted
+    if (periodic && cmd != CMD_READ_MEASUREMENT && cmd != CMD_GET_DATA_READY_STATUS && 
+        cmd != CMD_STOP_PERIODIC_MEASUREMENT && cmd != CMD_SET_AMBIENT_PRESSURE){
+        return false;
+    }
+
+    int64_t exec_us = 1000;
+    switch (cmd)
+    {
+    case CMD_START_PERIODIC_MEASUREMENT:
+    case CMD_START_LOW_POWER_PERIODIC_MEASUREMENT:
+        state = cmd == CMD_START_PERIODIC_MEASUREMENT ? SIM_PERIODIC : SIM_LOW_POWER_PERIODIC;
+        next_sample_us = now + (state == SIM_PERIODIC ? PERIODIC_INTERVAL_US : LOW_POWER_PERIODIC_INTERVAL_US);
+        exec_us = 0;
+        break;
+    case CMD_STOP_PERIODIC_MEASUREMENT:
+        state = SIM_IDLE;
+        exec_us = 500 * 1000;
+        break;
+    case CMD_READ_MEASUREMENT: {
+        if (!data_ready && !faults.stale_data_ready){return false;}
+        uint16_t words[3] = {measured.co2, measured.temp_raw, measured.hum_raw};
+        respond(words, 3);
+        data_ready = false;
+        stats.reads++;
+        break;
+    }
+    case CMD_GET_DATA_READY_STATUS: {
+        uint16_t status = (data_ready || faults.stale_data_ready) ? 0x8006 : 0x8000;  // Low 11 bits are 0 if not ready
+        respond(&status, 1);
+        break;
+    }
+    case CMD_MEASURE_SINGLE_SHOT:
+    case CMD_MEASURE_SINGLE_SHOT_RHT_ONLY:
+        single_shot_pending = true;
+        next_sample_us = now + (cmd == CMD_MEASURE_SINGLE_SHOT ? SINGLE_SHOT_US : SINGLE_SHOT_RHT_ONLY_US);
+        exec_us = next_sample_us - now;
+        break;
+    case CMD_GET_SERIAL_NUMBER: {
+        uint16_t serial[3] = {0x5349, 0x4d00, 0x0001};
+        respond(serial, 3);
+        break;
+    }
+    case CMD_SET_AUTOMATIC_SELF_CALIBRATION:
+        if (n_args != 1){return false;}
+        asc_enabled = args[0] != 0;
+        break;
+    case CMD_GET_AUTOMATIC_SELF_CALIBRATION: {
+        uint16_t asc = asc_enabled;
+        respond(&asc, 1);
+        break;
+    }
+    case CMD_SET_TEMPERATURE_OFFSET:
+        if (n_args != 1){return false;}
+        temperature_offset = args[0];
+        break;
+    case CMD_GET_TEMPERATURE_OFFSET:
+        respond(&temperature_offset, 1);
+        break;
+    case CMD_SET_SENSOR_ALTITUDE:
+        if (n_args != 1){return false;}
+        altitude = args[0];
+        break;
+    case CMD_GET_SENSOR_ALTITUDE:
+        respond(&altitude, 1);
+        break;
+    case CMD_SET_AMBIENT_PRESSURE:
+        if (n_args != 1){return false;}
+        break;
+    case CMD_PERFORM_FORCED_RECALIBRATION: {
+        if (n_args != 1){return false;}
+        uint16_t correction = 0x8000;
+        respond(&correction, 1);
+        exec_us = 400 * 1000;
+        break;
+    }
+    case CMD_PERFORM_SELF_TEST: {
+        uint16_t malfunction = 0;
+        respond(&malfunction, 1);
+        exec_us = 10000 * 1000;
+        break;
+    }
+    case CMD_PERSIST_SETTINGS:
+        exec_us = 800 * 1000;
+        break;
+    case CMD_PERFORM_FACTORY_RESET:
+        asc_enabled = true;
+        temperature_offset = 0;
+        altitude = 0;
+        exec_us = 1200 * 1000;
+        break;
+    case CMD_REINIT:
+        exec_us = 20 * 1000;
+        break;
+    case CMD_POWER_DOWN:
+        state = SIM_POWER_DOWN;
+        single_shot_pending = false;
+        data_ready = false;
+        break;
+    case CMD_WAKE_UP:
+        // Not acknowledged even when the sensor is awake
+        return false;
+    default:
+        return false;
+    }
+    busy_until_us = now + exec_us;
+    stats.commands++;
+    return true;
+}
+
+// Counts a transfer. Returns true if it must be NACKed because of an injected fault.
+static bool count_transfer(void)
+{
+    stats.transfers++;
+    return faults.nack_every > 0 && stats.transfers % faults.nack_every == 0;
+}
+
+esp_err_t __wrap_i2c_dev_write(const i2c_dev_t *dev, const void *out_reg, size_t out_reg_size, const void *out_data, size_t out_size)
+{
+    const uint8_t *buf = out_data;
+    if (dev->addr != SCD4X_I2C_ADDR || out_reg_size != 0 || out_size < 2 || (out_size - 2) % 3 != 0){
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    TRACE(TRACE_I2C_WRITE_BEGIN, (buf[0] << 8) | buf[1]);
+    int64_t now = sensor_clock_now_us();
+    bool ack = true;
+    taskENTER_CRITICAL(&sim_lock);
+    advance(now);
+    if (count_transfer() || now < busy_until_us){
+        ack = false;  // The sensor does not respond while it executes a command
+    } else {
+        uint16_t cmd = (buf[0] << 8) | buf[1];
+        uint16_t args[3];
+        size_t n_args = (out_size - 2) / 3;
+        for (size_t i = 0; i < n_args && ack; i++){
+            const uint8_t *word = &buf[2 + i * 3];
+            if (i >= 3 || crc8(word, 2) != word[2]){
+                stats.crc_errors++;
+                ack = false;
+            } else {
+                args[i] = (word[0] << 8) | word[1];
+            }
+        }
+        ack = ack && execute(cmd, args, n_args, now);
+    }
+    if (!ack){stats.nacks++;}
+    taskEXIT_CRITICAL(&sim_lock);
+    TRACE(TRACE_I2C_END, ack ? ESP_OK : ESP_FAIL);
+    return ack ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t __wrap_i2c_dev_read(const i2c_dev_t *dev, const void *out_data, size_t out_size, void *in_data, size_t in_size)
+{
+    uint8_t *buf = in_data;
+    if (dev->addr != SCD4X_I2C_ADDR || out_size != 0 || in_size % 3 != 0){
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    TRACE(TRACE_I2C_READ_BEGIN, in_size);
+    int64_t now = sensor_clock_now_us();
+    bool ack = true;
+    taskENTER_CRITICAL(&sim_lock);
+    advance(now);
+    if (count_transfer() || now < busy_until_us || in_size / 3 > response_words){
+        ack = false;  // Read too early, or the last command has no response
+    } else {
+        for (size_t i = 0; i < in_size / 3; i++){
+            buf[i * 3] = response[i] >> 8;
+            buf[i * 3 + 1] = response[i] & 0xff;
+            buf[i * 3 + 2] = crc8(&buf[i * 3], 2);
+        }
+        response_words = 0;
+    }
+    if (!ack){stats.nacks++;}
+    taskEXIT_CRITICAL(&sim_lock);
+    TRACE(TRACE_I2C_END, ack ? ESP_OK : ESP_FAIL);
+    return ack ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t scd4x_sim_push_trace_line(const char *line)
+{
+    unsigned co2;
+    float temp, hum;
+    if (sscanf(line, " {CO2: %u, TEMP: %f, HUM: %f}", &co2, &temp, &hum) != 3 || co2 > UINT16_MAX){
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (temp < -45){temp = -45;}
+    if (temp > 130){temp = 130;}
+    if (hum < 0){hum = 0;}
+    if (hum > 100){hum = 100;}
+
+    // Inverse of the conversion in the scd4x driver
+    struct sim_sample s = {
+        .co2 = co2,
+        .temp_raw = (uint16_t)((temp + 45) * 65536 / 175 + 0.5f),
+        .hum_raw = (uint16_t)(hum * 65536 / 100 + 0.5f),
+    };
+    if (s.temp_raw == 0 && temp > 0){s.temp_raw = UINT16_MAX;}  // Rounded over the top of the range
+    if (s.hum_raw == 0 && hum > 0){s.hum_raw = UINT16_MAX;}
+
+    esp_err_t err = ESP_OK;
+    taskENTER_CRITICAL(&sim_lock);
+    if (trace_head - trace_tail < SCD4X_SIM_TRACE_LEN){
+        trace[trace_head % SCD4X_SIM_TRACE_LEN] = s;
+        trace_head++;
+    } else {
+        err = ESP_ERR_NO_MEM;
+    }
+    taskEXIT_CRITICAL(&sim_lock);
+    return err;
+}
+
+void scd4x_sim_set_faults(const struct scd4x_sim_faults *f)
+{
+    taskENTER_CRITICAL(&sim_lock);
+    faults = *f;
+    taskEXIT_CRITICAL(&sim_lock);
+    ESP_LOGW(SIM_TAG, "Faults: NACK every %lu transfers, 0 ppm every %lu samples, stale data ready %s", 
+             (unsigned long)f->nack_every, (unsigned long)f->zero_co2_every, f->stale_data_ready ? "on" : "off");
+}
+
+void scd4x_sim_get_faults(struct scd4x_sim_faults *f)
+{
+    taskENTER_CRITICAL(&sim_lock);
+    *f = faults;
+    taskEXIT_CRITICAL(&sim_lock);
+}
+
+void scd4x_sim_get_stats(struct scd4x_sim_stats *s)
+{
+    taskENTER_CRITICAL(&sim_lock);
+    *s = stats;
+    s->trace_queued = trace_head - trace_tail;
+    taskEXIT_CRITICAL(&sim_lock);
+}
+
+#endif
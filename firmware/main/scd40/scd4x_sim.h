@@ -0,0 +1,44 @@
+#ifndef _SCD4X_SIM_H
+#define _SCD4X_SIM_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <esp_err.h>
+
+/*
+Simulated SCD4x on the I2C bus. When the firmware is built with SIMULATE_SCD4X (see main/CMakeLists.txt), the linker 
+routes i2c_dev_read() and i2c_dev_write() to this model instead of the I2C driver. The unmodified scd4x driver then 
+talks to the model: commands, argument and response words with their CRC8, execution and conversion times, and the 
+operating mode rules of the sensor (which commands are accepted in which mode, wake up not being acknowledged).
+Its time is the sensor clock of sensor_clock.h, the one the SCD40 task reads.
+
+Samples come from a trace, which is fed one line at a time in the format of the JSON serial output, 
+'{CO2: 612, TEMP: 21.3, HUM: 45.2}'. When the trace runs out, the last sample is repeated. Faults can be injected 
+to test the error paths of the sensor code.
+*/
+
+#define SCD4X_SIM_TRACE_LEN 64  // Number of trace samples that can be queued
+
+struct scd4x_sim_faults {
+    uint32_t nack_every;      // NACK every Nth I2C transfer. 0 disables.
+    uint32_t zero_co2_every;  // Make every Nth sample read 0 ppm CO2. 0 disables.
+    bool stale_data_ready;    // Report data ready even when no new sample was taken, so the previous one is read again
+};
+
+struct scd4x_sim_stats {
+    uint32_t transfers;       // I2C transfers addressed to the sensor
+    uint32_t commands;        // Commands accepted
+    uint32_t nacks;           // Transfers not acknowledged, injected or because of an invalid command or timing
+    uint32_t crc_errors;      // Command arguments with a wrong CRC
+    uint32_t samples;         // Samples taken by the sensor
+    uint32_t reads;           // Samples read by the driver
+    uint32_t trace_queued;    // Trace samples waiting to be measured
+};
+
+// Queues a sample in the format of the JSON serial output. Returns ESP_ERR_INVALID_ARG if the line does not parse.
+esp_err_t scd4x_sim_push_trace_line(const char *line);
+void scd4x_sim_set_faults(const struct scd4x_sim_faults *faults);
+void scd4x_sim_get_faults(struct scd4x_sim_faults *faults);
+void scd4x_sim_get_stats(struct scd4x_sim_stats *stats);
+
+#endif
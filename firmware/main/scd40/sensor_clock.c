@@ -0,0 +1,31 @@
+#include <esp_timer.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "sensor_clock.h"
+
+static void task_delay_ms(uint32_t ms)
+{
+    vTaskDelay(pdMS_TO_TICKS(ms));
+}
+
+static const struct sensor_clock default_clock = {
+    .now_us = esp_timer_get_time,
+    .delay_ms = task_delay_ms,
+};
+
+static const struct sensor_clock *current = &default_clock;
+
+void sensor_clock_set(const struct sensor_clock *clock)
+{
+    current = clock != NULL ? clock : &default_clock;
+}
+
+int64_t sensor_clock_now_us(void)
+{
+    return current->now_us();
+}
+
+void sensor_clock_delay_ms(uint32_t ms)
+{
+    current->delay_ms(ms);
+}
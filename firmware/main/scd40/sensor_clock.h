@@ -0,0 +1,35 @@
+#ifndef _SENSOR_CLOCK_H
+#define _SENSOR_CLOCK_H
+
+#include <stdint.h>
+
+/*
+The clock of the sensor path. The SCD40 task takes its times and sleeps its conversion and polling waits on it, and
+the simulated SCD4x of scd4x_sim.c takes its samples and execution times from it, so both always see the same time.
+
+By default it is esp_timer_get_time(), with vTaskDelay() for the waits. In the host builds of test/, both of these run
+on the virtual clock of the shims, which only moves while every task waits, so a week of sampling takes seconds.
+
+Another clock can be installed before the SCD40 task starts. The task's sampling timer and notifications stay on the
+RTOS, so while the task runs, an installed clock must move with the FreeRTOS ticks.
+*/
+
+struct sensor_clock {
+    int64_t (*now_us)(void);
+    void (*delay_ms)(uint32_t ms);
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Installs 'clock', which must stay valid while it is used. NULL restores the default clock.
+void sensor_clock_set(const struct sensor_clock *clock);
+int64_t sensor_clock_now_us(void);
+void sensor_clock_delay_ms(uint32_t ms);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
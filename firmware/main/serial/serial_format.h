@@ -0,0 +1,148 @@
+#ifndef _SERIAL_FORMAT_H
+#define _SERIAL_FORMAT_H
+
+/*
+Binary format of the measurements printed on the serial port. This header has no dependencies on ESP-IDF, so that the
+host-side decoder in tools/ can use it too.
+
+Each measurement is sent as one record, COBS-encoded and surrounded by 0x00 delimiters:
+
+    0x00 [COBS(record)] 0x00
+
+The leading delimiter separates the frame from any log text printed before it, so text on the same port costs at most
+one garbage frame and never a record. A record is SERIAL_RECORD_LEN bytes, all fields little endian:
+
+    offset  size  field
+    0       1     version      SERIAL_FORMAT_VERSION
+    1       1     type         SERIAL_RECORD_MEASUREMENT
+    2       2     seq          Incremented for every record, wraps at 65536. Gaps are lost frames.
+    4       4     uptime_ms    Milliseconds since boot when the sample was read
+    8       4     device_id    Last four bytes of the factory MAC address
+    12      2     co2          PPM
+    14      2     temp_cdeg    Temperature in centi-degrees Celsius, signed
+    16      2     hum_cpct     Relative humidity in centi-percent
+    18      2     crc          CRC-16/CCITT-FALSE of bytes 0 to 17
+*/
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define SERIAL_FORMAT_VERSION 1
+#define SERIAL_RECORD_MEASUREMENT 1
+#define SERIAL_RECORD_LEN 20
+#define SERIAL_FRAME_MAX_LEN (SERIAL_RECORD_LEN + SERIAL_RECORD_LEN / 254 + 1 + 2)  // COBS overhead and delimiters
+
+struct serial_record {
+    uint8_t version;
+    uint8_t type;
+    uint16_t seq;
+    uint32_t uptime_ms;
+    uint32_t device_id;
+    uint16_t co2;
+    int16_t temp_cdeg;
+    uint16_t hum_cpct;
+};
+
+static inline uint16_t serial_crc16(const uint8_t *data, size_t len)
+{
+    uint16_t crc = 0xffff;
+    for (size_t i = 0; i < len; i++){
+        crc ^= (uint16_t)data[i] << 8;
+        for (int b = 0; b < 8; b++){
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+        }
+    }
+    return crc;
+}
+
+static inline void serial_put_u16(uint8_t *p, uint16_t v)
+{
+    p[0] = v;
+    p[1] = v >> 8;
+}
+
+static inline void serial_put_u32(uint8_t *p, uint32_t v)
+{
+    serial_put_u16(p, v);
+    serial_put_u16(p + 2, v >> 16);
+}
+
+static inline uint16_t serial_get_u16(const uint8_t *p)
+{
+    return p[0] | (uint16_t)p[1] << 8;
+}
+
+static inline uint32_t serial_get_u32(const uint8_t *p)
+{
+    return serial_get_u16(p) | (uint32_t)serial_get_u16(p + 2) << 16;
+}
+
+// Packs 'r' into 'out', which must hold SERIAL_RECORD_LEN bytes, and appends the CRC
+static inline void serial_record_pack(const struct serial_record *r, uint8_t *out)
+{
+    out[0] = r->version;
+    out[1] = r->type;
+    serial_put_u16(out + 2, r->seq);
+    serial_put_u32(out + 4, r->uptime_ms);
+    serial_put_u32(out + 8, r->device_id);
+    serial_put_u16(out + 12, r->co2);
+    serial_put_u16(out + 14, (uint16_t)r->temp_cdeg);
+    serial_put_u16(out + 16, r->hum_cpct);
+    serial_put_u16(out + 18, serial_crc16(out, SERIAL_RECORD_LEN - 2));
+}
+
+// Unpacks a record. Returns false if its length, CRC, version or type is wrong.
+static inline bool serial_record_unpack(const uint8_t *in, size_t len, struct serial_record *r)
+{
+    if (len != SERIAL_RECORD_LEN || serial_get_u16(in + 18) != serial_crc16(in, SERIAL_RECORD_LEN - 2)){return false;}
+    r->version = in[0];
+    r->type = in[1];
+    r->seq = serial_get_u16(in + 2);
+    r->uptime_ms = serial_get_u32(in + 4);
+    r->device_id = serial_get_u32(in + 8);
+    r->co2 = serial_get_u16(in + 12);
+    r->temp_cdeg = (int16_t)serial_get_u16(in + 14);
+    r->hum_cpct = serial_get_u16(in + 16);
+    return r->version == SERIAL_FORMAT_VERSION && r->type == SERIAL_RECORD_MEASUREMENT;
+}
+
+// COBS-encodes 'len' bytes of 'in' into 'out', which must hold len + len / 254 + 1 bytes. Returns the encoded length.
+static inline size_t serial_cobs_encode(const uint8_t *in, size_t len, uint8_t *out)
+{
+    size_t code_at = 0, o = 1;
+    uint8_t code = 1;
+    for (size_t i = 0; i < len; i++){
+        if (in[i] != 0){
+            out[o++] = in[i];
+            code++;
+        }
+        if (in[i] == 0 || code == 0xff){
+            out[code_at] = code;
+            code = 1;
+            code_at = o++;
+        }
+    }
+    out[code_at] = code;
+    return o;
+}
+
+// Decodes a COBS frame without its delimiters. 'out' must hold 'len' bytes. Returns the decoded length, or 0 if the
+// frame is malformed.
+static inline size_t serial_cobs_decode(const uint8_t *in, size_t len, uint8_t *out)
+{
+    size_t i = 0, o = 0;
+    while (i < len){
+        uint8_t code = in[i++];
+        if (code == 0 || i + code - 1 > len){return 0;}
+        for (uint8_t k = 1; k < code; k++){
+            out[o++] = in[i++];
+        }
+        if (code != 0xff && i < len){
+            out[o++] = 0;
+        }
+    }
+    return o;
+}
+
+#endif
@@ -0,0 +1,232 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <inttypes.h>
+#include <string.h>
+#include <esp_log.h>
+#include <esp_mac.h>
+#include <esp_timer.h>
+#include "driver/usb_serial_jtag.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "serial_out.h"
+#include "serial_format.h"
+#include "../latency/latency.h"
+#include "../diag/diag.h"
+
+// Largest write to the driver. Its TX ring buffer holds 256 bytes, and a larger write would never fit.
+#define SERIAL_OUT_CHUNK 64
+
+static uint16_t seq = 0;
+static uint32_t device_id = 0;
+static bool device_id_read = false;
+
+// The ring, filled at 'head' by the producers and drained 'used' bytes behind it by the writer task. The writer
+// copies out of the ring without holding the lock: producers only ever write into the free space.
+static uint8_t ring[SERIAL_OUT_RING_SIZE];
+static size_t head = 0;
+static size_t used = 0;
+static struct serial_out_stats stats = {0};
+static portMUX_TYPE ring_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static TaskHandle_t writer_task_handle = NULL;
+static StaticTask_t writer_task_buffer;
+static StackType_t writer_task_stack[SERIAL_OUT_TASK_STACK];
+
+// Copies 'len' bytes into the ring, expanding LF to CRLF if 'text' is set, or drops all of them
+static bool ring_put(const uint8_t *data, size_t len, bool text)
+{
+    size_t needed = len;
+    if (text){
+        for (size_t i = 0; i < len; i++){
+            needed += data[i] == '\n';
+        }
+    }
+
+    bool queued = false;
+    taskENTER_CRITICAL(&ring_lock);
+    if (needed <= SERIAL_OUT_RING_SIZE - used){
+        for (size_t i = 0; i < len; i++){
+            if (text && data[i] == '\n'){
+                ring[head] = '\r';
+                head = (head + 1) % SERIAL_OUT_RING_SIZE;
+            }
+            ring[head] = data[i];
+            head = (head + 1) % SERIAL_OUT_RING_SIZE;
+        }
+        used += needed;
+        if (used > stats.ring_high_water){stats.ring_high_water = used;}
+        stats.writes++;
+        queued = true;
+    } else {
+        stats.writes_dropped++;
+        stats.bytes_dropped += needed;
+    }
+    taskEXIT_CRITICAL(&ring_lock);
+
+    if (queued && writer_task_handle != NULL){
+        xTaskNotifyGive(writer_task_handle);
+    }
+    return queued;
+}
+
+// Returns the length of the line, or -1 if it was dropped
+static int vprintf_line(const char *format, va_list args)
+{
+    char line[SERIAL_OUT_LINE_MAX];
+    int len = vsnprintf(line, sizeof(line), format, args);
+    if (len < 0){return -1;}
+    if (len >= (int)sizeof(line)){
+        // Truncated. The line still ends where it should have.
+        len = sizeof(line) - 1;
+        line[len - 1] = '\n';
+    }
+    return ring_put((const uint8_t *)line, len, true) ? len : -1;
+}
+
+// Output function of the ESP log library, in place of vprintf to stdout
+static int log_vprintf(const char *format, va_list args)
+{
+    return vprintf_line(format, args);
+}
+
+bool serial_out_write(const void *data, size_t len)
+{
+    return ring_put(data, len, false);
+}
+
+bool serial_out_write_text(const char *text, size_t len)
+{
+    return ring_put((const uint8_t *)text, len, true);
+}
+
+bool serial_out_printf(const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    bool queued = vprintf_line(format, args) >= 0;
+    va_end(args);
+    return queued;
+}
+
+static void writer_task(void *pvParameters)
+{
+    while (1){
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        while (1){
+            // The oldest bytes, up to the end of the ring or SERIAL_OUT_CHUNK
+            taskENTER_CRITICAL(&ring_lock);
+            size_t tail = (head + SERIAL_OUT_RING_SIZE - used) % SERIAL_OUT_RING_SIZE;
+            size_t len = used;
+            taskEXIT_CRITICAL(&ring_lock);
+            if (len == 0){break;}
+            if (len > SERIAL_OUT_RING_SIZE - tail){len = SERIAL_OUT_RING_SIZE - tail;}
+            if (len > SERIAL_OUT_CHUNK){len = SERIAL_OUT_CHUNK;}
+
+            // Waits for as long as the host does not read. Only this task is held up.
+            int written = usb_serial_jtag_write_bytes(ring + tail, len, portMAX_DELAY);
+
+            taskENTER_CRITICAL(&ring_lock);
+            used -= len;
+            if (written == (int)len){
+                stats.bytes_written += len;
+            } else {
+                stats.bytes_dropped += len;
+            }
+            taskEXIT_CRITICAL(&ring_lock);
+        }
+    }
+}
+
+esp_err_t serial_out_start(void)
+{
+    writer_task_handle = xTaskCreateStatic(writer_task, "serial_out", SERIAL_OUT_TASK_STACK, NULL,
+                                           SERIAL_OUT_TASK_PRIORITY, writer_task_stack, &writer_task_buffer);
+    diag_register_task(writer_task_handle, SERIAL_OUT_TASK_STACK);
+    esp_log_set_vprintf(log_vprintf);
+
+    // Drain what was queued before the start
+    xTaskNotifyGive(writer_task_handle);
+    return ESP_OK;
+}
+
+// Rounds hundredths to tenths, half away from zero, as %.1f would
+static int32_t centi_to_deci(int32_t centi)
+{
+    return (centi < 0 ? centi - 5 : centi + 5) / 10;
+}
+
+int serial_out_format_text(char *buf, size_t len, const struct SCD40measurement *meas)
+{
+    // Formatted from integers. The sign is printed separately, so that -0.4 keeps it.
+    int32_t temp = centi_to_deci(meas->temp_cdeg);
+    int32_t hum = centi_to_deci(meas->hum_cpct);
+    uint32_t temp_abs = temp < 0 ? -temp : temp;
+    return snprintf(buf, len, "{CO2: %u, TEMP: %s%" PRIu32 ".%" PRIu32 ", HUM: %" PRId32 ".%" PRId32 "}\n", meas->co2, 
+                    temp < 0 ? "-" : "", temp_abs / 10, temp_abs % 10, hum / 10, hum % 10);
+}
+
+static void print_text(const struct SCD40measurement *meas)
+{
+    char line[SERIAL_OUT_LINE_MAX];
+    int len = serial_out_format_text(line, sizeof(line), meas);
+    if (len > 0 && serial_out_write_text(line, len)){
+        taskENTER_CRITICAL(&ring_lock);
+        stats.lines++;
+        taskEXIT_CRITICAL(&ring_lock);
+    }
+}
+
+static void write_binary(const struct SCD40measurement *meas)
+{
+    if (!device_id_read){
+        uint8_t mac[6] = {0};
+        esp_efuse_mac_get_default(mac);
+        device_id = (uint32_t)mac[2] << 24 | (uint32_t)mac[3] << 16 | (uint32_t)mac[4] << 8 | mac[5];
+        device_id_read = true;
+    }
+
+    struct serial_record record = {
+        .version = SERIAL_FORMAT_VERSION,
+        .type = SERIAL_RECORD_MEASUREMENT,
+        .seq = seq++,
+        .uptime_ms = (esp_timer_get_time() - (latency_now() - meas->read_us)) / 1000,
+        .device_id = device_id,
+        .co2 = meas->co2,
+        .temp_cdeg = meas->temp_cdeg,
+        .hum_cpct = meas->hum_cpct,
+    };
+
+    uint8_t packed[SERIAL_RECORD_LEN];
+    uint8_t frame[SERIAL_FRAME_MAX_LEN];
+    serial_record_pack(&record, packed);
+    frame[0] = 0;
+    size_t len = 1 + serial_cobs_encode(packed, sizeof(packed), frame + 1);
+    frame[len++] = 0;
+
+    // A dropped frame is seen by the host as a gap in 'seq'
+    bool queued = serial_out_write(frame, len);
+    taskENTER_CRITICAL(&ring_lock);
+    if (queued){
+        stats.frames++;
+    } else {
+        stats.frames_dropped++;
+    }
+    taskEXIT_CRITICAL(&ring_lock);
+}
+
+void serial_out_measurement(const struct SCD40measurement *meas, uint8_t format)
+{
+    if (format == SERIAL_FORMAT_BINARY){
+        write_binary(meas);
+    } else {
+        print_text(meas);
+    }
+}
+
+void serial_out_get_stats(struct serial_out_stats *out)
+{
+    taskENTER_CRITICAL(&ring_lock);
+    *out = stats;
+    taskEXIT_CRITICAL(&ring_lock);
+}
@@ -0,0 +1,67 @@
+#ifndef _SERIAL_OUT_H
+#define _SERIAL_OUT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <esp_err.h>
+#include "../types.h"
+
+/*
+Output service of the serial port. Producers copy their bytes into a ring buffer and return at once. A low priority
+writer task moves them from the ring to the USB serial JTAG driver, and is the only task that ever waits for the host.
+A host that stops reading therefore fills the ring, and never stalls the controller or any other producer.
+
+Drop policy: a write that does not fit completely into the free space of the ring is dropped as a whole, and counted.
+What is already queued is kept, so the output stays in order and a log line or binary frame is never cut.
+
+Once serial_out_start() has run, the ESP log output is routed through the ring as well. Log lines are formatted on
+the stack of the task that logs, into SERIAL_OUT_LINE_MAX bytes; longer lines are truncated.
+
+The measurements are printed as a text line or as a binary frame (see serial_format.h). Binary frames are written to
+the driver unchanged, while the line endings of text are expanded to CRLF, like stdout does.
+
+The console does not go through the ring: its prompt, echo and command output are written to stdout, which the VFS
+hands to the same USB serial JTAG driver. The writer task writes in chunks of up to 64 bytes, so console output and
+queued output interleave at those chunk boundaries, and a line or binary frame of the ring can be split by console
+output. Commands that print a lot are best run with the measurement output off.
+*/
+
+#define SERIAL_OUT_RING_SIZE 4096
+#define SERIAL_OUT_LINE_MAX 160
+#define SERIAL_OUT_TASK_STACK 2048
+#define SERIAL_OUT_TASK_PRIORITY 1  // Lowest above idle: the output waits for every other task
+
+struct serial_out_stats {
+    uint32_t lines;            // Measurement text lines queued
+    uint32_t frames;           // Measurement binary frames queued
+    uint32_t frames_dropped;   // Measurement binary frames dropped
+    uint32_t writes;           // Writes of all producers queued, log lines included
+    uint32_t writes_dropped;   // Writes of all producers dropped
+    uint32_t bytes_written;    // Bytes the writer task handed to the driver
+    uint32_t bytes_dropped;    // Bytes of the dropped writes
+    uint32_t ring_high_water;  // Most bytes that were queued at once
+};
+
+// Starts the writer task and routes the log output through the ring. Must be called after the USB serial JTAG
+// driver is installed, which start_console() does. What is written before is queued until then.
+esp_err_t serial_out_start(void);
+
+// Queues 'len' bytes unchanged. Never blocks. Returns false if they were dropped.
+bool serial_out_write(const void *data, size_t len);
+
+// Queues 'len' bytes of text, with the line endings expanded to CRLF. Never blocks. Returns false if it was dropped.
+bool serial_out_write_text(const char *text, size_t len);
+
+// Formats a text line of up to SERIAL_OUT_LINE_MAX bytes and queues it. Never blocks. Returns false if it was dropped.
+bool serial_out_printf(const char *format, ...) __attribute__((format(printf, 1, 2)));
+
+// Prints 'meas' in 'format' (enum SERIAL_FORMATS). Never blocks.
+void serial_out_measurement(const struct SCD40measurement *meas, uint8_t format);
+
+// Formats the text line of 'meas' into 'buf', without floats. Returns the length, like snprintf.
+int serial_out_format_text(char *buf, size_t len, const struct SCD40measurement *meas);
+
+void serial_out_get_stats(struct serial_out_stats *stats);
+
+#endif
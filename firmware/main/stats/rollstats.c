@@ -0,0 +1,233 @@
+#include <stdbool.h>
+#include <string.h>
+#include "../sync/spinlock.h"
+#include "rollstats.h"
+
+// Sums of the samples in one bucket. A bucket is at most 48 minutes long, so the sums of 16-bit values fit in 32 bits.
+struct bucket {
+    uint32_t count;
+    int32_t sum[ROLLSTATS_N_CHANNELS];
+    uint64_t sumsq[ROLLSTATS_N_CHANNELS];
+};
+
+// Minimum or maximum of a closed bucket
+struct extreme {
+    uint32_t bucket;
+    int32_t value;
+};
+
+// Monotonic deque of the extremes of the closed buckets in a window. For minima the values increase from front to
+// back, for maxima they decrease, so the extreme of the window is at the front.
+struct deque {
+    struct extreme items[ROLLSTATS_BUCKETS];
+    uint8_t front;
+    uint8_t len;
+};
+
+struct window {
+    uint32_t bucket_s;
+    uint32_t current;   // Number of the open bucket, time_s / bucket_s
+    bool started;
+    struct bucket buckets[ROLLSTATS_BUCKETS];  // By bucket number modulo ROLLSTATS_BUCKETS
+
+    // Totals of all buckets in the window, the open one included
+    uint32_t count;
+    int64_t sum[ROLLSTATS_N_CHANNELS];
+    uint64_t sumsq[ROLLSTATS_N_CHANNELS];
+
+    int32_t open_min[ROLLSTATS_N_CHANNELS];
+    int32_t open_max[ROLLSTATS_N_CHANNELS];
+    struct deque mins[ROLLSTATS_N_CHANNELS];
+    struct deque maxs[ROLLSTATS_N_CHANNELS];
+};
+
+static struct window windows[ROLLSTATS_N_WINDOWS] = {
+    [ROLLSTATS_1MIN] = {.bucket_s = 60 / ROLLSTATS_BUCKETS},
+    [ROLLSTATS_15MIN] = {.bucket_s = 15 * 60 / ROLLSTATS_BUCKETS},
+    [ROLLSTATS_1H] = {.bucket_s = 60 * 60 / ROLLSTATS_BUCKETS},
+    [ROLLSTATS_24H] = {.bucket_s = 24 * 60 * 60 / ROLLSTATS_BUCKETS},
+};
+static spinlock_t rollstats_lock = SPINLOCK_INITIALIZER;
+
+static struct extreme *deque_at(struct deque *d, uint8_t i)
+{
+    return &d->items[(d->front + i) % ROLLSTATS_BUCKETS];
+}
+
+// Appends an extreme, after dropping those at the back that it makes irrelevant
+static void deque_push(struct deque *d, uint32_t bucket, int32_t value, bool is_min)
+{
+    while (d->len > 0){
+        int32_t back = deque_at(d, d->len - 1)->value;
+        if (is_min ? back < value : back > value){break;}
+        d->len--;
+    }
+    *deque_at(d, d->len) = (struct extreme){.bucket = bucket, .value = value};
+    d->len++;
+}
+
+// Drops the extremes of the buckets before 'first_bucket'
+static void deque_expire(struct deque *d, uint32_t first_bucket)
+{
+    while (d->len > 0 && deque_at(d, 0)->bucket < first_bucket){
+        d->front = (d->front + 1) % ROLLSTATS_BUCKETS;
+        d->len--;
+    }
+}
+
+// Moves the window on to 'bucket': closes the open bucket, and removes the buckets that fall out of the window
+static void window_advance(struct window *w, uint32_t bucket)
+{
+    if (w->buckets[w->current % ROLLSTATS_BUCKETS].count > 0){
+        for (int c = 0; c < ROLLSTATS_N_CHANNELS; c++){
+            deque_push(&w->mins[c], w->current, w->open_min[c], true);
+            deque_push(&w->maxs[c], w->current, w->open_max[c], false);
+        }
+    }
+
+    // The slots of the buckets after the open one up to 'bucket' hold the buckets that expire. After a gap as long as
+    // the window, that is all of them.
+    uint32_t steps = bucket - w->current;
+    if (steps > ROLLSTATS_BUCKETS){steps = ROLLSTATS_BUCKETS;}
+    for (uint32_t i = 1; i <= steps; i++){
+        struct bucket *b = &w->buckets[(w->current + i) % ROLLSTATS_BUCKETS];
+        w->count -= b->count;
+        for (int c = 0; c < ROLLSTATS_N_CHANNELS; c++){
+            w->sum[c] -= b->sum[c];
+            w->sumsq[c] -= b->sumsq[c];
+        }
+        memset(b, 0, sizeof(*b));
+    }
+
+    uint32_t first_bucket = bucket >= ROLLSTATS_BUCKETS - 1 ? bucket - (ROLLSTATS_BUCKETS - 1) : 0;
+    for (int c = 0; c < ROLLSTATS_N_CHANNELS; c++){
+        deque_expire(&w->mins[c], first_bucket);
+        deque_expire(&w->maxs[c], first_bucket);
+    }
+    w->current = bucket;
+}
+
+static void window_add(struct window *w, const int32_t *values, uint32_t time_s)
+{
+    uint32_t bucket = time_s / w->bucket_s;
+    if (!w->started){
+        w->current = bucket;
+        w->started = true;
+    } else if (bucket > w->current){
+        window_advance(w, bucket);
+    }
+
+    struct bucket *b = &w->buckets[w->current % ROLLSTATS_BUCKETS];
+    bool first = b->count == 0;
+    b->count++;
+    w->count++;
+    for (int c = 0; c < ROLLSTATS_N_CHANNELS; c++){
+        int32_t v = values[c];
+        uint64_t sq = (uint64_t)((int64_t)v * v);
+        b->sum[c] += v;
+        b->sumsq[c] += sq;
+        w->sum[c] += v;
+        w->sumsq[c] += sq;
+        if (first || v < w->open_min[c]){w->open_min[c] = v;}
+        if (first || v > w->open_max[c]){w->open_max[c] = v;}
+    }
+}
+
+void rollstats_add(const struct SCD40measurement *meas, uint32_t time_s)
+{
+    const int32_t values[ROLLSTATS_N_CHANNELS] = {meas->co2, meas->temp_cdeg, meas->hum_cpct};
+
+    spinlock_take(&rollstats_lock);
+    for (int i = 0; i < ROLLSTATS_N_WINDOWS; i++){
+        window_add(&windows[i], values, time_s);
+    }
+    spinlock_give(&rollstats_lock);
+}
+
+static uint32_t isqrt64(uint64_t v)
+{
+    uint64_t root = 0;
+    uint64_t bit = 1ULL << 62;
+    while (bit > v){bit >>= 2;}
+    while (bit != 0){
+        if (v >= root + bit){
+            v -= root + bit;
+            root = (root >> 1) + bit;
+        } else {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+    return (uint32_t)root;
+}
+
+// Population variance from the totals. Exact while n * sumsq fits in 64 bits, which at the 5 second minimum
+// measurement period holds for all windows. Beyond that the mean is rounded first.
+static uint64_t variance(uint32_t n, int64_t sum, uint64_t sumsq)
+{
+    if (n < 2){return 0;}
+    if (sumsq <= UINT64_MAX / n){
+        uint64_t abs_sum = sum < 0 ? -sum : sum;
+        return (n * sumsq - abs_sum * abs_sum) / ((uint64_t)n * n);  // sum^2 <= n * sumsq, so no overflow
+    }
+    int64_t mean = sum / n;
+    uint64_t mean_sq = (uint64_t)(mean * mean);
+    return sumsq / n > mean_sq ? sumsq / n - mean_sq : 0;
+}
+
+void rollstats_get(enum ROLLSTATS_WINDOWS window, enum ROLLSTATS_CHANNELS channel, struct rollstats_result *result)
+{
+    memset(result, 0, sizeof(*result));
+    if (window >= ROLLSTATS_N_WINDOWS || channel >= ROLLSTATS_N_CHANNELS){return;}
+
+    struct window *w = &windows[window];
+    spinlock_take(&rollstats_lock);
+    uint32_t n = w->count;
+    int64_t sum = w->sum[channel];
+    uint64_t sumsq = w->sumsq[channel];
+    if (n > 0){
+        bool open = w->buckets[w->current % ROLLSTATS_BUCKETS].count > 0;
+        struct deque *mins = &w->mins[channel];
+        struct deque *maxs = &w->maxs[channel];
+        int32_t min = open ? w->open_min[channel] : INT32_MAX;
+        int32_t max = open ? w->open_max[channel] : INT32_MIN;
+        if (mins->len > 0 && deque_at(mins, 0)->value < min){min = deque_at(mins, 0)->value;}
+        if (maxs->len > 0 && deque_at(maxs, 0)->value > max){max = deque_at(maxs, 0)->value;}
+        result->min = min;
+        result->max = max;
+    }
+    spinlock_give(&rollstats_lock);
+
+    if (n == 0){return;}
+    result->count = n;
+    result->mean = (int32_t)((sum < 0 ? sum - n / 2 : sum + n / 2) / n);
+    result->sd = isqrt64(variance(n, sum, sumsq));
+}
+
+uint32_t rollstats_window_s(enum ROLLSTATS_WINDOWS window)
+{
+    return window < ROLLSTATS_N_WINDOWS ? windows[window].bucket_s * ROLLSTATS_BUCKETS : 0;
+}
+
+const char *rollstats_window_to_str(enum ROLLSTATS_WINDOWS window)
+{
+    switch (window)
+    {
+    case ROLLSTATS_1MIN: return "1min";
+    case ROLLSTATS_15MIN: return "15min";
+    case ROLLSTATS_1H: return "1h";
+    case ROLLSTATS_24H: return "24h";
+    default: return "unknown";
+    }
+}
+
+const char *rollstats_channel_to_str(enum ROLLSTATS_CHANNELS channel)
+{
+    switch (channel)
+    {
+    case ROLLSTATS_CO2: return "co2";
+    case ROLLSTATS_TEMP: return "temp";
+    case ROLLSTATS_HUM: return "hum";
+    default: return "unknown";
+    }
+}
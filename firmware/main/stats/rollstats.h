@@ -0,0 +1,57 @@
+#ifndef _ROLLSTATS_H
+#define _ROLLSTATS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "../types.h"
+
+/*
+Rolling statistics of the measurements over the last minute, 15 minutes, hour and 24 hours: mean, minimum, maximum and
+standard deviation of the CO2, temperature and humidity.
+
+Every window is split into ROLLSTATS_BUCKETS buckets of equal length. A bucket holds the sample count and the sums
+and sums of squares of the samples in it, and the window keeps running totals of these, so a sample is added and an
+expired bucket removed in constant time. The minima and maxima of the closed buckets are kept in monotonic deques, so
+the extremes of the window are at their fronts. The windows thus move in steps of one bucket (2 seconds for the
+minute, 48 minutes for the day), the memory is fixed, and no sample is ever looked at twice.
+
+All values are integers in the units of SCD40measurement: PPM, centi-degrees and centi-percent. The sums are exact, so
+removing a bucket leaves no rounding error behind. The results are those of the last sample added.
+*/
+
+#define ROLLSTATS_BUCKETS 30
+
+enum ROLLSTATS_WINDOWS {
+    ROLLSTATS_1MIN,
+    ROLLSTATS_15MIN,
+    ROLLSTATS_1H,
+    ROLLSTATS_24H,
+    ROLLSTATS_N_WINDOWS
+};
+
+enum ROLLSTATS_CHANNELS {
+    ROLLSTATS_CO2,   // PPM
+    ROLLSTATS_TEMP,  // Centi-degrees Celsius
+    ROLLSTATS_HUM,   // Centi-percent relative humidity
+    ROLLSTATS_N_CHANNELS
+};
+
+struct rollstats_result {
+    uint32_t count;  // Samples in the window. The other fields are 0 if there are none.
+    int32_t mean;    // Rounded to the nearest unit
+    int32_t min;
+    int32_t max;
+    int32_t sd;      // Population standard deviation, rounded down
+};
+
+// Adds a measurement taken at 'time_s' seconds since boot. Times must not decrease.
+void rollstats_add(const struct SCD40measurement *meas, uint32_t time_s);
+
+// Reads the statistics of 'channel' over 'window'
+void rollstats_get(enum ROLLSTATS_WINDOWS window, enum ROLLSTATS_CHANNELS channel, struct rollstats_result *result);
+
+uint32_t rollstats_window_s(enum ROLLSTATS_WINDOWS window);
+const char *rollstats_window_to_str(enum ROLLSTATS_WINDOWS window);
+const char *rollstats_channel_to_str(enum ROLLSTATS_CHANNELS channel);
+
+#endif
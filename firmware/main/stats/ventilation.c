@@ -0,0 +1,207 @@
+#include <stdbool.h>
+#include <string.h>
+#include "../sync/spinlock.h"
+#include "ventilation.h"
+
+#define LOG2_FRAC_BITS 12
+#define SLOPE_FRAC_BITS (LOG2_FRAC_BITS + 16)
+#define LN2_X_360000 249533  // ln(2) * 3600 s/h * 100, turns a slope in log2 per second into centi-ACH
+
+// State of the detector, and the sums of the fit of the episode in progress. Only the controller task touches these.
+static struct {
+    bool tracking;        // 'peak' and 'last_s' hold a sample
+    bool decaying;        // An episode is in progress
+    bool published;       // The episode has published an estimate
+    uint16_t peak;        // Highest reading since the CO2 last started to rise, while no episode is in progress
+    uint32_t last_s;
+
+    uint16_t baseline;
+    uint16_t start_co2;
+    uint16_t min_co2;
+    uint32_t start_s;
+
+    // Sums over the samples of t, the seconds since 'start_s', and y, log2(co2 - baseline) in Q12
+    uint32_t n;
+    int64_t sum_t;
+    int64_t sum_y;
+    int64_t sum_tt;
+    int64_t sum_ty;
+    int64_t sum_yy;
+} ep;
+
+static struct ventilation_estimate latest = {0};
+static struct ventilation_stats stats = {0};
+static spinlock_t ventilation_lock = SPINLOCK_INITIALIZER;
+
+// log2(x) in Q12, for x > 0. The fraction is found bit by bit, by squaring the mantissa.
+static int32_t log2_q12(uint32_t x)
+{
+    int32_t msb = 31 - __builtin_clz(x);
+    int32_t result = msb << LOG2_FRAC_BITS;
+    uint64_t m = msb > 30 ? x >> (msb - 30) : (uint64_t)x << (30 - msb);  // In [1, 2), Q30
+    for (int32_t bit = 1 << (LOG2_FRAC_BITS - 1); bit > 0; bit >>= 1){
+        m = (m * m) >> 30;
+        if (m >= 2ULL << 30){
+            m >>= 1;
+            result += bit;
+        }
+    }
+    return result;
+}
+
+static void add_point(uint16_t co2, uint32_t time_s)
+{
+    int64_t t = time_s - ep.start_s;
+    int64_t y = log2_q12(co2 - ep.baseline);
+    ep.n++;
+    ep.sum_t += t;
+    ep.sum_y += y;
+    ep.sum_tt += t * t;
+    ep.sum_ty += t * y;
+    ep.sum_yy += y * y;
+    if (co2 < ep.min_co2){ep.min_co2 = co2;}
+    ep.last_s = time_s;
+}
+
+static void start_episode(uint16_t co2, uint32_t time_s, uint16_t baseline)
+{
+    memset(&ep, 0, sizeof(ep));
+    ep.tracking = true;
+    ep.decaying = true;
+    ep.baseline = baseline;
+    ep.start_co2 = co2;
+    ep.min_co2 = co2;
+    ep.start_s = time_s;
+    add_point(co2, time_s);
+
+    spinlock_take(&ventilation_lock);
+    stats.episodes++;
+    stats.in_episode = true;
+    spinlock_give(&ventilation_lock);
+}
+
+// Ends the episode in progress. Detection starts over from 'co2'.
+static void end_episode(uint16_t co2, uint32_t time_s)
+{
+    spinlock_take(&ventilation_lock);
+    if (ep.published){latest.final = true;}
+    stats.in_episode = false;
+    spinlock_give(&ventilation_lock);
+
+    ep.decaying = false;
+    ep.peak = co2;
+    ep.last_s = time_s;
+}
+
+static bool episode_over(uint16_t co2, uint32_t time_s, uint16_t baseline)
+{
+    return baseline != ep.baseline ||
+           time_s - ep.last_s > VENTILATION_MAX_GAP_S ||
+           time_s - ep.start_s > VENTILATION_MAX_DURATION_S ||
+           ep.n >= VENTILATION_MAX_SAMPLES ||
+           co2 >= ep.min_co2 + VENTILATION_END_RISE_PPM ||
+           co2 < baseline + VENTILATION_END_EXCESS_PPM;
+}
+
+// Solves the normal equations of the episode. Returns false if the fit shows no decay.
+static bool fit(struct ventilation_estimate *estimate)
+{
+    // n times the centered sums of squares and products. Within the bounds of VENTILATION_MAX_SAMPLES and
+    // VENTILATION_MAX_DURATION_S, every product stays below 2^55.
+    int64_t n = ep.n;
+    int64_t s_tt = n * ep.sum_tt - ep.sum_t * ep.sum_t;
+    int64_t s_ty = n * ep.sum_ty - ep.sum_t * ep.sum_y;
+    int64_t s_yy = n * ep.sum_yy - ep.sum_y * ep.sum_y;
+    if (s_tt <= 0 || s_ty >= 0){return false;}
+
+    // The slope -s_ty / s_tt in Q28, with both scaled down alike until the shift fits
+    uint64_t num = -s_ty;
+    uint64_t den = s_tt;
+    while (num >= 1ULL << (63 - (SLOPE_FRAC_BITS - LOG2_FRAC_BITS))){
+        num >>= 1;
+        den >>= 1;
+    }
+    if (den == 0){return false;}
+    uint64_t slope = (num << (SLOPE_FRAC_BITS - LOG2_FRAC_BITS)) / den;
+    uint64_t ach = slope > (UINT64_MAX >> 1) / LN2_X_360000 ? UINT32_MAX :
+                   (slope * LN2_X_360000 + (1ULL << (SLOPE_FRAC_BITS - 1))) >> SLOPE_FRAC_BITS;
+
+    // R^2 = s_ty^2 / (s_tt * s_yy), all three scaled down alike until the products fit
+    uint64_t a = -s_ty;
+    uint64_t b = s_tt;
+    uint64_t c = s_yy;
+    while ((a | b | c) >= 1ULL << 28){
+        a >>= 1;
+        b >>= 1;
+        c >>= 1;
+    }
+    uint64_t r2_pct = b * c == 0 ? 0 : a * a * 100 / (b * c);
+
+    estimate->ach_centi = ach > UINT32_MAX ? UINT32_MAX : ach;
+    estimate->confidence_pct = r2_pct > 100 ? 100 : r2_pct;
+    return true;
+}
+
+// Publishes the fit of the episode once it is long and deep enough
+static void update_estimate(void)
+{
+    uint32_t duration_s = ep.last_s - ep.start_s;
+    bool deep = 4 * (ep.min_co2 - ep.baseline) <= 3 * (ep.start_co2 - ep.baseline);
+    if (ep.n < VENTILATION_MIN_SAMPLES || duration_s < VENTILATION_MIN_DURATION_S || !deep){return;}
+
+    struct ventilation_estimate estimate = {
+        .valid = true,
+        .baseline = ep.baseline,
+        .samples = ep.n,
+        .duration_s = duration_s,
+        .time_s = ep.last_s,
+    };
+    if (!fit(&estimate)){return;}
+
+    spinlock_take(&ventilation_lock);
+    latest = estimate;
+    if (!ep.published){stats.estimates++;}
+    spinlock_give(&ventilation_lock);
+    ep.published = true;
+}
+
+void ventilation_add(const struct SCD40measurement *meas, uint32_t time_s, uint16_t baseline)
+{
+    uint16_t co2 = meas->co2;
+    if (ep.decaying && episode_over(co2, time_s, baseline)){
+        end_episode(co2, time_s);
+        return;
+    }
+    if (ep.decaying){
+        add_point(co2, time_s);
+        update_estimate();
+        return;
+    }
+
+    // No episode: follow the peak, and start one once the CO2 has fallen far enough from a high enough peak
+    bool stale = !ep.tracking || time_s - ep.last_s > VENTILATION_MAX_GAP_S;
+    if (stale || co2 >= ep.peak || ep.peak < baseline + VENTILATION_START_EXCESS_PPM){
+        ep.tracking = true;
+        ep.peak = co2;
+        ep.last_s = time_s;
+        return;
+    }
+    ep.last_s = time_s;
+    if (ep.peak - co2 >= VENTILATION_START_DROP_PPM && co2 >= baseline + VENTILATION_END_EXCESS_PPM){
+        start_episode(co2, time_s, baseline);
+    }
+}
+
+void ventilation_get(struct ventilation_estimate *estimate)
+{
+    spinlock_take(&ventilation_lock);
+    *estimate = latest;
+    spinlock_give(&ventilation_lock);
+}
+
+void ventilation_get_stats(struct ventilation_stats *out)
+{
+    spinlock_take(&ventilation_lock);
+    *out = stats;
+    spinlock_give(&ventilation_lock);
+}
@@ -0,0 +1,66 @@
+#ifndef _VENTILATION_H
+#define _VENTILATION_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "../types.h"
+
+/*
+Online estimate of the ventilation rate of the room, in air changes per hour (ACH), from the decay of the CO2.
+
+With no source in the room, the CO2 above the outdoor baseline decays exponentially: C(t) - C_out = E0 * e^(-k t), with
+k the air change rate. The logarithm of the excess is then a straight line in t, whose slope is -k. A decay episode
+starts when the CO2 has fallen VENTILATION_START_DROP_PPM from a peak at least VENTILATION_START_EXCESS_PPM above the
+baseline. It ends when the CO2 rises VENTILATION_END_RISE_PPM above the lowest reading of the episode (a new source),
+gets within VENTILATION_END_EXCESS_PPM of the baseline (the noise of the sensor takes over), after a gap between two
+samples longer than VENTILATION_MAX_GAP_S, after VENTILATION_MAX_DURATION_S or VENTILATION_MAX_SAMPLES, or when the
+baseline is changed.
+
+The line is fitted by recursive least squares in information form: every sample updates the sums of the normal
+equations, and the 2x2 system is solved from them when an estimate is due. Unlike in the covariance form, the update
+needs no division and accumulates no rounding. All of it is in integers: log2 of the excess in Q12 fixed point, times in
+seconds from the start of the episode, 64-bit sums. The memory is a few sums and the cost per sample constant.
+
+An estimate is published once the episode has VENTILATION_MIN_SAMPLES samples over VENTILATION_MIN_DURATION_S, and the
+excess has fallen to 3/4 of where it started. It is updated with every further sample of the episode, and kept after
+the episode ends until the next one publishes. Its confidence is the coefficient of determination R^2 of the fit: the
+share of the variance of log(C - C_out) that the exponential decay explains.
+*/
+
+#define VENTILATION_START_EXCESS_PPM 300
+#define VENTILATION_START_DROP_PPM 30   // About the repeatability of the SCD40 at indoor levels
+#define VENTILATION_END_RISE_PPM 50
+#define VENTILATION_END_EXCESS_PPM 100
+#define VENTILATION_MAX_GAP_S (15 * 60)
+#define VENTILATION_MAX_DURATION_S (4 * 60 * 60)
+#define VENTILATION_MAX_SAMPLES 4096     // With the duration, keeps the sums of the fit well within 64 bits
+#define VENTILATION_MIN_SAMPLES 8
+#define VENTILATION_MIN_DURATION_S (5 * 60)
+
+struct ventilation_estimate {
+    bool valid;               // False until the first estimate. The other fields are 0.
+    bool final;               // The episode has ended, the estimate no longer changes
+    uint32_t ach_centi;       // Air changes per hour, in hundredths
+    uint8_t confidence_pct;   // R^2 of the fit, in percent
+    uint16_t baseline;        // Outdoor CO2 in PPM the decay was fitted towards
+    uint32_t samples;         // Samples of the episode in the fit
+    uint32_t duration_s;      // From the first to the last of them
+    uint32_t time_s;          // Time of the last of them, in seconds since boot
+};
+
+struct ventilation_stats {
+    uint32_t episodes;        // Decay episodes started
+    uint32_t estimates;       // Of those, the ones that published an estimate
+    bool in_episode;          // An episode is in progress
+};
+
+// Adds a measurement taken at 'time_s' seconds since boot, with the outdoor CO2 at 'baseline' PPM. Times must not
+// decrease.
+void ventilation_add(const struct SCD40measurement *meas, uint32_t time_s, uint16_t baseline);
+
+// Reads the latest estimate
+void ventilation_get(struct ventilation_estimate *estimate);
+
+void ventilation_get_stats(struct ventilation_stats *stats);
+
+#endif
@@ -0,0 +1,31 @@
+#ifndef _SPINLOCK_H
+#define _SPINLOCK_H
+
+/*
+Short critical sections around state that one task writes and other tasks read, such as the statistics modules. On
+the target this is a FreeRTOS spinlock (portMUX), which also masks interrupts. Off the target, where ESP_PLATFORM is
+not defined, it is a pthread mutex, so that the modules that only need this lock build and run in the host tests
+without FreeRTOS.
+
+Nothing that blocks may be called with the lock held.
+*/
+
+#if ESP_PLATFORM
+#include "freertos/FreeRTOS.h"
+
+typedef portMUX_TYPE spinlock_t;
+#define SPINLOCK_INITIALIZER portMUX_INITIALIZER_UNLOCKED
+
+static inline void spinlock_take(spinlock_t *lock){taskENTER_CRITICAL(lock);}
+static inline void spinlock_give(spinlock_t *lock){taskEXIT_CRITICAL(lock);}
+#else
+#include <pthread.h>
+
+typedef pthread_mutex_t spinlock_t;
+#define SPINLOCK_INITIALIZER PTHREAD_MUTEX_INITIALIZER
+
+static inline void spinlock_take(spinlock_t *lock){pthread_mutex_lock(lock);}
+static inline void spinlock_give(spinlock_t *lock){pthread_mutex_unlock(lock);}
+#endif
+
+#endif
@@ -0,0 +1,129 @@
+#ifndef _CHANNEL_H
+#define _CHANNEL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+
+/*
+Statically allocated tasks and channels. A channel is a FreeRTOS queue that carries items of one type, and its
+storage is part of the object, so a channel declared at file scope ends up in .bss and is created without the heap.
+The same holds for the stack and control block of a task. The tasks and channels of the device are declared in one
+table in topology/topology.cpp.
+
+Tasks receive their channels in a struct, through a typed entry point (see task_spec), so the wiring is checked by
+the compiler instead of being unpacked from an array by index.
+*/
+
+// Handle of a channel that carries items of type T
+template <typename T>
+class ChannelHandle {
+public:
+    ChannelHandle() = default;
+    explicit ChannelHandle(QueueHandle_t queue) : handle(queue) {}
+
+    bool send(const T &item, TickType_t wait = 0) const {
+        return xQueueSendToBack(handle, &item, wait) == pdPASS;
+    }
+    bool receive(T &item, TickType_t wait = portMAX_DELAY) const {
+        return xQueueReceive(handle, &item, wait) == pdTRUE;
+    }
+
+    // The underlying queue, for queue sets and the C parts of the firmware
+    QueueHandle_t queue() const {return handle;}
+    bool valid() const {return handle != NULL;}
+
+private:
+    QueueHandle_t handle = NULL;
+};
+
+// A channel of up to N items of type T. create() must be called once before the handle is used.
+template <typename T, UBaseType_t N>
+class Channel {
+public:
+    static_assert(N > 0, "A channel must hold at least one item");
+
+    ChannelHandle<T> create() {
+        handle = ChannelHandle<T>(xQueueCreateStatic(N, sizeof(T), storage, &control));
+        return handle;
+    }
+    ChannelHandle<T> get() const {return handle;}
+
+private:
+    StaticQueue_t control;
+    uint8_t storage[N * sizeof(T)];
+    ChannelHandle<T> handle;
+};
+
+// A queue set for up to N items in its member queues. The FreeRTOS version of ESP-IDF 5.3 has no
+// xQueueCreateSetStatic, so the set is created the way later versions implement it.
+template <UBaseType_t N>
+class QueueSet {
+public:
+    QueueSetHandle_t create() {
+        handle = xQueueGenericCreateStatic(N, sizeof(QueueSetMemberHandle_t), storage, &control, queueQUEUE_TYPE_SET);
+        return handle;
+    }
+    QueueSetHandle_t get() const {return handle;}
+
+private:
+    StaticQueue_t control;
+    uint8_t storage[N * sizeof(QueueSetMemberHandle_t)];
+    QueueSetHandle_t handle = NULL;
+};
+
+// Stack and control block of a task. Stack sizes are in bytes on ESP-IDF.
+static_assert(sizeof(StackType_t) == 1, "Stack sizes are expected in bytes");
+
+template <uint32_t StackBytes>
+struct TaskStorage {
+    StaticTask_t control;
+    StackType_t stack[StackBytes];
+};
+
+// One row of the task table
+struct TaskSpec {
+    TaskFunction_t entry;
+    const char *name;
+    uint32_t stack_bytes;
+    StackType_t *stack;
+    StaticTask_t *control;
+    void *params;
+    UBaseType_t priority;
+    TaskHandle_t *handle;
+};
+
+// Calls a task function that takes its parameters as 'const P *'
+template <typename P, void (*Fn)(const P *)>
+void task_entry(void *params)
+{
+    Fn(static_cast<const P *>(params));
+}
+
+// Builds a row of the task table. The task function must take a pointer to the type of 'params'.
+template <typename P, void (*Fn)(const P *), uint32_t StackBytes>
+constexpr TaskSpec task_spec(TaskStorage<StackBytes> &storage, const char *name, P *params, UBaseType_t priority,
+                             TaskHandle_t *handle)
+{
+    return {&task_entry<P, Fn>, name, StackBytes, storage.stack, &storage.control, params, priority, handle};
+}
+
+// Row of the task table for a task without parameters
+template <uint32_t StackBytes>
+constexpr TaskSpec task_spec(TaskStorage<StackBytes> &storage, TaskFunction_t entry, const char *name,
+                             UBaseType_t priority, TaskHandle_t *handle)
+{
+    return {entry, name, StackBytes, storage.stack, &storage.control, NULL, priority, handle};
+}
+
+// Creates the task of a row of the table
+inline TaskHandle_t task_start(const TaskSpec &spec)
+{
+    *spec.handle = xTaskCreateStatic(spec.entry, spec.name, spec.stack_bytes, spec.params, spec.priority, spec.stack,
+                                     spec.control);
+    return *spec.handle;
+}
+
+#endif
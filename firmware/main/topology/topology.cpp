@@ -0,0 +1,122 @@
+#include <esp_log.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "topology.h"
+#include "channel.h"
+#include "../types.h"
+#include "../scd40/scd40.h"
+#include "../led/led.h"
+#include "../controller/controller.h"
+#include "../ble/ble.h"
+extern "C" {
+#include "../zigbee/zigbee.h"
+#include "../tslog/tslog.h"
+#include "../diag/diag.h"
+}
+
+static constexpr const char *TOPOLOGY_TAG = "topology";
+
+// Stack sizes of the tasks, in bytes. The 'diag' console command shows how much of each is used.
+static constexpr uint32_t LED_TASK_STACK = 4096;
+static constexpr uint32_t CONTROLLER_TASK_STACK = configMINIMAL_STACK_SIZE * 8;
+static constexpr uint32_t SCD40_TASK_STACK = configMINIMAL_STACK_SIZE * 8;
+static constexpr uint32_t BLE_TASK_STACK = configMINIMAL_STACK_SIZE * 8;
+static constexpr uint32_t ZIGBEE_TASK_STACK = configMINIMAL_STACK_SIZE * 8;
+static constexpr uint32_t TSLOG_TASK_STACK = configMINIMAL_STACK_SIZE * 4;
+
+TaskHandle_t scd40_task_handle = NULL;
+TaskHandle_t led_task_handle = NULL;
+TaskHandle_t controller_task_handle = NULL;
+TaskHandle_t ble_task_handle = NULL;
+TaskHandle_t zigbee_task_handle = NULL;
+TaskHandle_t tslog_task_handle = NULL;
+
+// Channels
+static Channel<SCD40measurement, 1> measurements;                // SCD40 -> controller
+static Channel<LED_STATES, 1> led_states;                        // Controller -> LED
+static Channel<esp_err_t, 1> errors;                             // All tasks -> controller
+static Channel<int32_t, CONFIG_EVENTS_QUEUE_LEN> config_events;  // Event loop -> controller
+static QueueSet<1 + 1 + CONFIG_EVENTS_QUEUE_LEN> controller_set; // Inputs of the controller
+
+// The channels each task is given
+static led_channels led_params;
+static controller_channels controller_params;
+static scd40_channels scd40_params;
+static ble_channels ble_params;
+static zigbee_channels zigbee_params;
+
+// Task storage
+static TaskStorage<LED_TASK_STACK> led_storage;
+static TaskStorage<CONTROLLER_TASK_STACK> controller_storage;
+static TaskStorage<SCD40_TASK_STACK> scd40_storage;
+static TaskStorage<BLE_TASK_STACK> ble_storage;
+static TaskStorage<ZIGBEE_TASK_STACK> zigbee_storage;
+static TaskStorage<TSLOG_TASK_STACK> tslog_storage;
+
+// The tasks, in launch order. The LED task builds its queue set while the LED state channel is still empty, so it is 
+// launched before the controller. The BLE and ZigBee tasks receive measurements from the measurement bus. The flash 
+// log task runs below the other tasks because flash writes and erases are slow.
+static const TaskSpec TASKS[] = {
+    task_spec<led_channels, led_task>(led_storage, "LED_task", &led_params, 10, &led_task_handle),
+    task_spec<controller_channels, controller_task>(controller_storage, "controller_task", &controller_params, 10, &controller_task_handle),
+    task_spec<scd40_channels, scd40_task>(scd40_storage, "SCD40_task", &scd40_params, 10, &scd40_task_handle),
+    task_spec<ble_channels, ble_task>(ble_storage, "BLE_task", &ble_params, 10, &ble_task_handle),
+    task_spec<zigbee_channels, zigbee_task>(zigbee_storage, "ZigBee_task", &zigbee_params, 10, &zigbee_task_handle),
+    task_spec(tslog_storage, tslog_task, "tslog_task", 5, &tslog_task_handle),
+};
+
+// Creates the channels and hands them to the tasks
+static void wire_channels(){
+    measurements.create();
+    led_states.create();
+    errors.create();
+    config_events.create();
+
+    led_params = {
+        .led_states = led_states.get(),
+        .errors = errors.get(),
+    };
+    controller_params = {
+        .measurements = measurements.get(),
+        .led_states = led_states.get(),
+        .errors = errors.get(),
+        .config_events = config_events.get(),
+        .queue_set = NULL,
+    };
+    scd40_params = {
+        .measurements = measurements.get(),
+        .errors = errors.get(),
+    };
+    ble_params = {
+        .errors = errors.get(),
+    };
+    zigbee_params = {
+        .errors = errors.get().queue(),
+    };
+}
+
+void topology_start(void){
+    // Create the channels. Their storage is static, so this cannot fail.
+    wire_channels();
+
+    // The controller blocks on all of its input channels at once. The set must be populated while the channels are 
+    // empty, which is why it is built here before any of the producing tasks are launched.
+    QueueSetHandle_t controller_queue_set = controller_set.create();
+    if ((xQueueAddToSet(measurements.get().queue(), controller_queue_set) != pdPASS) ||
+        (xQueueAddToSet(errors.get().queue(), controller_queue_set) != pdPASS) ||
+        (xQueueAddToSet(config_events.get().queue(), controller_queue_set) != pdPASS)){
+        ESP_LOGE(TOPOLOGY_TAG, "Failed at populating controller queue set");
+        controller_queue_set = 0;
+    }
+    controller_params.queue_set = controller_queue_set;
+
+    // Launch the tasks in the order of the table
+    for (const TaskSpec &task : TASKS){
+        if (task_start(task) == NULL){
+            ESP_LOGE(TOPOLOGY_TAG, "Failed at launching %s", task.name);
+            continue;
+        }
+        diag_register_task(*task.handle, task.stack_bytes);
+    }
+}
@@ -0,0 +1,13 @@
+#ifndef _TOPOLOGY_H
+#define _TOPOLOGY_H
+
+/*
+Topology of the firmware: the channels between the tasks, and the tasks. Everything is allocated statically, so the
+sizes show up in .bss of the map file and boot does not use the heap for them. app_main starts the topology once NVS
+and the history are ready, and the host pipeline test in test/test_pipeline.cpp starts the same table.
+*/
+
+// Creates the channels, builds the queue set of the controller and launches the tasks in the order of the table
+void topology_start(void);
+
+#endif
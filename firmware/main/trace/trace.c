@@ -0,0 +1,99 @@
+#include "trace.h"
+#if TRACE_ENABLED
+
+#include <stdio.h>
+#include <inttypes.h>
+#include <esp_attr.h>
+#include <esp_cpu.h>
+#include <esp_err.h>
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "trace_freertos.h"
+
+_Static_assert(TRACE_TASK_SWITCHED_IN == 1 && TRACE_QUEUE_SEND == 2 && TRACE_QUEUE_RECEIVE == 3 &&
+               TRACE_QUEUE_SEND_FROM_ISR == 4 && TRACE_QUEUE_RECEIVE_FROM_ISR == 5, "Update trace_freertos.h");
+_Static_assert((TRACE_BUFFER_LEN & (TRACE_BUFFER_LEN - 1)) == 0, "TRACE_BUFFER_LEN must be a power of two");
+
+static struct trace_record trace_buffer[TRACE_BUFFER_LEN];
+static uint32_t trace_head = 0;          // Number of records ever written
+static volatile bool trace_on = true;
+
+// Called from FreeRTOS, ISRs and with the flash cache disabled, so it lives in IRAM and only calls inline functions
+IRAM_ATTR void trace_record(uint32_t event, uint32_t arg)
+{
+    if (!trace_on){return;}
+    uint32_t i = __atomic_fetch_add(&trace_head, 1, __ATOMIC_RELAXED);
+    struct trace_record *r = &trace_buffer[i & (TRACE_BUFFER_LEN - 1)];
+    r->cycles = esp_cpu_get_cycle_count();
+    r->event_arg = trace_pack(event, arg);
+}
+
+IRAM_ATTR void trace_task_switched_in(void)
+{
+    trace_record(TRACE_TASK_SWITCHED_IN, (uint32_t)(uintptr_t)xTaskGetCurrentTaskHandle());
+}
+
+void trace_set_enabled(bool enabled)
+{
+    trace_on = enabled;
+}
+
+static void dump_tasks(void)
+{
+#if configUSE_TRACE_FACILITY
+    static TaskStatus_t tasks[32];
+    UBaseType_t n = uxTaskGetSystemState(tasks, sizeof(tasks) / sizeof(tasks[0]), NULL);
+    for (UBaseType_t i = 0; i < n; i++){
+        printf("T %06" PRIx32 " %s\n", (uint32_t)tasks[i].xHandle & TRACE_ARG_MASK, tasks[i].pcTaskName);
+    }
+#else
+    printf("# Enable CONFIG_FREERTOS_USE_TRACE_FACILITY for task names\n");
+#endif
+}
+
+void trace_dump(void)
+{
+    bool was_on = trace_on;
+    trace_on = false;
+
+    uint32_t head = trace_head;
+    uint32_t n = head < TRACE_BUFFER_LEN ? head : TRACE_BUFFER_LEN;
+    printf("=== TRACE BEGIN cpu_mhz=%d records=%" PRIu32 " lost=%" PRIu32 " ===\n", 
+           CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ, n, head - n);
+    dump_tasks();
+    for (uint32_t i = head - n; i != head; i++){
+        const struct trace_record *r = &trace_buffer[i & (TRACE_BUFFER_LEN - 1)];
+        printf("R %08" PRIx32 "%08" PRIx32 "\n", r->cycles, r->event_arg);
+    }
+    printf("=== TRACE END ===\n");
+
+    trace_head = 0;
+    trace_on = was_on;
+}
+
+#if !SIMULATE_SCD4X
+// Every I2C transfer of the scd4x driver passes through here (see main/CMakeLists.txt). With the simulated sensor, 
+// the model in scd4x_sim.c records these events instead.
+esp_err_t __real_i2c_dev_write(const void *dev, const void *out_reg, size_t out_reg_size, const void *out_data, size_t out_size);
+esp_err_t __real_i2c_dev_read(const void *dev, const void *out_data, size_t out_size, void *in_data, size_t in_size);
+
+esp_err_t __wrap_i2c_dev_write(const void *dev, const void *out_reg, size_t out_reg_size, const void *out_data, size_t out_size)
+{
+    const uint8_t *cmd = out_data;
+    TRACE(TRACE_I2C_WRITE_BEGIN, out_size >= 2 ? (cmd[0] << 8) | cmd[1] : 0);
+    esp_err_t err = __real_i2c_dev_write(dev, out_reg, out_reg_size, out_data, out_size);
+    TRACE(TRACE_I2C_END, err);
+    return err;
+}
+
+esp_err_t __wrap_i2c_dev_read(const void *dev, const void *out_data, size_t out_size, void *in_data, size_t in_size)
+{
+    TRACE(TRACE_I2C_READ_BEGIN, in_size);
+    esp_err_t err = __real_i2c_dev_read(dev, out_data, out_size, in_data, in_size);
+    TRACE(TRACE_I2C_END, err);
+    return err;
+}
+#endif
+
+#endif
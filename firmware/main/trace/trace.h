@@ -0,0 +1,40 @@
+#ifndef _TRACE_H
+#define _TRACE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "trace_format.h"
+
+/*
+Binary event trace. Events go into a ring of fixed-size records (see trace_format.h), from tasks and ISRs alike, 
+without locks. A record costs a cycle counter read, an atomic add and two stores.
+
+Tracing is enabled with MINICO2_TRACE in the top level CMakeLists.txt, which also hooks the FreeRTOS task switch and
+queue trace macros (trace_freertos.h). When it is disabled, TRACE() compiles to nothing.
+*/
+
+#ifndef TRACE_ENABLED
+#define TRACE_ENABLED 0
+#endif
+
+#if TRACE_ENABLED
+#define TRACE(event, arg) trace_record((event), (uint32_t)(arg))
+#else
+#define TRACE(event, arg) do {} while (0)
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void trace_record(uint32_t event, uint32_t arg);
+
+// Stops tracing and prints the buffer to stdout in the text format of trace_format.h, then resumes tracing
+void trace_dump(void);
+void trace_set_enabled(bool enabled);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,89 @@
+#ifndef _TRACE_FORMAT_H
+#define _TRACE_FORMAT_H
+
+#include <stdint.h>
+
+/*
+Format of the binary trace records, shared by the firmware and tools/trace_to_chrome.c. This file must not depend on
+ESP-IDF.
+
+A record is 8 bytes: the CPU cycle counter when the event happened, and the event id in the top 8 bits of the second
+word with a 24 bit argument below it. Pointer arguments (tasks, queues) keep their low 24 bits, which are unique 
+within the 512 KB of SRAM of the ESP32-C6.
+
+The 'trace' console command prints the buffer as text, so it can be captured from the serial console:
+
+    === TRACE BEGIN cpu_mhz=<n> records=<n> lost=<n> ===
+    T <task id, hex> <task name>          (one line per task)
+    R <cycles, 8 hex digits><event and arg, 8 hex digits>   (one line per record, oldest first)
+    === TRACE END ===
+*/
+
+#define TRACE_BUFFER_LEN 2048  // Records in the trace buffer. Must be a power of two.
+#define TRACE_ARG_BITS 24
+#define TRACE_ARG_MASK ((1u << TRACE_ARG_BITS) - 1)
+
+enum TRACE_EVENTS {
+    TRACE_NONE,
+    TRACE_TASK_SWITCHED_IN,       // arg: task
+    TRACE_QUEUE_SEND,             // arg: queue
+    TRACE_QUEUE_RECEIVE,          // arg: queue
+    TRACE_QUEUE_SEND_FROM_ISR,    // arg: queue
+    TRACE_QUEUE_RECEIVE_FROM_ISR, // arg: queue
+    TRACE_I2C_WRITE_BEGIN,        // arg: first two bytes written, the SCD4x command
+    TRACE_I2C_READ_BEGIN,         // arg: number of bytes read
+    TRACE_I2C_END,                // arg: esp_err_t result
+    TRACE_GAP_ADV_START,          // Advertising start requested
+    TRACE_GAP_ADV_STARTED,        // Advertising start complete. arg: status
+    TRACE_GAP_ADV_STOP,           // Advertising stop requested
+    TRACE_GAP_ADV_STOPPED,        // Advertising stop complete. arg: status
+    TRACE_NVS_COMMIT_BEGIN,
+    TRACE_NVS_COMMIT_END,         // arg: esp_err_t result
+    TRACE_BENCH,                  // Recorded by the trace_event benchmark of the 'bench' command
+    TRACE_N_EVENTS
+};
+
+struct trace_record {
+    uint32_t cycles;
+    uint32_t event_arg;
+};
+
+static inline uint32_t trace_pack(uint32_t event, uint32_t arg)
+{
+    return (event << TRACE_ARG_BITS) | (arg & TRACE_ARG_MASK);
+}
+
+static inline uint32_t trace_event(const struct trace_record *r)
+{
+    return r->event_arg >> TRACE_ARG_BITS;
+}
+
+static inline uint32_t trace_arg(const struct trace_record *r)
+{
+    return r->event_arg & TRACE_ARG_MASK;
+}
+
+static inline const char *trace_event_to_str(uint32_t event)
+{
+    switch (event)
+    {
+    case TRACE_TASK_SWITCHED_IN: return "task_switched_in";
+    case TRACE_QUEUE_SEND: return "queue_send";
+    case TRACE_QUEUE_RECEIVE: return "queue_receive";
+    case TRACE_QUEUE_SEND_FROM_ISR: return "queue_send_from_isr";
+    case TRACE_QUEUE_RECEIVE_FROM_ISR: return "queue_receive_from_isr";
+    case TRACE_I2C_WRITE_BEGIN: return "i2c_write";
+    case TRACE_I2C_READ_BEGIN: return "i2c_read";
+    case TRACE_I2C_END: return "i2c_end";
+    case TRACE_GAP_ADV_START: return "gap_adv_start";
+    case TRACE_GAP_ADV_STARTED: return "gap_adv_started";
+    case TRACE_GAP_ADV_STOP: return "gap_adv_stop";
+    case TRACE_GAP_ADV_STOPPED: return "gap_adv_stopped";
+    case TRACE_NVS_COMMIT_BEGIN: return "nvs_commit";
+    case TRACE_NVS_COMMIT_END: return "nvs_commit_end";
+    case TRACE_BENCH: return "bench";
+    default: return "unknown";
+    }
+}
+
+#endif
@@ -0,0 +1,20 @@
+/*
+Force-included into every C file of the build when MINICO2_TRACE is on, so that FreeRTOS picks up these trace macros 
+instead of its empty defaults. Keep it free of other includes.
+*/
+#ifndef _TRACE_FREERTOS_H
+#define _TRACE_FREERTOS_H
+
+#include <stdint.h>
+
+void trace_record(uint32_t event, uint32_t arg);
+void trace_task_switched_in(void);
+
+// Event ids from trace_format.h, checked in trace.c
+#define traceTASK_SWITCHED_IN() trace_task_switched_in()
+#define traceQUEUE_SEND(pxQueue) trace_record(2, (uint32_t)(pxQueue))
+#define traceQUEUE_RECEIVE(pxQueue) trace_record(3, (uint32_t)(pxQueue))
+#define traceQUEUE_SEND_FROM_ISR(pxQueue) trace_record(4, (uint32_t)(pxQueue))
+#define traceQUEUE_RECEIVE_FROM_ISR(pxQueue) trace_record(5, (uint32_t)(pxQueue))
+
+#endif
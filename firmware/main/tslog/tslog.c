@@ -0,0 +1,237 @@
+#include <string.h>
+#include <inttypes.h>
+#include <esp_log.h>
+#include <esp_check.h>
+#include <esp_timer.h>
+#include <esp_partition.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "../types.h"
+#include "../bus/measurement_bus.h"
+#include "tslog.h"
+
+static const char *TSLOG_TAG = "tslog";
+
+static const esp_partition_t *partition = NULL;
+static const uint8_t *map = NULL;  // The partition, memory mapped for reading
+static esp_partition_mmap_handle_t map_handle;
+static uint32_t n_pages = 0;
+
+// Write position
+static uint32_t cur_page = 0;
+static uint32_t cur_off = 0;
+static bool page_open = false;
+static uint32_t next_seq = 0;
+static struct tslog_cursor cursor;
+static uint32_t time_offset_s = 0;  // Added to the uptime to get the log time
+
+static uint32_t appended = 0;
+static uint32_t pages_erased = 0;
+
+static const struct tslog_page_header *page_header(uint32_t page)
+{
+    return (const struct tslog_page_header *)&map[page * TSLOG_PAGE_SIZE];
+}
+
+// Decodes all records of a page. Returns the offset after the last valid record.
+static uint32_t scan_page(uint32_t page, struct tslog_cursor *c, uint32_t *samples)
+{
+    const uint8_t *p = &map[page * TSLOG_PAGE_SIZE];
+    uint32_t off = sizeof(struct tslog_page_header);
+    struct tslog_sample s;
+    tslog_cursor_init(c, page_header(page));
+    *samples = 1;
+    size_t n;
+    while ((n = tslog_decode(&p[off], TSLOG_PAGE_SIZE - off, c, &s)) > 0){
+        off += n;
+        (*samples)++;
+    }
+    return off;
+}
+
+static bool tail_erased(uint32_t page, uint32_t off)
+{
+    const uint8_t *p = &map[page * TSLOG_PAGE_SIZE];
+    for (; off < TSLOG_PAGE_SIZE; off++){
+        if (p[off] != TSLOG_ERASED){return false;}
+    }
+    return true;
+}
+
+esp_err_t tslog_init(void)
+{
+    partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, TSLOG_PARTITION_SUBTYPE, TSLOG_PARTITION_LABEL);
+    ESP_RETURN_ON_FALSE(partition != NULL, ESP_ERR_NOT_FOUND, TSLOG_TAG, "Log partition '%s' not found", TSLOG_PARTITION_LABEL);
+    ESP_RETURN_ON_FALSE(partition->erase_size == TSLOG_PAGE_SIZE, ESP_ERR_INVALID_SIZE, TSLOG_TAG, "Unexpected erase size");
+    n_pages = partition->size / TSLOG_PAGE_SIZE;
+
+    const void *ptr;
+    ESP_RETURN_ON_ERROR(esp_partition_mmap(partition, 0, partition->size, ESP_PARTITION_MMAP_DATA, &ptr, &map_handle), 
+                        TSLOG_TAG, "Mapping log partition failed");
+    map = ptr;
+
+    // The page with the highest sequence number is the one written last
+    bool found = false;
+    uint32_t max_seq = 0;
+    for (uint32_t page = 0; page < n_pages; page++){
+        const struct tslog_page_header *h = page_header(page);
+        if (tslog_header_valid(h) && (!found || h->seq > max_seq)){
+            found = true;
+            max_seq = h->seq;
+            cur_page = page;
+        }
+    }
+
+    if (!found){
+        // Empty log. The first page opened is page 0.
+        cur_page = n_pages - 1;
+        ESP_LOGI(TSLOG_TAG, "Log is empty, %" PRIu32 " pages available", n_pages);
+        return ESP_OK;
+    }
+
+    // Continue in the last page if nothing was written after its last complete record. If a record was torn by a 
+    // power loss, the rest of the page is abandoned.
+    uint32_t samples;
+    cur_off = scan_page(cur_page, &cursor, &samples);
+    page_open = tail_erased(cur_page, cur_off);
+    next_seq = max_seq + 1;
+    time_offset_s = cursor.prev.time_s + 1;
+    ESP_LOGI(TSLOG_TAG, "Recovered log at page %" PRIu32 " offset %" PRIu32 "%s", cur_page, cur_off, 
+             page_open ? "" : " (torn record, starting a new page)");
+    return ESP_OK;
+}
+
+// Erases the next page and writes a header to it holding 's'
+static esp_err_t open_page(const struct tslog_sample *s)
+{
+    uint32_t page = (cur_page + 1) % n_pages;
+    ESP_RETURN_ON_ERROR(esp_partition_erase_range(partition, page * TSLOG_PAGE_SIZE, TSLOG_PAGE_SIZE), TSLOG_TAG, "Erasing page failed");
+    pages_erased++;
+
+    struct tslog_page_header h = {
+        .magic = TSLOG_PAGE_MAGIC,
+        .seq = next_seq,
+        .first = *s,
+    };
+    h.crc = tslog_header_crc(&h);
+
+    // The magic is written last, so that a torn header is not valid
+    size_t magic_len = sizeof(h.magic);
+    ESP_RETURN_ON_ERROR(esp_partition_write(partition, page * TSLOG_PAGE_SIZE + magic_len, (uint8_t *)&h + magic_len, sizeof(h) - magic_len), 
+                        TSLOG_TAG, "Writing page header failed");
+    ESP_RETURN_ON_ERROR(esp_partition_write(partition, page * TSLOG_PAGE_SIZE, &h.magic, magic_len), TSLOG_TAG, "Writing page magic failed");
+
+    cur_page = page;
+    cur_off = sizeof(h);
+    page_open = true;
+    next_seq++;
+    tslog_cursor_init(&cursor, &h);
+    return ESP_OK;
+}
+
+esp_err_t tslog_append(struct tslog_sample *sample)
+{
+    if (map == NULL){return ESP_ERR_INVALID_STATE;}
+
+    sample->time_s = time_offset_s + esp_timer_get_time() / 1000000;
+    appended++;
+
+    if (!page_open){
+        return open_page(sample);
+    }
+
+    uint8_t rec[TSLOG_MAX_RECORD_LEN];
+    size_t n = tslog_encode(rec, &cursor, sample);
+    if (cur_off + n > TSLOG_PAGE_SIZE){
+        page_open = false;
+        return open_page(sample);
+    }
+
+    // The payload is written before the length byte, so that a torn record is never decoded
+    uint32_t addr = cur_page * TSLOG_PAGE_SIZE + cur_off;
+    ESP_RETURN_ON_ERROR(esp_partition_write(partition, addr + 1, &rec[1], n - 1), TSLOG_TAG, "Writing record failed");
+    ESP_RETURN_ON_ERROR(esp_partition_write(partition, addr, &rec[0], 1), TSLOG_TAG, "Writing record length failed");
+    cur_off += n;
+    tslog_cursor_advance(&cursor, sample);
+    return ESP_OK;
+}
+
+void tslog_begin(struct tslog_iter *it)
+{
+    // The page after the current one is the oldest, as pages are filled in order
+    it->page = cur_page;
+    it->pages_left = map == NULL ? 0 : n_pages;
+    it->in_page = false;
+}
+
+bool tslog_next(struct tslog_iter *it, struct tslog_sample *sample)
+{
+    while (1){
+        if (!it->in_page){
+            if (it->pages_left == 0){return false;}
+            it->page = (it->page + 1) % n_pages;
+            it->pages_left--;
+            const struct tslog_page_header *h = page_header(it->page);
+            if (!tslog_header_valid(h)){continue;}
+            tslog_cursor_init(&it->cursor, h);
+            it->off = sizeof(*h);
+            it->in_page = true;
+            *sample = h->first;
+            return true;
+        }
+
+        const uint8_t *p = &map[it->page * TSLOG_PAGE_SIZE];
+        size_t n = tslog_decode(&p[it->off], TSLOG_PAGE_SIZE - it->off, &it->cursor, sample);
+        if (n == 0){
+            it->in_page = false;
+            continue;
+        }
+        it->off += n;
+        return true;
+    }
+}
+
+void tslog_get_stats(struct tslog_stats *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+    stats->pages = n_pages;
+    stats->appended = appended;
+    stats->pages_erased = pages_erased;
+    for (uint32_t page = 0; map != NULL && page < n_pages; page++){
+        if (!tslog_header_valid(page_header(page))){continue;}
+        struct tslog_cursor c;
+        uint32_t samples;
+        stats->bytes += scan_page(page, &c, &samples);
+        stats->samples += samples;
+        stats->pages_used++;
+    }
+}
+
+void tslog_task(void *pvParameters)
+{
+    esp_err_t err = tslog_init();
+    if (err != ESP_OK){
+        // The device works without the log, so this is not treated as a device error. The task is registered with
+        // the diagnostics, so it idles instead of deleting itself.
+        ESP_LOGE(TSLOG_TAG, "Log init failed (%s), not logging to flash", esp_err_to_name(err));
+        while (1){
+            vTaskDelay(pdMS_TO_TICKS(1000));
+        }
+    }
+
+    static struct measurement_bus_subscriber bus_sub;
+    ESP_ERROR_CHECK(measurement_bus_subscribe(&bus_sub));
+
+    struct SCD40measurement meas;
+    while (1){
+        measurement_bus_wait(portMAX_DELAY);
+        while (measurement_bus_read(&bus_sub, &meas)){
+            struct tslog_sample sample = {
+                .co2 = meas.co2,
+                .temp_dc = (int16_t)(meas.temp_cdeg / 10),
+                .hum_dpct = (uint16_t)(meas.hum_cpct / 10),
+            };
+            ESP_ERROR_CHECK_WITHOUT_ABORT(tslog_append(&sample));
+        }
+    }
+}
@@ -0,0 +1,51 @@
+#ifndef _TSLOG_H
+#define _TSLOG_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <esp_err.h>
+#include "tslog_format.h"
+
+/*
+Append-only, compressed time series log of measurements on the 'tslog' flash partition. See tslog_format.h for the
+on-flash format. The log survives reboots. Log time continues from the last sample in the log after a reboot, so the
+time the device was off is not counted.
+*/
+
+#define TSLOG_PARTITION_LABEL "tslog"
+#define TSLOG_PARTITION_SUBTYPE 0x40
+
+struct tslog_stats {
+    uint32_t pages;          // Number of pages in the partition
+    uint32_t pages_used;     // Number of pages holding data
+    uint32_t samples;        // Number of samples in the log
+    uint32_t bytes;          // Number of bytes used by the samples, including page headers
+    uint32_t appended;       // Number of samples appended since boot
+    uint32_t pages_erased;   // Number of pages erased since boot
+};
+
+// Iterator over the samples in the log, oldest first
+struct tslog_iter {
+    uint32_t page;           // Current page
+    uint32_t pages_left;     // Pages left to visit after the current one
+    uint32_t off;            // Offset of the next record in the current page
+    bool in_page;
+    struct tslog_cursor cursor;
+};
+
+// Finds and maps the log partition, and recovers the write position by scanning the page headers
+esp_err_t tslog_init(void);
+
+// Appends a sample. Its 'time_s' is overwritten with the log time.
+esp_err_t tslog_append(struct tslog_sample *sample);
+
+void tslog_begin(struct tslog_iter *it);
+bool tslog_next(struct tslog_iter *it, struct tslog_sample *sample);
+
+// Walks the whole log to compute its statistics
+void tslog_get_stats(struct tslog_stats *stats);
+
+// Task that appends every measurement on the measurement bus to the log
+void tslog_task(void *pvParameters);
+
+#endif
@@ -0,0 +1,157 @@
+#ifndef _TSLOG_FORMAT_H
+#define _TSLOG_FORMAT_H
+
+/*
+On-flash format of the time series log. This header has no dependencies on ESP-IDF, so that the host-side decoder 
+in tools/ can use it too.
+
+The log partition is split into pages of one flash erase sector each. Pages are filled in order and wrap around, the 
+oldest page being erased when the log is full. Each page starts with a header that holds a sequence number and the 
+first sample of the page in full. The samples that follow are stored as records:
+
+    [len] [delta-of-delta time] [co2 XOR previous] [temperature XOR previous] [humidity XOR previous]
+
+'len' is the number of bytes after it, and the four fields are varints (the time field zigzag-encoded). The payload
+of a record is written before its length byte, so a record whose length byte is still erased (0xFF) was not 
+completed and marks the end of the page.
+*/
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define TSLOG_PAGE_SIZE 4096
+#define TSLOG_PAGE_MAGIC 0x474c5354  // "TSLG"
+#define TSLOG_ERASED 0xff
+#define TSLOG_MAX_RECORD_LEN 16      // Length byte plus four varints of up to 5, 3, 3 and 3 bytes
+
+struct tslog_sample {
+    uint32_t time_s;     // Log time in seconds
+    uint16_t co2;        // PPM
+    int16_t temp_dc;     // Deci-degrees Celsius
+    uint16_t hum_dpct;   // Deci-percent relative humidity
+};
+
+struct tslog_page_header {
+    uint32_t magic;      // TSLOG_PAGE_MAGIC. Written last, so a page with a torn header is not valid.
+    uint32_t seq;        // Incremented for every page that is started
+    struct tslog_sample first;
+    uint16_t crc;        // CRC-16/CCITT of 'seq' and 'first'
+};
+
+// Decoder state carried from one record to the next
+struct tslog_cursor {
+    struct tslog_sample prev;
+    int32_t prev_delta_s;
+};
+
+static inline uint16_t tslog_crc16(const uint8_t *data, size_t len)
+{
+    uint16_t crc = 0xffff;
+    for (size_t i = 0; i < len; i++){
+        crc ^= (uint16_t)data[i] << 8;
+        for (int b = 0; b < 8; b++){
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+        }
+    }
+    return crc;
+}
+
+static inline uint16_t tslog_header_crc(const struct tslog_page_header *h)
+{
+    // The fields are hashed one by one, so that the CRC does not depend on struct padding
+    uint8_t buf[14];
+    const struct tslog_sample *s = &h->first;
+    uint32_t v32[2] = {h->seq, s->time_s};
+    uint16_t v16[3] = {s->co2, (uint16_t)s->temp_dc, s->hum_dpct};
+    for (int i = 0; i < 2; i++){
+        for (int b = 0; b < 4; b++){buf[i * 4 + b] = (v32[i] >> (8 * b)) & 0xff;}
+    }
+    for (int i = 0; i < 3; i++){
+        for (int b = 0; b < 2; b++){buf[8 + i * 2 + b] = (v16[i] >> (8 * b)) & 0xff;}
+    }
+    return tslog_crc16(buf, sizeof(buf));
+}
+
+static inline bool tslog_header_valid(const struct tslog_page_header *h)
+{
+    return h->magic == TSLOG_PAGE_MAGIC && h->crc == tslog_header_crc(h);
+}
+
+static inline size_t tslog_put_varint(uint8_t *dst, uint32_t v)
+{
+    size_t n = 0;
+    while (v >= 0x80){
+        dst[n++] = (v & 0x7f) | 0x80;
+        v >>= 7;
+    }
+    dst[n++] = v;
+    return n;
+}
+
+// Reads a varint from 'src', which holds 'len' bytes. Returns the number of bytes read, or 0 if it is malformed.
+static inline size_t tslog_get_varint(const uint8_t *src, size_t len, uint32_t *v)
+{
+    *v = 0;
+    for (size_t n = 0; n < len && n < 5; n++){
+        *v |= (uint32_t)(src[n] & 0x7f) << (7 * n);
+        if (!(src[n] & 0x80)){return n + 1;}
+    }
+    return 0;
+}
+
+static inline uint32_t tslog_zigzag(int32_t v){return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);}
+static inline int32_t tslog_unzigzag(uint32_t v){return (int32_t)(v >> 1) ^ -(int32_t)(v & 1);}
+
+// Starts decoding a page from its header
+static inline void tslog_cursor_init(struct tslog_cursor *c, const struct tslog_page_header *h)
+{
+    c->prev = h->first;
+    c->prev_delta_s = 0;
+}
+
+// Encodes 's' as a record following the cursor's previous sample into 'dst', including the length byte. The length 
+// byte is the first byte. Returns the total number of bytes.
+static inline size_t tslog_encode(uint8_t *dst, const struct tslog_cursor *c, const struct tslog_sample *s)
+{
+    int32_t delta = (int32_t)(s->time_s - c->prev.time_s);
+    size_t n = 1;
+    n += tslog_put_varint(&dst[n], tslog_zigzag(delta - c->prev_delta_s));
+    n += tslog_put_varint(&dst[n], s->co2 ^ c->prev.co2);
+    n += tslog_put_varint(&dst[n], (uint16_t)s->temp_dc ^ (uint16_t)c->prev.temp_dc);
+    n += tslog_put_varint(&dst[n], s->hum_dpct ^ c->prev.hum_dpct);
+    dst[0] = n - 1;
+    return n;
+}
+
+static inline void tslog_cursor_advance(struct tslog_cursor *c, const struct tslog_sample *s)
+{
+    c->prev_delta_s = (int32_t)(s->time_s - c->prev.time_s);
+    c->prev = *s;
+}
+
+// Decodes the record at 'src', which has 'avail' bytes left in the page. Returns the number of bytes consumed, or 0
+// at the end of the page's data.
+static inline size_t tslog_decode(const uint8_t *src, size_t avail, struct tslog_cursor *c, struct tslog_sample *s)
+{
+    if (avail < 1 || src[0] == TSLOG_ERASED || src[0] == 0 || (size_t)src[0] + 1 > avail){return 0;}
+    size_t len = src[0];
+    const uint8_t *p = &src[1];
+    uint32_t v[4];
+    for (int i = 0; i < 4; i++){
+        size_t n = tslog_get_varint(p, len - (p - &src[1]), &v[i]);
+        if (n == 0){return 0;}
+        p += n;
+    }
+    if ((size_t)(p - &src[1]) != len){return 0;}
+
+    int32_t delta = c->prev_delta_s + tslog_unzigzag(v[0]);
+    s->time_s = c->prev.time_s + delta;
+    s->co2 = c->prev.co2 ^ v[1];
+    s->temp_dc = (int16_t)((uint16_t)c->prev.temp_dc ^ v[2]);
+    s->hum_dpct = c->prev.hum_dpct ^ v[3];
+    tslog_cursor_advance(c, s);
+    return len + 1;
+}
+
+#endif
@@ -2,15 +2,18 @@
 #define _TYPES_H
 
 #include <stdio.h>
+#include <stdint.h>
 
 #define str(x) #x
 #define xstr(x) str(x)  // Permits printing of enums as strings
 
-// Struct that holds one measurement made by the SCD40 sensor
+// Struct that holds one measurement made by the SCD40 sensor. The target has no FPU, so the values are scaled 
+// integers, in the units that BLE (BTHome) and Zigbee send.
 struct SCD40measurement{
-    uint16_t co2;
-    float temperature;
-    float humidity;
+    uint16_t co2;        // PPM
+    int16_t temp_cdeg;   // Centi-degrees Celsius
+    uint16_t hum_cpct;   // Centi-percent relative humidity
+    uint32_t read_us;  // Time the sample was read from the sensor, from latency_now(). Used to track its latency.
 };
 
 // The uniquely identified states that the LED can be in
@@ -49,14 +52,25 @@ struct led_cfg_s {
   uint16_t limit_critical;// CO2 concentration in PPM for the CRITICAL_CO2 LED state to enable.
 };
 
-// MiniCO2 configuration struct
+// Formats of the measurements printed on the serial port
+enum SERIAL_FORMATS {
+  SERIAL_FORMAT_TEXT,     // One line of text per measurement
+  SERIAL_FORMAT_BINARY,   // COBS-framed binary records, see serial/serial_format.h
+};
+
+// MiniCO2 configuration struct. New fields are added last, so that the config blob of older firmware, which is migrated 
+// on the first boot, still loads: the fields it does not have keep their defaults.
 struct minico2_cfg_s {
   char name [128];       // User-defined nickname for easy identification
-  uint16_t measurement_period;  // Number of seconds between each measurement. Any number less than 5 is forced to 5.
+  uint16_t measurement_period;  // Number of seconds between each measurement. Any number less than 5 is forced to 5, and more than 65535 to 65535.
+                                // With adaptive sampling, the longest period.
   bool serial_print_enabled;
   bool ble_enabled;
   bool zigbee_enabled;
   struct led_cfg_s led_cfg;
+  uint8_t serial_format;  // enum SERIAL_FORMATS
+  uint16_t outdoor_co2;   // Outdoor CO2 concentration in PPM, the baseline the indoor CO2 decays towards
+  bool adaptive_sampling; // Shorten the measurement period while the CO2 changes fast or is near an LED limit
 };
 
 // RGBA color struct
@@ -71,7 +85,7 @@ struct RGBA {
 struct LED_VISUAL_STATE {
   struct RGBA clr;
   enum LED_MODES mode;
-  float period; // Flash/pulse period in seconds
+  uint16_t period_ms; // Flash/pulse period in milliseconds
 };
 
 #endif
\ No newline at end of file
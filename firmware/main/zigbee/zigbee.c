@@ -6,23 +6,27 @@ Apologies in advance for the likely blunders. Do you know ZigBee? Feel free to m
 #include "esp_check.h"
 #include "esp_err.h"
 #include "esp_log.h"
-#include "nvs_flash.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "ha/esp_zigbee_ha_standard.h"
 #include "zigbee.h"
 #include "../types.h"
+#include "../bus/measurement_bus.h"
+#include "../latency/latency.h"
+#include "../diag/diag.h"
+#include "../boot/boot.h"
+#include "../stats/rollstats.h"
 
 static const char *ZIGBEE_TAG = "zigbee";
 
-static int16_t zb_temp_and_hum_to_s16(float temp_or_hum)
-{
-    return (int16_t)(temp_or_hum * 100);
-}
+#define ZIGBEE_DATA_TASK_STACK (configMINIMAL_STACK_SIZE * 8)
+static StackType_t zigbee_data_task_stack[ZIGBEE_DATA_TASK_STACK];
+static StaticTask_t zigbee_data_task_buffer;
 
+// The CO2 cluster is the only one that takes a float, a fraction of 1. Converted in single precision.
 static float_t zb_co2_to_float(uint16_t co2)
 {
-    return (float_t)(co2 * 1E-6);
+    return (float_t)co2 * 1E-6f;
 }
 
 // static void esp_app_buttons_handler(switch_func_pair_t *button_func_pair)
@@ -43,10 +47,25 @@ static float_t zb_co2_to_float(uint16_t co2)
 //     }
 // }
 
+/* Writes the rolling statistics of 'channel' to the manufacturer specific attributes of its cluster. Must be called with 
+the Zigbee lock held. */
+static void set_stats_attributes(uint16_t cluster_id, enum ROLLSTATS_CHANNELS channel)
+{
+    struct rollstats_result stats;
+    rollstats_get(ZIGBEE_STATS_WINDOW, channel, &stats);
+    uint16_t values[] = {stats.mean, stats.min, stats.max, stats.sd};  // Same bits for the S16 temperature attributes
+    uint16_t attr_ids[] = {ZB_ATTR_STATS_MEAN_ID, ZB_ATTR_STATS_MIN_ID, ZB_ATTR_STATS_MAX_ID, ZB_ATTR_STATS_SD_ID};
+    for (int i = 0; i < 4; i++){
+        esp_zb_zcl_set_manufacturer_attribute_val(HA_ESP_SENSOR_ENDPOINT, cluster_id, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE,
+            MINICO2_MANUFACTURER_CODE, attr_ids[i], &values[i], false);
+    }
+}
+
 static void esp_app_measurement_handler(struct SCD40measurement measurement)
 {
-    int16_t temp = zb_temp_and_hum_to_s16(measurement.temperature);
-    int16_t hum = zb_temp_and_hum_to_s16(measurement.humidity);
+    // The temperature and humidity clusters take hundredths, the units of the measurement
+    int16_t temp = measurement.temp_cdeg;
+    uint16_t hum = measurement.hum_cpct;
     float_t co2 = zb_co2_to_float(measurement.co2);
     esp_zb_lock_acquire(portMAX_DELAY);
     /* Update temperature sensor measured value */
@@ -61,7 +80,12 @@ static void esp_app_measurement_handler(struct SCD40measurement measurement)
     esp_zb_zcl_set_attribute_val(HA_ESP_SENSOR_ENDPOINT,
         ESP_ZB_ZCL_CLUSTER_ID_CARBON_DIOXIDE_MEASUREMENT, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE,
         ESP_ZB_ZCL_ATTR_CARBON_DIOXIDE_MEASUREMENT_MEASURED_VALUE_ID, &co2, false);
+    /* Update the rolling statistics */
+    set_stats_attributes(ESP_ZB_ZCL_CLUSTER_ID_TEMP_MEASUREMENT, ROLLSTATS_TEMP);
+    set_stats_attributes(ESP_ZB_ZCL_CLUSTER_ID_REL_HUMIDITY_MEASUREMENT, ROLLSTATS_HUM);
+    set_stats_attributes(ESP_ZB_ZCL_CLUSTER_ID_CARBON_DIOXIDE_MEASUREMENT, ROLLSTATS_CO2);
     esp_zb_lock_release();
+    latency_record(LATENCY_ZIGBEE_ATTRIBUTE_WRITTEN, measurement.read_us);
 }
 
 static void bdb_start_top_level_commissioning_cb(uint8_t mode_mask)
@@ -117,6 +141,17 @@ void esp_zb_app_signal_handler(esp_zb_app_signal_t *signal_struct)
 
 
 
+/* Adds the manufacturer specific attributes of the rolling statistics to a measurement cluster */
+static void add_stats_attributes(esp_zb_attribute_list_t *cluster, uint16_t cluster_id, uint8_t attr_type)
+{
+    uint16_t attr_ids[] = {ZB_ATTR_STATS_MEAN_ID, ZB_ATTR_STATS_MIN_ID, ZB_ATTR_STATS_MAX_ID, ZB_ATTR_STATS_SD_ID};
+    for (int i = 0; i < 4; i++){
+        uint16_t value = 0;
+        ESP_ERROR_CHECK(esp_zb_cluster_add_manufacturer_attr(cluster, cluster_id, attr_ids[i], MINICO2_MANUFACTURER_CODE,
+            attr_type, ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY | ESP_ZB_ZCL_ATTR_ACCESS_REPORTING, &value));
+    }
+}
+
 /* Create the clusters for the Home Assistant endpoint */
 static esp_zb_cluster_list_t *custom_minico2_clusters_create(esp_zb_minico2_cfg_t *minico2_sensor)
 {
@@ -139,9 +174,15 @@ static esp_zb_cluster_list_t *custom_minico2_clusters_create(esp_zb_minico2_cfg_
     ESP_ERROR_CHECK(esp_zb_cluster_list_add_identify_cluster(cluster_list, esp_zb_zcl_attr_list_create(ESP_ZB_ZCL_CLUSTER_ID_IDENTIFY), ESP_ZB_ZCL_CLUSTER_CLIENT_ROLE));
 
     /* Add the sensor clusters to the cluster list */
-    ESP_ERROR_CHECK(esp_zb_cluster_list_add_temperature_meas_cluster(cluster_list, esp_zb_temperature_meas_cluster_create(&(minico2_sensor->temp_meas_cfg)), ESP_ZB_ZCL_CLUSTER_SERVER_ROLE));
-    ESP_ERROR_CHECK(esp_zb_cluster_list_add_humidity_meas_cluster(cluster_list, esp_zb_humidity_meas_cluster_create(&(minico2_sensor->hum_meas_cfg)), ESP_ZB_ZCL_CLUSTER_SERVER_ROLE));
-    ESP_ERROR_CHECK(esp_zb_cluster_list_add_carbon_dioxide_measurement_cluster(cluster_list, esp_zb_carbon_dioxide_measurement_cluster_create(&(minico2_sensor->co2_meas_cfg)), ESP_ZB_ZCL_CLUSTER_SERVER_ROLE));
+    esp_zb_attribute_list_t *temp_cluster = esp_zb_temperature_meas_cluster_create(&(minico2_sensor->temp_meas_cfg));
+    esp_zb_attribute_list_t *hum_cluster = esp_zb_humidity_meas_cluster_create(&(minico2_sensor->hum_meas_cfg));
+    esp_zb_attribute_list_t *co2_cluster = esp_zb_carbon_dioxide_measurement_cluster_create(&(minico2_sensor->co2_meas_cfg));
+    add_stats_attributes(temp_cluster, ESP_ZB_ZCL_CLUSTER_ID_TEMP_MEASUREMENT, ESP_ZB_ZCL_ATTR_TYPE_S16);
+    add_stats_attributes(hum_cluster, ESP_ZB_ZCL_CLUSTER_ID_REL_HUMIDITY_MEASUREMENT, ESP_ZB_ZCL_ATTR_TYPE_U16);
+    add_stats_attributes(co2_cluster, ESP_ZB_ZCL_CLUSTER_ID_CARBON_DIOXIDE_MEASUREMENT, ESP_ZB_ZCL_ATTR_TYPE_U16);
+    ESP_ERROR_CHECK(esp_zb_cluster_list_add_temperature_meas_cluster(cluster_list, temp_cluster, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE));
+    ESP_ERROR_CHECK(esp_zb_cluster_list_add_humidity_meas_cluster(cluster_list, hum_cluster, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE));
+    ESP_ERROR_CHECK(esp_zb_cluster_list_add_carbon_dioxide_measurement_cluster(cluster_list, co2_cluster, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE));
 
     /* Add the LED configuration clusters to the cluster list */
     ESP_ERROR_CHECK(esp_zb_cluster_list_add_on_off_cluster(cluster_list, esp_zb_on_off_cluster_create(&(minico2_sensor->led_on_off_cfg)), ESP_ZB_ZCL_CLUSTER_SERVER_ROLE));
@@ -178,7 +219,6 @@ static void zigbee_setup()
         .radio_config = ESP_ZB_DEFAULT_RADIO_CONFIG(),
         .host_config = ESP_ZB_DEFAULT_HOST_CONFIG(),
     };
-    ESP_ERROR_CHECK(nvs_flash_init());
     ESP_ERROR_CHECK(esp_zb_platform_config(&config));
 
     /* Initialize Zigbee stack */
@@ -191,12 +231,12 @@ static void zigbee_setup()
     esp_zb_minico2_cfg_t minico2_cfg = ESP_ZB_DEFAULT_MINICO2_SENSOR_CONFIG();
 
     /* Set sensor limits */
-    minico2_cfg.temp_meas_cfg.min_value = zb_temp_and_hum_to_s16(ESP_TEMP_SENSOR_MIN_VALUE);
-    minico2_cfg.temp_meas_cfg.max_value = zb_temp_and_hum_to_s16(ESP_TEMP_SENSOR_MAX_VALUE);
-    minico2_cfg.hum_meas_cfg.min_value = zb_temp_and_hum_to_s16(ESP_RH_SENSOR_MIN_VALUE);
-    minico2_cfg.hum_meas_cfg.max_value = zb_temp_and_hum_to_s16(ESP_RH_SENSOR_MAX_VALUE);
-    minico2_cfg.co2_meas_cfg.min_measured_value = zb_temp_and_hum_to_s16(ESP_RH_SENSOR_MIN_VALUE);
-    minico2_cfg.co2_meas_cfg.max_measured_value = zb_temp_and_hum_to_s16(ESP_RH_SENSOR_MAX_VALUE);
+    minico2_cfg.temp_meas_cfg.min_value = ESP_TEMP_SENSOR_MIN_VALUE * 100;
+    minico2_cfg.temp_meas_cfg.max_value = ESP_TEMP_SENSOR_MAX_VALUE * 100;
+    minico2_cfg.hum_meas_cfg.min_value = ESP_RH_SENSOR_MIN_VALUE * 100;
+    minico2_cfg.hum_meas_cfg.max_value = ESP_RH_SENSOR_MAX_VALUE * 100;
+    minico2_cfg.co2_meas_cfg.min_measured_value = ESP_RH_SENSOR_MIN_VALUE * 100;
+    minico2_cfg.co2_meas_cfg.max_measured_value = ESP_RH_SENSOR_MAX_VALUE * 100;
 
     /* Build the Home Assistant endpoint */
     esp_zb_ep_list_t *esp_zb_sensor_ep = custom_minico2_ha_ep_create(HA_ESP_SENSOR_ENDPOINT, &minico2_cfg);
@@ -244,51 +284,41 @@ static void zigbee_setup()
 
 void zigbee_data_handler_task(void *pvParameters)
 {
-    // Get the queues from the pvParameters pointer
-    QueueHandle_t *queues = (QueueHandle_t *)pvParameters;
-    QueueHandle_t zigbee_queue = queues[0];
-    QueueHandle_t errors_queue = queues[1];
-
-    // If any of the queues failed at being created, we go into an infinite loop
-    if ((zigbee_queue == 0) || (errors_queue == 0)){
-        ESP_LOGE(ZIGBEE_TAG, "Zigbee queue or errors queue is 0, entering infinite loop");
-        while (1){
-            vTaskDelay(pdMS_TO_TICKS(1000));
-        }
-    }
+    static struct measurement_bus_subscriber bus_sub;
+    ESP_ERROR_CHECK(measurement_bus_subscribe(&bus_sub));
 
     ESP_LOGI(ZIGBEE_TAG, "Zigbee data handler task launched.");
     struct SCD40measurement meas;
     while (1){
-        if (xQueueReceive(zigbee_queue, &( meas), (TickType_t) 10)){
-            ESP_LOGD(ZIGBEE_TAG, "Sensor data received on Zigbee queue");
+        measurement_bus_wait(portMAX_DELAY);
+        while (measurement_bus_read(&bus_sub, &meas)){
+            ESP_LOGD(ZIGBEE_TAG, "Sensor data received on measurement bus");
             esp_app_measurement_handler(meas);
         }
     }
 }
 
-void zigbee_task(void *pvParameters)
+void zigbee_task(const struct zigbee_channels *channels)
 {
-    // Get the queues from the pvParameters pointer
-    QueueHandle_t *queues = (QueueHandle_t *)pvParameters;
-    QueueHandle_t zigbee_queue = queues[0];
-    QueueHandle_t errors_queue = queues[1];
+    QueueHandle_t errors_queue = channels->errors;
 
     // If any of the queues failed at being created, we go into an infinite loop
-    if ((zigbee_queue == 0) || (errors_queue == 0)){
-        ESP_LOGE(ZIGBEE_TAG, "Zigbee queue or errors queue is 0, entering infinite loop");
+    if (errors_queue == 0){
+        ESP_LOGE(ZIGBEE_TAG, "Errors queue is 0, entering infinite loop");
         while (1){
             vTaskDelay(pdMS_TO_TICKS(1000));
         }
     }
 
-    /* Setup zigbee */
+    /* Setup zigbee. The stack keeps its network data in NVS. */
+    boot_wait(BOOT_BIT(BOOT_NVS_READY), portMAX_DELAY);
     zigbee_setup();
+    boot_mark(BOOT_ZIGBEE_READY);
 
     /* Launch the ZigBee data handler task */
-    TaskHandle_t zigbee_data_task_handle = NULL;
-    QueueHandle_t zigbee_queues[] = {zigbee_queue, errors_queue}; 
-    xTaskCreate(zigbee_data_handler_task, "Zigbee_data_task", configMINIMAL_STACK_SIZE * 8, zigbee_queues, 5, &zigbee_data_task_handle);
+    TaskHandle_t zigbee_data_task_handle = xTaskCreateStatic(zigbee_data_handler_task, "Zigbee_data_task", 
+        ZIGBEE_DATA_TASK_STACK, NULL, 5, zigbee_data_task_stack, &zigbee_data_task_buffer);
+    diag_register_task(zigbee_data_task_handle, ZIGBEE_DATA_TASK_STACK);
 
     ESP_LOGI(ZIGBEE_TAG, "Zigbee setup finished, launching zigbee stack main loop.");
     esp_zb_stack_main_loop();
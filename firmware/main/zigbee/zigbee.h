@@ -2,8 +2,14 @@
 #define _ZIGBEE_H
 
 #include "esp_zigbee_core.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
 
-void zigbee_task(void *pvParameters);
+struct zigbee_channels {
+    QueueHandle_t errors;  // esp_err_t, to the controller
+};
+
+void zigbee_task(const struct zigbee_channels *channels);
 
 /* Zigbee configuration */
 #define INSTALLCODE_POLICY_ENABLE       false   /* enable the install code policy for security */
@@ -19,6 +25,28 @@ void zigbee_task(void *pvParameters);
 #define ESP_CO2_SENSOR_MIN_VALUE        (0*1E-6)    /* SCD4x CO2 sensor min measured value (fraction of 1) */
 #define ESP_CO2_SENSOR_MAX_VALUE        (2000*1E-6) /* SCD4x CO2 sensor max measured value (fraction of 1) */
 
+/* Rolling statistics of ZIGBEE_STATS_WINDOW, as manufacturer specific attributes of the temperature (0x0402), humidity 
+ * (0x0405) and CO2 (0x040D) measurement clusters of HA_ESP_SENSOR_ENDPOINT. They are read only and reportable, and 
+ * their type is that of the MeasuredValue of the cluster: S16 for temperature, U16 for humidity and CO2. The values are
+ * in the units of the measurement: hundredths of a degree or percent, and PPM for CO2 (not a fraction of 1 as in the 
+ * MeasuredValue of the CO2 cluster). All four are 0 until the window holds a sample.
+ *
+ *   0xF000  Mean over the window, rounded to the nearest unit
+ *   0xF001  Minimum over the window
+ *   0xF002  Maximum over the window
+ *   0xF003  Population standard deviation over the window, rounded down
+ *
+ * No manufacturer code is assigned to this project, so the attributes are under 0xFFF1, the first of the test codes 
+ * of the Connectivity Standards Alliance. No certified product uses these, so a client only finds the attributes if it
+ * asks for that code. A device with its own code must change MINICO2_MANUFACTURER_CODE.
+ */
+#define ZIGBEE_STATS_WINDOW             ROLLSTATS_1H
+#define MINICO2_MANUFACTURER_CODE       0xFFF1  /* CSA test manufacturer code, not assigned to anyone */
+#define ZB_ATTR_STATS_MEAN_ID           0xF000  /* Mean over the window */
+#define ZB_ATTR_STATS_MIN_ID            0xF001  /* Minimum over the window */
+#define ZB_ATTR_STATS_MAX_ID            0xF002  /* Maximum over the window */
+#define ZB_ATTR_STATS_SD_ID             0xF003  /* Standard deviation over the window */
+
 /* Attribute values in ZCL string format
  * The string should be started with the length of its own.
  */
@@ -102,6 +130,6 @@ typedef struct esp_zb_minico2_cfg_s {
         .led_brightness_cfg =                                                                           \
             {                                                                                           \
                 .current_level = 50                                                                     \
-            }                                                                                           \                                                                                       \
+            }                                                                                           \
     }
 #endif
\ No newline at end of file
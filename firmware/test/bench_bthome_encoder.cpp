@@ -0,0 +1,134 @@
+/*
+Cost of an advert of the BLE task, on the host: bthome::Encoder, which patches the measurement bytes of a persistent
+advert, against building a bthome::Advertisement from three bthome::Measurement for every sample, as the BLE task did
+before. Both copy the payload out, as the BLE task does. Encrypted adverts use a shorter name, see
+test_bthome_encoder.cpp, and the AES-CCM of shim/mbedtls_ccm.c.
+
+Reports nanoseconds per advert, the best of BENCH_ROUNDS rounds, and the calls of operator new per advert. The names
+fit into the small string buffer of std::string, so the std::string of Advertisement does not allocate either.
+Run it from the build directory: ./bench_bthome_encoder
+*/
+
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <new>
+#include "advertisement.h"
+#include "encoder.h"
+
+#define BENCH_CALLS 200000
+#define BENCH_ROUNDS 5
+
+using namespace bthome;
+
+static const uint8_t KEY[16] = {0x23, 0x1d, 0x39, 0xc1, 0xd7, 0xcc, 0x1a, 0xb1, 0xae, 0xe2, 0x24, 0xcd, 0x09, 0x6d,
+                                0xb9, 0x32};
+
+static uint64_t allocs = 0;
+
+void *operator new(size_t size)
+{
+    allocs++;
+    void *p = malloc(size);
+    if (p == NULL){throw std::bad_alloc();}
+    return p;
+}
+
+void operator delete(void *p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+    free(p);
+}
+
+static uint8_t advert_data[constants::BLE_ADVERT_MAX_LEN + 8];
+static volatile uint32_t sink;
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void advert_old(const char *name, bool encrypt, uint32_t i)
+{
+    Measurement temp(constants::ObjectId::TEMPERATURE_PRECISE, (uint64_t)(2000 + i % 500));
+    Measurement hum(constants::ObjectId::HUMIDITY_PRECISE, (uint64_t)(4000 + i % 1000));
+    Measurement co2(constants::ObjectId::CO2, (uint64_t)(400 + i % 2000));
+    Advertisement advert(name, encrypt, KEY);
+    advert.addMeasurement(temp);
+    advert.addMeasurement(hum);
+    advert.addMeasurement(co2);
+    memcpy(advert_data, advert.getPayload(), advert.getPayloadSize());
+    sink = advert.getPayloadSize();
+}
+
+static void advert_encoder(Encoder &encoder, uint32_t i)
+{
+    // The slots are those of the fields in the order they were added
+    encoder.setValue(0, (int32_t)(2000 + i % 500));
+    encoder.setValue(1, (int32_t)(4000 + i % 1000));
+    encoder.setValue(2, (int32_t)(400 + i % 2000));
+    memcpy(advert_data, encoder.getPayload(), encoder.getPayloadSize());
+    sink = encoder.getPayloadSize();
+}
+
+static void report(const char *label, double best_ns, uint64_t round_allocs)
+{
+    printf("%-24s: %8.1f ns per advert, %5.2f allocations per advert\n", label, best_ns / BENCH_CALLS,
+           (double)round_allocs / BENCH_CALLS);
+}
+
+static void bench_old(const char *label, const char *name, bool encrypt)
+{
+    double best = 1e30;
+    uint64_t round_allocs = 0;
+    for (int round = 0; round < BENCH_ROUNDS; round++){
+        uint64_t a0 = allocs;
+        double t0 = now_ns();
+        for (uint32_t i = 0; i < BENCH_CALLS; i++){
+            advert_old(name, encrypt, i);
+        }
+        double elapsed = now_ns() - t0;
+        if (elapsed < best){best = elapsed;}
+        round_allocs = allocs - a0;
+    }
+    report(label, best, round_allocs);
+}
+
+static void bench_encoder(const char *label, const char *name, bool encrypt)
+{
+    Encoder encoder(name, encrypt, KEY);
+    encoder.addField(constants::ObjectId::TEMPERATURE_PRECISE);
+    encoder.addField(constants::ObjectId::HUMIDITY_PRECISE);
+    encoder.addField(constants::ObjectId::CO2);
+
+    double best = 1e30;
+    uint64_t round_allocs = 0;
+    for (int round = 0; round < BENCH_ROUNDS; round++){
+        uint64_t a0 = allocs;
+        double t0 = now_ns();
+        for (uint32_t i = 0; i < BENCH_CALLS; i++){
+            advert_encoder(encoder, i);
+        }
+        double elapsed = now_ns() - t0;
+        if (elapsed < best){best = elapsed;}
+        round_allocs = allocs - a0;
+    }
+    report(label, best, round_allocs);
+}
+
+int main(void)
+{
+    bench_old("advertisement_plain", "MINICO2", false);
+    bench_encoder("encoder_plain", "MINICO2", false);
+    bench_old("advertisement_encrypted", "CO2", true);
+    bench_encoder("encoder_encrypted", "CO2", true);
+    return 0;
+}
@@ -0,0 +1,138 @@
+/*
+Throughput of the measurement bus of main/bus/measurement_bus.c, on the host.
+
+First, the cost of a publish and of a read in one thread, without contention. Then the controller's case at full
+speed: one task publishes as fast as it can, while 1 to MEASUREMENT_BUS_MAX_SUBSCRIBERS tasks read with their own
+cursors and wait for a notification when they have caught up. A reader that falls more than MEASUREMENT_BUS_LEN
+behind counts the overwritten samples as dropped, so reads plus drops must add up to what was published.
+
+Times are from the monotonic clock of the host, not the virtual clock of the shims, which stands still while tasks run.
+Run it from the build directory: ./bench_measurement_bus [publishes]
+*/
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "kernel.h"
+#include "freertos/task.h"
+#include "../main/bus/measurement_bus.h"
+
+#define SINGLE_THREAD_ROUNDS 10000000
+#define DEFAULT_PUBLISHES 2000000
+
+struct reader {
+    StaticTask_t control;
+    struct measurement_bus_subscriber sub;
+    volatile bool subscribed;
+    volatile bool done;
+    uint32_t reads;
+    uint32_t co2_sum;       // Keeps the reads from being optimised away
+};
+
+static volatile bool publishing_done = false;
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void reader_task(void *pvParameters)
+{
+    struct reader *r = pvParameters;
+    measurement_bus_subscribe(&r->sub);
+    r->subscribed = true;
+
+    struct SCD40measurement meas;
+    while (1){
+        while (measurement_bus_read(&r->sub, &meas)){
+            r->reads++;
+            r->co2_sum += meas.co2;
+        }
+        if (publishing_done && measurement_bus_head() == r->sub.cursor){break;}
+        measurement_bus_wait(pdMS_TO_TICKS(10));
+    }
+    r->done = true;
+    vTaskDelete(NULL);
+}
+
+static void bench_single_thread(void)
+{
+    static struct measurement_bus_subscriber sub;
+    measurement_bus_subscribe(&sub);
+
+    struct SCD40measurement meas = {.co2 = 612};
+    uint32_t sum = 0;
+    double t0 = now_s();
+    for (uint32_t i = 0; i < SINGLE_THREAD_ROUNDS; i++){
+        meas.co2 = 400 + i % 1000;
+        measurement_bus_publish(&meas);
+        struct SCD40measurement out;
+        measurement_bus_read(&sub, &out);
+        sum += out.co2;
+    }
+    double elapsed = now_s() - t0;
+    printf("publish + read, one thread: %6.1f ns per sample (checksum %" PRIu32 ")\n",
+           elapsed * 1e9 / SINGLE_THREAD_ROUNDS, sum);
+}
+
+// The readers subscribe before the publisher starts
+static void bench_readers(uint32_t n_readers, uint32_t publishes)
+{
+    static struct reader readers[MEASUREMENT_BUS_MAX_SUBSCRIBERS];
+    publishing_done = false;
+    for (uint32_t i = 0; i < n_readers; i++){
+        xTaskCreateStatic(reader_task, "reader", 4096, &readers[i], 5, NULL, &readers[i].control);
+        while (!readers[i].subscribed){}
+    }
+
+    uint32_t head0 = measurement_bus_head();
+    struct SCD40measurement meas = {.co2 = 612};
+    double t0 = now_s();
+    for (uint32_t i = 0; i < publishes; i++){
+        meas.co2 = 400 + i % 1000;
+        measurement_bus_publish(&meas);
+    }
+    double elapsed = now_s() - t0;
+    publishing_done = true;
+    for (uint32_t i = 0; i < n_readers; i++){
+        while (!readers[i].done){vTaskDelay(1);}
+    }
+
+    printf("%" PRIu32 " reader(s): %6.1f M publishes/s", n_readers, publishes / elapsed * 1e-6);
+    for (uint32_t i = 0; i < n_readers; i++){
+        struct reader *r = &readers[i];
+        printf(", reader %" PRIu32 " read %5.1f%% dropped %5.1f%%", i, 100.0 * r->reads / publishes,
+               100.0 * r->sub.dropped / publishes);
+        if (r->reads + r->sub.dropped != measurement_bus_head() - head0){
+            printf(" (MISMATCH)");
+        }
+    }
+    printf("\n");
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t publishes = argc > 1 ? strtoul(argv[1], NULL, 10) : DEFAULT_PUBLISHES;
+
+    // The bus has no unsubscribe, so every round runs in a process of its own, on a new bus
+    for (uint32_t n = 0; n <= MEASUREMENT_BUS_MAX_SUBSCRIBERS; n++){
+        fflush(stdout);
+        pid_t pid = fork();
+        if (pid == 0){
+            if (n == 0){
+                bench_single_thread();
+            } else {
+                bench_readers(n, publishes);
+            }
+            fflush(stdout);
+            _exit(0);
+        }
+        waitpid(pid, NULL, 0);
+    }
+    return 0;
+}
@@ -0,0 +1,35 @@
+/*
+The on-target benchmarks of main/bench/bench.cpp, run on the host: Measurement construction, adverts built with
+bthome::Advertisement and with the encoder, plain and encrypted, the LED state of a CO2 level, config_to_str, and the
+text line of a measurement from integers and from floats.
+
+The columns are those of the 'bench' console command. Cycles are ticks of the time stamp counter on x86 (see
+shim/include/esp_cpu.h), allocations per call are counted by the heap hooks of shim/heap_hooks.cpp, and the stack is
+the high water mark of the benchmark task on the host (see shim/include/freertos/task.h). The host numbers only
+compare with each other: the target has no FPU, a 160 MHz clock and other stack frames.
+
+Run it from the build directory: ./bench_measurement_paths [name filter]
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include "driver/usb_serial_jtag.h"
+#include "../main/bench/bench.h"
+extern "C" {
+#include "../main/globals.h"
+}
+
+// Linked in with the serial formatting, which the benchmarks call. Nothing is written to the port.
+int usb_serial_jtag_write_bytes(const void *src, size_t size, TickType_t ticks_to_wait)
+{
+    (void)src;
+    (void)ticks_to_wait;
+    return size;
+}
+
+int main(int argc, char **argv)
+{
+    // The config that load_config() starts from on the device
+    MINICO2CONFIG = MINICO2CONFIG_DEFAULT;
+    return bench_run(argc > 1 ? argv[1] : NULL) == ESP_OK ? 0 : 1;
+}
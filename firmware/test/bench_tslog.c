@@ -0,0 +1,119 @@
+/*
+Compression and throughput of the flash time series log of main/tslog/tslog.c, on the host, with the log partition in
+memory (see shim/esp_partition.h).
+
+By default a week of samples every 30 s is appended: the CO2 of an office, with people in during working hours and
+sensor noise, and temperature and humidity that follow it slowly. The virtual clock of the shims moves 30 s between
+appends, which the log takes its sample times from. Then the log is read back and checked against what was appended,
+and recovered from the partition as after a reboot.
+
+Reports the bytes per sample, against the size of a struct tslog_sample, how many days of history the partition
+holds at that rate, and samples per second for appends, reads and the recovery scan, from the monotonic clock of the
+host. Run it from the build directory: ./bench_tslog [days]
+*/
+
+#include <inttypes.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "kernel.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "../main/tslog/tslog.h"
+
+#define PERIOD_S 30
+#define DAY_S (24 * 60 * 60)
+#define DEFAULT_DAYS 7
+#define RECOVERIES 20
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// The sample at 't' seconds: CO2 that builds up from 8:00 to 18:00 on weekdays, and decays over the night
+static struct tslog_sample sample_at(uint32_t t)
+{
+    uint32_t day = t / DAY_S;
+    double hour = (t % DAY_S) / 3600.0;
+    bool workday = day % 7 < 5;
+    double co2 = 420;
+    if (workday && hour >= 8 && hour < 18){
+        co2 += 900 * (1 - exp(-(hour - 8) / 1.5));
+    } else if (workday && hour >= 18){
+        co2 += 900 * exp(-(hour - 18) / 2.0);
+    }
+    double temp = 20.5 + 2.0 * (co2 - 420) / 900 + 0.5 * sin(2 * M_PI * hour / 24);
+    double hum = 42 + 6.0 * (co2 - 420) / 900;
+
+    struct tslog_sample s = {
+        .co2 = (uint16_t)(co2 + rand() % 21 - 10),
+        .temp_dc = (int16_t)lround(temp * 10) + rand() % 3 - 1,
+        .hum_dpct = (uint16_t)lround(hum * 10) + rand() % 5 - 2,
+    };
+    return s;
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t days = argc > 1 ? strtoul(argv[1], NULL, 10) : DEFAULT_DAYS;
+    uint32_t n = days * DAY_S / PERIOD_S;
+    struct tslog_sample *appended = malloc(n * sizeof(*appended));
+
+    esp_log_level_set("*", ESP_LOG_WARN);
+    ESP_ERROR_CHECK(tslog_init());
+
+    srand(1);
+    double append_s = 0;
+    for (uint32_t i = 0; i < n; i++){
+        appended[i] = sample_at(i * PERIOD_S);
+        double t0 = now_s();
+        ESP_ERROR_CHECK(tslog_append(&appended[i]));
+        append_s += now_s() - t0;
+        vTaskDelay(pdMS_TO_TICKS(PERIOD_S * 1000));
+    }
+
+    struct tslog_stats stats;
+    tslog_get_stats(&stats);
+
+    // The log holds the newest samples, all of them unless it wrapped around
+    struct tslog_iter it;
+    struct tslog_sample s;
+    uint32_t read = 0;
+    uint32_t mismatches = 0;
+    uint32_t first = n - stats.samples;
+    double t0 = now_s();
+    tslog_begin(&it);
+    while (tslog_next(&it, &s)){
+        const struct tslog_sample *a = first + read < n ? &appended[first + read] : NULL;
+        if (a == NULL || s.time_s != a->time_s || s.co2 != a->co2 || s.temp_dc != a->temp_dc ||
+            s.hum_dpct != a->hum_dpct){
+            mismatches++;
+        }
+        read++;
+    }
+    double read_s = now_s() - t0;
+
+    t0 = now_s();
+    for (int i = 0; i < RECOVERIES; i++){
+        ESP_ERROR_CHECK(tslog_init());
+    }
+    double recover_s = (now_s() - t0) / RECOVERIES;
+
+    double bytes_per_sample = (double)stats.bytes / stats.samples;
+    double capacity_days = stats.pages * (double)TSLOG_PAGE_SIZE / bytes_per_sample * PERIOD_S / DAY_S;
+    printf("%" PRIu32 " samples over %" PRIu32 " days every %d s, %" PRIu32 " in the log on %" PRIu32 " of %" PRIu32
+           " pages\n", n, days, PERIOD_S, stats.samples, stats.pages_used, stats.pages);
+    printf("Bytes per sample         : %.2f (%.1fx smaller than the %zu bytes of the struct), page headers included\n",
+           bytes_per_sample, sizeof(struct tslog_sample) / bytes_per_sample, sizeof(struct tslog_sample));
+    printf("Partition holds          : %.0f days at %d s\n", capacity_days, PERIOD_S);
+    printf("Append                   : %.2f M samples/s\n", n / append_s * 1e-6);
+    printf("Read back                : %.2f M samples/s, %" PRIu32 " read, %" PRIu32 " mismatches\n",
+           read / read_s * 1e-6, read, mismatches);
+    printf("Recovery scan            : %.3f ms for %" PRIu32 " pages\n", recover_s * 1e3, stats.pages);
+    free(appended);
+    return mismatches == 0 && read == stats.samples ? 0 : 1;
+}
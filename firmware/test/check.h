@@ -0,0 +1,22 @@
+#ifndef _CHECK_H
+#define _CHECK_H
+
+#include <stdio.h>
+
+/*
+Checks of the host tests. A failed check prints its location and is counted, and the test goes on, so that one run
+shows every failure. main() returns CHECK_RESULT(), which fails the test if any check failed.
+*/
+
+static int check_failures = 0;
+
+#define CHECK(cond) do { \
+    if (!(cond)){ \
+        fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+        check_failures++; \
+    } \
+} while (0)
+
+#define CHECK_RESULT() (check_failures == 0 ? 0 : 1)
+
+#endif
@@ -0,0 +1,198 @@
+#include <string.h>
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "esp_bt.h"
+#include "esp_bt_main.h"
+#include "esp_gap_ble_api.h"
+#include "kernel.h"
+
+enum STACK_STATES {
+    STACK_IDLE,
+    STACK_INITIALIZED,
+    STACK_ENABLED,
+};
+
+struct gap_event {
+    esp_gap_ble_cb_event_t event;
+    esp_ble_gap_cb_param_t param;
+};
+
+#define GAP_QUEUE_LEN 8
+
+// State of the controller and of Bluedroid, only touched under the kernel lock
+static enum STACK_STATES controller = STACK_IDLE;
+static enum STACK_STATES bluedroid = STACK_IDLE;
+static esp_gap_ble_cb_t gap_callback = NULL;
+static struct shim_gap_stats stats;
+static int64_t advertising_since_us = 0;
+
+static StaticQueue_t gap_queue_control;
+static uint8_t gap_queue_storage[GAP_QUEUE_LEN * sizeof(struct gap_event)];
+static QueueHandle_t gap_queue = NULL;
+static StaticTask_t btc_task_control;
+
+static void btc_task(void *arg)
+{
+    (void)arg;
+    struct gap_event ev;
+    while (1){
+        xQueueReceive(gap_queue, &ev, portMAX_DELAY);
+        shim_lock();
+        esp_gap_ble_cb_t callback = gap_callback;
+        shim_unlock();
+        if (callback != NULL){callback(ev.event, &ev.param);}
+    }
+}
+
+static esp_err_t transition(enum STACK_STATES *state, enum STACK_STATES from, enum STACK_STATES to, bool needs_controller)
+{
+    shim_lock();
+    esp_err_t err = *state == from && (!needs_controller || controller == STACK_ENABLED) ? ESP_OK : ESP_ERR_INVALID_STATE;
+    if (err == ESP_OK){*state = to;}
+    shim_unlock();
+    return err;
+}
+
+esp_err_t esp_bt_controller_mem_release(esp_bt_mode_t mode)
+{
+    (void)mode;
+    return ESP_OK;
+}
+
+esp_err_t esp_bt_controller_init(esp_bt_controller_config_t *cfg)
+{
+    if (cfg == NULL){return ESP_ERR_INVALID_ARG;}
+    return transition(&controller, STACK_IDLE, STACK_INITIALIZED, false);
+}
+
+esp_err_t esp_bt_controller_deinit(void)
+{
+    return transition(&controller, STACK_INITIALIZED, STACK_IDLE, false);
+}
+
+esp_err_t esp_bt_controller_enable(esp_bt_mode_t mode)
+{
+    if (mode != ESP_BT_MODE_BLE){return ESP_ERR_INVALID_ARG;}
+    return transition(&controller, STACK_INITIALIZED, STACK_ENABLED, false);
+}
+
+esp_err_t esp_bt_controller_disable(void)
+{
+    shim_lock();
+    esp_err_t err = controller == STACK_ENABLED && bluedroid == STACK_IDLE ? ESP_OK : ESP_ERR_INVALID_STATE;
+    if (err == ESP_OK){controller = STACK_INITIALIZED;}
+    shim_unlock();
+    return err;
+}
+
+esp_err_t esp_bluedroid_init(void)
+{
+    return transition(&bluedroid, STACK_IDLE, STACK_INITIALIZED, true);
+}
+
+esp_err_t esp_bluedroid_deinit(void)
+{
+    return transition(&bluedroid, STACK_INITIALIZED, STACK_IDLE, false);
+}
+
+esp_err_t esp_bluedroid_enable(void)
+{
+    esp_err_t err = transition(&bluedroid, STACK_INITIALIZED, STACK_ENABLED, true);
+    if (err == ESP_OK && gap_queue == NULL){
+        gap_queue = xQueueCreateStatic(GAP_QUEUE_LEN, sizeof(struct gap_event), gap_queue_storage, &gap_queue_control);
+        xTaskCreateStatic(btc_task, "BTC_TASK", 3072, NULL, 19, NULL, &btc_task_control);
+    }
+    return err;
+}
+
+esp_err_t esp_bluedroid_disable(void)
+{
+    shim_lock();
+    if (stats.advertising){stats.advertising_us += shim_now_us() - advertising_since_us;}
+    stats.advertising = false;
+    shim_unlock();
+    return transition(&bluedroid, STACK_ENABLED, STACK_INITIALIZED, false);
+}
+
+esp_err_t esp_ble_gap_register_callback(esp_gap_ble_cb_t callback)
+{
+    shim_lock();
+    gap_callback = callback;
+    shim_unlock();
+    return ESP_OK;
+}
+
+// Queues the completion event of a GAP call, for the callback
+static esp_err_t complete(esp_gap_ble_cb_event_t event, esp_bt_status_t status)
+{
+    struct gap_event ev = {.event = event};
+    // The status is the first member of every event of the union
+    ev.param.adv_data_raw_cmpl.status = status;
+    xQueueSendToBack(gap_queue, &ev, portMAX_DELAY);
+    return ESP_OK;
+}
+
+static bool enabled(void)
+{
+    shim_lock();
+    bool on = bluedroid == STACK_ENABLED;
+    shim_unlock();
+    return on;
+}
+
+esp_err_t esp_ble_gap_config_adv_data_raw(uint8_t *raw_data, uint32_t raw_data_len)
+{
+    if (raw_data == NULL || raw_data_len > ESP_BLE_ADV_DATA_LEN_MAX){return ESP_ERR_INVALID_ARG;}
+    if (!enabled()){return ESP_ERR_INVALID_STATE;}
+    shim_lock();
+    memcpy(stats.adv_data, raw_data, raw_data_len);
+    stats.adv_data_len = raw_data_len;
+    stats.adv_data_sets++;
+    shim_unlock();
+    return complete(ESP_GAP_BLE_ADV_DATA_RAW_SET_COMPLETE_EVT, ESP_BT_STATUS_SUCCESS);
+}
+
+esp_err_t esp_ble_gap_config_scan_rsp_data_raw(uint8_t *raw_data, uint32_t raw_data_len)
+{
+    if (raw_data == NULL || raw_data_len > ESP_BLE_SCAN_RSP_DATA_LEN_MAX){return ESP_ERR_INVALID_ARG;}
+    if (!enabled()){return ESP_ERR_INVALID_STATE;}
+    return complete(ESP_GAP_BLE_SCAN_RSP_DATA_RAW_SET_COMPLETE_EVT, ESP_BT_STATUS_SUCCESS);
+}
+
+esp_err_t esp_ble_gap_start_advertising(esp_ble_adv_params_t *adv_params)
+{
+    if (adv_params == NULL || adv_params->adv_int_min > adv_params->adv_int_max){return ESP_ERR_INVALID_ARG;}
+    if (!enabled()){return ESP_ERR_INVALID_STATE;}
+    shim_lock();
+    bool started = !stats.advertising;
+    if (started){
+        stats.advertising = true;
+        stats.starts++;
+        advertising_since_us = shim_now_us();
+    } else {
+        stats.failed_starts++;
+    }
+    shim_unlock();
+    return complete(ESP_GAP_BLE_ADV_START_COMPLETE_EVT, started ? ESP_BT_STATUS_SUCCESS : ESP_BT_STATUS_FAIL);
+}
+
+esp_err_t esp_ble_gap_stop_advertising(void)
+{
+    if (!enabled()){return ESP_ERR_INVALID_STATE;}
+    shim_lock();
+    if (stats.advertising){
+        stats.advertising_us += shim_now_us() - advertising_since_us;
+        stats.stops++;
+    }
+    stats.advertising = false;
+    shim_unlock();
+    return complete(ESP_GAP_BLE_ADV_STOP_COMPLETE_EVT, ESP_BT_STATUS_SUCCESS);
+}
+
+void shim_gap_get_stats(struct shim_gap_stats *out)
+{
+    shim_lock();
+    *out = stats;
+    if (stats.advertising){out->advertising_us += shim_now_us() - advertising_since_us;}
+    shim_unlock();
+}
@@ -0,0 +1,130 @@
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/task.h"
+#include "esp_event.h"
+#include "kernel.h"
+
+struct handler {
+    esp_event_base_t base;
+    int32_t id;
+    esp_event_handler_t handler;
+    void *arg;
+    struct handler *next;
+};
+
+struct event {
+    esp_event_base_t base;
+    int32_t id;
+    struct event *next;
+    size_t size;
+    uint8_t data[];
+};
+
+// Handlers in the order they were registered, and the posted events. The loop task waits on 'events'.
+static struct handler *handlers = NULL;
+static struct event *events = NULL;
+static struct event **events_tail = &events;
+static bool loop_created = false;
+static StaticTask_t loop_task_control;
+
+static void loop_task(void *arg)
+{
+    (void)arg;
+    shim_lock();
+    while (1){
+        if (events == NULL){
+            shim_block(&events, -1);
+            continue;
+        }
+        struct event *event = events;
+        events = event->next;
+        if (events == NULL){events_tail = &events;}
+        // Handlers are never freed, so the lock is only dropped for the call
+        for (struct handler *h = handlers; h != NULL; h = h->next){
+            bool match = (h->base == ESP_EVENT_ANY_BASE || h->base == event->base) &&
+                         (h->id == ESP_EVENT_ANY_ID || h->id == event->id);
+            if (!match || h->handler == NULL){continue;}  // A NULL handler was unregistered
+            esp_event_handler_t handler = h->handler;
+            void *handler_arg = h->arg;
+            shim_unlock();
+            handler(handler_arg, event->base, event->id, event->size > 0 ? event->data : NULL);
+            shim_lock();
+        }
+        free(event);
+    }
+}
+
+esp_err_t esp_event_loop_create_default(void)
+{
+    shim_lock();
+    bool created = loop_created;
+    loop_created = true;
+    shim_unlock();
+    if (created){return ESP_ERR_INVALID_STATE;}
+    xTaskCreateStatic(loop_task, "sys_evt", 4096, NULL, 20, NULL, &loop_task_control);
+    return ESP_OK;
+}
+
+esp_err_t esp_event_handler_instance_register(esp_event_base_t base, int32_t id, esp_event_handler_t handler, void *arg,
+                                              esp_event_handler_instance_t *instance)
+{
+    struct handler *h = calloc(1, sizeof(*h));
+    if (h == NULL){return ESP_ERR_NO_MEM;}
+    h->base = base;
+    h->id = id;
+    h->handler = handler;
+    h->arg = arg;
+    shim_lock();
+    if (!loop_created){
+        shim_unlock();
+        free(h);
+        return ESP_ERR_INVALID_STATE;
+    }
+    // Appended, so that handlers run in the order they were registered
+    struct handler **tail = &handlers;
+    while (*tail != NULL){tail = &(*tail)->next;}
+    *tail = h;
+    shim_unlock();
+    if (instance != NULL){*instance = h;}
+    return ESP_OK;
+}
+
+esp_err_t esp_event_handler_register(esp_event_base_t base, int32_t id, esp_event_handler_t handler, void *arg)
+{
+    return esp_event_handler_instance_register(base, id, handler, arg, NULL);
+}
+
+esp_err_t esp_event_handler_instance_unregister(esp_event_base_t base, int32_t id,
+                                                esp_event_handler_instance_t instance)
+{
+    (void)base;
+    (void)id;
+    if (instance == NULL){return ESP_ERR_INVALID_ARG;}
+    shim_lock();
+    ((struct handler *)instance)->handler = NULL;
+    shim_unlock();
+    return ESP_OK;
+}
+
+esp_err_t esp_event_post(esp_event_base_t base, int32_t id, const void *data, size_t size, TickType_t ticks)
+{
+    (void)ticks;
+    struct event *event = malloc(sizeof(*event) + size);
+    if (event == NULL){return ESP_ERR_NO_MEM;}
+    event->base = base;
+    event->id = id;
+    event->next = NULL;
+    event->size = data != NULL ? size : 0;
+    if (event->size > 0){memcpy(event->data, data, size);}
+    shim_lock();
+    if (!loop_created){
+        shim_unlock();
+        free(event);
+        return ESP_ERR_INVALID_STATE;
+    }
+    *events_tail = event;
+    events_tail = &event->next;
+    shim_wake(&events);
+    shim_unlock();
+    return ESP_OK;
+}
@@ -0,0 +1,92 @@
+#include <stdlib.h>
+#include <string.h>
+#include "esp_partition.h"
+
+#define SECTOR_SIZE 4096
+
+// The data partitions of partitions.csv, at the offsets the partition tool gives them
+static const esp_partition_t partitions[] = {
+    {.type = ESP_PARTITION_TYPE_DATA, .subtype = ESP_PARTITION_SUBTYPE_DATA_NVS, .address = 0x9000, .size = 0x6000,
+     .erase_size = SECTOR_SIZE, .label = "nvs"},
+    {.type = ESP_PARTITION_TYPE_DATA, .subtype = ESP_PARTITION_SUBTYPE_DATA_FAT, .address = 0x210000, .size = 0x4000,
+     .erase_size = SECTOR_SIZE, .label = "zb_storage"},
+    {.type = ESP_PARTITION_TYPE_DATA, .subtype = ESP_PARTITION_SUBTYPE_DATA_FAT, .address = 0x214000, .size = 0x400,
+     .erase_size = SECTOR_SIZE, .label = "zb_fct"},
+    {.type = ESP_PARTITION_TYPE_DATA, .subtype = 0x40, .address = 0x215000, .size = 0x100000,
+     .erase_size = SECTOR_SIZE, .label = "tslog"},
+};
+
+#define N_PARTITIONS (sizeof(partitions) / sizeof(partitions[0]))
+
+static uint8_t *contents[N_PARTITIONS];
+
+static uint8_t *contents_of(const esp_partition_t *partition)
+{
+    size_t i = partition - partitions;
+    if (contents[i] == NULL){
+        contents[i] = malloc(partition->size);
+        memset(contents[i], 0xff, partition->size);
+    }
+    return contents[i];
+}
+
+static bool in_range(const esp_partition_t *partition, size_t offset, size_t size)
+{
+    return offset <= partition->size && size <= partition->size - offset;
+}
+
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype,
+                                                const char *label)
+{
+    for (size_t i = 0; i < N_PARTITIONS; i++){
+        const esp_partition_t *p = &partitions[i];
+        if ((type == ESP_PARTITION_TYPE_ANY || p->type == type) &&
+            (subtype == ESP_PARTITION_SUBTYPE_ANY || p->subtype == subtype) &&
+            (label == NULL || strcmp(p->label, label) == 0)){
+            return p;
+        }
+    }
+    return NULL;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t *partition, size_t src_offset, void *dst, size_t size)
+{
+    if (!in_range(partition, src_offset, size)){return ESP_ERR_INVALID_SIZE;}
+    memcpy(dst, contents_of(partition) + src_offset, size);
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_write(const esp_partition_t *partition, size_t dst_offset, const void *src, size_t size)
+{
+    if (!in_range(partition, dst_offset, size)){return ESP_ERR_INVALID_SIZE;}
+    uint8_t *dst = contents_of(partition) + dst_offset;
+    const uint8_t *s = src;
+    for (size_t i = 0; i < size; i++){
+        dst[i] &= s[i];
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t *partition, size_t offset, size_t size)
+{
+    if (offset % partition->erase_size != 0 || size % partition->erase_size != 0){return ESP_ERR_INVALID_ARG;}
+    if (!in_range(partition, offset, size)){return ESP_ERR_INVALID_SIZE;}
+    memset(contents_of(partition) + offset, 0xff, size);
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_mmap(const esp_partition_t *partition, size_t offset, size_t size,
+                             esp_partition_mmap_memory_t memory, const void **out_ptr,
+                             esp_partition_mmap_handle_t *out_handle)
+{
+    (void)memory;
+    if (!in_range(partition, offset, size)){return ESP_ERR_INVALID_ARG;}
+    *out_ptr = contents_of(partition) + offset;
+    *out_handle = partition - partitions + 1;
+    return ESP_OK;
+}
+
+void esp_partition_munmap(esp_partition_mmap_handle_t handle)
+{
+    (void)handle;
+}
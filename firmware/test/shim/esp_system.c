@@ -0,0 +1,179 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_err.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_mac.h"
+#include "esp_random.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "kernel.h"
+
+static vprintf_like_t log_vprintf = vprintf;
+static esp_log_level_t log_level = ESP_LOG_INFO;  // CONFIG_LOG_DEFAULT_LEVEL of sdkconfig
+
+const char *esp_err_to_name(esp_err_t code)
+{
+    switch (code){
+    case ESP_OK: return "ESP_OK";
+    case ESP_FAIL: return "ESP_FAIL";
+    case ESP_ERR_NO_MEM: return "ESP_ERR_NO_MEM";
+    case ESP_ERR_INVALID_ARG: return "ESP_ERR_INVALID_ARG";
+    case ESP_ERR_INVALID_STATE: return "ESP_ERR_INVALID_STATE";
+    case ESP_ERR_INVALID_SIZE: return "ESP_ERR_INVALID_SIZE";
+    case ESP_ERR_NOT_FOUND: return "ESP_ERR_NOT_FOUND";
+    case ESP_ERR_NOT_SUPPORTED: return "ESP_ERR_NOT_SUPPORTED";
+    case ESP_ERR_TIMEOUT: return "ESP_ERR_TIMEOUT";
+    case ESP_ERR_INVALID_RESPONSE: return "ESP_ERR_INVALID_RESPONSE";
+    case ESP_ERR_INVALID_CRC: return "ESP_ERR_INVALID_CRC";
+    case ESP_ERR_INVALID_VERSION: return "ESP_ERR_INVALID_VERSION";
+    case ESP_ERR_NOT_FINISHED: return "ESP_ERR_NOT_FINISHED";
+    case ESP_ERR_NVS_NOT_INITIALIZED: return "ESP_ERR_NVS_NOT_INITIALIZED";
+    case ESP_ERR_NVS_NOT_FOUND: return "ESP_ERR_NVS_NOT_FOUND";
+    case ESP_ERR_NVS_TYPE_MISMATCH: return "ESP_ERR_NVS_TYPE_MISMATCH";
+    case ESP_ERR_NVS_READ_ONLY: return "ESP_ERR_NVS_READ_ONLY";
+    case ESP_ERR_NVS_INVALID_HANDLE: return "ESP_ERR_NVS_INVALID_HANDLE";
+    case ESP_ERR_NVS_INVALID_NAME: return "ESP_ERR_NVS_INVALID_NAME";
+    case ESP_ERR_NVS_INVALID_LENGTH: return "ESP_ERR_NVS_INVALID_LENGTH";
+    case ESP_ERR_NVS_NO_FREE_PAGES: return "ESP_ERR_NVS_NO_FREE_PAGES";
+    case ESP_ERR_NVS_NEW_VERSION_FOUND: return "ESP_ERR_NVS_NEW_VERSION_FOUND";
+    default: return "UNKNOWN ERROR";
+    }
+}
+
+vprintf_like_t esp_log_set_vprintf(vprintf_like_t func)
+{
+    vprintf_like_t previous = log_vprintf;
+    log_vprintf = func;
+    return previous;
+}
+
+void esp_log_level_set(const char *tag, esp_log_level_t level)
+{
+    if (strcmp(tag, "*") == 0){log_level = level;}
+}
+
+uint32_t esp_log_timestamp(void)
+{
+    return shim_now_us() / 1000;
+}
+
+void esp_log_write(esp_log_level_t level, const char *tag, const char *format, ...)
+{
+    (void)tag;
+    if (level > log_level){return;}
+    va_list args;
+    va_start(args, format);
+    log_vprintf(format, args);
+    va_end(args);
+}
+
+int64_t esp_timer_get_time(void)
+{
+    return shim_now_us();
+}
+
+esp_err_t esp_efuse_mac_get_default(uint8_t *mac)
+{
+    static const uint8_t fixed[6] = {0x02, 0x00, 0x00, 0xc0, 0xff, 0xee};
+    memcpy(mac, fixed, sizeof(fixed));
+    return ESP_OK;
+}
+
+esp_err_t esp_read_mac(uint8_t *mac, esp_mac_type_t type)
+{
+    esp_efuse_mac_get_default(mac);
+    mac[5] += type;
+    return ESP_OK;
+}
+
+__attribute__((weak)) uint32_t esp_random(void)
+{
+    // xorshift32
+    static uint32_t state = 0x2545f491;
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+#define MAX_SHUTDOWN_HANDLERS 5
+
+static shutdown_handler_t shutdown_handlers[MAX_SHUTDOWN_HANDLERS];
+
+esp_err_t esp_register_shutdown_handler(shutdown_handler_t handler)
+{
+    for (int i = 0; i < MAX_SHUTDOWN_HANDLERS; i++){
+        if (shutdown_handlers[i] == handler){return ESP_ERR_INVALID_STATE;}
+        if (shutdown_handlers[i] == NULL){
+            shutdown_handlers[i] = handler;
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NO_MEM;
+}
+
+esp_err_t esp_unregister_shutdown_handler(shutdown_handler_t handler)
+{
+    for (int i = 0; i < MAX_SHUTDOWN_HANDLERS; i++){
+        if (shutdown_handlers[i] == handler){
+            shutdown_handlers[i] = NULL;
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_INVALID_STATE;
+}
+
+void esp_restart(void)
+{
+    for (int i = MAX_SHUTDOWN_HANDLERS - 1; i >= 0; i--){
+        if (shutdown_handlers[i] != NULL){shutdown_handlers[i]();}
+    }
+    exit(0);
+}
+
+uint32_t esp_get_free_heap_size(void)
+{
+    return SHIM_HEAP_FREE_BYTES;
+}
+
+uint32_t esp_get_minimum_free_heap_size(void)
+{
+    return SHIM_HEAP_FREE_BYTES;
+}
+
+void *heap_caps_malloc(size_t size, uint32_t caps)
+{
+    (void)caps;
+    return malloc(size);
+}
+
+void *heap_caps_calloc(size_t n, size_t size, uint32_t caps)
+{
+    (void)caps;
+    return calloc(n, size);
+}
+
+void heap_caps_free(void *ptr)
+{
+    free(ptr);
+}
+
+size_t heap_caps_get_free_size(uint32_t caps)
+{
+    (void)caps;
+    return SHIM_HEAP_FREE_BYTES;
+}
+
+size_t heap_caps_get_minimum_free_size(uint32_t caps)
+{
+    (void)caps;
+    return SHIM_HEAP_FREE_BYTES;
+}
+
+size_t heap_caps_get_largest_free_block(uint32_t caps)
+{
+    (void)caps;
+    return SHIM_HEAP_FREE_BYTES / 2;
+}
@@ -0,0 +1,134 @@
+#include <stdlib.h>
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "kernel.h"
+
+struct esp_timer {
+    esp_timer_cb_t callback;
+    void *arg;
+    bool skip_unhandled_events;
+    int64_t alarm_us;    // Virtual time of the next call, or -1 if the timer is stopped
+    uint64_t period_us;  // 0 for a one shot timer
+    struct esp_timer *next;
+};
+
+// All timers. The timer task waits on this list, for the earliest alarm.
+static struct esp_timer *timers = NULL;
+static StaticTask_t timer_task_control;
+static bool timer_task_started = false;
+
+static struct esp_timer *earliest(void)
+{
+    struct esp_timer *first = NULL;
+    for (struct esp_timer *t = timers; t != NULL; t = t->next){
+        if (t->alarm_us >= 0 && (first == NULL || t->alarm_us < first->alarm_us)){first = t;}
+    }
+    return first;
+}
+
+static void timer_task(void *arg)
+{
+    (void)arg;
+    shim_lock();
+    while (1){
+        struct esp_timer *due = earliest();
+        if (due == NULL || due->alarm_us > shim_now_us()){
+            shim_block(&timers, due != NULL ? due->alarm_us : -1);
+            continue;
+        }
+        if (due->period_us > 0){
+            due->alarm_us += due->period_us;
+            if (due->skip_unhandled_events && due->alarm_us <= shim_now_us()){
+                due->alarm_us = shim_now_us() + due->period_us;
+            }
+        } else {
+            due->alarm_us = -1;
+        }
+        esp_timer_cb_t callback = due->callback;
+        void *callback_arg = due->arg;
+        shim_unlock();
+        callback(callback_arg);
+        shim_lock();
+    }
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *args, esp_timer_handle_t *handle)
+{
+    if (args == NULL || args->callback == NULL || handle == NULL){return ESP_ERR_INVALID_ARG;}
+    struct esp_timer *timer = calloc(1, sizeof(*timer));
+    if (timer == NULL){return ESP_ERR_NO_MEM;}
+    timer->callback = args->callback;
+    timer->arg = args->arg;
+    timer->skip_unhandled_events = args->skip_unhandled_events;
+    timer->alarm_us = -1;
+
+    shim_lock();
+    bool first = !timer_task_started;
+    timer_task_started = true;
+    timer->next = timers;
+    timers = timer;
+    shim_unlock();
+    if (first){
+        xTaskCreateStatic(timer_task, "esp_timer", 3584, NULL, 22, NULL, &timer_task_control);
+    }
+    *handle = timer;
+    return ESP_OK;
+}
+
+static esp_err_t start(esp_timer_handle_t timer, uint64_t timeout_us, uint64_t period_us)
+{
+    shim_lock();
+    esp_err_t err = timer->alarm_us < 0 ? ESP_OK : ESP_ERR_INVALID_STATE;
+    if (err == ESP_OK){
+        timer->alarm_us = shim_now_us() + timeout_us;
+        timer->period_us = period_us;
+        shim_wake(&timers);
+    }
+    shim_unlock();
+    return err;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us)
+{
+    return start(timer, timeout_us, 0);
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period_us)
+{
+    return start(timer, period_us, period_us);
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer)
+{
+    shim_lock();
+    esp_err_t err = timer->alarm_us >= 0 ? ESP_OK : ESP_ERR_INVALID_STATE;
+    timer->alarm_us = -1;
+    shim_wake(&timers);
+    shim_unlock();
+    return err;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t timer)
+{
+    shim_lock();
+    esp_err_t err = timer->alarm_us < 0 ? ESP_OK : ESP_ERR_INVALID_STATE;
+    if (err == ESP_OK){
+        for (struct esp_timer **t = &timers; *t != NULL; t = &(*t)->next){
+            if (*t == timer){
+                *t = timer->next;
+                break;
+            }
+        }
+    }
+    shim_unlock();
+    if (err == ESP_OK){free(timer);}
+    return err;
+}
+
+bool esp_timer_is_active(esp_timer_handle_t timer)
+{
+    shim_lock();
+    bool active = timer->alarm_us >= 0;
+    shim_unlock();
+    return active;
+}
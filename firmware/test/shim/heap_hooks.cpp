@@ -0,0 +1,89 @@
+#include <stdlib.h>
+#include <new>
+#include "esp_heap_caps.h"
+
+/*
+The heap hooks of ESP-IDF (CONFIG_HEAP_USE_HOOKS) on the host. Every allocation of C++ and, with the malloc family
+wrapped by the linker (see test/CMakeLists.txt), of the C code of the program calls esp_heap_trace_alloc_hook(), which
+the program must define, as on the target. Allocations inside the host's C library are not seen.
+*/
+
+extern "C" {
+void esp_heap_trace_alloc_hook(void *ptr, size_t size, uint32_t caps);
+void esp_heap_trace_free_hook(void *ptr);
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t n, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+void __real_free(void *ptr);
+
+void *__wrap_malloc(size_t size)
+{
+    void *ptr = __real_malloc(size);
+    if (ptr != NULL){esp_heap_trace_alloc_hook(ptr, size, MALLOC_CAP_DEFAULT);}
+    return ptr;
+}
+
+void *__wrap_calloc(size_t n, size_t size)
+{
+    void *ptr = __real_calloc(n, size);
+    if (ptr != NULL){esp_heap_trace_alloc_hook(ptr, n * size, MALLOC_CAP_DEFAULT);}
+    return ptr;
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+    if (ptr != NULL){esp_heap_trace_free_hook(ptr);}
+    void *moved = __real_realloc(ptr, size);
+    if (moved != NULL){esp_heap_trace_alloc_hook(moved, size, MALLOC_CAP_DEFAULT);}
+    return moved;
+}
+
+void __wrap_free(void *ptr)
+{
+    if (ptr != NULL){esp_heap_trace_free_hook(ptr);}
+    __real_free(ptr);
+}
+}
+
+void *operator new(size_t size)
+{
+    void *ptr = __wrap_malloc(size > 0 ? size : 1);
+    if (ptr == NULL){throw std::bad_alloc();}
+    return ptr;
+}
+
+void *operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept
+{
+    return __wrap_malloc(size > 0 ? size : 1);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) noexcept
+{
+    return __wrap_malloc(size > 0 ? size : 1);
+}
+
+void operator delete(void *ptr) noexcept
+{
+    __wrap_free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept
+{
+    __wrap_free(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept
+{
+    __wrap_free(ptr);
+}
+
+void operator delete[](void *ptr, size_t) noexcept
+{
+    __wrap_free(ptr);
+}
@@ -0,0 +1,20 @@
+#ifndef _SHIM_GPIO_H
+#define _SHIM_GPIO_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// The pins the firmware names. Nothing drives them on the host.
+typedef enum {
+    GPIO_NUM_NC = -1,
+    GPIO_NUM_8 = 8,
+    GPIO_NUM_18 = 18,
+    GPIO_NUM_20 = 20,
+} gpio_num_t;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
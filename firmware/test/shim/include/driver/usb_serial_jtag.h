@@ -0,0 +1,25 @@
+#ifndef _SHIM_USB_SERIAL_JTAG_H
+#define _SHIM_USB_SERIAL_JTAG_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    uint32_t tx_buffer_size;
+    uint32_t rx_buffer_size;
+} usb_serial_jtag_driver_config_t;
+
+// Not part of the shims: defined by each host program, as the host end of the port that it simulates
+int usb_serial_jtag_write_bytes(const void *src, size_t size, TickType_t ticks_to_wait);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,9 @@
+#ifndef _SHIM_ESP_ATTR_H
+#define _SHIM_ESP_ATTR_H
+
+// The host has no IRAM: code placement attributes are ignored
+#define IRAM_ATTR
+#define DRAM_ATTR
+#define RTC_DATA_ATTR
+
+#endif
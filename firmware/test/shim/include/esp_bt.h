@@ -0,0 +1,35 @@
+#ifndef _SHIM_ESP_BT_H
+#define _SHIM_ESP_BT_H
+
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    ESP_BT_MODE_IDLE = 0x00,
+    ESP_BT_MODE_BLE = 0x01,
+    ESP_BT_MODE_CLASSIC_BT = 0x02,
+    ESP_BT_MODE_BTDM = 0x03,
+} esp_bt_mode_t;
+
+typedef struct {
+    uint32_t config_magic;
+} esp_bt_controller_config_t;
+
+#define BT_CONTROLLER_INIT_CONFIG_DEFAULT() {.config_magic = 0x5A5AA5A5}
+
+// The controller only keeps its state: idle, initialised or enabled, as the device checks it
+esp_err_t esp_bt_controller_mem_release(esp_bt_mode_t mode);
+esp_err_t esp_bt_controller_init(esp_bt_controller_config_t *cfg);
+esp_err_t esp_bt_controller_deinit(void);
+esp_err_t esp_bt_controller_enable(esp_bt_mode_t mode);
+esp_err_t esp_bt_controller_disable(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,31 @@
+#ifndef _SHIM_ESP_BT_DEFS_H
+#define _SHIM_ESP_BT_DEFS_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    ESP_BT_STATUS_SUCCESS = 0,
+    ESP_BT_STATUS_FAIL,
+    ESP_BT_STATUS_NOT_READY,
+    ESP_BT_STATUS_BUSY = 0x0a,
+} esp_bt_status_t;
+
+#define ESP_BD_ADDR_LEN 6
+typedef uint8_t esp_bd_addr_t[ESP_BD_ADDR_LEN];
+
+typedef enum {
+    BLE_ADDR_TYPE_PUBLIC = 0x00,
+    BLE_ADDR_TYPE_RANDOM = 0x01,
+    BLE_ADDR_TYPE_RPA_PUBLIC = 0x02,
+    BLE_ADDR_TYPE_RPA_RANDOM = 0x03,
+} esp_ble_addr_type_t;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,20 @@
+#ifndef _SHIM_ESP_BT_MAIN_H
+#define _SHIM_ESP_BT_MAIN_H
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Enabling Bluedroid starts the "BTC_TASK" task, which calls the GAP callback. Needs the controller enabled.
+esp_err_t esp_bluedroid_init(void);
+esp_err_t esp_bluedroid_deinit(void);
+esp_err_t esp_bluedroid_enable(void);
+esp_err_t esp_bluedroid_disable(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,33 @@
+#ifndef _SHIM_ESP_CPU_H
+#define _SHIM_ESP_CPU_H
+
+#include <stdint.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef uint32_t esp_cpu_cycle_count_t;
+
+// The time stamp counter on x86, which counts at the nominal clock of the CPU rather than its actual cycles.
+// Nanoseconds of the monotonic clock elsewhere.
+static inline esp_cpu_cycle_count_t esp_cpu_get_cycle_count(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return (esp_cpu_cycle_count_t)__rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (esp_cpu_cycle_count_t)((uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec);
+#endif
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
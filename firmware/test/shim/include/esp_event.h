@@ -0,0 +1,37 @@
+#ifndef _SHIM_ESP_EVENT_H
+#define _SHIM_ESP_EVENT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef const char *esp_event_base_t;
+typedef void *esp_event_handler_instance_t;
+typedef void (*esp_event_handler_t)(void *event_handler_arg, esp_event_base_t event_base, int32_t event_id,
+                                    void *event_data);
+
+#define ESP_EVENT_DECLARE_BASE(id) extern esp_event_base_t const id
+#define ESP_EVENT_DEFINE_BASE(id) esp_event_base_t const id = #id
+#define ESP_EVENT_ANY_BASE NULL
+#define ESP_EVENT_ANY_ID -1
+
+// Only the default loop. Its handlers run in the "sys_evt" task, in the order the events were posted. The queue of
+// the loop has no limit, so a post never waits.
+esp_err_t esp_event_loop_create_default(void);
+esp_err_t esp_event_handler_register(esp_event_base_t base, int32_t id, esp_event_handler_t handler, void *arg);
+esp_err_t esp_event_handler_instance_register(esp_event_base_t base, int32_t id, esp_event_handler_t handler, void *arg,
+                                              esp_event_handler_instance_t *instance);
+esp_err_t esp_event_handler_instance_unregister(esp_event_base_t base, int32_t id,
+                                                esp_event_handler_instance_t instance);
+esp_err_t esp_event_post(esp_event_base_t base, int32_t id, const void *data, size_t size, TickType_t ticks);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,98 @@
+#ifndef _SHIM_ESP_GAP_BLE_API_H
+#define _SHIM_ESP_GAP_BLE_API_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_bt_defs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ESP_BLE_ADV_DATA_LEN_MAX 31
+#define ESP_BLE_SCAN_RSP_DATA_LEN_MAX 31
+
+typedef enum {
+    ESP_GAP_BLE_ADV_DATA_RAW_SET_COMPLETE_EVT = 4,
+    ESP_GAP_BLE_SCAN_RSP_DATA_RAW_SET_COMPLETE_EVT = 5,
+    ESP_GAP_BLE_ADV_START_COMPLETE_EVT = 6,
+    ESP_GAP_BLE_ADV_STOP_COMPLETE_EVT = 17,
+} esp_gap_ble_cb_event_t;
+
+typedef enum {
+    ADV_TYPE_IND = 0x00,
+    ADV_TYPE_DIRECT_IND_HIGH = 0x01,
+    ADV_TYPE_SCAN_IND = 0x02,
+    ADV_TYPE_NONCONN_IND = 0x03,
+    ADV_TYPE_DIRECT_IND_LOW = 0x04,
+} esp_ble_adv_type_t;
+
+typedef enum {
+    ADV_CHNL_37 = 0x01,
+    ADV_CHNL_38 = 0x02,
+    ADV_CHNL_39 = 0x04,
+    ADV_CHNL_ALL = 0x07,
+} esp_ble_adv_channel_t;
+
+typedef enum {
+    ADV_FILTER_ALLOW_SCAN_ANY_CON_ANY = 0x00,
+    ADV_FILTER_ALLOW_SCAN_WLST_CON_ANY,
+    ADV_FILTER_ALLOW_SCAN_ANY_CON_WLST,
+    ADV_FILTER_ALLOW_SCAN_WLST_CON_WLST,
+} esp_ble_adv_filter_t;
+
+typedef struct {
+    uint16_t adv_int_min;
+    uint16_t adv_int_max;
+    esp_ble_adv_type_t adv_type;
+    esp_ble_addr_type_t own_addr_type;
+    esp_bd_addr_t peer_addr;
+    esp_ble_addr_type_t peer_addr_type;
+    esp_ble_adv_channel_t channel_map;
+    esp_ble_adv_filter_t adv_filter_policy;
+} esp_ble_adv_params_t;
+
+typedef union {
+    struct ble_adv_data_raw_cmpl_evt_param {
+        esp_bt_status_t status;
+    } adv_data_raw_cmpl;
+    struct ble_scan_rsp_data_raw_cmpl_evt_param {
+        esp_bt_status_t status;
+    } scan_rsp_data_raw_cmpl;
+    struct ble_adv_start_cmpl_evt_param {
+        esp_bt_status_t status;
+    } adv_start_cmpl;
+    struct ble_adv_stop_cmpl_evt_param {
+        esp_bt_status_t status;
+    } adv_stop_cmpl;
+} esp_ble_gap_cb_param_t;
+
+typedef void (*esp_gap_ble_cb_t)(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t *param);
+
+// Each call completes with its event, which the "BTC_TASK" task passes to the callback, as on the device. Starting
+// while advertising completes with ESP_BT_STATUS_FAIL.
+esp_err_t esp_ble_gap_register_callback(esp_gap_ble_cb_t callback);
+esp_err_t esp_ble_gap_config_adv_data_raw(uint8_t *raw_data, uint32_t raw_data_len);
+esp_err_t esp_ble_gap_config_scan_rsp_data_raw(uint8_t *raw_data, uint32_t raw_data_len);
+esp_err_t esp_ble_gap_start_advertising(esp_ble_adv_params_t *adv_params);
+esp_err_t esp_ble_gap_stop_advertising(void);
+
+// What the controller did since the start of the host program
+struct shim_gap_stats {
+    uint32_t adv_data_sets;
+    uint32_t starts;
+    uint32_t failed_starts;
+    uint32_t stops;
+    bool advertising;
+    int64_t advertising_us;                      // Time spent advertising, up to now
+    uint8_t adv_data[ESP_BLE_ADV_DATA_LEN_MAX];  // Data of the adverts
+    uint8_t adv_data_len;
+};
+void shim_gap_get_stats(struct shim_gap_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
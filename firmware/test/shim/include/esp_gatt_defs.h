@@ -0,0 +1,6 @@
+#ifndef _SHIM_ESP_GATT_DEFS_H
+#define _SHIM_ESP_GATT_DEFS_H
+
+// Included by main/ble/ble.cpp, which uses none of it
+
+#endif
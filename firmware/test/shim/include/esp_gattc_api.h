@@ -0,0 +1,6 @@
+#ifndef _SHIM_ESP_GATTC_API_H
+#define _SHIM_ESP_GATTC_API_H
+
+// Included by main/ble/ble.cpp, which uses none of it
+
+#endif
@@ -0,0 +1,27 @@
+#ifndef _SHIM_ESP_MAC_H
+#define _SHIM_ESP_MAC_H
+
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    ESP_MAC_WIFI_STA,
+    ESP_MAC_WIFI_SOFTAP,
+    ESP_MAC_BT,
+    ESP_MAC_ETH,
+    ESP_MAC_IEEE802154,
+} esp_mac_type_t;
+
+// A fixed MAC address, 02:00:00:c0:ff:ee plus the type for esp_read_mac()
+esp_err_t esp_efuse_mac_get_default(uint8_t *mac);
+esp_err_t esp_read_mac(uint8_t *mac, esp_mac_type_t type);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
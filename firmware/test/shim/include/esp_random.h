@@ -0,0 +1,17 @@
+#ifndef _SHIM_ESP_RANDOM_H
+#define _SHIM_ESP_RANDOM_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Pseudo-random, the same sequence in every run. Weak, so that a host program can define its own.
+uint32_t esp_random(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
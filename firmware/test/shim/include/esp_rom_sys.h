@@ -0,0 +1,17 @@
+#ifndef _SHIM_ESP_ROM_SYS_H
+#define _SHIM_ESP_ROM_SYS_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Busy wait. On the host the calling task waits in the kernel until the virtual clock has moved 'us' on.
+void esp_rom_delay_us(uint32_t us);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
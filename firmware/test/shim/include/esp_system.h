@@ -0,0 +1,26 @@
+#ifndef _SHIM_ESP_SYSTEM_H
+#define _SHIM_ESP_SYSTEM_H
+
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef void (*shutdown_handler_t)(void);
+
+esp_err_t esp_register_shutdown_handler(shutdown_handler_t handler);
+esp_err_t esp_unregister_shutdown_handler(shutdown_handler_t handler);
+
+// Runs the shutdown handlers, latest registered first, and ends the host program
+void esp_restart(void) __attribute__((noreturn));
+
+uint32_t esp_get_free_heap_size(void);
+uint32_t esp_get_minimum_free_heap_size(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,374 @@
+#ifndef _SHIM_ESP_ZIGBEE_CORE_H
+#define _SHIM_ESP_ZIGBEE_CORE_H
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+
+/*
+Zigbee stack of the host builds: the part of the esp-zigbee-lib API the firmware uses. Endpoints, clusters and
+attributes are kept in lists as the firmware builds them, and the ZCL keeps the attribute values, which
+esp_zb_zcl_get_attribute() reads back. There is no radio: esp_zb_stack_main_loop() passes the signals of a start
+and of a network steering that always succeeds to esp_zb_app_signal_handler(), runs the scheduler alarms on the
+virtual clock, and never returns.
+
+As on the device, the ZCL must only be used with the Zigbee lock held, and the shim aborts if it is not.
+*/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef uint8_t esp_zb_ieee_addr_t[8];
+typedef void (*esp_zb_callback_t)(uint8_t param);
+
+// Platform
+
+typedef enum {
+    ZB_RADIO_MODE_NATIVE = 0x0,
+    ZB_RADIO_MODE_UART_RCP = 0x1,
+} esp_zb_radio_mode_t;
+
+typedef enum {
+    ZB_HOST_CONNECTION_MODE_NONE = 0x0,
+    ZB_HOST_CONNECTION_MODE_CLI_UART = 0x1,
+    ZB_HOST_CONNECTION_MODE_RCP_UART = 0x2,
+} esp_zb_host_connection_mode_t;
+
+typedef struct {
+    esp_zb_radio_mode_t radio_mode;
+} esp_zb_radio_config_t;
+
+typedef struct {
+    esp_zb_host_connection_mode_t host_connection_mode;
+} esp_zb_host_config_t;
+
+typedef struct {
+    esp_zb_radio_config_t radio_config;
+    esp_zb_host_config_t host_config;
+} esp_zb_platform_config_t;
+
+// Network
+
+typedef enum {
+    ESP_ZB_DEVICE_TYPE_COORDINATOR = 0x0,
+    ESP_ZB_DEVICE_TYPE_ROUTER = 0x1,
+    ESP_ZB_DEVICE_TYPE_ED = 0x2,
+    ESP_ZB_DEVICE_TYPE_NONE = 0x3,
+} esp_zb_nwk_device_type_t;
+
+typedef enum {
+    ESP_ZB_ED_AGING_TIMEOUT_10SEC = 0,
+    ESP_ZB_ED_AGING_TIMEOUT_2MIN,
+    ESP_ZB_ED_AGING_TIMEOUT_4MIN,
+    ESP_ZB_ED_AGING_TIMEOUT_8MIN,
+    ESP_ZB_ED_AGING_TIMEOUT_16MIN,
+    ESP_ZB_ED_AGING_TIMEOUT_32MIN,
+    ESP_ZB_ED_AGING_TIMEOUT_64MIN,
+} esp_zb_aging_timeout_t;
+
+typedef struct {
+    uint8_t max_children;
+} esp_zb_zczr_cfg_t;
+
+typedef struct {
+    uint8_t ed_timeout;
+    uint32_t keep_alive;
+} esp_zb_zed_cfg_t;
+
+typedef struct {
+    esp_zb_nwk_device_type_t esp_zb_role;
+    bool install_code_policy;
+    union {
+        esp_zb_zczr_cfg_t zczr_cfg;
+        esp_zb_zed_cfg_t zed_cfg;
+    } nwk_cfg;
+} esp_zb_cfg_t;
+
+#define ESP_ZB_TRANSCEIVER_ALL_CHANNELS_MASK 0x07FFF800U
+
+// Signals
+
+typedef enum {
+    ESP_ZB_ZDO_SIGNAL_DEFAULT_START = 0x00,
+    ESP_ZB_ZDO_SIGNAL_SKIP_STARTUP = 0x01,
+    ESP_ZB_ZDO_SIGNAL_DEVICE_ANNCE = 0x02,
+    ESP_ZB_ZDO_SIGNAL_LEAVE = 0x03,
+    ESP_ZB_ZDO_SIGNAL_ERROR = 0x04,
+    ESP_ZB_BDB_SIGNAL_DEVICE_FIRST_START = 0x05,
+    ESP_ZB_BDB_SIGNAL_DEVICE_REBOOT = 0x06,
+    ESP_ZB_BDB_SIGNAL_STEERING = 0x0a,
+    ESP_ZB_BDB_SIGNAL_FORMATION = 0x0b,
+    ESP_ZB_COMMON_SIGNAL_CAN_SLEEP = 0x16,
+} esp_zb_app_signal_type_t;
+
+typedef struct {
+    uint32_t *p_app_signal;
+    esp_err_t esp_err_status;
+} esp_zb_app_signal_t;
+
+#define ESP_ZB_BDB_MODE_INITIALIZATION 0
+#define ESP_ZB_BDB_MODE_TOUCHLINK_COMMISSIONING 1
+#define ESP_ZB_BDB_MODE_NETWORK_STEERING 2
+#define ESP_ZB_BDB_MODE_NETWORK_FORMATION 4
+
+// Defined by the application
+void esp_zb_app_signal_handler(esp_zb_app_signal_t *signal_s);
+
+// ZCL
+
+#define ESP_ZB_AF_HA_PROFILE_ID 0x0104
+
+#define ESP_ZB_ZCL_CLUSTER_SERVER_ROLE 0x01
+#define ESP_ZB_ZCL_CLUSTER_CLIENT_ROLE 0x02
+
+#define ESP_ZB_ZCL_CMD_DIRECTION_TO_SRV 0x00
+#define ESP_ZB_ZCL_CMD_DIRECTION_TO_CLI 0x01
+
+#define ESP_ZB_ZCL_CLUSTER_ID_BASIC 0x0000
+#define ESP_ZB_ZCL_CLUSTER_ID_IDENTIFY 0x0003
+#define ESP_ZB_ZCL_CLUSTER_ID_ON_OFF 0x0006
+#define ESP_ZB_ZCL_CLUSTER_ID_LEVEL_CONTROL 0x0008
+#define ESP_ZB_ZCL_CLUSTER_ID_TEMP_MEASUREMENT 0x0402
+#define ESP_ZB_ZCL_CLUSTER_ID_REL_HUMIDITY_MEASUREMENT 0x0405
+#define ESP_ZB_ZCL_CLUSTER_ID_CARBON_DIOXIDE_MEASUREMENT 0x040D
+
+#define ESP_ZB_ZCL_ATTR_TYPE_BOOL 0x10
+#define ESP_ZB_ZCL_ATTR_TYPE_U8 0x20
+#define ESP_ZB_ZCL_ATTR_TYPE_U16 0x21
+#define ESP_ZB_ZCL_ATTR_TYPE_U32 0x23
+#define ESP_ZB_ZCL_ATTR_TYPE_S16 0x29
+#define ESP_ZB_ZCL_ATTR_TYPE_8BIT_ENUM 0x30
+#define ESP_ZB_ZCL_ATTR_TYPE_SINGLE 0x39
+#define ESP_ZB_ZCL_ATTR_TYPE_CHAR_STRING 0x42
+
+#define ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY 0x01
+#define ESP_ZB_ZCL_ATTR_ACCESS_WRITE_ONLY 0x02
+#define ESP_ZB_ZCL_ATTR_ACCESS_READ_WRITE 0x03
+#define ESP_ZB_ZCL_ATTR_ACCESS_REPORTING 0x04
+
+#define ESP_ZB_ZCL_ATTR_NON_MANUFACTURER_SPECIFIC 0xFFFF
+
+#define ESP_ZB_ZCL_ATTR_BASIC_ZCL_VERSION_ID 0x0000
+#define ESP_ZB_ZCL_ATTR_BASIC_MANUFACTURER_NAME_ID 0x0004
+#define ESP_ZB_ZCL_ATTR_BASIC_MODEL_IDENTIFIER_ID 0x0005
+#define ESP_ZB_ZCL_ATTR_BASIC_POWER_SOURCE_ID 0x0007
+#define ESP_ZB_ZCL_ATTR_IDENTIFY_IDENTIFY_TIME_ID 0x0000
+#define ESP_ZB_ZCL_ATTR_ON_OFF_ON_OFF_ID 0x0000
+#define ESP_ZB_ZCL_ATTR_LEVEL_CONTROL_CURRENT_LEVEL_ID 0x0000
+#define ESP_ZB_ZCL_ATTR_TEMP_MEASUREMENT_VALUE_ID 0x0000
+#define ESP_ZB_ZCL_ATTR_TEMP_MEASUREMENT_MIN_VALUE_ID 0x0001
+#define ESP_ZB_ZCL_ATTR_TEMP_MEASUREMENT_MAX_VALUE_ID 0x0002
+#define ESP_ZB_ZCL_ATTR_REL_HUMIDITY_MEASUREMENT_VALUE_ID 0x0000
+#define ESP_ZB_ZCL_ATTR_REL_HUMIDITY_MEASUREMENT_MIN_VALUE_ID 0x0001
+#define ESP_ZB_ZCL_ATTR_REL_HUMIDITY_MEASUREMENT_MAX_VALUE_ID 0x0002
+#define ESP_ZB_ZCL_ATTR_CARBON_DIOXIDE_MEASUREMENT_MEASURED_VALUE_ID 0x0000
+#define ESP_ZB_ZCL_ATTR_CARBON_DIOXIDE_MEASUREMENT_MIN_MEASURED_VALUE_ID 0x0001
+#define ESP_ZB_ZCL_ATTR_CARBON_DIOXIDE_MEASUREMENT_MAX_MEASURED_VALUE_ID 0x0002
+
+#define ESP_ZB_ZCL_BASIC_ZCL_VERSION_DEFAULT_VALUE ((uint8_t)0x08)
+#define ESP_ZB_ZCL_BASIC_POWER_SOURCE_DEFAULT_VALUE ((uint8_t)0x00)
+#define ESP_ZB_ZCL_IDENTIFY_IDENTIFY_TIME_DEFAULT_VALUE ((uint16_t)0x0000)
+#define ESP_ZB_ZCL_TEMP_MEASUREMENT_MEASURED_VALUE_DEFAULT ((int16_t)0xFFFF)
+#define ESP_ZB_ZCL_TEMP_MEASUREMENT_MIN_MEASURED_VALUE_DEFAULT ((int16_t)0x8000)
+#define ESP_ZB_ZCL_TEMP_MEASUREMENT_MAX_MEASURED_VALUE_DEFAULT ((int16_t)0x8000)
+#define ESP_ZB_ZCL_CARBON_DIOXIDE_MEASUREMENT_MEASURED_VALUE_DEFAULT (0.0f)
+#define ESP_ZB_ZCL_CARBON_DIOXIDE_MEASUREMENT_MIN_MEASURED_VALUE_DEFAULT (0.0f)
+#define ESP_ZB_ZCL_CARBON_DIOXIDE_MEASUREMENT_MAX_MEASURED_VALUE_DEFAULT (1.0f)
+
+typedef enum {
+    ESP_ZB_ZCL_STATUS_SUCCESS = 0x00,
+    ESP_ZB_ZCL_STATUS_FAIL = 0x01,
+    ESP_ZB_ZCL_STATUS_UNSUP_ATTRIB = 0x86,
+} esp_zb_zcl_status_t;
+
+typedef struct {
+    uint16_t id;
+    uint8_t type;
+    uint8_t access;
+    uint16_t manuf_code;
+    void *data_p;
+} esp_zb_zcl_attr_t;
+
+// The attributes of one cluster. The head of a list holds no attribute, only the cluster ID.
+typedef struct esp_zb_attribute_list_s {
+    esp_zb_zcl_attr_t attribute;
+    uint16_t cluster_id;
+    struct esp_zb_attribute_list_s *next;
+} esp_zb_attribute_list_t;
+
+// The clusters of one endpoint, after a head without cluster
+typedef struct esp_zb_cluster_list_s {
+    uint16_t cluster_id;
+    uint8_t role_mask;
+    esp_zb_attribute_list_t *attr_list;
+    struct esp_zb_cluster_list_s *next;
+} esp_zb_cluster_list_t;
+
+typedef struct {
+    uint8_t endpoint;
+    uint16_t app_profile_id;
+    uint16_t app_device_id;
+    uint32_t app_device_version;
+} esp_zb_endpoint_config_t;
+
+// The endpoints of a device, after a head without endpoint
+typedef struct esp_zb_ep_list_s {
+    esp_zb_endpoint_config_t config;
+    esp_zb_cluster_list_t *cluster_list;
+    struct esp_zb_ep_list_s *next;
+} esp_zb_ep_list_t;
+
+typedef struct {
+    uint8_t zcl_version;
+    uint8_t power_source;
+} esp_zb_basic_cluster_cfg_t;
+
+typedef struct {
+    uint16_t identify_time;
+} esp_zb_identify_cluster_cfg_t;
+
+typedef struct {
+    int16_t measured_value;
+    int16_t min_value;
+    int16_t max_value;
+} esp_zb_temperature_meas_cluster_cfg_t;
+
+typedef struct {
+    uint16_t measured_value;
+    uint16_t min_value;
+    uint16_t max_value;
+} esp_zb_humidity_meas_cluster_cfg_t;
+
+typedef struct {
+    float measured_value;
+    float min_measured_value;
+    float max_measured_value;
+} esp_zb_carbon_dioxide_measurement_cluster_cfg_t;
+
+typedef struct {
+    bool on_off;
+} esp_zb_on_off_cluster_cfg_t;
+
+typedef struct {
+    uint8_t current_level;
+} esp_zb_level_cluster_cfg_t;
+
+typedef union {
+    uint8_t u8;
+    int8_t s8;
+    uint16_t u16;
+    int16_t s16;
+    uint32_t u32;
+    int32_t s32;
+} esp_zb_zcl_attr_var_t;
+
+typedef struct {
+    uint8_t direction;
+    uint8_t ep;
+    uint16_t cluster_id;
+    uint8_t cluster_role;
+    uint16_t attr_id;
+    uint8_t flags;
+    uint64_t run_time;
+    union {
+        struct {
+            uint16_t min_interval;
+            uint16_t max_interval;
+            esp_zb_zcl_attr_var_t delta;
+            esp_zb_zcl_attr_var_t reported_value;
+            uint16_t def_min_interval;
+            uint16_t def_max_interval;
+        } send_info;
+        struct {
+            uint16_t timeout;
+        } recv_info;
+    } u;
+    struct {
+        uint16_t short_addr;
+        uint8_t endpoint;
+        uint16_t profile_id;
+    } dst;
+    uint16_t manuf_code;
+} esp_zb_zcl_reporting_info_t;
+
+esp_err_t esp_zb_platform_config(esp_zb_platform_config_t *config);
+void esp_zb_init(esp_zb_cfg_t *nwk_cfg);
+esp_err_t esp_zb_device_register(esp_zb_ep_list_t *ep_list);
+esp_err_t esp_zb_set_primary_network_channel_set(uint32_t channel_mask);
+esp_err_t esp_zb_start(bool autostart);
+void esp_zb_stack_main_loop(void) __attribute__((noreturn));
+bool esp_zb_lock_acquire(TickType_t block_ticks);
+void esp_zb_lock_release(void);
+
+esp_err_t esp_zb_bdb_start_top_level_commissioning(uint8_t mode_mask);
+bool esp_zb_bdb_is_factory_new(void);
+void esp_zb_get_extended_pan_id(esp_zb_ieee_addr_t ext_pan_id);
+uint16_t esp_zb_get_pan_id(void);
+uint8_t esp_zb_get_current_channel(void);
+uint16_t esp_zb_get_short_address(void);
+void esp_zb_scheduler_alarm(esp_zb_callback_t cb, uint8_t param, uint32_t time);
+const char *esp_zb_zdo_signal_to_string(esp_zb_app_signal_type_t signal);
+
+esp_zb_ep_list_t *esp_zb_ep_list_create(void);
+esp_err_t esp_zb_ep_list_add_ep(esp_zb_ep_list_t *ep_list, esp_zb_cluster_list_t *cluster_list,
+                                esp_zb_endpoint_config_t endpoint_config);
+esp_zb_cluster_list_t *esp_zb_zcl_cluster_list_create(void);
+esp_zb_attribute_list_t *esp_zb_zcl_attr_list_create(uint16_t cluster_id);
+
+esp_zb_attribute_list_t *esp_zb_basic_cluster_create(esp_zb_basic_cluster_cfg_t *basic_cfg);
+esp_zb_attribute_list_t *esp_zb_identify_cluster_create(esp_zb_identify_cluster_cfg_t *identify_cfg);
+esp_zb_attribute_list_t *esp_zb_temperature_meas_cluster_create(esp_zb_temperature_meas_cluster_cfg_t *temperature_cfg);
+esp_zb_attribute_list_t *esp_zb_humidity_meas_cluster_create(esp_zb_humidity_meas_cluster_cfg_t *humidity_cfg);
+esp_zb_attribute_list_t *esp_zb_carbon_dioxide_measurement_cluster_create(
+    esp_zb_carbon_dioxide_measurement_cluster_cfg_t *carbon_dioxide_cfg);
+esp_zb_attribute_list_t *esp_zb_on_off_cluster_create(esp_zb_on_off_cluster_cfg_t *on_off_cfg);
+esp_zb_attribute_list_t *esp_zb_level_cluster_create(esp_zb_level_cluster_cfg_t *level_cfg);
+
+esp_err_t esp_zb_basic_cluster_add_attr(esp_zb_attribute_list_t *attr_list, uint16_t attr_id, void *value_p);
+esp_err_t esp_zb_cluster_add_manufacturer_attr(esp_zb_attribute_list_t *attr_list, uint16_t cluster_id,
+                                               uint16_t attr_id, uint16_t manuf_code, uint8_t attr_type,
+                                               uint8_t attr_access, void *value_p);
+
+esp_err_t esp_zb_cluster_list_add_basic_cluster(esp_zb_cluster_list_t *cluster_list, esp_zb_attribute_list_t *attr_list,
+                                                uint8_t role_mask);
+esp_err_t esp_zb_cluster_list_add_identify_cluster(esp_zb_cluster_list_t *cluster_list,
+                                                   esp_zb_attribute_list_t *attr_list, uint8_t role_mask);
+esp_err_t esp_zb_cluster_list_add_temperature_meas_cluster(esp_zb_cluster_list_t *cluster_list,
+                                                           esp_zb_attribute_list_t *attr_list, uint8_t role_mask);
+esp_err_t esp_zb_cluster_list_add_humidity_meas_cluster(esp_zb_cluster_list_t *cluster_list,
+                                                        esp_zb_attribute_list_t *attr_list, uint8_t role_mask);
+esp_err_t esp_zb_cluster_list_add_carbon_dioxide_measurement_cluster(esp_zb_cluster_list_t *cluster_list,
+                                                                     esp_zb_attribute_list_t *attr_list,
+                                                                     uint8_t role_mask);
+esp_err_t esp_zb_cluster_list_add_on_off_cluster(esp_zb_cluster_list_t *cluster_list, esp_zb_attribute_list_t *attr_list,
+                                                 uint8_t role_mask);
+esp_err_t esp_zb_cluster_list_add_level_cluster(esp_zb_cluster_list_t *cluster_list, esp_zb_attribute_list_t *attr_list,
+                                                uint8_t role_mask);
+
+esp_err_t esp_zb_zcl_update_reporting_info(esp_zb_zcl_reporting_info_t *config);
+esp_zb_zcl_status_t esp_zb_zcl_set_attribute_val(uint8_t endpoint, uint16_t cluster_id, uint8_t cluster_role,
+                                                 uint16_t attr_id, void *value_p, bool check);
+esp_zb_zcl_status_t esp_zb_zcl_set_manufacturer_attribute_val(uint8_t endpoint, uint16_t cluster_id,
+                                                              uint8_t cluster_role, uint16_t manuf_code,
+                                                              uint16_t attr_id, void *value_p, bool check);
+esp_zb_zcl_attr_t *esp_zb_zcl_get_attribute(uint8_t endpoint, uint16_t cluster_id, uint8_t cluster_role,
+                                            uint16_t attr_id);
+esp_zb_zcl_attr_t *esp_zb_zcl_get_manufacturer_attribute(uint8_t endpoint, uint16_t cluster_id, uint8_t cluster_role,
+                                                         uint16_t attr_id, uint16_t manuf_code);
+
+// What the stack did since the start of the host program
+struct shim_zb_stats {
+    bool joined;                 // Network steering succeeded
+    uint32_t attribute_writes;   // Successful writes of attribute values
+    uint32_t reporting_infos;    // Reporting configurations
+};
+void shim_zb_get_stats(struct shim_zb_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
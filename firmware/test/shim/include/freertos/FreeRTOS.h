@@ -0,0 +1,100 @@
+#ifndef _SHIM_FREERTOS_H
+#define _SHIM_FREERTOS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+
+/*
+FreeRTOS of the host builds: the part of the API the firmware uses, on POSIX threads and a virtual clock (see
+shim/kernel.h). Every task is a thread, and tasks that are ready run at the same time, whatever their priority.
+Critical sections are recursive mutexes, one per portMUX, so they exclude each other but not the rest of the code.
+*/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+typedef uint8_t StackType_t;  // Stack sizes are in bytes, as on ESP-IDF
+typedef void (*TaskFunction_t)(void *);
+
+#define configTICK_RATE_HZ 100  // CONFIG_FREERTOS_HZ of sdkconfig
+#define configMAX_TASK_NAME_LEN 16
+#define configMINIMAL_STACK_SIZE 768
+#define portTICK_PERIOD_MS (1000 / configTICK_RATE_HZ)
+#define portMAX_DELAY ((TickType_t)0xffffffffUL)
+#define pdMS_TO_TICKS(ms) ((TickType_t)(((uint64_t)(ms) * configTICK_RATE_HZ) / 1000))
+
+#define pdFALSE 0
+#define pdTRUE 1
+#define pdPASS pdTRUE
+#define pdFAIL pdFALSE
+#define errQUEUE_EMPTY pdFALSE
+#define errQUEUE_FULL pdFALSE
+
+typedef struct {
+    pthread_mutex_t mutex;
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED {PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP}
+#define taskENTER_CRITICAL(mux) pthread_mutex_lock(&(mux)->mutex)
+#define taskEXIT_CRITICAL(mux) pthread_mutex_unlock(&(mux)->mutex)
+#define taskENTER_CRITICAL_ISR(mux) taskENTER_CRITICAL(mux)
+#define taskEXIT_CRITICAL_ISR(mux) taskEXIT_CRITICAL(mux)
+#define portENTER_CRITICAL(mux) taskENTER_CRITICAL(mux)
+#define portEXIT_CRITICAL(mux) taskEXIT_CRITICAL(mux)
+
+// Control block of a task. The fields after 'thread' belong to the kernel and are only touched under its lock.
+typedef struct shim_task {
+    pthread_t thread;
+    pthread_cond_t wake;
+    char name[configMAX_TASK_NAME_LEN];
+    TaskFunction_t entry;
+    void *params;
+    UBaseType_t priority;
+    uint32_t stack_bytes;
+    uint8_t *host_stack;      // Stack of the thread, painted to measure the high water mark. NULL for the main thread.
+    size_t host_stack_bytes;
+    const uint8_t *host_stack_entry;  // Frame of the task's entry. The thread descriptor of the C library is above it.
+
+    bool blocked;             // Waiting in the kernel
+    const void *waiting_on;   // The object it waits for, or NULL for a delay
+    int64_t deadline_us;      // When the wait times out, or -1
+    uint32_t notify_value;
+    bool notify_pending;
+    bool deleted;
+    struct shim_task *next;   // All tasks
+} StaticTask_t;
+
+typedef StaticTask_t *TaskHandle_t;
+
+// Control block of a queue, a queue set or a semaphore. Only touched under the kernel lock.
+typedef struct shim_queue {
+    uint8_t *storage;
+    UBaseType_t length;
+    UBaseType_t item_size;
+    UBaseType_t head;          // Index of the oldest item
+    UBaseType_t count;
+    uint8_t type;
+    struct shim_queue *set;    // The queue set it is a member of, or NULL
+    TaskHandle_t holder;       // Task that holds a mutex
+    UBaseType_t recursion;     // Takes of a recursive mutex by its holder
+} StaticQueue_t;
+
+typedef StaticQueue_t StaticSemaphore_t;
+
+typedef uint32_t EventBits_t;
+
+typedef struct {
+    EventBits_t bits;
+} StaticEventGroup_t;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,24 @@
+#ifndef _SHIM_EVENT_GROUPS_H
+#define _SHIM_EVENT_GROUPS_H
+
+#include "FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef StaticEventGroup_t *EventGroupHandle_t;
+
+EventGroupHandle_t xEventGroupCreateStatic(StaticEventGroup_t *control);
+EventGroupHandle_t xEventGroupCreate(void);
+EventBits_t xEventGroupSetBits(EventGroupHandle_t group, EventBits_t bits);
+EventBits_t xEventGroupClearBits(EventGroupHandle_t group, EventBits_t bits);
+EventBits_t xEventGroupGetBits(EventGroupHandle_t group);
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t group, EventBits_t bits, BaseType_t clear_on_exit,
+                                BaseType_t wait_for_all, TickType_t ticks);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef _SHIM_QUEUE_H
+#define _SHIM_QUEUE_H
+
+#include "FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef StaticQueue_t *QueueHandle_t;
+typedef StaticQueue_t *QueueSetHandle_t;
+typedef StaticQueue_t *QueueSetMemberHandle_t;
+
+#define queueQUEUE_TYPE_BASE ((uint8_t)0U)
+#define queueQUEUE_TYPE_SET ((uint8_t)0U)
+#define queueQUEUE_TYPE_MUTEX ((uint8_t)1U)
+#define queueQUEUE_TYPE_COUNTING_SEMAPHORE ((uint8_t)2U)
+#define queueQUEUE_TYPE_BINARY_SEMAPHORE ((uint8_t)3U)
+#define queueQUEUE_TYPE_RECURSIVE_MUTEX ((uint8_t)4U)
+
+QueueHandle_t xQueueGenericCreateStatic(UBaseType_t length, UBaseType_t item_size, uint8_t *storage,
+                                        StaticQueue_t *control, uint8_t type);
+QueueHandle_t xQueueGenericCreate(UBaseType_t length, UBaseType_t item_size, uint8_t type);
+#define xQueueCreateStatic(length, item_size, storage, control) \
+    xQueueGenericCreateStatic((length), (item_size), (storage), (control), queueQUEUE_TYPE_BASE)
+#define xQueueCreate(length, item_size) xQueueGenericCreate((length), (item_size), queueQUEUE_TYPE_BASE)
+
+BaseType_t xQueueSendToBack(QueueHandle_t queue, const void *item, TickType_t ticks);
+BaseType_t xQueueOverwrite(QueueHandle_t queue, const void *item);
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t ticks);
+BaseType_t xQueuePeek(QueueHandle_t queue, void *item, TickType_t ticks);
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue);
+BaseType_t xQueueReset(QueueHandle_t queue);
+#define xQueueSend(queue, item, ticks) xQueueSendToBack((queue), (item), (ticks))
+#define xQueueSendFromISR(queue, item, woken) xQueueSendToBack((queue), (item), 0)
+#define xQueueSendToBackFromISR(queue, item, woken) xQueueSendToBack((queue), (item), 0)
+
+// The queue must be empty when it is added, as on FreeRTOS
+BaseType_t xQueueAddToSet(QueueSetMemberHandle_t member, QueueSetHandle_t set);
+QueueSetMemberHandle_t xQueueSelectFromSet(QueueSetHandle_t set, TickType_t ticks);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,29 @@
+#ifndef _SHIM_SEMPHR_H
+#define _SHIM_SEMPHR_H
+
+#include "queue.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Semaphores are queues of items without data, as on FreeRTOS, so they can be members of a queue set
+typedef QueueHandle_t SemaphoreHandle_t;
+
+SemaphoreHandle_t xSemaphoreCreateBinaryStatic(StaticSemaphore_t *control);
+SemaphoreHandle_t xSemaphoreCreateMutexStatic(StaticSemaphore_t *control);
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutexStatic(StaticSemaphore_t *control);
+SemaphoreHandle_t xSemaphoreCreateBinary(void);
+SemaphoreHandle_t xSemaphoreCreateMutex(void);
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex(void);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore);
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks);
+BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t semaphore);
+BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t semaphore, TickType_t ticks);
+#define xSemaphoreGiveFromISR(semaphore, woken) xSemaphoreGive(semaphore)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
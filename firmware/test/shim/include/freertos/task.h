@@ -0,0 +1,43 @@
+#ifndef _SHIM_TASK_H
+#define _SHIM_TASK_H
+
+#include "FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    eNoAction,
+    eSetBits,
+    eIncrement,
+    eSetValueWithOverwrite,
+    eSetValueWithoutOverwrite,
+} eNotifyAction;
+
+TaskHandle_t xTaskCreateStatic(TaskFunction_t entry, const char *name, uint32_t stack_bytes, void *params,
+                               UBaseType_t priority, StackType_t *stack, StaticTask_t *control);
+BaseType_t xTaskCreate(TaskFunction_t entry, const char *name, uint32_t stack_bytes, void *params,
+                       UBaseType_t priority, TaskHandle_t *handle);
+void vTaskDelete(TaskHandle_t task);  // Only the calling task, with NULL
+void vTaskDelay(TickType_t ticks);
+TickType_t xTaskGetTickCount(void);
+TaskHandle_t xTaskGetCurrentTaskHandle(void);
+TaskHandle_t xTaskGetHandle(const char *name);
+char *pcTaskGetName(TaskHandle_t task);
+UBaseType_t uxTaskGetNumberOfTasks(void);
+// Bytes of the stack that were never used. Host code takes more stack than the target, so each thread gets
+// SHIM_STACK_MARGIN (shim/kernel.h) more than it asked for, and the high water mark counts from the size asked for.
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task);
+
+BaseType_t xTaskNotify(TaskHandle_t task, uint32_t value, eNotifyAction action);
+BaseType_t xTaskNotifyGive(TaskHandle_t task);
+BaseType_t xTaskNotifyWait(uint32_t clear_on_entry, uint32_t clear_on_exit, uint32_t *value, TickType_t ticks);
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t ticks);
+uint32_t ulTaskNotifyValueClear(TaskHandle_t task, uint32_t bits);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
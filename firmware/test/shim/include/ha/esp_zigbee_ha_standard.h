@@ -0,0 +1,9 @@
+#ifndef _SHIM_ESP_ZIGBEE_HA_STANDARD_H
+#define _SHIM_ESP_ZIGBEE_HA_STANDARD_H
+
+#include "esp_zigbee_core.h"
+
+#define ESP_ZB_HA_SIMPLE_SENSOR_DEVICE_ID 0x000C
+#define ESP_ZB_HA_TEMPERATURE_SENSOR_DEVICE_ID 0x0302
+
+#endif
@@ -0,0 +1,38 @@
+#ifndef _SHIM_I2CDEV_H
+#define _SHIM_I2CDEV_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "driver/gpio.h"
+
+/*
+The device descriptor and transfers of the i2cdev component of esp-idf-lib. There is no bus on the host: the host
+programs link with -Wl,--wrap=i2c_dev_read,--wrap=i2c_dev_write, as the firmware does with SIMULATE_SCD4X, and the
+transfers go to the simulated SCD4x of main/scd40/scd4x_sim.c.
+*/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef int i2c_port_t;
+
+typedef struct {
+    i2c_port_t port;
+    uint8_t addr;
+    gpio_num_t sda_io_num;
+    gpio_num_t scl_io_num;
+    uint32_t clk_speed;
+} i2c_dev_t;
+
+esp_err_t i2cdev_init(void);
+esp_err_t i2c_dev_read(const i2c_dev_t *dev, const void *out_data, size_t out_size, void *in_data, size_t in_size);
+esp_err_t i2c_dev_write(const i2c_dev_t *dev, const void *out_reg, size_t out_reg_size, const void *out_data,
+                        size_t out_size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,42 @@
+#ifndef _SHIM_MBEDTLS_CCM_H
+#define _SHIM_MBEDTLS_CCM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+AES-CCM of mbedtls, for the BTHome encryption: AES-128 only, with the key schedule computed once by
+mbedtls_ccm_setkey() as mbedtls does. A plain byte-oriented AES, so it is slower than the one of ESP-IDF, but the same
+for every caller.
+*/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    MBEDTLS_CIPHER_ID_NONE,
+    MBEDTLS_CIPHER_ID_NULL,
+    MBEDTLS_CIPHER_ID_AES,
+} mbedtls_cipher_id_t;
+
+#define MBEDTLS_ERR_CCM_BAD_INPUT -0x000D
+
+typedef struct {
+    uint8_t round_keys[176];
+    int key_set;
+} mbedtls_ccm_context;
+
+void mbedtls_ccm_init(mbedtls_ccm_context *ctx);
+void mbedtls_ccm_free(mbedtls_ccm_context *ctx);
+int mbedtls_ccm_setkey(mbedtls_ccm_context *ctx, mbedtls_cipher_id_t cipher, const unsigned char *key,
+                       unsigned int keybits);
+int mbedtls_ccm_encrypt_and_tag(mbedtls_ccm_context *ctx, size_t length, const unsigned char *iv, size_t iv_len,
+                                const unsigned char *ad, size_t ad_len, const unsigned char *input,
+                                unsigned char *output, unsigned char *tag, size_t tag_len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef _SHIM_SCD4X_H
+#define _SHIM_SCD4X_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "i2cdev.h"
+
+/*
+The scd4x driver of esp-idf-lib, the part of it that the firmware uses. shim/scd4x.c sends the same commands with the
+same waits, so that the simulated SCD4x sees the transfers it sees on target.
+*/
+
+#define SCD4X_I2C_ADDR 0x62
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+esp_err_t scd4x_init_desc(i2c_dev_t *dev, i2c_port_t port, gpio_num_t sda_gpio, gpio_num_t scl_gpio);
+esp_err_t scd4x_start_periodic_measurement(i2c_dev_t *dev);
+esp_err_t scd4x_read_measurement_ticks(i2c_dev_t *dev, uint16_t *co2, uint16_t *temperature, uint16_t *humidity);
+esp_err_t scd4x_read_measurement(i2c_dev_t *dev, uint16_t *co2, float *temperature, float *humidity);
+esp_err_t scd4x_stop_periodic_measurement(i2c_dev_t *dev);
+esp_err_t scd4x_get_automatic_self_calibration(i2c_dev_t *dev, bool *enabled);
+esp_err_t scd4x_set_automatic_self_calibration(i2c_dev_t *dev, bool enabled);
+esp_err_t scd4x_start_low_power_periodic_measurement(i2c_dev_t *dev);
+esp_err_t scd4x_get_data_ready_status(i2c_dev_t *dev, bool *data_ready);
+esp_err_t scd4x_get_serial_number(i2c_dev_t *dev, uint16_t *serial0, uint16_t *serial1, uint16_t *serial2);
+esp_err_t scd4x_perform_self_test(i2c_dev_t *dev, bool *malfunction);
+esp_err_t scd4x_reinit(i2c_dev_t *dev);
+esp_err_t scd4x_measure_single_shot(i2c_dev_t *dev);
+esp_err_t scd4x_power_down(i2c_dev_t *dev);
+esp_err_t scd4x_wake_up(i2c_dev_t *dev);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,18 @@
+#ifndef _SHIM_SDKCONFIG_H
+#define _SHIM_SDKCONFIG_H
+
+// The options of sdkconfig that the firmware reads, with the values of the ESP32-C6 build
+
+#define CONFIG_IDF_TARGET "esp32c6"
+#define CONFIG_IDF_TARGET_ESP32C6 1
+#define CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ 160
+#define CONFIG_FREERTOS_HZ 100
+#define CONFIG_FREERTOS_IDLE_TASK_STACKSIZE 1536
+#define CONFIG_ESP_TIMER_TASK_STACK_SIZE 3584
+#define CONFIG_ESP_SYSTEM_EVENT_TASK_STACK_SIZE 4096
+#define CONFIG_BT_BTC_TASK_STACK_SIZE 3072
+#define CONFIG_BT_BTU_TASK_STACK_SIZE 4352
+#define CONFIG_BT_LE_CONTROLLER_TASK_STACK_SIZE 4096
+#define CONFIG_LOG_DEFAULT_LEVEL 3
+
+#endif
@@ -0,0 +1,325 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "freertos/task.h"
+#include "esp_rom_sys.h"
+#include "kernel.h"
+
+static pthread_mutex_t kernel_lock = PTHREAD_MUTEX_INITIALIZER;
+static int64_t now_us = 0;
+static TaskHandle_t tasks = NULL;
+static uint32_t n_tasks = 0;
+static uint32_t running = 0;                 // Tasks that are not blocked in the kernel
+static __thread TaskHandle_t self = NULL;
+
+#define STACK_PAINT 0xa5
+
+int64_t shim_now_us(void)
+{
+    return __atomic_load_n(&now_us, __ATOMIC_ACQUIRE);
+}
+
+void shim_lock(void)
+{
+    pthread_mutex_lock(&kernel_lock);
+}
+
+void shim_unlock(void)
+{
+    pthread_mutex_unlock(&kernel_lock);
+}
+
+static void add_task(TaskHandle_t task, const char *name)
+{
+    pthread_cond_init(&task->wake, NULL);
+    strncpy(task->name, name, sizeof(task->name) - 1);
+    task->name[sizeof(task->name) - 1] = '\0';
+    task->blocked = false;
+    task->waiting_on = NULL;
+    task->deadline_us = -1;
+    task->notify_value = 0;
+    task->notify_pending = false;
+    task->deleted = false;
+    task->next = tasks;
+    tasks = task;
+    n_tasks++;
+    running++;
+}
+
+TaskHandle_t shim_self(void)
+{
+    if (self == NULL){
+        // A thread that was not started as a task, such as the main thread
+        self = calloc(1, sizeof(StaticTask_t));
+        self->thread = pthread_self();
+        add_task(self, "main");
+    }
+    return self;
+}
+
+static void wake_task(TaskHandle_t task)
+{
+    task->blocked = false;
+    task->waiting_on = NULL;
+    task->deadline_us = -1;
+    running++;
+    pthread_cond_signal(&task->wake);
+}
+
+// Every task waits: moves the clock to the earliest deadline, and wakes the tasks that reach it
+static void advance(void)
+{
+    int64_t next = -1;
+    for (TaskHandle_t t = tasks; t != NULL; t = t->next){
+        if (t->blocked && t->deadline_us >= 0 && (next < 0 || t->deadline_us < next)){next = t->deadline_us;}
+    }
+    if (next < 0){
+        fprintf(stderr, "shim: every task waits without a deadline\n");
+        abort();
+    }
+    if (next > now_us){__atomic_store_n(&now_us, next, __ATOMIC_RELEASE);}
+    for (TaskHandle_t t = tasks; t != NULL; t = t->next){
+        if (t->blocked && t->deadline_us >= 0 && t->deadline_us <= now_us){wake_task(t);}
+    }
+}
+
+void shim_block(const void *object, int64_t deadline_us)
+{
+    TaskHandle_t task = shim_self();
+    if (deadline_us >= 0 && deadline_us <= now_us){return;}
+    task->blocked = true;
+    task->waiting_on = object;
+    task->deadline_us = deadline_us;
+    running--;
+    if (running == 0){advance();}
+    while (task->blocked){
+        pthread_cond_wait(&task->wake, &kernel_lock);
+    }
+}
+
+void shim_wake(const void *object)
+{
+    for (TaskHandle_t t = tasks; t != NULL; t = t->next){
+        if (t->blocked && t->waiting_on == object){wake_task(t);}
+    }
+}
+
+int64_t shim_deadline(TickType_t ticks)
+{
+    if (ticks == portMAX_DELAY){return -1;}
+    return now_us + (int64_t)ticks * portTICK_PERIOD_MS * 1000;
+}
+
+static void *task_main(void *arg)
+{
+    self = arg;
+    self->host_stack_entry = __builtin_frame_address(0);
+    self->entry(self->params);
+    // A FreeRTOS task must not return. Like vTaskDelete(NULL), it is taken off the clock.
+    vTaskDelete(NULL);
+    return NULL;
+}
+
+TaskHandle_t xTaskCreateStatic(TaskFunction_t entry, const char *name, uint32_t stack_bytes, void *params,
+                               UBaseType_t priority, StackType_t *stack, StaticTask_t *control)
+{
+    (void)stack;
+    // The thread runs on a painted stack of its own. It is never freed, as a deleted task may still be exiting.
+    size_t page = sysconf(_SC_PAGESIZE);
+    control->host_stack_bytes = (stack_bytes + SHIM_STACK_MARGIN + page - 1) / page * page;
+    control->host_stack = aligned_alloc(page, control->host_stack_bytes);
+    if (control->host_stack == NULL){
+        fprintf(stderr, "shim: no memory for the stack of task %s\n", name);
+        abort();
+    }
+    memset(control->host_stack, STACK_PAINT, control->host_stack_bytes);
+
+    shim_lock();
+    shim_self();
+    control->entry = entry;
+    control->params = params;
+    control->priority = priority;
+    control->stack_bytes = stack_bytes;
+    add_task(control, name);
+    shim_unlock();
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    pthread_attr_setstack(&attr, control->host_stack, control->host_stack_bytes);
+    if (pthread_create(&control->thread, &attr, task_main, control) != 0){
+        fprintf(stderr, "shim: creating task %s failed\n", name);
+        abort();
+    }
+    pthread_attr_destroy(&attr);
+    return control;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t entry, const char *name, uint32_t stack_bytes, void *params,
+                       UBaseType_t priority, TaskHandle_t *handle)
+{
+    TaskHandle_t task = xTaskCreateStatic(entry, name, stack_bytes, params, priority, NULL,
+                                          calloc(1, sizeof(StaticTask_t)));
+    if (handle != NULL){*handle = task;}
+    return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t task)
+{
+    shim_lock();
+    TaskHandle_t me = shim_self();
+    if (task != NULL && task != me){
+        fprintf(stderr, "shim: only the calling task can be deleted\n");
+        abort();
+    }
+    me->deleted = true;
+    running--;
+    // Some other task may still be running. If not, the clock moves on for those that wait.
+    if (running == 0){advance();}
+    shim_unlock();
+    pthread_exit(NULL);
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    shim_lock();
+    int64_t deadline = shim_deadline(ticks);
+    while (deadline < 0 || now_us < deadline){
+        shim_block(NULL, deadline);
+    }
+    shim_unlock();
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    return shim_now_us() / 1000 / portTICK_PERIOD_MS;
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    shim_lock();
+    TaskHandle_t task = shim_self();
+    shim_unlock();
+    return task;
+}
+
+TaskHandle_t xTaskGetHandle(const char *name)
+{
+    TaskHandle_t found = NULL;
+    shim_lock();
+    for (TaskHandle_t t = tasks; t != NULL && found == NULL; t = t->next){
+        if (!t->deleted && strcmp(t->name, name) == 0){found = t;}
+    }
+    shim_unlock();
+    return found;
+}
+
+char *pcTaskGetName(TaskHandle_t task)
+{
+    return task == NULL ? xTaskGetCurrentTaskHandle()->name : task->name;
+}
+
+UBaseType_t uxTaskGetNumberOfTasks(void)
+{
+    shim_lock();
+    UBaseType_t n = 0;
+    for (TaskHandle_t t = tasks; t != NULL; t = t->next){
+        n += !t->deleted;
+    }
+    shim_unlock();
+    return n;
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task)
+{
+    if (task == NULL){task = xTaskGetCurrentTaskHandle();}
+    if (task->host_stack == NULL || task->host_stack_entry == NULL){return task->stack_bytes;}
+    // The stack grows down, so the paint is left at the bottom. The use is counted from the frame of the entry.
+    size_t unused = 0;
+    while (unused < task->host_stack_bytes && task->host_stack[unused] == STACK_PAINT){unused++;}
+    size_t used = task->host_stack_entry - (task->host_stack + unused);
+    return used < task->stack_bytes ? task->stack_bytes - used : 0;
+}
+
+BaseType_t xTaskNotify(TaskHandle_t task, uint32_t value, eNotifyAction action)
+{
+    BaseType_t result = pdPASS;
+    shim_lock();
+    switch (action){
+    case eSetBits: task->notify_value |= value; break;
+    case eIncrement: task->notify_value++; break;
+    case eSetValueWithOverwrite: task->notify_value = value; break;
+    case eSetValueWithoutOverwrite:
+        if (task->notify_pending){
+            result = pdFAIL;
+        } else {
+            task->notify_value = value;
+        }
+        break;
+    case eNoAction: break;
+    }
+    if (result == pdPASS){
+        task->notify_pending = true;
+        shim_wake(&task->notify_value);
+    }
+    shim_unlock();
+    return result;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+    return xTaskNotify(task, 0, eIncrement);
+}
+
+BaseType_t xTaskNotifyWait(uint32_t clear_on_entry, uint32_t clear_on_exit, uint32_t *value, TickType_t ticks)
+{
+    shim_lock();
+    TaskHandle_t me = shim_self();
+    int64_t deadline = shim_deadline(ticks);
+    if (!me->notify_pending){me->notify_value &= ~clear_on_entry;}
+    while (!me->notify_pending && ticks > 0 && (deadline < 0 || now_us < deadline)){
+        shim_block(&me->notify_value, deadline);
+    }
+    if (value != NULL){*value = me->notify_value;}
+    BaseType_t result = me->notify_pending ? pdTRUE : pdFALSE;
+    if (result == pdTRUE){me->notify_value &= ~clear_on_exit;}
+    me->notify_pending = false;
+    shim_unlock();
+    return result;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t ticks)
+{
+    shim_lock();
+    TaskHandle_t me = shim_self();
+    int64_t deadline = shim_deadline(ticks);
+    while (me->notify_value == 0 && ticks > 0 && (deadline < 0 || now_us < deadline)){
+        shim_block(&me->notify_value, deadline);
+    }
+    uint32_t value = me->notify_value;
+    if (value != 0){me->notify_value = clear ? 0 : value - 1;}
+    me->notify_pending = false;
+    shim_unlock();
+    return value;
+}
+
+uint32_t ulTaskNotifyValueClear(TaskHandle_t task, uint32_t bits)
+{
+    shim_lock();
+    if (task == NULL){task = shim_self();}
+    uint32_t value = task->notify_value;
+    task->notify_value &= ~bits;
+    shim_unlock();
+    return value;
+}
+
+void esp_rom_delay_us(uint32_t us)
+{
+    shim_lock();
+    int64_t deadline = shim_now_us() + us;
+    while (shim_now_us() < deadline){
+        shim_block(NULL, deadline);
+    }
+    shim_unlock();
+}
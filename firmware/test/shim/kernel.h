@@ -0,0 +1,50 @@
+#ifndef _SHIM_KERNEL_H
+#define _SHIM_KERNEL_H
+
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+
+/*
+Kernel of the host shims, with a virtual clock. Time stands still while any task runs, and jumps to the earliest
+deadline once every task waits in the kernel: for a delay, a notification, a queue, an event group or a timer. Work
+takes no virtual time, so a day of sampling runs as fast as the host can execute it, and the time a task sees does
+not depend on the load of the host.
+
+A thread that is not a task becomes one the first time it calls the kernel, so the main thread of a host program is a
+task as soon as it starts one. A task that waits outside of the kernel, for I/O or a mutex held by a task that waits,
+stops the clock. If every task waits without a deadline, nothing can ever run again and the kernel aborts.
+
+The waits of the FreeRTOS and ESP-IDF shims are built from shim_block() and shim_wake(), under the kernel lock.
+*/
+
+// Stack given to every task on top of the size it asked for, for the larger frames of the host and its C library
+#define SHIM_STACK_MARGIN (64 * 1024)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Current virtual time in microseconds. Starts at 0.
+int64_t shim_now_us(void);
+
+void shim_lock(void);
+void shim_unlock(void);
+
+// The calling task. Must be called under the lock.
+TaskHandle_t shim_self(void);
+
+// Blocks the calling task under the lock, until shim_wake() is called for 'object' or the virtual time reaches
+// 'deadline_us' (-1 for none). The condition waited for must be checked again after it returns.
+void shim_block(const void *object, int64_t deadline_us);
+
+// Wakes the tasks blocked on 'object'. Must be called under the lock.
+void shim_wake(const void *object);
+
+// Deadline of a wait of 'ticks' from now: -1 for portMAX_DELAY
+int64_t shim_deadline(TickType_t ticks);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
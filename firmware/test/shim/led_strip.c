@@ -0,0 +1,82 @@
+#include <stdlib.h>
+#include <string.h>
+#include "led_strip.h"
+#include "kernel.h"
+
+struct led_strip_t {
+    uint32_t n;
+    uint8_t *pixels;  // Buffer, RGB
+    uint8_t *shown;   // Last refresh
+    uint32_t refreshes;
+};
+
+static led_strip_handle_t last_created = NULL;
+
+esp_err_t led_strip_new_rmt_device(const led_strip_config_t *led_config, const led_strip_rmt_config_t *rmt_config,
+                                   led_strip_handle_t *ret_strip)
+{
+    if (led_config == NULL || rmt_config == NULL || ret_strip == NULL || led_config->max_leds == 0){
+        return ESP_ERR_INVALID_ARG;
+    }
+    led_strip_handle_t strip = calloc(1, sizeof(*strip));
+    strip->n = led_config->max_leds;
+    strip->pixels = calloc(strip->n, 3);
+    strip->shown = calloc(strip->n, 3);
+    shim_lock();
+    last_created = strip;
+    shim_unlock();
+    *ret_strip = strip;
+    return ESP_OK;
+}
+
+esp_err_t led_strip_set_pixel(led_strip_handle_t strip, uint32_t index, uint32_t red, uint32_t green, uint32_t blue)
+{
+    if (index >= strip->n || red > 255 || green > 255 || blue > 255){return ESP_ERR_INVALID_ARG;}
+    shim_lock();
+    strip->pixels[index * 3] = red;
+    strip->pixels[index * 3 + 1] = green;
+    strip->pixels[index * 3 + 2] = blue;
+    shim_unlock();
+    return ESP_OK;
+}
+
+esp_err_t led_strip_refresh(led_strip_handle_t strip)
+{
+    shim_lock();
+    memcpy(strip->shown, strip->pixels, strip->n * 3);
+    strip->refreshes++;
+    shim_unlock();
+    return ESP_OK;
+}
+
+esp_err_t led_strip_clear(led_strip_handle_t strip)
+{
+    shim_lock();
+    memset(strip->pixels, 0, strip->n * 3);
+    shim_unlock();
+    return led_strip_refresh(strip);
+}
+
+esp_err_t led_strip_del(led_strip_handle_t strip)
+{
+    shim_lock();
+    if (last_created == strip){last_created = NULL;}
+    shim_unlock();
+    free(strip->pixels);
+    free(strip->shown);
+    free(strip);
+    return ESP_OK;
+}
+
+void shim_led_strip_get_state(struct shim_led_strip_state *state)
+{
+    memset(state, 0, sizeof(*state));
+    shim_lock();
+    if (last_created != NULL){
+        state->r = last_created->shown[0];
+        state->g = last_created->shown[1];
+        state->b = last_created->shown[2];
+        state->refreshes = last_created->refreshes;
+    }
+    shim_unlock();
+}
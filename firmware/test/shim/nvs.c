@@ -0,0 +1,272 @@
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "nvs_flash.h"
+#include "kernel.h"
+
+#define MAX_NAMESPACES 8
+
+enum ENTRY_TYPES {
+    ENTRY_U8,
+    ENTRY_U16,
+    ENTRY_U32,
+    ENTRY_STR,
+    ENTRY_BLOB,
+};
+
+struct entry {
+    uint32_t ns;  // Index of the namespace
+    char key[NVS_KEY_NAME_MAX_SIZE];
+    enum ENTRY_TYPES type;
+    size_t length;
+    uint8_t *data;
+    struct entry *next;
+};
+
+// The store is only touched under the kernel lock. Nothing in it waits.
+static bool initialized = false;
+static char namespaces[MAX_NAMESPACES][NVS_KEY_NAME_MAX_SIZE];
+static uint32_t n_namespaces = 0;
+static struct entry *entries = NULL;
+static uint32_t commits = 0;
+
+// Handles are the index of their namespace plus 1, and have the read-only flag in bit 31
+#define HANDLE_READONLY (1UL << 31)
+
+static void erase_all_entries(void)
+{
+    while (entries != NULL){
+        struct entry *e = entries;
+        entries = e->next;
+        free(e->data);
+        free(e);
+    }
+}
+
+esp_err_t nvs_flash_init(void)
+{
+    shim_lock();
+    initialized = true;
+    shim_unlock();
+    return ESP_OK;
+}
+
+esp_err_t nvs_flash_erase(void)
+{
+    shim_lock();
+    erase_all_entries();
+    n_namespaces = 0;
+    initialized = false;
+    shim_unlock();
+    return ESP_OK;
+}
+
+esp_err_t nvs_open(const char *namespace_name, nvs_open_mode_t open_mode, nvs_handle_t *out_handle)
+{
+    if (strlen(namespace_name) >= NVS_KEY_NAME_MAX_SIZE){return ESP_ERR_NVS_INVALID_NAME;}
+    esp_err_t err = ESP_OK;
+    shim_lock();
+    uint32_t ns = 0;
+    while (ns < n_namespaces && strcmp(namespaces[ns], namespace_name) != 0){ns++;}
+    if (!initialized){
+        err = ESP_ERR_NVS_NOT_INITIALIZED;
+    } else if (ns == n_namespaces){
+        // As on the device, a namespace is only created by a read-write open
+        if (open_mode == NVS_READONLY){
+            err = ESP_ERR_NVS_NOT_FOUND;
+        } else if (n_namespaces == MAX_NAMESPACES){
+            err = ESP_ERR_NO_MEM;
+        } else {
+            strcpy(namespaces[n_namespaces++], namespace_name);
+        }
+    }
+    shim_unlock();
+    if (err == ESP_OK){*out_handle = (ns + 1) | (open_mode == NVS_READONLY ? HANDLE_READONLY : 0);}
+    return err;
+}
+
+void nvs_close(nvs_handle_t handle)
+{
+    (void)handle;
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle)
+{
+    (void)handle;
+    shim_lock();
+    commits++;
+    shim_unlock();
+    return ESP_OK;
+}
+
+uint32_t shim_nvs_commits(void)
+{
+    shim_lock();
+    uint32_t n = commits;
+    shim_unlock();
+    return n;
+}
+
+static bool valid_handle(nvs_handle_t handle)
+{
+    uint32_t ns = (handle & ~HANDLE_READONLY) - 1;
+    return initialized && ns < n_namespaces;
+}
+
+static struct entry **find(nvs_handle_t handle, const char *key)
+{
+    uint32_t ns = (handle & ~HANDLE_READONLY) - 1;
+    struct entry **e = &entries;
+    while (*e != NULL && ((*e)->ns != ns || strcmp((*e)->key, key) != 0)){e = &(*e)->next;}
+    return e;
+}
+
+static esp_err_t set(nvs_handle_t handle, const char *key, enum ENTRY_TYPES type, const void *value, size_t length)
+{
+    if (strlen(key) >= NVS_KEY_NAME_MAX_SIZE){return ESP_ERR_NVS_INVALID_NAME;}
+    uint8_t *data = malloc(length > 0 ? length : 1);
+    if (data == NULL){return ESP_ERR_NO_MEM;}
+    memcpy(data, value, length);
+
+    esp_err_t err = ESP_OK;
+    shim_lock();
+    if (!valid_handle(handle)){
+        err = ESP_ERR_NVS_INVALID_HANDLE;
+    } else if (handle & HANDLE_READONLY){
+        err = ESP_ERR_NVS_READ_ONLY;
+    } else {
+        struct entry **e = find(handle, key);
+        if (*e == NULL){
+            *e = calloc(1, sizeof(struct entry));
+            (*e)->ns = (handle & ~HANDLE_READONLY) - 1;
+            strcpy((*e)->key, key);
+        }
+        free((*e)->data);
+        (*e)->type = type;
+        (*e)->length = length;
+        (*e)->data = data;
+        data = NULL;
+    }
+    shim_unlock();
+    free(data);
+    return err;
+}
+
+// Copies an entry out. For strings and blobs, 'length' is the size of 'out' on entry and that of the value on return.
+static esp_err_t get(nvs_handle_t handle, const char *key, enum ENTRY_TYPES type, void *out, size_t *length)
+{
+    esp_err_t err = ESP_OK;
+    shim_lock();
+    struct entry *e = valid_handle(handle) ? *find(handle, key) : NULL;
+    if (!valid_handle(handle)){
+        err = ESP_ERR_NVS_INVALID_HANDLE;
+    } else if (e == NULL || e->type != type){
+        // The device looks keys up together with their type
+        err = ESP_ERR_NVS_NOT_FOUND;
+    } else if (out == NULL){
+        *length = e->length;
+    } else if (*length < e->length){
+        err = ESP_ERR_NVS_INVALID_LENGTH;
+    } else {
+        memcpy(out, e->data, e->length);
+        *length = e->length;
+    }
+    shim_unlock();
+    return err;
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char *key)
+{
+    esp_err_t err = ESP_OK;
+    shim_lock();
+    struct entry **e = valid_handle(handle) ? find(handle, key) : NULL;
+    if (e == NULL){
+        err = ESP_ERR_NVS_INVALID_HANDLE;
+    } else if (*e == NULL){
+        err = ESP_ERR_NVS_NOT_FOUND;
+    } else {
+        struct entry *erased = *e;
+        *e = erased->next;
+        free(erased->data);
+        free(erased);
+    }
+    shim_unlock();
+    return err;
+}
+
+esp_err_t nvs_erase_all(nvs_handle_t handle)
+{
+    esp_err_t err = ESP_OK;
+    shim_lock();
+    if (!valid_handle(handle)){
+        err = ESP_ERR_NVS_INVALID_HANDLE;
+    } else {
+        uint32_t ns = (handle & ~HANDLE_READONLY) - 1;
+        struct entry **e = &entries;
+        while (*e != NULL){
+            if ((*e)->ns == ns){
+                struct entry *erased = *e;
+                *e = erased->next;
+                free(erased->data);
+                free(erased);
+            } else {
+                e = &(*e)->next;
+            }
+        }
+    }
+    shim_unlock();
+    return err;
+}
+
+esp_err_t nvs_set_u8(nvs_handle_t handle, const char *key, uint8_t value)
+{
+    return set(handle, key, ENTRY_U8, &value, sizeof(value));
+}
+
+esp_err_t nvs_set_u16(nvs_handle_t handle, const char *key, uint16_t value)
+{
+    return set(handle, key, ENTRY_U16, &value, sizeof(value));
+}
+
+esp_err_t nvs_set_u32(nvs_handle_t handle, const char *key, uint32_t value)
+{
+    return set(handle, key, ENTRY_U32, &value, sizeof(value));
+}
+
+esp_err_t nvs_set_str(nvs_handle_t handle, const char *key, const char *value)
+{
+    return set(handle, key, ENTRY_STR, value, strlen(value) + 1);
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t length)
+{
+    return set(handle, key, ENTRY_BLOB, value, length);
+}
+
+esp_err_t nvs_get_u8(nvs_handle_t handle, const char *key, uint8_t *out_value)
+{
+    size_t length = sizeof(*out_value);
+    return get(handle, key, ENTRY_U8, out_value, &length);
+}
+
+esp_err_t nvs_get_u16(nvs_handle_t handle, const char *key, uint16_t *out_value)
+{
+    size_t length = sizeof(*out_value);
+    return get(handle, key, ENTRY_U16, out_value, &length);
+}
+
+esp_err_t nvs_get_u32(nvs_handle_t handle, const char *key, uint32_t *out_value)
+{
+    size_t length = sizeof(*out_value);
+    return get(handle, key, ENTRY_U32, out_value, &length);
+}
+
+esp_err_t nvs_get_str(nvs_handle_t handle, const char *key, char *out_value, size_t *length)
+{
+    return get(handle, key, ENTRY_STR, out_value, length);
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *out_value, size_t *length)
+{
+    return get(handle, key, ENTRY_BLOB, out_value, length);
+}
@@ -0,0 +1,268 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/event_groups.h"
+#include "kernel.h"
+
+// Receivers of a queue wait on the queue, senders on its 'length'
+
+static void put_item(QueueHandle_t queue, const void *item)
+{
+    UBaseType_t tail = (queue->head + queue->count) % queue->length;
+    if (queue->item_size > 0 && item != NULL){memcpy(queue->storage + tail * queue->item_size, item, queue->item_size);}
+    queue->count++;
+    shim_wake(queue);
+    if (queue->set != NULL){
+        // A set holds one entry for every item in its members, so it cannot be full
+        put_item(queue->set, &queue);
+    }
+}
+
+static void take_item(QueueHandle_t queue, void *item)
+{
+    if (queue->item_size > 0){memcpy(item, queue->storage + queue->head * queue->item_size, queue->item_size);}
+    queue->head = (queue->head + 1) % queue->length;
+    queue->count--;
+    shim_wake(&queue->length);
+}
+
+QueueHandle_t xQueueGenericCreateStatic(UBaseType_t length, UBaseType_t item_size, uint8_t *storage,
+                                        StaticQueue_t *control, uint8_t type)
+{
+    memset(control, 0, sizeof(*control));
+    control->storage = storage;
+    control->length = length;
+    control->item_size = item_size;
+    control->type = type;
+    if (type == queueQUEUE_TYPE_MUTEX || type == queueQUEUE_TYPE_RECURSIVE_MUTEX){control->count = 1;}
+    return control;
+}
+
+QueueHandle_t xQueueGenericCreate(UBaseType_t length, UBaseType_t item_size, uint8_t type)
+{
+    return xQueueGenericCreateStatic(length, item_size, malloc(length * item_size + 1), malloc(sizeof(StaticQueue_t)),
+                                     type);
+}
+
+BaseType_t xQueueSendToBack(QueueHandle_t queue, const void *item, TickType_t ticks)
+{
+    shim_lock();
+    int64_t deadline = shim_deadline(ticks);
+    while (queue->count == queue->length && ticks > 0 && (deadline < 0 || shim_now_us() < deadline)){
+        shim_block(&queue->length, deadline);
+    }
+    BaseType_t result = queue->count < queue->length ? pdPASS : errQUEUE_FULL;
+    if (result == pdPASS){put_item(queue, item);}
+    shim_unlock();
+    return result;
+}
+
+BaseType_t xQueueOverwrite(QueueHandle_t queue, const void *item)
+{
+    shim_lock();
+    if (queue->count == queue->length){
+        // Only meant for queues of length 1, as on FreeRTOS
+        memcpy(queue->storage + queue->head * queue->item_size, item, queue->item_size);
+        shim_wake(queue);
+    } else {
+        put_item(queue, item);
+    }
+    shim_unlock();
+    return pdPASS;
+}
+
+static BaseType_t receive(QueueHandle_t queue, void *item, TickType_t ticks, bool remove)
+{
+    shim_lock();
+    int64_t deadline = shim_deadline(ticks);
+    while (queue->count == 0 && ticks > 0 && (deadline < 0 || shim_now_us() < deadline)){
+        shim_block(queue, deadline);
+    }
+    BaseType_t result = queue->count > 0 ? pdTRUE : errQUEUE_EMPTY;
+    if (result == pdTRUE){
+        if (remove){
+            take_item(queue, item);
+        } else if (queue->item_size > 0){
+            memcpy(item, queue->storage + queue->head * queue->item_size, queue->item_size);
+        }
+    }
+    shim_unlock();
+    return result;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t ticks)
+{
+    return receive(queue, item, ticks, true);
+}
+
+BaseType_t xQueuePeek(QueueHandle_t queue, void *item, TickType_t ticks)
+{
+    return receive(queue, item, ticks, false);
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue)
+{
+    shim_lock();
+    UBaseType_t count = queue->count;
+    shim_unlock();
+    return count;
+}
+
+BaseType_t xQueueReset(QueueHandle_t queue)
+{
+    shim_lock();
+    queue->head = 0;
+    queue->count = 0;
+    shim_wake(&queue->length);
+    shim_unlock();
+    return pdPASS;
+}
+
+BaseType_t xQueueAddToSet(QueueSetMemberHandle_t member, QueueSetHandle_t set)
+{
+    shim_lock();
+    BaseType_t result = member->set == NULL && member->count == 0 ? pdPASS : pdFAIL;
+    if (result == pdPASS){member->set = set;}
+    shim_unlock();
+    return result;
+}
+
+QueueSetMemberHandle_t xQueueSelectFromSet(QueueSetHandle_t set, TickType_t ticks)
+{
+    QueueSetMemberHandle_t member = NULL;
+    return xQueueReceive(set, &member, ticks) == pdTRUE ? member : NULL;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinaryStatic(StaticSemaphore_t *control)
+{
+    return xQueueGenericCreateStatic(1, 0, NULL, control, queueQUEUE_TYPE_BINARY_SEMAPHORE);
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutexStatic(StaticSemaphore_t *control)
+{
+    return xQueueGenericCreateStatic(1, 0, NULL, control, queueQUEUE_TYPE_MUTEX);
+}
+
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutexStatic(StaticSemaphore_t *control)
+{
+    return xQueueGenericCreateStatic(1, 0, NULL, control, queueQUEUE_TYPE_RECURSIVE_MUTEX);
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void)
+{
+    return xSemaphoreCreateBinaryStatic(malloc(sizeof(StaticSemaphore_t)));
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    return xSemaphoreCreateMutexStatic(malloc(sizeof(StaticSemaphore_t)));
+}
+
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex(void)
+{
+    return xSemaphoreCreateRecursiveMutexStatic(malloc(sizeof(StaticSemaphore_t)));
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore)
+{
+    shim_lock();
+    bool mutex = semaphore->type == queueQUEUE_TYPE_MUTEX || semaphore->type == queueQUEUE_TYPE_RECURSIVE_MUTEX;
+    BaseType_t result = semaphore->count < semaphore->length ? pdPASS : pdFAIL;
+    if (mutex && semaphore->holder != shim_self()){result = pdFAIL;}
+    if (result == pdPASS){
+        semaphore->holder = NULL;
+        put_item(semaphore, NULL);
+    }
+    shim_unlock();
+    return result;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks)
+{
+    BaseType_t result = receive(semaphore, NULL, ticks, true);
+    if (result == pdTRUE && semaphore->type != queueQUEUE_TYPE_BINARY_SEMAPHORE){
+        shim_lock();
+        semaphore->holder = shim_self();
+        shim_unlock();
+    }
+    return result;
+}
+
+BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t semaphore, TickType_t ticks)
+{
+    shim_lock();
+    bool held = semaphore->holder == shim_self();
+    if (held){semaphore->recursion++;}
+    shim_unlock();
+    return held ? pdTRUE : xSemaphoreTake(semaphore, ticks);
+}
+
+BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t semaphore)
+{
+    shim_lock();
+    bool nested = semaphore->holder == shim_self() && semaphore->recursion > 0;
+    if (nested){semaphore->recursion--;}
+    shim_unlock();
+    return nested ? pdPASS : xSemaphoreGive(semaphore);
+}
+
+// Tasks waiting for bits of an event group wait on the group
+
+EventGroupHandle_t xEventGroupCreateStatic(StaticEventGroup_t *control)
+{
+    control->bits = 0;
+    return control;
+}
+
+EventGroupHandle_t xEventGroupCreate(void)
+{
+    return xEventGroupCreateStatic(malloc(sizeof(StaticEventGroup_t)));
+}
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t group, EventBits_t bits)
+{
+    shim_lock();
+    group->bits |= bits;
+    EventBits_t now = group->bits;
+    shim_wake(group);
+    shim_unlock();
+    return now;
+}
+
+EventBits_t xEventGroupClearBits(EventGroupHandle_t group, EventBits_t bits)
+{
+    shim_lock();
+    EventBits_t before = group->bits;
+    group->bits &= ~bits;
+    shim_unlock();
+    return before;
+}
+
+EventBits_t xEventGroupGetBits(EventGroupHandle_t group)
+{
+    shim_lock();
+    EventBits_t bits = group->bits;
+    shim_unlock();
+    return bits;
+}
+
+static bool bits_met(EventBits_t have, EventBits_t wanted, BaseType_t wait_for_all)
+{
+    return wait_for_all ? (have & wanted) == wanted : (have & wanted) != 0;
+}
+
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t group, EventBits_t bits, BaseType_t clear_on_exit,
+                                BaseType_t wait_for_all, TickType_t ticks)
+{
+    shim_lock();
+    int64_t deadline = shim_deadline(ticks);
+    while (!bits_met(group->bits, bits, wait_for_all) && ticks > 0 && (deadline < 0 || shim_now_us() < deadline)){
+        shim_block(group, deadline);
+    }
+    EventBits_t result = group->bits;
+    if (clear_on_exit && bits_met(result, bits, wait_for_all)){group->bits &= ~bits;}
+    shim_unlock();
+    return result;
+}
@@ -0,0 +1,180 @@
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_rom_sys.h"
+#include "scd4x.h"
+
+// Commands and execution times of the SCD4x, as the esp-idf-lib driver sends and waits them
+#define CMD_START_PERIODIC_MEASUREMENT           0x21b1
+#define CMD_READ_MEASUREMENT                     0xec05
+#define CMD_STOP_PERIODIC_MEASUREMENT            0x3f86
+#define CMD_SET_AUTOMATIC_SELF_CALIBRATION       0x2416
+#define CMD_GET_AUTOMATIC_SELF_CALIBRATION       0x2313
+#define CMD_START_LOW_POWER_PERIODIC_MEASUREMENT 0x21ac
+#define CMD_GET_DATA_READY_STATUS                0xe4b8
+#define CMD_GET_SERIAL_NUMBER                    0x3682
+#define CMD_PERFORM_SELF_TEST                    0x3639
+#define CMD_REINIT                               0x3646
+#define CMD_MEASURE_SINGLE_SHOT                  0x219d
+#define CMD_POWER_DOWN                           0x36e0
+#define CMD_WAKE_UP                              0x36f6
+
+static uint8_t crc8(const uint8_t *data, size_t len)
+{
+    uint8_t crc = 0xff;
+    for (size_t i = 0; i < len; i++){
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++){
+            crc = (crc & 0x80) ? (crc << 1) ^ 0x31 : crc << 1;
+        }
+    }
+    return crc;
+}
+
+static esp_err_t send_cmd(i2c_dev_t *dev, uint16_t cmd, const uint16_t *data, size_t words)
+{
+    uint8_t buf[2 + 3 * 3];
+    buf[0] = cmd >> 8;
+    buf[1] = cmd & 0xff;
+    for (size_t i = 0; i < words; i++){
+        buf[2 + i * 3] = data[i] >> 8;
+        buf[2 + i * 3 + 1] = data[i] & 0xff;
+        buf[2 + i * 3 + 2] = crc8(&buf[2 + i * 3], 2);
+    }
+    return i2c_dev_write(dev, NULL, 0, buf, 2 + words * 3);
+}
+
+static esp_err_t read_resp(i2c_dev_t *dev, uint16_t *data, size_t words)
+{
+    uint8_t buf[3 * 3];
+    esp_err_t err = i2c_dev_read(dev, NULL, 0, buf, words * 3);
+    if (err != ESP_OK){return err;}
+    for (size_t i = 0; i < words; i++){
+        if (crc8(&buf[i * 3], 2) != buf[i * 3 + 2]){return ESP_ERR_INVALID_CRC;}
+        data[i] = (buf[i * 3] << 8) | buf[i * 3 + 1];
+    }
+    return ESP_OK;
+}
+
+// Sends a command, waits its execution time, and reads its response words. The driver sleeps waits over 10 ms, and
+// busy waits the shorter ones.
+static esp_err_t execute_cmd(i2c_dev_t *dev, uint16_t cmd, uint32_t timeout_ms, const uint16_t *out_data,
+                             size_t out_words, uint16_t *in_data, size_t in_words)
+{
+    esp_err_t err = send_cmd(dev, cmd, out_data, out_words);
+    if (err != ESP_OK){return err;}
+    if (timeout_ms > 10){
+        vTaskDelay(pdMS_TO_TICKS(timeout_ms));
+    } else if (timeout_ms > 0){
+        esp_rom_delay_us(timeout_ms * 1000);
+    }
+    return in_words > 0 ? read_resp(dev, in_data, in_words) : ESP_OK;
+}
+
+esp_err_t scd4x_init_desc(i2c_dev_t *dev, i2c_port_t port, gpio_num_t sda_gpio, gpio_num_t scl_gpio)
+{
+    memset(dev, 0, sizeof(*dev));
+    dev->port = port;
+    dev->addr = SCD4X_I2C_ADDR;
+    dev->sda_io_num = sda_gpio;
+    dev->scl_io_num = scl_gpio;
+    dev->clk_speed = 100000;
+    return ESP_OK;
+}
+
+esp_err_t scd4x_start_periodic_measurement(i2c_dev_t *dev)
+{
+    return execute_cmd(dev, CMD_START_PERIODIC_MEASUREMENT, 0, NULL, 0, NULL, 0);
+}
+
+esp_err_t scd4x_read_measurement_ticks(i2c_dev_t *dev, uint16_t *co2, uint16_t *temperature, uint16_t *humidity)
+{
+    uint16_t buf[3];
+    esp_err_t err = execute_cmd(dev, CMD_READ_MEASUREMENT, 1, NULL, 0, buf, 3);
+    if (err != ESP_OK){return err;}
+    *co2 = buf[0];
+    *temperature = buf[1];
+    *humidity = buf[2];
+    return ESP_OK;
+}
+
+esp_err_t scd4x_read_measurement(i2c_dev_t *dev, uint16_t *co2, float *temperature, float *humidity)
+{
+    uint16_t t_raw, h_raw;
+    esp_err_t err = scd4x_read_measurement_ticks(dev, co2, &t_raw, &h_raw);
+    if (err != ESP_OK){return err;}
+    *temperature = (float)t_raw * 175.0f / 65536.0f - 45.0f;
+    *humidity = (float)h_raw * 100.0f / 65536.0f;
+    return ESP_OK;
+}
+
+esp_err_t scd4x_stop_periodic_measurement(i2c_dev_t *dev)
+{
+    return execute_cmd(dev, CMD_STOP_PERIODIC_MEASUREMENT, 500, NULL, 0, NULL, 0);
+}
+
+esp_err_t scd4x_get_automatic_self_calibration(i2c_dev_t *dev, bool *enabled)
+{
+    uint16_t value;
+    esp_err_t err = execute_cmd(dev, CMD_GET_AUTOMATIC_SELF_CALIBRATION, 1, NULL, 0, &value, 1);
+    if (err == ESP_OK){*enabled = value != 0;}
+    return err;
+}
+
+esp_err_t scd4x_set_automatic_self_calibration(i2c_dev_t *dev, bool enabled)
+{
+    uint16_t value = enabled;
+    return execute_cmd(dev, CMD_SET_AUTOMATIC_SELF_CALIBRATION, 1, &value, 1, NULL, 0);
+}
+
+esp_err_t scd4x_start_low_power_periodic_measurement(i2c_dev_t *dev)
+{
+    return execute_cmd(dev, CMD_START_LOW_POWER_PERIODIC_MEASUREMENT, 0, NULL, 0, NULL, 0);
+}
+
+esp_err_t scd4x_get_data_ready_status(i2c_dev_t *dev, bool *data_ready)
+{
+    uint16_t status;
+    esp_err_t err = execute_cmd(dev, CMD_GET_DATA_READY_STATUS, 1, NULL, 0, &status, 1);
+    if (err == ESP_OK){*data_ready = (status & 0x7ff) != 0;}
+    return err;
+}
+
+esp_err_t scd4x_get_serial_number(i2c_dev_t *dev, uint16_t *serial0, uint16_t *serial1, uint16_t *serial2)
+{
+    uint16_t buf[3];
+    esp_err_t err = execute_cmd(dev, CMD_GET_SERIAL_NUMBER, 1, NULL, 0, buf, 3);
+    if (err != ESP_OK){return err;}
+    *serial0 = buf[0];
+    *serial1 = buf[1];
+    *serial2 = buf[2];
+    return ESP_OK;
+}
+
+esp_err_t scd4x_perform_self_test(i2c_dev_t *dev, bool *malfunction)
+{
+    uint16_t value;
+    esp_err_t err = execute_cmd(dev, CMD_PERFORM_SELF_TEST, 10000, NULL, 0, &value, 1);
+    if (err == ESP_OK){*malfunction = value != 0;}
+    return err;
+}
+
+esp_err_t scd4x_reinit(i2c_dev_t *dev)
+{
+    return execute_cmd(dev, CMD_REINIT, 20, NULL, 0, NULL, 0);
+}
+
+esp_err_t scd4x_measure_single_shot(i2c_dev_t *dev)
+{
+    return execute_cmd(dev, CMD_MEASURE_SINGLE_SHOT, 5000, NULL, 0, NULL, 0);
+}
+
+esp_err_t scd4x_power_down(i2c_dev_t *dev)
+{
+    return execute_cmd(dev, CMD_POWER_DOWN, 1, NULL, 0, NULL, 0);
+}
+
+esp_err_t scd4x_wake_up(i2c_dev_t *dev)
+{
+    return execute_cmd(dev, CMD_WAKE_UP, 20, NULL, 0, NULL, 0);
+}
@@ -0,0 +1,480 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/semphr.h"
+#include "esp_zigbee_core.h"
+#include "kernel.h"
+
+#define MAX_SIGNALS 8
+#define MAX_ALARMS 8
+
+struct signal {
+    esp_zb_app_signal_type_t type;
+    esp_err_t status;
+};
+
+struct alarm {
+    esp_zb_callback_t callback;
+    uint8_t param;
+    int64_t at_us;  // -1 for a free slot
+};
+
+// Signals and alarms for the main loop, which waits on 'signals'. Under the kernel lock.
+static struct signal signals[MAX_SIGNALS];
+static uint32_t signals_head = 0;
+static uint32_t n_signals = 0;
+static struct alarm alarms[MAX_ALARMS];
+
+// The stack, guarded by the Zigbee lock
+static StaticSemaphore_t zb_lock_control;
+static SemaphoreHandle_t zb_lock = NULL;
+static esp_zb_ep_list_t *device = NULL;
+static struct shim_zb_stats stats;
+
+static const esp_zb_ieee_addr_t EXTENDED_PAN_ID = {0x6b, 0x1a, 0xc0, 0xff, 0xee, 0x00, 0x00, 0x02};
+
+static void post_signal(esp_zb_app_signal_type_t type, esp_err_t status)
+{
+    shim_lock();
+    if (n_signals == MAX_SIGNALS){
+        fprintf(stderr, "shim: too many Zigbee signals pending\n");
+        abort();
+    }
+    signals[(signals_head + n_signals) % MAX_SIGNALS] = (struct signal){type, status};
+    n_signals++;
+    shim_wake(signals);
+    shim_unlock();
+}
+
+esp_err_t esp_zb_platform_config(esp_zb_platform_config_t *config)
+{
+    return config != NULL && config->radio_config.radio_mode == ZB_RADIO_MODE_NATIVE ? ESP_OK : ESP_ERR_NOT_SUPPORTED;
+}
+
+void esp_zb_init(esp_zb_cfg_t *nwk_cfg)
+{
+    (void)nwk_cfg;
+    zb_lock = xSemaphoreCreateRecursiveMutexStatic(&zb_lock_control);
+    for (int i = 0; i < MAX_ALARMS; i++){alarms[i].at_us = -1;}
+}
+
+bool esp_zb_lock_acquire(TickType_t block_ticks)
+{
+    return xSemaphoreTakeRecursive(zb_lock, block_ticks) == pdTRUE;
+}
+
+void esp_zb_lock_release(void)
+{
+    xSemaphoreGiveRecursive(zb_lock);
+}
+
+static void check_locked(const char *function)
+{
+    shim_lock();
+    bool locked = zb_lock != NULL && zb_lock->holder == shim_self();
+    shim_unlock();
+    if (!locked){
+        fprintf(stderr, "shim: %s() called without the Zigbee lock\n", function);
+        abort();
+    }
+}
+
+esp_err_t esp_zb_device_register(esp_zb_ep_list_t *ep_list)
+{
+    device = ep_list;
+    return ESP_OK;
+}
+
+esp_err_t esp_zb_set_primary_network_channel_set(uint32_t channel_mask)
+{
+    return (channel_mask & ~ESP_ZB_TRANSCEIVER_ALL_CHANNELS_MASK) == 0 ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t esp_zb_start(bool autostart)
+{
+    if (device == NULL){return ESP_ERR_INVALID_STATE;}
+    // Without autostart the application starts the commissioning, when it gets this signal
+    post_signal(autostart ? ESP_ZB_BDB_SIGNAL_DEVICE_FIRST_START : ESP_ZB_ZDO_SIGNAL_SKIP_STARTUP, ESP_OK);
+    return ESP_OK;
+}
+
+void esp_zb_stack_main_loop(void)
+{
+    shim_lock();
+    while (1){
+        if (n_signals > 0){
+            struct signal s = signals[signals_head];
+            signals_head = (signals_head + 1) % MAX_SIGNALS;
+            n_signals--;
+            shim_unlock();
+            uint32_t type = s.type;
+            esp_zb_app_signal_t app_signal = {.p_app_signal = &type, .esp_err_status = s.status};
+            esp_zb_lock_acquire(portMAX_DELAY);
+            esp_zb_app_signal_handler(&app_signal);
+            esp_zb_lock_release();
+            shim_lock();
+            continue;
+        }
+        struct alarm *next = NULL;
+        for (int i = 0; i < MAX_ALARMS; i++){
+            if (alarms[i].at_us >= 0 && (next == NULL || alarms[i].at_us < next->at_us)){next = &alarms[i];}
+        }
+        if (next != NULL && next->at_us <= shim_now_us()){
+            struct alarm due = *next;
+            next->at_us = -1;
+            shim_unlock();
+            esp_zb_lock_acquire(portMAX_DELAY);
+            due.callback(due.param);
+            esp_zb_lock_release();
+            shim_lock();
+            continue;
+        }
+        shim_block(signals, next != NULL ? next->at_us : -1);
+    }
+}
+
+esp_err_t esp_zb_bdb_start_top_level_commissioning(uint8_t mode_mask)
+{
+    if (mode_mask == ESP_ZB_BDB_MODE_INITIALIZATION){
+        post_signal(stats.joined ? ESP_ZB_BDB_SIGNAL_DEVICE_REBOOT : ESP_ZB_BDB_SIGNAL_DEVICE_FIRST_START, ESP_OK);
+    } else if (mode_mask & ESP_ZB_BDB_MODE_NETWORK_STEERING){
+        stats.joined = true;
+        post_signal(ESP_ZB_BDB_SIGNAL_STEERING, ESP_OK);
+    } else {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    return ESP_OK;
+}
+
+bool esp_zb_bdb_is_factory_new(void)
+{
+    return !stats.joined;
+}
+
+void esp_zb_get_extended_pan_id(esp_zb_ieee_addr_t ext_pan_id)
+{
+    memcpy(ext_pan_id, EXTENDED_PAN_ID, sizeof(EXTENDED_PAN_ID));
+}
+
+uint16_t esp_zb_get_pan_id(void)
+{
+    return 0x1a6b;
+}
+
+uint8_t esp_zb_get_current_channel(void)
+{
+    return 15;
+}
+
+uint16_t esp_zb_get_short_address(void)
+{
+    return stats.joined ? 0x4f1c : 0xffff;
+}
+
+void esp_zb_scheduler_alarm(esp_zb_callback_t cb, uint8_t param, uint32_t time)
+{
+    shim_lock();
+    int i = 0;
+    while (i < MAX_ALARMS && alarms[i].at_us >= 0){i++;}
+    if (i == MAX_ALARMS){
+        fprintf(stderr, "shim: too many Zigbee alarms\n");
+        abort();
+    }
+    alarms[i] = (struct alarm){cb, param, shim_now_us() + (int64_t)time * 1000};
+    shim_wake(signals);
+    shim_unlock();
+}
+
+const char *esp_zb_zdo_signal_to_string(esp_zb_app_signal_type_t signal)
+{
+    switch (signal){
+    case ESP_ZB_ZDO_SIGNAL_DEFAULT_START: return "ZDO_SIGNAL_DEFAULT_START";
+    case ESP_ZB_ZDO_SIGNAL_SKIP_STARTUP: return "ZDO_SIGNAL_SKIP_STARTUP";
+    case ESP_ZB_ZDO_SIGNAL_DEVICE_ANNCE: return "ZDO_SIGNAL_DEVICE_ANNCE";
+    case ESP_ZB_ZDO_SIGNAL_LEAVE: return "ZDO_SIGNAL_LEAVE";
+    case ESP_ZB_ZDO_SIGNAL_ERROR: return "ZDO_SIGNAL_ERROR";
+    case ESP_ZB_BDB_SIGNAL_DEVICE_FIRST_START: return "BDB_SIGNAL_DEVICE_FIRST_START";
+    case ESP_ZB_BDB_SIGNAL_DEVICE_REBOOT: return "BDB_SIGNAL_DEVICE_REBOOT";
+    case ESP_ZB_BDB_SIGNAL_STEERING: return "BDB_SIGNAL_STEERING";
+    case ESP_ZB_BDB_SIGNAL_FORMATION: return "BDB_SIGNAL_FORMATION";
+    case ESP_ZB_COMMON_SIGNAL_CAN_SLEEP: return "COMMON_SIGNAL_CAN_SLEEP";
+    default: return "Unknown";
+    }
+}
+
+// Endpoints, clusters and attributes
+
+esp_zb_ep_list_t *esp_zb_ep_list_create(void)
+{
+    return calloc(1, sizeof(esp_zb_ep_list_t));
+}
+
+esp_err_t esp_zb_ep_list_add_ep(esp_zb_ep_list_t *ep_list, esp_zb_cluster_list_t *cluster_list,
+                                esp_zb_endpoint_config_t endpoint_config)
+{
+    esp_zb_ep_list_t *ep = calloc(1, sizeof(*ep));
+    ep->config = endpoint_config;
+    ep->cluster_list = cluster_list;
+    while (ep_list->next != NULL){ep_list = ep_list->next;}
+    ep_list->next = ep;
+    return ESP_OK;
+}
+
+esp_zb_cluster_list_t *esp_zb_zcl_cluster_list_create(void)
+{
+    return calloc(1, sizeof(esp_zb_cluster_list_t));
+}
+
+esp_zb_attribute_list_t *esp_zb_zcl_attr_list_create(uint16_t cluster_id)
+{
+    esp_zb_attribute_list_t *head = calloc(1, sizeof(*head));
+    head->cluster_id = cluster_id;
+    head->attribute.id = 0xffff;
+    return head;
+}
+
+static size_t attr_size(uint8_t type, const void *value)
+{
+    switch (type){
+    case ESP_ZB_ZCL_ATTR_TYPE_BOOL:
+    case ESP_ZB_ZCL_ATTR_TYPE_U8:
+    case ESP_ZB_ZCL_ATTR_TYPE_8BIT_ENUM: return 1;
+    case ESP_ZB_ZCL_ATTR_TYPE_U16:
+    case ESP_ZB_ZCL_ATTR_TYPE_S16: return 2;
+    case ESP_ZB_ZCL_ATTR_TYPE_U32:
+    case ESP_ZB_ZCL_ATTR_TYPE_SINGLE: return 4;
+    case ESP_ZB_ZCL_ATTR_TYPE_CHAR_STRING: return 1 + ((const uint8_t *)value)[0];  // Length first
+    default:
+        fprintf(stderr, "shim: ZCL attribute type 0x%02x is not supported\n", type);
+        abort();
+    }
+}
+
+static esp_err_t add_attr(esp_zb_attribute_list_t *attr_list, uint16_t attr_id, uint16_t manuf_code, uint8_t type,
+                          uint8_t access, const void *value)
+{
+    if (attr_list == NULL || value == NULL){return ESP_ERR_INVALID_ARG;}
+    esp_zb_attribute_list_t **tail = &attr_list->next;
+    for (; *tail != NULL; tail = &(*tail)->next){
+        if ((*tail)->attribute.id == attr_id && (*tail)->attribute.manuf_code == manuf_code){return ESP_ERR_INVALID_ARG;}
+    }
+    // Strings get their maximum size, as on the device
+    size_t size = type == ESP_ZB_ZCL_ATTR_TYPE_CHAR_STRING ? 256 : attr_size(type, value);
+    esp_zb_attribute_list_t *node = calloc(1, sizeof(*node));
+    node->cluster_id = attr_list->cluster_id;
+    node->attribute = (esp_zb_zcl_attr_t){attr_id, type, access, manuf_code, calloc(1, size)};
+    memcpy(node->attribute.data_p, value, attr_size(type, value));
+    *tail = node;
+    return ESP_OK;
+}
+
+static esp_err_t add_standard_attr(esp_zb_attribute_list_t *attr_list, uint16_t attr_id, uint8_t type,
+                                   const void *value)
+{
+    return add_attr(attr_list, attr_id, ESP_ZB_ZCL_ATTR_NON_MANUFACTURER_SPECIFIC, type,
+                    ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY | ESP_ZB_ZCL_ATTR_ACCESS_REPORTING, value);
+}
+
+esp_zb_attribute_list_t *esp_zb_basic_cluster_create(esp_zb_basic_cluster_cfg_t *basic_cfg)
+{
+    esp_zb_attribute_list_t *list = esp_zb_zcl_attr_list_create(ESP_ZB_ZCL_CLUSTER_ID_BASIC);
+    add_standard_attr(list, ESP_ZB_ZCL_ATTR_BASIC_ZCL_VERSION_ID, ESP_ZB_ZCL_ATTR_TYPE_U8, &basic_cfg->zcl_version);
+    add_standard_attr(list, ESP_ZB_ZCL_ATTR_BASIC_POWER_SOURCE_ID, ESP_ZB_ZCL_ATTR_TYPE_8BIT_ENUM,
+                      &basic_cfg->power_source);
+    return list;
+}
+
+esp_zb_attribute_list_t *esp_zb_identify_cluster_create(esp_zb_identify_cluster_cfg_t *identify_cfg)
+{
+    esp_zb_attribute_list_t *list = esp_zb_zcl_attr_list_create(ESP_ZB_ZCL_CLUSTER_ID_IDENTIFY);
+    add_standard_attr(list, ESP_ZB_ZCL_ATTR_IDENTIFY_IDENTIFY_TIME_ID, ESP_ZB_ZCL_ATTR_TYPE_U16,
+                      &identify_cfg->identify_time);
+    return list;
+}
+
+esp_zb_attribute_list_t *esp_zb_temperature_meas_cluster_create(esp_zb_temperature_meas_cluster_cfg_t *temperature_cfg)
+{
+    esp_zb_attribute_list_t *list = esp_zb_zcl_attr_list_create(ESP_ZB_ZCL_CLUSTER_ID_TEMP_MEASUREMENT);
+    add_standard_attr(list, ESP_ZB_ZCL_ATTR_TEMP_MEASUREMENT_VALUE_ID, ESP_ZB_ZCL_ATTR_TYPE_S16,
+                      &temperature_cfg->measured_value);
+    add_standard_attr(list, ESP_ZB_ZCL_ATTR_TEMP_MEASUREMENT_MIN_VALUE_ID, ESP_ZB_ZCL_ATTR_TYPE_S16,
+                      &temperature_cfg->min_value);
+    add_standard_attr(list, ESP_ZB_ZCL_ATTR_TEMP_MEASUREMENT_MAX_VALUE_ID, ESP_ZB_ZCL_ATTR_TYPE_S16,
+                      &temperature_cfg->max_value);
+    return list;
+}
+
+esp_zb_attribute_list_t *esp_zb_humidity_meas_cluster_create(esp_zb_humidity_meas_cluster_cfg_t *humidity_cfg)
+{
+    esp_zb_attribute_list_t *list = esp_zb_zcl_attr_list_create(ESP_ZB_ZCL_CLUSTER_ID_REL_HUMIDITY_MEASUREMENT);
+    add_standard_attr(list, ESP_ZB_ZCL_ATTR_REL_HUMIDITY_MEASUREMENT_VALUE_ID, ESP_ZB_ZCL_ATTR_TYPE_U16,
+                      &humidity_cfg->measured_value);
+    add_standard_attr(list, ESP_ZB_ZCL_ATTR_REL_HUMIDITY_MEASUREMENT_MIN_VALUE_ID, ESP_ZB_ZCL_ATTR_TYPE_U16,
+                      &humidity_cfg->min_value);
+    add_standard_attr(list, ESP_ZB_ZCL_ATTR_REL_HUMIDITY_MEASUREMENT_MAX_VALUE_ID, ESP_ZB_ZCL_ATTR_TYPE_U16,
+                      &humidity_cfg->max_value);
+    return list;
+}
+
+esp_zb_attribute_list_t *esp_zb_carbon_dioxide_measurement_cluster_create(
+    esp_zb_carbon_dioxide_measurement_cluster_cfg_t *carbon_dioxide_cfg)
+{
+    esp_zb_attribute_list_t *list = esp_zb_zcl_attr_list_create(ESP_ZB_ZCL_CLUSTER_ID_CARBON_DIOXIDE_MEASUREMENT);
+    add_standard_attr(list, ESP_ZB_ZCL_ATTR_CARBON_DIOXIDE_MEASUREMENT_MEASURED_VALUE_ID, ESP_ZB_ZCL_ATTR_TYPE_SINGLE,
+                      &carbon_dioxide_cfg->measured_value);
+    add_standard_attr(list, ESP_ZB_ZCL_ATTR_CARBON_DIOXIDE_MEASUREMENT_MIN_MEASURED_VALUE_ID,
+                      ESP_ZB_ZCL_ATTR_TYPE_SINGLE, &carbon_dioxide_cfg->min_measured_value);
+    add_standard_attr(list, ESP_ZB_ZCL_ATTR_CARBON_DIOXIDE_MEASUREMENT_MAX_MEASURED_VALUE_ID,
+                      ESP_ZB_ZCL_ATTR_TYPE_SINGLE, &carbon_dioxide_cfg->max_measured_value);
+    return list;
+}
+
+esp_zb_attribute_list_t *esp_zb_on_off_cluster_create(esp_zb_on_off_cluster_cfg_t *on_off_cfg)
+{
+    esp_zb_attribute_list_t *list = esp_zb_zcl_attr_list_create(ESP_ZB_ZCL_CLUSTER_ID_ON_OFF);
+    add_standard_attr(list, ESP_ZB_ZCL_ATTR_ON_OFF_ON_OFF_ID, ESP_ZB_ZCL_ATTR_TYPE_BOOL, &on_off_cfg->on_off);
+    return list;
+}
+
+esp_zb_attribute_list_t *esp_zb_level_cluster_create(esp_zb_level_cluster_cfg_t *level_cfg)
+{
+    esp_zb_attribute_list_t *list = esp_zb_zcl_attr_list_create(ESP_ZB_ZCL_CLUSTER_ID_LEVEL_CONTROL);
+    add_standard_attr(list, ESP_ZB_ZCL_ATTR_LEVEL_CONTROL_CURRENT_LEVEL_ID, ESP_ZB_ZCL_ATTR_TYPE_U8,
+                      &level_cfg->current_level);
+    return list;
+}
+
+esp_err_t esp_zb_basic_cluster_add_attr(esp_zb_attribute_list_t *attr_list, uint16_t attr_id, void *value_p)
+{
+    if (attr_id != ESP_ZB_ZCL_ATTR_BASIC_MANUFACTURER_NAME_ID && attr_id != ESP_ZB_ZCL_ATTR_BASIC_MODEL_IDENTIFIER_ID){
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    return add_standard_attr(attr_list, attr_id, ESP_ZB_ZCL_ATTR_TYPE_CHAR_STRING, value_p);
+}
+
+esp_err_t esp_zb_cluster_add_manufacturer_attr(esp_zb_attribute_list_t *attr_list, uint16_t cluster_id,
+                                               uint16_t attr_id, uint16_t manuf_code, uint8_t attr_type,
+                                               uint8_t attr_access, void *value_p)
+{
+    if (attr_list == NULL || attr_list->cluster_id != cluster_id){return ESP_ERR_INVALID_ARG;}
+    return add_attr(attr_list, attr_id, manuf_code, attr_type, attr_access, value_p);
+}
+
+static esp_err_t add_cluster(esp_zb_cluster_list_t *cluster_list, esp_zb_attribute_list_t *attr_list,
+                             uint16_t cluster_id, uint8_t role_mask)
+{
+    if (cluster_list == NULL || attr_list == NULL || attr_list->cluster_id != cluster_id){return ESP_ERR_INVALID_ARG;}
+    esp_zb_cluster_list_t **tail = &cluster_list->next;
+    for (; *tail != NULL; tail = &(*tail)->next){
+        if ((*tail)->cluster_id == cluster_id && (*tail)->role_mask == role_mask){return ESP_ERR_INVALID_ARG;}
+    }
+    *tail = calloc(1, sizeof(esp_zb_cluster_list_t));
+    (*tail)->cluster_id = cluster_id;
+    (*tail)->role_mask = role_mask;
+    (*tail)->attr_list = attr_list;
+    return ESP_OK;
+}
+
+esp_err_t esp_zb_cluster_list_add_basic_cluster(esp_zb_cluster_list_t *cluster_list, esp_zb_attribute_list_t *attr_list,
+                                                uint8_t role_mask)
+{
+    return add_cluster(cluster_list, attr_list, ESP_ZB_ZCL_CLUSTER_ID_BASIC, role_mask);
+}
+
+esp_err_t esp_zb_cluster_list_add_identify_cluster(esp_zb_cluster_list_t *cluster_list,
+                                                   esp_zb_attribute_list_t *attr_list, uint8_t role_mask)
+{
+    return add_cluster(cluster_list, attr_list, ESP_ZB_ZCL_CLUSTER_ID_IDENTIFY, role_mask);
+}
+
+esp_err_t esp_zb_cluster_list_add_temperature_meas_cluster(esp_zb_cluster_list_t *cluster_list,
+                                                           esp_zb_attribute_list_t *attr_list, uint8_t role_mask)
+{
+    return add_cluster(cluster_list, attr_list, ESP_ZB_ZCL_CLUSTER_ID_TEMP_MEASUREMENT, role_mask);
+}
+
+esp_err_t esp_zb_cluster_list_add_humidity_meas_cluster(esp_zb_cluster_list_t *cluster_list,
+                                                        esp_zb_attribute_list_t *attr_list, uint8_t role_mask)
+{
+    return add_cluster(cluster_list, attr_list, ESP_ZB_ZCL_CLUSTER_ID_REL_HUMIDITY_MEASUREMENT, role_mask);
+}
+
+esp_err_t esp_zb_cluster_list_add_carbon_dioxide_measurement_cluster(esp_zb_cluster_list_t *cluster_list,
+                                                                     esp_zb_attribute_list_t *attr_list,
+                                                                     uint8_t role_mask)
+{
+    return add_cluster(cluster_list, attr_list, ESP_ZB_ZCL_CLUSTER_ID_CARBON_DIOXIDE_MEASUREMENT, role_mask);
+}
+
+esp_err_t esp_zb_cluster_list_add_on_off_cluster(esp_zb_cluster_list_t *cluster_list, esp_zb_attribute_list_t *attr_list,
+                                                 uint8_t role_mask)
+{
+    return add_cluster(cluster_list, attr_list, ESP_ZB_ZCL_CLUSTER_ID_ON_OFF, role_mask);
+}
+
+esp_err_t esp_zb_cluster_list_add_level_cluster(esp_zb_cluster_list_t *cluster_list, esp_zb_attribute_list_t *attr_list,
+                                                uint8_t role_mask)
+{
+    return add_cluster(cluster_list, attr_list, ESP_ZB_ZCL_CLUSTER_ID_LEVEL_CONTROL, role_mask);
+}
+
+esp_err_t esp_zb_zcl_update_reporting_info(esp_zb_zcl_reporting_info_t *config)
+{
+    if (esp_zb_zcl_get_manufacturer_attribute(config->ep, config->cluster_id, config->cluster_role, config->attr_id,
+                                              config->manuf_code) == NULL){
+        return ESP_ERR_NOT_FOUND;
+    }
+    stats.reporting_infos++;
+    return ESP_OK;
+}
+
+esp_zb_zcl_attr_t *esp_zb_zcl_get_manufacturer_attribute(uint8_t endpoint, uint16_t cluster_id, uint8_t cluster_role,
+                                                         uint16_t attr_id, uint16_t manuf_code)
+{
+    for (esp_zb_ep_list_t *ep = device != NULL ? device->next : NULL; ep != NULL; ep = ep->next){
+        if (ep->config.endpoint != endpoint){continue;}
+        for (esp_zb_cluster_list_t *c = ep->cluster_list->next; c != NULL; c = c->next){
+            if (c->cluster_id != cluster_id || !(c->role_mask & cluster_role)){continue;}
+            for (esp_zb_attribute_list_t *a = c->attr_list->next; a != NULL; a = a->next){
+                if (a->attribute.id == attr_id && a->attribute.manuf_code == manuf_code){return &a->attribute;}
+            }
+        }
+    }
+    return NULL;
+}
+
+esp_zb_zcl_attr_t *esp_zb_zcl_get_attribute(uint8_t endpoint, uint16_t cluster_id, uint8_t cluster_role,
+                                            uint16_t attr_id)
+{
+    return esp_zb_zcl_get_manufacturer_attribute(endpoint, cluster_id, cluster_role, attr_id,
+                                                 ESP_ZB_ZCL_ATTR_NON_MANUFACTURER_SPECIFIC);
+}
+
+esp_zb_zcl_status_t esp_zb_zcl_set_manufacturer_attribute_val(uint8_t endpoint, uint16_t cluster_id,
+                                                              uint8_t cluster_role, uint16_t manuf_code,
+                                                              uint16_t attr_id, void *value_p, bool check)
+{
+    (void)check;
+    check_locked(__func__);
+    esp_zb_zcl_attr_t *attr = esp_zb_zcl_get_manufacturer_attribute(endpoint, cluster_id, cluster_role, attr_id,
+                                                                    manuf_code);
+    if (attr == NULL){return ESP_ZB_ZCL_STATUS_UNSUP_ATTRIB;}
+    memcpy(attr->data_p, value_p, attr_size(attr->type, value_p));
+    stats.attribute_writes++;
+    return ESP_ZB_ZCL_STATUS_SUCCESS;
+}
+
+esp_zb_zcl_status_t esp_zb_zcl_set_attribute_val(uint8_t endpoint, uint16_t cluster_id, uint8_t cluster_role,
+                                                 uint16_t attr_id, void *value_p, bool check)
+{
+    return esp_zb_zcl_set_manufacturer_attribute_val(endpoint, cluster_id, cluster_role,
+                                                     ESP_ZB_ZCL_ATTR_NON_MANUFACTURER_SPECIFIC, attr_id, value_p,
+                                                     check);
+}
+
+void shim_zb_get_stats(struct shim_zb_stats *out)
+{
+    esp_zb_lock_acquire(portMAX_DELAY);
+    *out = stats;
+    esp_zb_lock_release();
+}
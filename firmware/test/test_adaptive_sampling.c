@@ -0,0 +1,138 @@
+/*
+Runs the adaptive sampling policy of main/scd40/adaptive_sampling.c through a simulated office day, sampling at the
+periods it picks, and compares it with sampling at the configured period all the time. The CO2 is steady over night,
+rises while people come in, stays near an LED limit, and decays while windows are open, with the noise of the SCD40
+on top.
+
+The policy must sample at the configured period while the CO2 is steady and far from the limits, and see the LED
+limits crossed sooner than the fixed period does. On a steady level close to a limit, the noise alone must not make it
+oscillate between periods.
+*/
+
+#include <inttypes.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "check.h"
+#include "../main/scd40/adaptive_sampling.h"
+
+#define CEILING_S 300
+#define DAY_S (24 * 60 * 60)
+#define NOISE_PPM 10
+#define H (60 * 60)
+
+static const struct led_cfg_s limits = {.brightness = 0.3, .limit_medium = 1000, .limit_high = 1500,
+                                        .limit_critical = 2000};
+
+// The CO2 of the simulated day at 't' seconds after midnight, without noise
+static double day_co2(uint32_t t)
+{
+    if (t < 7 * H){return 450;}
+    if (t < 9 * H){return 450 + 600.0 * (t - 7 * H) / H;}                              // Filling up, to 1650
+    if (t < 10 * H){return 1650 - 170.0 * (t - 9 * H) / H;}                            // Slowly down to 1480
+    if (t < 12 * H){return 1480 + 15 * sin(2 * M_PI * (t - 10 * H) / (40 * 60));}       // Just below the high limit
+    if (t < 13 * H){return 420 + 1060 * exp(-2.0 * (t - 12 * H) / H);}                 // Windows open at lunch
+    double lunch_end = 420 + 1060 * exp(-2.0);
+    if (t < 17 * H){return lunch_end + 300.0 * (t - 13 * H) / H;}                       // Afternoon
+    return 420 + (lunch_end + 1200 - 420) * exp(-0.5 * (t - 17 * H) / H);              // Empty, windows shut
+}
+
+struct run {
+    uint32_t samples;
+    uint32_t changes;
+    uint32_t max_crossing_delay_s;  // From a limit crossing of the CO2 to the first sample that sees it
+    uint32_t night_samples;         // Samples while the CO2 is steady and far from the limits
+    uint32_t night_short_samples;   // Of those, the ones taken at less than the ceiling
+};
+
+static int zone(double co2)
+{
+    return (co2 >= limits.limit_medium) + (co2 >= limits.limit_high) + (co2 >= limits.limit_critical);
+}
+
+static void run_day(bool enabled, struct run *r)
+{
+    memset(r, 0, sizeof(*r));
+    srand(3);
+    adaptive_sampling_reset(CEILING_S, enabled);
+    struct adaptive_sampling_stats before;
+    adaptive_sampling_get_stats(&before);
+
+    uint32_t t = 0;
+    uint32_t period = CEILING_S;
+    int seen_zone = zone(day_co2(0));
+    while (t < DAY_S){
+        double co2 = day_co2(t);
+        struct SCD40measurement m = {.co2 = (uint16_t)lround(co2 + rand() % (2 * NOISE_PPM + 1) - NOISE_PPM)};
+        uint32_t next = adaptive_sampling_update(&m, t, &limits);
+        r->samples++;
+        if (next != period){r->changes++;}
+        if (t < 7 * H && t > 30 * 60){
+            r->night_samples++;
+            if (next < CEILING_S){r->night_short_samples++;}
+        }
+
+        // When the sample sees a new zone, find when the CO2 entered it
+        int z = zone(co2);
+        if (z != seen_zone){
+            uint32_t crossed = t;
+            while (crossed > 0 && zone(day_co2(crossed - 1)) == z){crossed--;}
+            if (t - crossed > r->max_crossing_delay_s){r->max_crossing_delay_s = t - crossed;}
+            seen_zone = z;
+        }
+        period = next;
+        t += period;
+    }
+
+    struct adaptive_sampling_stats after;
+    adaptive_sampling_get_stats(&after);
+    CHECK(after.samples == before.samples + r->samples);
+    CHECK(after.period_changes - before.period_changes == r->changes);
+    CHECK(after.enabled == enabled);
+    CHECK(after.ceiling_s == CEILING_S);
+}
+
+int main(void)
+{
+    struct run fixed, adaptive;
+    run_day(false, &fixed);
+    run_day(true, &adaptive);
+    printf("fixed %u s:  %4" PRIu32 " samples, %3" PRIu32 " period changes, limit crossings seen after up to %3" PRIu32
+           " s\n", CEILING_S, fixed.samples, fixed.changes, fixed.max_crossing_delay_s);
+    printf("adaptive:     %4" PRIu32 " samples, %3" PRIu32 " period changes, limit crossings seen after up to %3" PRIu32
+           " s\n", adaptive.samples, adaptive.changes, adaptive.max_crossing_delay_s);
+
+    // Disabled, it is the fixed period
+    CHECK(fixed.samples == DAY_S / CEILING_S);
+    CHECK(fixed.changes == 0);
+
+    // Steady and far from the limits, it samples at the configured period
+    CHECK(adaptive.night_samples > 0);
+    CHECK(adaptive.night_short_samples == 0);
+
+    // It sees the limits crossed well before the fixed period does, at a fraction of the samples of the floor
+    CHECK(adaptive.max_crossing_delay_s <= 60);
+    CHECK(adaptive.max_crossing_delay_s < fixed.max_crossing_delay_s);
+    CHECK(adaptive.samples < DAY_S / ADAPTIVE_SAMPLING_FLOOR_S / 5);
+
+    // The noise of the sensor alone does not make it oscillate between steps, also close to a limit. Settling from the
+    // ceiling takes a few changes.
+    adaptive_sampling_reset(CEILING_S, true);
+    struct adaptive_sampling_stats before, after;
+    adaptive_sampling_get_stats(&before);
+    uint32_t t = 2 * DAY_S;
+    for (int i = 0; i < 2 * H / 40; i++){
+        struct SCD40measurement m = {.co2 = limits.limit_high - 30 + rand() % (2 * NOISE_PPM + 1) - NOISE_PPM};
+        t += adaptive_sampling_update(&m, t, &limits);
+    }
+    adaptive_sampling_get_stats(&after);
+    printf("steady 30 PPM below a limit for 2 h: %" PRIu32 " period changes, period %u s\n",
+           after.period_changes - before.period_changes, after.period_s);
+    CHECK(after.period_changes - before.period_changes <= 6);
+
+    // With the ceiling at the floor there is nothing to adapt
+    adaptive_sampling_reset(ADAPTIVE_SAMPLING_FLOOR_S, true);
+    struct SCD40measurement m = {.co2 = 1490};
+    CHECK(adaptive_sampling_update(&m, DAY_S, &limits) == ADAPTIVE_SAMPLING_FLOOR_S);
+    return CHECK_RESULT();
+}
@@ -0,0 +1,97 @@
+/*
+Compares the adverts of bthome::Encoder, which the BLE task uses, byte for byte with those of bthome::Advertisement,
+built from scratch for every sample as the BLE task did before. Both get the fields of the device, temperature,
+humidity and CO2, over a sweep of values that includes negative temperatures and the limits of each field, in plain
+text and encrypted.
+
+With the name of the device, the three fields and the counter and MIC of the encryption take 34 bytes, more than an
+advert holds, so the encrypted adverts are compared with a shorter name. An Advertisement starts its encryption
+counter at a random value, and the Encoder once and then counts up. esp_random() is defined here so that every
+Advertisement starts where the Encoder is.
+*/
+
+#include <cinttypes>
+#include <cstring>
+#include "check.h"
+#include "esp_random.h"
+#include "advertisement.h"
+#include "encoder.h"
+
+using namespace bthome;
+
+static const uint8_t KEY[16] = {0x23, 0x1d, 0x39, 0xc1, 0xd7, 0xcc, 0x1a, 0xb1, 0xae, 0xe2, 0x24, 0xcd, 0x09, 0x6d,
+                                0xb9, 0x32};
+
+static uint32_t next_random = 0;
+
+uint32_t esp_random(void)
+{
+    return next_random;
+}
+
+struct sample {
+    int32_t temp_cdeg;
+    int32_t hum_cpct;
+    int32_t co2;
+};
+
+static uint32_t compare(const char *name, bool encrypt, const struct sample *samples, uint32_t n)
+{
+    next_random = 17;
+    Encoder encoder(name, encrypt, KEY);
+    int8_t temp_slot = encoder.addField(constants::ObjectId::TEMPERATURE_PRECISE);
+    int8_t hum_slot = encoder.addField(constants::ObjectId::HUMIDITY_PRECISE);
+    int8_t co2_slot = encoder.addField(constants::ObjectId::CO2);
+
+    uint32_t mismatches = 0;
+    for (uint32_t i = 0; i < n; i++){
+        const struct sample *s = &samples[i];
+        encoder.setValue(temp_slot, s->temp_cdeg);
+        encoder.setValue(hum_slot, s->hum_cpct);
+        encoder.setValue(co2_slot, s->co2);
+        const uint8_t *payload = encoder.getPayload();
+
+        next_random = 17 + i;
+        Measurement temp(constants::ObjectId::TEMPERATURE_PRECISE, (uint64_t)(int64_t)s->temp_cdeg);
+        Measurement hum(constants::ObjectId::HUMIDITY_PRECISE, (uint64_t)s->hum_cpct);
+        Measurement co2(constants::ObjectId::CO2, (uint64_t)s->co2);
+        Advertisement advert(name, encrypt, KEY);
+        advert.addMeasurement(temp);
+        advert.addMeasurement(hum);
+        advert.addMeasurement(co2);
+        const uint8_t *expected = advert.getPayload();
+
+        if (encoder.getPayloadSize() != advert.getPayloadSize() ||
+            memcmp(payload, expected, advert.getPayloadSize()) != 0){
+            if (mismatches == 0){
+                fprintf(stderr, "first mismatch, %s: %" PRId32 " cdeg %" PRId32 " cpct %" PRId32 " ppm\n",
+                        encrypt ? "encrypted" : "plain", s->temp_cdeg, s->hum_cpct, s->co2);
+            }
+            mismatches++;
+        }
+    }
+    return mismatches;
+}
+
+int main(void)
+{
+    static struct sample samples[1000];
+    uint32_t n = 0;
+    // The limits of the fields, then a sweep
+    samples[n++] = {0, 0, 0};
+    samples[n++] = {-1, 1, 1};
+    samples[n++] = {-4000, 10000, 40000};
+    samples[n++] = {INT16_MAX, UINT16_MAX, UINT16_MAX};
+    samples[n++] = {INT16_MIN, 0, 400};
+    while (n < sizeof(samples) / sizeof(samples[0])){
+        samples[n] = {-1000 + (int32_t)n * 7, (int32_t)(n * 997 % 10001), 400 + (int32_t)(n * 37 % 4600)};
+        n++;
+    }
+
+    uint32_t plain = compare("MINICO2", false, samples, n);
+    uint32_t encrypted = compare("CO2", true, samples, n);
+    printf("%" PRIu32 " samples: %" PRIu32 " plain and %" PRIu32 " encrypted adverts differ\n", n, plain, encrypted);
+    CHECK(plain == 0);
+    CHECK(encrypted == 0);
+    return CHECK_RESULT();
+}
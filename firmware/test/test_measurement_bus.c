@@ -0,0 +1,60 @@
+/*
+Checks the lapping of main/bus/measurement_bus.c in one thread: a subscriber up to MEASUREMENT_BUS_LEN measurements
+behind reads all of them in order and drops none, one that is further behind drops exactly the oldest ones, and one
+that has caught up reads nothing.
+*/
+
+#include <string.h>
+#include "check.h"
+#include "../main/bus/measurement_bus.h"
+
+static uint16_t next_co2 = 1;
+
+static void publish(uint32_t n)
+{
+    for (uint32_t i = 0; i < n; i++){
+        struct SCD40measurement meas = {.co2 = next_co2++};
+        measurement_bus_publish(&meas);
+    }
+}
+
+// Reads everything 'sub' has not read yet. Checks that the measurements come in order, from 'first_co2', and
+// returns how many there were.
+static uint32_t read_all(struct measurement_bus_subscriber *sub, uint16_t first_co2)
+{
+    struct SCD40measurement meas;
+    uint32_t read = 0;
+    while (measurement_bus_read(sub, &meas)){
+        CHECK(meas.co2 == first_co2 + read);
+        read++;
+    }
+    return read;
+}
+
+int main(void)
+{
+    static struct measurement_bus_subscriber sub;
+    CHECK(measurement_bus_subscribe(&sub) == ESP_OK);
+    CHECK(read_all(&sub, next_co2) == 0);
+
+    // Behind by fewer than MEASUREMENT_BUS_LEN, and by exactly MEASUREMENT_BUS_LEN
+    for (uint32_t behind = 1; behind <= MEASUREMENT_BUS_LEN; behind++){
+        uint16_t first = next_co2;
+        publish(behind);
+        CHECK(read_all(&sub, first) == behind);
+        CHECK(sub.dropped == 0);
+    }
+
+    // Behind by more: the oldest are dropped, and the last MEASUREMENT_BUS_LEN are read
+    uint32_t dropped = 0;
+    for (uint32_t extra = 1; extra <= 3 * MEASUREMENT_BUS_LEN; extra++){
+        uint16_t first = next_co2 + extra;
+        publish(MEASUREMENT_BUS_LEN + extra);
+        dropped += extra;
+        CHECK(read_all(&sub, first) == MEASUREMENT_BUS_LEN);
+        CHECK(sub.dropped == dropped);
+    }
+
+    CHECK(measurement_bus_head() == next_co2 - 1);
+    return CHECK_RESULT();
+}
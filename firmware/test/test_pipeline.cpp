@@ -0,0 +1,205 @@
+/*
+Runs the tasks of the firmware on the host: the topology of main/topology/topology.cpp started the way app_main starts
+it, with the SCD40 task reading the simulated SCD4x through the scd4x driver, the controller, the LED task on the
+led_strip shim, the BLE task on the GAP shim of shim/bluedroid.c, the ZigBee task on the ZCL shim of shim/zigbee.c,
+the flash log, and the config in the NVS shim. Everything runs on the virtual clock of shim/kernel.h.
+
+Feeds the sensor an office week, a CO2 level per hour, and runs a week of sampling at 30 s. Checks that every sample
+went through to the outputs: the measurement bus, the ZCL attributes, the BLE adverts and the LED, and that a config
+change made during the week reaches the LED and NVS. The week must take seconds of the host's time.
+*/
+
+#include <inttypes.h>
+#include <string.h>
+#include <time.h>
+#include "check.h"
+#include "kernel.h"
+#include "freertos/task.h"
+#include "esp_event.h"
+#include "driver/usb_serial_jtag.h"
+#include "esp_gap_ble_api.h"
+#include "led_strip.h"
+#include "nvs_flash.h"
+#include "../main/types.h"
+#include "../main/topology/topology.h"
+#include "../main/ble/ble.h"
+extern "C" {
+#include "../main/zigbee/zigbee.h"
+#include "../main/config/config.h"
+#include "../main/config/loadsave.h"
+#include "../main/history/history.h"
+#include "../main/boot/boot.h"
+#include "../main/bus/measurement_bus.h"
+#include "../main/scd40/scd4x_sim.h"
+}
+
+#define HOUR_S (60 * 60)
+#define WEEK_S (7 * 24 * HOUR_S)
+#define PERIOD_S 30
+
+// The serial output is not started on the host, so nothing is written to the port
+int usb_serial_jtag_write_bytes(const void *src, size_t size, TickType_t ticks_to_wait)
+{
+    (void)src;
+    (void)ticks_to_wait;
+    return size;
+}
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// CO2 of an office at 'hour' of the week: outdoor air at night, rising through the working day, up to the high LED
+// level in the afternoon
+static uint16_t office_co2(uint32_t hour)
+{
+    uint32_t hour_of_day = hour % 24;
+    return hour_of_day >= 9 && hour_of_day < 17 ? 600 + (hour_of_day - 9) * 150 : 500;
+}
+
+// The order of app_main, without the console, the serial output and the diagnostics timer
+static void start_firmware(void)
+{
+    boot_init();
+    CHECK(esp_event_loop_create_default() == ESP_OK);
+    CHECK(init_nvs() == ESP_OK);
+    boot_mark(BOOT_NVS_READY);
+    CHECK(history_init(HISTORY_MAX_BYTES) == ESP_OK);
+    topology_start();
+    boot_mark(BOOT_TASKS_LAUNCHED);
+    // A task that took a snapshot of the defaults before the config was loaded sees it change
+    struct minico2_cfg_s cfg;
+    uint32_t version = config_snapshot(&cfg);
+    CHECK(init_config_storage() == ESP_OK);
+    CHECK(config_snapshot_if_changed(&cfg, &version));
+    boot_mark(BOOT_CONFIG_LOADED);
+}
+
+static void check_boot(void)
+{
+    const enum BOOT_PHASES phases[] = {BOOT_SENSOR_READY, BOOT_BLE_READY, BOOT_ZIGBEE_READY, BOOT_FIRST_SAMPLE_READ,
+                                       BOOT_FIRST_SAMPLE_PUBLISHED};
+    for (enum BOOT_PHASES phase : phases){
+        CHECK(boot_phase_time_us(phase) >= 0);
+    }
+    // The first sample is a single shot, not the first interval of the low power periodic mode
+    CHECK(boot_phase_time_us(BOOT_FIRST_SAMPLE_PUBLISHED) - boot_phase_time_us(BOOT_SENSOR_READY) < 10 * 1000000);
+    // The config is written to NVS on the first boot
+    CHECK(shim_nvs_commits() >= 1);
+}
+
+// The ZCL attributes hold the last measurement
+static void check_zigbee(const struct SCD40measurement *last)
+{
+    struct shim_zb_stats zb;
+    shim_zb_get_stats(&zb);
+    CHECK(zb.joined);
+    CHECK(zb.reporting_infos >= 2);
+
+    esp_zb_lock_acquire(portMAX_DELAY);
+    esp_zb_zcl_attr_t *temp = esp_zb_zcl_get_attribute(HA_ESP_SENSOR_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_TEMP_MEASUREMENT,
+        ESP_ZB_ZCL_CLUSTER_SERVER_ROLE, ESP_ZB_ZCL_ATTR_TEMP_MEASUREMENT_VALUE_ID);
+    esp_zb_zcl_attr_t *hum = esp_zb_zcl_get_attribute(HA_ESP_SENSOR_ENDPOINT,
+        ESP_ZB_ZCL_CLUSTER_ID_REL_HUMIDITY_MEASUREMENT, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE,
+        ESP_ZB_ZCL_ATTR_REL_HUMIDITY_MEASUREMENT_VALUE_ID);
+    esp_zb_zcl_attr_t *co2 = esp_zb_zcl_get_attribute(HA_ESP_SENSOR_ENDPOINT,
+        ESP_ZB_ZCL_CLUSTER_ID_CARBON_DIOXIDE_MEASUREMENT, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE,
+        ESP_ZB_ZCL_ATTR_CARBON_DIOXIDE_MEASUREMENT_MEASURED_VALUE_ID);
+    CHECK(temp != NULL && hum != NULL && co2 != NULL);
+    if (temp != NULL && hum != NULL && co2 != NULL){
+        CHECK(*(int16_t *)temp->data_p == last->temp_cdeg);
+        CHECK(*(uint16_t *)hum->data_p == last->hum_cpct);
+        CHECK(*(float *)co2->data_p == (float)last->co2 * 1E-6f);
+    }
+    esp_zb_lock_release();
+}
+
+// Every sample published since startup was advertised, and advertising never overlapped
+static void check_ble(void)
+{
+    uint32_t published = measurement_bus_head();
+    struct shim_gap_stats gap;
+    shim_gap_get_stats(&gap);
+    struct ble_adv_stats adv;
+    ble_get_adv_stats(&adv);
+    printf("BLE: %" PRIu32 " samples advertised in %" PRIu32 " bursts, %.0f s of advertising\n", adv.samples,
+           gap.starts, gap.advertising_us * 1e-6);
+    CHECK(gap.failed_starts == 0);
+    CHECK(gap.adv_data_sets >= published);
+    CHECK(gap.adv_data_len > 0);
+    CHECK(adv.samples + 1 >= published && adv.samples <= published);
+    CHECK(gap.advertising_us > 0 && gap.advertising_us < (int64_t)WEEK_S * 1000000 / 10);
+}
+
+// A week of sampling at 30 s, with the LED brightness changed on the third day
+static void check_week(void)
+{
+    struct scd4x_sim_stats sim_start;
+    scd4x_sim_get_stats(&sim_start);
+    uint32_t published_start = measurement_bus_head();
+    uint32_t commits_start = shim_nvs_commits();
+
+    static struct measurement_bus_subscriber sub;
+    CHECK(measurement_bus_subscribe(&sub) == ESP_OK);
+
+    double t0 = now_s();
+    int64_t virtual_start = shim_now_us();
+    for (uint32_t hour = 0; hour < WEEK_S / HOUR_S; hour++){
+        char line[64];
+        snprintf(line, sizeof(line), "{CO2: %u, TEMP: 21.5, HUM: 45.0}", office_co2(hour));
+        CHECK(scd4x_sim_push_trace_line(line) == ESP_OK);
+        if (hour == 3 * 24){set_led_brightness(0.5);}
+        vTaskDelay(pdMS_TO_TICKS(HOUR_S * 1000));
+    }
+    // Half a period more, so the last sample has gone through every output
+    vTaskDelay(pdMS_TO_TICKS(PERIOD_S * 1000 / 2));
+    double host_s = now_s() - t0;
+    double virtual_s = (shim_now_us() - virtual_start) * 1e-6;
+
+    struct scd4x_sim_stats sim;
+    scd4x_sim_get_stats(&sim);
+    uint32_t published = measurement_bus_head() - published_start;
+    printf("week at %d s: %" PRIu32 " samples published, %.0f s of virtual time in %.3f s, %.0fx real time\n",
+           PERIOD_S, published, virtual_s, host_s, virtual_s / host_s);
+    CHECK(sim.reads - sim_start.reads == published);
+    CHECK(published >= WEEK_S / PERIOD_S && published <= WEEK_S / PERIOD_S + 1);
+    CHECK(host_s < 30);
+
+    struct SCD40measurement last = {}, meas;
+    uint32_t read = 0;
+    while (measurement_bus_read(&sub, &meas)){
+        last = meas;
+        read++;
+    }
+    CHECK(read > 0);
+    CHECK(last.co2 == office_co2(WEEK_S / HOUR_S - 1));
+    CHECK(last.temp_cdeg == 2150 && last.hum_cpct == 4500);
+
+    check_zigbee(&last);
+    check_ble();
+
+    // Outdoor air at the end of the week: green, at the brightness set on the third day
+    struct shim_led_strip_state led;
+    shim_led_strip_get_state(&led);
+    CHECK(led.r == 0 && led.g == 127 && led.b == 0);
+    CHECK(led.refreshes > 0);
+
+    // The brightness was saved to NVS
+    CHECK(shim_nvs_commits() > commits_start);
+    struct minico2_cfg_s cfg;
+    config_snapshot(&cfg);
+    CHECK(cfg.led_cfg.brightness == 0.5f);
+}
+
+int main(void)
+{
+    start_firmware();
+    // Past the first sample, a single shot after the sensor is ready
+    vTaskDelay(pdMS_TO_TICKS(PERIOD_S * 1000 / 2));
+    check_boot();
+    check_week();
+    return CHECK_RESULT();
+}
@@ -0,0 +1,109 @@
+/*
+Checks main/stats/rollstats.c against a brute-force scan: after every one of 60000 random samples, the statistics of
+every window and channel must equal those computed from all samples still in the window. The samples come at random
+intervals, with gaps longer than the longest window, and negative temperatures, so that the bucket expiry, the deques
+and the rounding of negative means are all exercised.
+*/
+
+#include <inttypes.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "check.h"
+#include "../main/stats/rollstats.h"
+
+#define SAMPLES 60000
+
+static struct SCD40measurement samples[SAMPLES];
+static uint32_t times[SAMPLES];
+
+static uint32_t isqrt128(unsigned __int128 v)
+{
+    uint64_t r = sqrtl((long double)v);
+    while ((unsigned __int128)r * r > v){r--;}
+    while ((unsigned __int128)(r + 1) * (r + 1) <= v){r++;}
+    return r;
+}
+
+static int32_t channel_value(const struct SCD40measurement *m, enum ROLLSTATS_CHANNELS channel)
+{
+    switch (channel)
+    {
+    case ROLLSTATS_CO2: return m->co2;
+    case ROLLSTATS_TEMP: return m->temp_cdeg;
+    default: return m->hum_cpct;
+    }
+}
+
+// The statistics of the samples up to 'last' whose bucket is one of the ROLLSTATS_BUCKETS last of the window
+static void brute_force(uint32_t last, enum ROLLSTATS_WINDOWS window, enum ROLLSTATS_CHANNELS channel,
+                        struct rollstats_result *r)
+{
+    uint32_t bucket_s = rollstats_window_s(window) / ROLLSTATS_BUCKETS;
+    int64_t first_bucket = (int64_t)(times[last] / bucket_s) - (ROLLSTATS_BUCKETS - 1);
+    int64_t sum = 0;
+    __int128 sumsq = 0;
+    memset(r, 0, sizeof(*r));
+    r->min = INT32_MAX;
+    r->max = INT32_MIN;
+    for (int64_t i = last; i >= 0 && (int64_t)(times[i] / bucket_s) >= first_bucket; i--){
+        int32_t v = channel_value(&samples[i], channel);
+        r->count++;
+        sum += v;
+        sumsq += (int64_t)v * v;
+        if (v < r->min){r->min = v;}
+        if (v > r->max){r->max = v;}
+    }
+    int64_t n = r->count;
+    r->mean = (sum < 0 ? sum - n / 2 : sum + n / 2) / n;
+    r->sd = n < 2 ? 0 : isqrt128((unsigned __int128)(n * sumsq - (__int128)sum * sum) / ((__int128)n * n));
+}
+
+int main(void)
+{
+    srand(1);
+    uint32_t t = 1000;
+    int32_t co2 = 800, temp = 2000, hum = 5000;
+    uint32_t mismatches = 0;
+    for (uint32_t i = 0; i < SAMPLES; i++){
+        // Mostly the 5 to 60 second periods of the firmware, now and then a gap of minutes, hours or a day and more
+        int gap = rand() % 10000;
+        t += gap < 9950 ? 5 + rand() % 56 : gap < 9995 ? 60 + rand() % 7200 : 86400 + rand() % 86400;
+        co2 += rand() % 201 - 100;
+        temp += rand() % 101 - 50;
+        hum += rand() % 201 - 100;
+        co2 = co2 < 400 ? 400 : co2 > 5000 ? 5000 : co2;
+        temp = temp < -1000 ? -1000 : temp > 4000 ? 4000 : temp;
+        hum = hum < 0 ? 0 : hum > 10000 ? 10000 : hum;
+        samples[i] = (struct SCD40measurement){.co2 = co2, .temp_cdeg = temp, .hum_cpct = hum};
+        times[i] = t;
+        rollstats_add(&samples[i], t);
+
+        for (int w = 0; w < ROLLSTATS_N_WINDOWS; w++){
+            for (int c = 0; c < ROLLSTATS_N_CHANNELS; c++){
+                struct rollstats_result got, want;
+                rollstats_get(w, c, &got);
+                brute_force(i, w, c, &want);
+                bool same = got.count == want.count && got.mean == want.mean && got.min == want.min &&
+                            got.max == want.max && got.sd == want.sd;
+                if (!same && mismatches++ < 10){
+                    fprintf(stderr, "sample %" PRIu32 " %s %s: got n %" PRIu32 " mean %" PRId32 " min %" PRId32
+                            " max %" PRId32 " sd %" PRId32 ", want n %" PRIu32 " mean %" PRId32 " min %" PRId32
+                            " max %" PRId32 " sd %" PRId32 "\n", i, rollstats_window_to_str(w),
+                            rollstats_channel_to_str(c), got.count, got.mean, got.min, got.max, got.sd, want.count,
+                            want.mean, want.min, want.max, want.sd);
+                }
+            }
+        }
+    }
+    printf("%d samples over %" PRIu32 " s, %" PRIu32 " mismatches\n", SAMPLES, t - 1000, mismatches);
+    CHECK(mismatches == 0);
+
+    // Unknown windows and channels read as empty
+    struct rollstats_result r;
+    rollstats_get(ROLLSTATS_N_WINDOWS, ROLLSTATS_CO2, &r);
+    CHECK(r.count == 0);
+    rollstats_get(ROLLSTATS_1H, ROLLSTATS_N_CHANNELS, &r);
+    CHECK(r.count == 0);
+    return CHECK_RESULT();
+}
@@ -0,0 +1,250 @@
+/*
+Runs the simulated SCD4x of main/scd40/scd4x_sim.c through the scd4x driver (see shim/scd4x.c), on the virtual clock
+of the shims, which the sensor clock of main/scd40/sensor_clock.h reads by default.
+
+Checks the sequence of init_scd40() and how long it takes, a command sent while the sensor is still busy, the data
+ready flag and the samples of the periodic, low power periodic and single shot modes, a wrong CRC, the replay of a
+trace in the format of the JSON serial output, and each injected fault. Then a week of low power periodic sampling at
+30 s, which must take a small fraction of a second of the host's time.
+*/
+
+#include <inttypes.h>
+#include <string.h>
+#include <time.h>
+#include "check.h"
+#include "kernel.h"
+#include "freertos/task.h"
+#include "../main/scd40/scd40.h"
+#include "../main/scd40/scd4x_sim.h"
+
+#define WEEK_S (7 * 24 * 60 * 60)
+
+static i2c_dev_t dev;
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static bool data_ready(void)
+{
+    bool ready = false;
+    CHECK(scd4x_get_data_ready_status(&dev, &ready) == ESP_OK);
+    return ready;
+}
+
+static uint16_t read_co2(void)
+{
+    uint16_t co2 = 0, temp, hum;
+    CHECK(scd4x_read_measurement_ticks(&dev, &co2, &temp, &hum) == ESP_OK);
+    return co2;
+}
+
+static void sleep_ms(uint32_t ms)
+{
+    vTaskDelay(pdMS_TO_TICKS(ms));
+}
+
+// The sequence of init_scd40(), without the self test
+static void check_init(void)
+{
+    int64_t t0 = shim_now_us();
+    CHECK(scd4x_init_desc(&dev, 0, SCD40_SDA, SCD40_SCL) == ESP_OK);
+    CHECK(scd4x_wake_up(&dev) == ESP_FAIL);  // Never acknowledged
+    CHECK(scd4x_stop_periodic_measurement(&dev) == ESP_OK);
+    CHECK(scd4x_reinit(&dev) == ESP_OK);
+    uint16_t serial[3];
+    CHECK(scd4x_get_serial_number(&dev, serial, serial + 1, serial + 2) == ESP_OK);
+    CHECK(serial[0] == 0x5349 && serial[1] == 0x4d00 && serial[2] == 0x0001);
+    CHECK(scd4x_set_automatic_self_calibration(&dev, false) == ESP_OK);
+    bool asc = true;
+    CHECK(scd4x_get_automatic_self_calibration(&dev, &asc) == ESP_OK);
+    CHECK(!asc);
+    // Stop 500 ms, reinit 20 ms, and 1 ms for each of the three others. The driver does not wait after the wake up,
+    // which is not acknowledged.
+    int64_t elapsed = shim_now_us() - t0;
+    printf("init: %" PRId64 " us of virtual time\n", elapsed);
+    CHECK(elapsed == 523 * 1000);
+}
+
+// Transfers straight to the model: while a command executes, the sensor does not acknowledge, and arguments need
+// their CRC
+static void check_timing_and_crc(void)
+{
+    struct scd4x_sim_stats before, after;
+    scd4x_sim_get_stats(&before);
+    const uint8_t stop[2] = {0x3f, 0x86};
+    const uint8_t data_ready_cmd[2] = {0xe4, 0xb8};
+    CHECK(i2c_dev_write(&dev, NULL, 0, stop, sizeof(stop)) == ESP_OK);
+    CHECK(i2c_dev_write(&dev, NULL, 0, data_ready_cmd, sizeof(data_ready_cmd)) == ESP_FAIL);
+    sleep_ms(490);
+    CHECK(i2c_dev_write(&dev, NULL, 0, data_ready_cmd, sizeof(data_ready_cmd)) == ESP_FAIL);
+    sleep_ms(10);
+    CHECK(i2c_dev_write(&dev, NULL, 0, data_ready_cmd, sizeof(data_ready_cmd)) == ESP_OK);
+    // The response is only there after the execution time
+    uint8_t response[3];
+    CHECK(i2c_dev_read(&dev, NULL, 0, response, sizeof(response)) == ESP_FAIL);
+    sleep_ms(10);
+    CHECK(i2c_dev_read(&dev, NULL, 0, response, sizeof(response)) == ESP_OK);
+
+    const uint8_t set_asc_bad_crc[5] = {0x24, 0x16, 0x00, 0x01, 0x00};
+    CHECK(i2c_dev_write(&dev, NULL, 0, set_asc_bad_crc, sizeof(set_asc_bad_crc)) == ESP_FAIL);
+    scd4x_sim_get_stats(&after);
+    CHECK(after.nacks - before.nacks == 4);
+    CHECK(after.crc_errors - before.crc_errors == 1);
+}
+
+static void check_periodic(void)
+{
+    CHECK(scd4x_start_periodic_measurement(&dev) == ESP_OK);
+    CHECK(!data_ready());
+    // Reading without a result is not acknowledged
+    uint16_t co2, temp, hum;
+    CHECK(scd4x_read_measurement_ticks(&dev, &co2, &temp, &hum) == ESP_FAIL);
+    // In the periodic modes the other commands are refused
+    CHECK(scd4x_reinit(&dev) == ESP_FAIL);
+    sleep_ms(5000);
+    CHECK(data_ready());
+    CHECK(scd4x_read_measurement_ticks(&dev, &co2, &temp, &hum) == ESP_OK);
+    CHECK(co2 == 600);
+    CHECK(scd4x_ticks_to_cdeg(temp) == 2500);
+    CHECK(scd4x_ticks_to_cpct(hum) == 4500);
+    CHECK(!data_ready());
+    CHECK(scd4x_stop_periodic_measurement(&dev) == ESP_OK);
+}
+
+static void check_single_shot(void)
+{
+    struct scd4x_sim_stats before, after;
+    scd4x_sim_get_stats(&before);
+    int64_t t0 = shim_now_us();
+    CHECK(scd4x_measure_single_shot(&dev) == ESP_OK);  // The driver waits the 5 s of the conversion
+    CHECK(shim_now_us() - t0 == 5000 * 1000);
+    CHECK(data_ready());
+    CHECK(read_co2() == 600);
+
+    // Powered down, the sensor acknowledges nothing until it is woken up
+    CHECK(scd4x_power_down(&dev) == ESP_OK);
+    CHECK(scd4x_measure_single_shot(&dev) == ESP_FAIL);
+    // The wake up takes 30 ms, which the driver does not wait as the command is not acknowledged
+    scd4x_wake_up(&dev);
+    CHECK(scd4x_measure_single_shot(&dev) == ESP_FAIL);
+    sleep_ms(30);
+    CHECK(scd4x_measure_single_shot(&dev) == ESP_OK);
+    CHECK(read_co2() == 600);
+    scd4x_sim_get_stats(&after);
+    CHECK(after.samples - before.samples == 2);
+    CHECK(after.reads - before.reads == 2);
+}
+
+static void check_trace(void)
+{
+    CHECK(scd4x_sim_push_trace_line("{CO2: 612, TEMP: 21.3, HUM: 45.2}") == ESP_OK);
+    CHECK(scd4x_sim_push_trace_line("{CO2: 1850, TEMP: -5.5, HUM: 100.0}") == ESP_OK);
+    CHECK(scd4x_sim_push_trace_line("CO2: 612") == ESP_ERR_INVALID_ARG);
+
+    CHECK(scd4x_start_low_power_periodic_measurement(&dev) == ESP_OK);
+    uint16_t co2, temp, hum;
+    sleep_ms(30000);
+    CHECK(scd4x_read_measurement_ticks(&dev, &co2, &temp, &hum) == ESP_OK);
+    CHECK(co2 == 612);
+    CHECK(scd4x_ticks_to_cdeg(temp) == 2130);
+    CHECK(scd4x_ticks_to_cpct(hum) == 4520);
+    sleep_ms(30000);
+    CHECK(scd4x_read_measurement_ticks(&dev, &co2, &temp, &hum) == ESP_OK);
+    CHECK(co2 == 1850);
+    CHECK(scd4x_ticks_to_cdeg(temp) == -550);
+    CHECK(scd4x_ticks_to_cpct(hum) == 10000);
+    // The trace ran out: the last sample repeats
+    sleep_ms(30000);
+    CHECK(read_co2() == 1850);
+    CHECK(scd4x_stop_periodic_measurement(&dev) == ESP_OK);
+
+    struct scd4x_sim_stats stats;
+    scd4x_sim_get_stats(&stats);
+    CHECK(stats.trace_queued == 0);
+}
+
+static void check_faults(void)
+{
+    struct scd4x_sim_faults faults = {.zero_co2_every = 2};
+    scd4x_sim_set_faults(&faults);
+    CHECK(scd4x_start_periodic_measurement(&dev) == ESP_OK);
+    uint32_t zeros = 0;
+    for (int i = 0; i < 10; i++){
+        sleep_ms(5000);
+        zeros += read_co2() == 0;
+    }
+    CHECK(zeros == 5);
+
+    // A stale data ready flag: the previous sample is read again, before the next one is taken
+    faults = (struct scd4x_sim_faults){.stale_data_ready = true};
+    scd4x_sim_set_faults(&faults);
+    struct scd4x_sim_stats before, after;
+    scd4x_sim_get_stats(&before);
+    CHECK(data_ready());
+    read_co2();
+    CHECK(data_ready());
+    read_co2();
+    scd4x_sim_get_stats(&after);
+    CHECK(after.samples == before.samples);
+    CHECK(after.reads - before.reads == 2);
+
+    // Every third transfer is not acknowledged. A poll is a write and a read, and fails with either.
+    faults = (struct scd4x_sim_faults){.nack_every = 3};
+    scd4x_sim_set_faults(&faults);
+    scd4x_sim_get_stats(&before);
+    uint32_t failed = 0;
+    for (int i = 0; i < 30; i++){
+        sleep_ms(5000);
+        bool ready;
+        failed += scd4x_get_data_ready_status(&dev, &ready) != ESP_OK;
+    }
+    scd4x_sim_get_stats(&after);
+    printf("nack_every 3: %" PRIu32 " of 30 data ready polls failed\n", failed);
+    CHECK(failed >= 14 && failed <= 16);
+    CHECK(after.nacks - before.nacks == failed);
+
+    faults = (struct scd4x_sim_faults){0};
+    scd4x_sim_set_faults(&faults);
+    sleep_ms(1000);
+    CHECK(scd4x_stop_periodic_measurement(&dev) == ESP_OK);
+}
+
+// A week of low power periodic sampling, read every 30 s as the SCD40 task does
+static void check_week(void)
+{
+    struct scd4x_sim_stats before, after;
+    scd4x_sim_get_stats(&before);
+    int64_t t0 = shim_now_us();
+    double host_t0 = now_s();
+    CHECK(scd4x_start_low_power_periodic_measurement(&dev) == ESP_OK);
+    uint32_t read = 0;
+    for (int i = 0; i < WEEK_S / 30; i++){
+        sleep_ms(30000);
+        if (data_ready()){read += read_co2() == 1850;}  // The last sample of the trace
+    }
+    CHECK(scd4x_stop_periodic_measurement(&dev) == ESP_OK);
+    double host_s = now_s() - host_t0;
+    scd4x_sim_get_stats(&after);
+    double virtual_s = (shim_now_us() - t0) * 1e-6;
+    printf("week at 30 s: %" PRIu32 " samples read, %.0f s of virtual time in %.3f s, %.0fx real time\n", read,
+           virtual_s, host_s, virtual_s / host_s);
+    CHECK(read == WEEK_S / 30);
+    CHECK(after.nacks == before.nacks);
+    CHECK(virtual_s >= WEEK_S);
+}
+
+int main(void)
+{
+    check_init();
+    check_timing_and_crc();
+    check_periodic();
+    check_single_shot();
+    check_trace();
+    check_faults();
+    check_week();
+    return CHECK_RESULT();
+}
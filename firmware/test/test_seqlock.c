@@ -0,0 +1,116 @@
+/*
+Stress test of main/config/seqlock.h: two writers, serialised by a mutex as the config setters are by their spinlock,
+and four readers that never block. Every write fills the whole payload with the number of writes so far, so a copy
+that mixes two writes, or does not belong to the version it was read at, is seen at once.
+
+Build:  cc -O2 -pthread -o test_seqlock test_seqlock.c
+Run:    ./test_seqlock [reads per reader]
+*/
+
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include "check.h"
+#include "../main/config/seqlock.h"
+
+#define WRITERS 2
+#define READERS 4
+#define PAYLOAD_WORDS 32  // Larger than the config fields the seqlock guards together
+
+static struct seqlock lock = SEQLOCK_INITIALIZER;
+static pthread_mutex_t writer_mutex = PTHREAD_MUTEX_INITIALIZER;
+static uint32_t payload[PAYLOAD_WORDS];
+static uint32_t writes = 0;
+static volatile int readers_done = 0;
+static uint64_t reads_per_reader = 3000000;
+
+struct reader_result {
+    uint64_t reads;
+    uint64_t retries;
+    uint64_t torn;
+    uint64_t backwards;  // Versions lower than one read before
+};
+
+static void *writer(void *arg)
+{
+    while (!__atomic_load_n(&readers_done, __ATOMIC_ACQUIRE)){
+        pthread_mutex_lock(&writer_mutex);
+        seqlock_write_begin(&lock);
+        writes++;
+        for (int i = 0; i < PAYLOAD_WORDS; i++){
+            __atomic_store_n(&payload[i], writes, __ATOMIC_RELAXED);
+        }
+        seqlock_write_end(&lock);
+        pthread_mutex_unlock(&writer_mutex);
+    }
+    return NULL;
+}
+
+static void *reader(void *arg)
+{
+    struct reader_result *r = arg;
+    uint32_t copy[PAYLOAD_WORDS];
+    uint32_t last_seq = 0;
+    for (r->reads = 0; r->reads < reads_per_reader; r->reads++){
+        uint32_t seq;
+        do {
+            seq = seqlock_read_begin(&lock);
+            for (int i = 0; i < PAYLOAD_WORDS; i++){
+                copy[i] = __atomic_load_n(&payload[i], __ATOMIC_RELAXED);
+            }
+            r->retries++;
+        } while (seqlock_read_retry(&lock, seq));
+        r->retries--;
+
+        // After n writes the version is 2n, and every word holds n
+        for (int i = 0; i < PAYLOAD_WORDS; i++){
+            if (copy[i] != seq / 2){
+                r->torn++;
+                break;
+            }
+        }
+        if (seq < last_seq){r->backwards++;}
+        last_seq = seq;
+    }
+    return NULL;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1){reads_per_reader = strtoull(argv[1], NULL, 10);}
+
+    pthread_t writer_threads[WRITERS];
+    pthread_t reader_threads[READERS];
+    struct reader_result results[READERS];
+    memset(results, 0, sizeof(results));
+    for (int i = 0; i < WRITERS; i++){
+        pthread_create(&writer_threads[i], NULL, writer, NULL);
+    }
+    for (int i = 0; i < READERS; i++){
+        pthread_create(&reader_threads[i], NULL, reader, &results[i]);
+    }
+    for (int i = 0; i < READERS; i++){
+        pthread_join(reader_threads[i], NULL);
+    }
+    __atomic_store_n(&readers_done, 1, __ATOMIC_RELEASE);
+    for (int i = 0; i < WRITERS; i++){
+        pthread_join(writer_threads[i], NULL);
+    }
+
+    struct reader_result total = {0};
+    for (int i = 0; i < READERS; i++){
+        total.reads += results[i].reads;
+        total.retries += results[i].retries;
+        total.torn += results[i].torn;
+        total.backwards += results[i].backwards;
+    }
+    printf("writes %" PRIu32 ", reads %" PRIu64 ", retries %" PRIu64 ", torn %" PRIu64 ", backwards %" PRIu64 "\n",
+           writes, total.reads, total.retries, total.torn, total.backwards);
+
+    CHECK(total.reads == READERS * reads_per_reader);
+    CHECK(total.torn == 0);
+    CHECK(total.backwards == 0);
+    CHECK(seqlock_version(&lock) == 2 * writes);
+    return CHECK_RESULT();
+}
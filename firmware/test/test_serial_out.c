@@ -0,0 +1,140 @@
+/*
+Runs the serial output of main/serial/serial_out.c against a host that stops reading: the writer task hands its first
+chunk to the USB serial JTAG port and never gets it back. Every producer must return at once, with the writes that do
+not fit into the ring dropped and counted as a whole. Once the host reads again, what was queued must come out
+unchanged and in order.
+
+Waiting in any producer would show on the virtual clock of the shims, which only moves while every task waits: it must
+still read 0 after all of the writes. A producer waiting for the stalled writer would make every task wait without a
+deadline, which aborts the test.
+*/
+
+#include <inttypes.h>
+#include <string.h>
+#include "check.h"
+#include "kernel.h"
+#include "esp_log.h"
+#include "driver/usb_serial_jtag.h"
+#include "../main/serial/serial_out.h"
+#include "../main/serial/serial_format.h"
+#include "../main/diag/diag.h"
+
+#define FRAME_LEN 100
+#define FLOOD_WRITES 100000
+
+static const char *TEST_TAG = "test";
+
+// The host end of the port: it reads nothing while 'stalled' is set
+static bool stalled = true;
+static uint8_t received[2 * SERIAL_OUT_RING_SIZE];
+static size_t n_received = 0;
+
+int usb_serial_jtag_write_bytes(const void *src, size_t size, TickType_t ticks_to_wait)
+{
+    (void)ticks_to_wait;
+    shim_lock();
+    while (stalled){
+        shim_block(&stalled, -1);
+    }
+    if (n_received + size <= sizeof(received)){
+        memcpy(received + n_received, src, size);
+        n_received += size;
+    }
+    shim_unlock();
+    return size;
+}
+
+// The diagnostics are not part of the test
+void diag_register_task(TaskHandle_t task, uint32_t stack_bytes)
+{
+    (void)task;
+    (void)stack_bytes;
+}
+
+static void fill_frame(uint8_t *frame, uint32_t n)
+{
+    memset(frame, 'A' + n % 26, FRAME_LEN);
+}
+
+int main(void)
+{
+    ESP_ERROR_CHECK(serial_out_start());
+    struct serial_out_stats stats;
+    uint8_t frame[FRAME_LEN];
+
+    // The ring fills with whole frames, and the one that no longer fits is dropped as a whole
+    uint32_t queued = 0;
+    while (1){
+        fill_frame(frame, queued);
+        if (!serial_out_write(frame, sizeof(frame))){break;}
+        queued++;
+    }
+    uint32_t queued_bytes = queued * FRAME_LEN;
+    CHECK(queued == SERIAL_OUT_RING_SIZE / FRAME_LEN);
+
+    // What is left fits exactly, and then not a byte more
+    size_t rest = SERIAL_OUT_RING_SIZE - queued_bytes;
+    uint8_t tail[FRAME_LEN];
+    memset(tail, 'z', rest);
+    CHECK(serial_out_write(tail, rest));
+    CHECK(!serial_out_write(tail, 1));
+
+    // Text is dropped with its line endings expanded, measurements and log lines like any other write
+    CHECK(!serial_out_write_text("a\nb\n", 4));
+    struct SCD40measurement meas = {.co2 = 612, .temp_cdeg = 2134, .hum_cpct = 4521};
+    serial_out_measurement(&meas, SERIAL_FORMAT_TEXT);
+    serial_out_measurement(&meas, SERIAL_FORMAT_BINARY);
+    ESP_LOGI(TEST_TAG, "Dropped while the host does not read");
+    for (int i = 0; i < FLOOD_WRITES; i++){
+        serial_out_write(frame, 1 + i % FRAME_LEN);
+    }
+
+    serial_out_get_stats(&stats);
+    printf("stalled host: %" PRIu32 " writes queued, %" PRIu32 " dropped (%" PRIu32 " bytes), virtual time %" PRId64
+           " us\n", stats.writes, stats.writes_dropped, stats.bytes_dropped, shim_now_us());
+    CHECK(shim_now_us() == 0);
+    CHECK(stats.writes == queued + 1);
+    CHECK(stats.writes_dropped == 1 + 1 + 1 + 2 + 1 + FLOOD_WRITES);
+    CHECK(stats.lines == 0);
+    CHECK(stats.frames == 0);
+    CHECK(stats.frames_dropped == 1);
+    CHECK(stats.bytes_written == 0);
+    CHECK(stats.ring_high_water == SERIAL_OUT_RING_SIZE);
+    uint32_t flood_bytes = 0;
+    for (int i = 0; i < FLOOD_WRITES; i++){
+        flood_bytes += 1 + i % FRAME_LEN;
+    }
+    // The dropped measurements and log line are not checked by length, only counted
+    CHECK(stats.bytes_dropped > FRAME_LEN + 1 + 6 + flood_bytes);
+
+    // The host reads again: the queued bytes come out in order, and the ring takes writes again
+    shim_lock();
+    stalled = false;
+    shim_wake(&stalled);
+    shim_unlock();
+    while (1){
+        serial_out_get_stats(&stats);
+        if (stats.bytes_written == SERIAL_OUT_RING_SIZE){break;}
+        vTaskDelay(1);
+    }
+    CHECK(n_received == SERIAL_OUT_RING_SIZE);
+    bool in_order = true;
+    for (uint32_t n = 0; n < queued; n++){
+        fill_frame(frame, n);
+        in_order &= memcmp(received + n * FRAME_LEN, frame, FRAME_LEN) == 0;
+    }
+    in_order &= memcmp(received + queued_bytes, tail, rest) == 0;
+    CHECK(in_order);
+
+    serial_out_measurement(&meas, SERIAL_FORMAT_TEXT);
+    while (1){
+        serial_out_get_stats(&stats);
+        if (stats.bytes_written > SERIAL_OUT_RING_SIZE){break;}
+        vTaskDelay(1);
+    }
+    const char *line = "{CO2: 612, TEMP: 21.3, HUM: 45.2}\r\n";
+    CHECK(stats.lines == 1);
+    CHECK(n_received == SERIAL_OUT_RING_SIZE + strlen(line));
+    CHECK(memcmp(received + SERIAL_OUT_RING_SIZE, line, strlen(line)) == 0);
+    return CHECK_RESULT();
+}
@@ -0,0 +1,132 @@
+/*
+Checks the ventilation estimate of main/stats/ventilation.c on simulated rooms: the CO2 rises with people in the room,
+then decays exponentially towards the outdoor baseline at a known air change rate, with the noise of the SCD40 on
+top. The estimate must find the rate, and the episode detection must not fit what is not a decay.
+
+The module keeps its state between calls, so the cases run one after the other on one clock, separated by gaps longer
+than VENTILATION_MAX_GAP_S.
+*/
+
+#include <inttypes.h>
+#include <math.h>
+#include <stdlib.h>
+#include "check.h"
+#include "../main/stats/ventilation.h"
+
+#define PERIOD_S 30
+#define BASELINE 420
+
+static uint32_t now_s = 1000;
+
+static void add(double co2, uint16_t baseline)
+{
+    struct SCD40measurement m = {.co2 = (uint16_t)lround(co2)};
+    ventilation_add(&m, now_s, baseline);
+    now_s += PERIOD_S;
+}
+
+static void new_case(void)
+{
+    now_s += VENTILATION_MAX_GAP_S + PERIOD_S;
+}
+
+// People in the room: a linear rise to 'peak'
+static void rise(double peak)
+{
+    for (int k = 0; k < 40; k++){add(500 + (peak - 500) * k / 39, BASELINE);}
+}
+
+// The room empties at 't' = 0: the excess over the baseline decays with 'ach' air changes per hour, for 'duration_s'
+static void decay(double peak, double ach, uint32_t duration_s, int noise_ppm)
+{
+    for (uint32_t t = PERIOD_S; t <= duration_s; t += PERIOD_S){
+        int noise = noise_ppm ? rand() % (2 * noise_ppm + 1) - noise_ppm : 0;
+        add(BASELINE + (peak - BASELINE) * exp(-ach * t / 3600.0) + noise, BASELINE);
+    }
+}
+
+static void check_rate(double ach, int noise_ppm, double tolerance)
+{
+    struct ventilation_stats before, after;
+    ventilation_get_stats(&before);
+    new_case();
+    rise(2000);
+    decay(2000, ach, 3 * 60 * 60, noise_ppm);
+
+    struct ventilation_estimate e;
+    ventilation_get(&e);
+    ventilation_get_stats(&after);
+    double got = e.ach_centi / 100.0;
+    printf("ACH %5.2f, noise %2d PPM: estimate %5.2f, confidence %3u%%, %4" PRIu32 " samples over %5" PRIu32 " s\n", 
+           ach, noise_ppm, got, e.confidence_pct, e.samples, e.duration_s);
+    CHECK(e.valid);
+    CHECK(e.baseline == BASELINE);
+    CHECK(fabs(got - ach) <= tolerance * ach + 0.01);
+    CHECK(e.confidence_pct >= 90);
+    CHECK(after.episodes == before.episodes + 1);
+    CHECK(after.estimates == before.estimates + 1);
+}
+
+int main(void)
+{
+    srand(1);
+
+    // Nothing is estimated before the first decay
+    struct ventilation_estimate e;
+    ventilation_get(&e);
+    CHECK(!e.valid);
+
+    // Exact exponentials, then with the noise of the sensor
+    const double rates[] = {0.3, 1, 2, 6, 15};
+    for (size_t i = 0; i < sizeof(rates) / sizeof(rates[0]); i++){check_rate(rates[i], 0, 0.01);}
+    for (size_t i = 0; i < sizeof(rates) / sizeof(rates[0]); i++){check_rate(rates[i], 20, 0.05);}
+
+    // The estimate of an episode that has ended stays, and is final
+    new_case();
+    add(BASELINE + 50, BASELINE);
+    ventilation_get(&e);
+    CHECK(e.valid && e.final);
+    struct ventilation_stats stats;
+    ventilation_get_stats(&stats);
+    CHECK(!stats.in_episode);
+
+    // A CO2 level that never gets VENTILATION_START_EXCESS_PPM above the baseline starts no episode
+    struct ventilation_stats before;
+    ventilation_get_stats(&before);
+    new_case();
+    for (int k = 0; k < 200; k++){add(BASELINE + 250 - (k % 40) * 5, BASELINE);}
+    ventilation_get_stats(&stats);
+    CHECK(stats.episodes == before.episodes);
+
+    // A decay that people interrupt before VENTILATION_MIN_DURATION_S ends without an estimate
+    ventilation_get_stats(&before);
+    new_case();
+    rise(1500);
+    decay(1500, 4, VENTILATION_MIN_DURATION_S - 2 * PERIOD_S, 0);
+    rise(1500);
+    ventilation_get_stats(&stats);
+    CHECK(stats.episodes == before.episodes + 1);
+    CHECK(stats.estimates == before.estimates);
+
+    // Changing the baseline ends the episode, which is fitted towards one baseline only
+    ventilation_get_stats(&before);
+    new_case();
+    rise(2000);
+    decay(2000, 2, 20 * 60, 0);
+    ventilation_get_stats(&stats);
+    CHECK(stats.in_episode);
+    add(1500, BASELINE + 10);
+    ventilation_get_stats(&stats);
+    CHECK(!stats.in_episode);
+    CHECK(stats.episodes == before.episodes + 1);
+
+    // A gap longer than VENTILATION_MAX_GAP_S ends it too
+    new_case();
+    rise(2000);
+    decay(2000, 2, 20 * 60, 0);
+    now_s += VENTILATION_MAX_GAP_S;
+    add(1000, BASELINE);
+    ventilation_get_stats(&stats);
+    CHECK(!stats.in_episode);
+    return CHECK_RESULT();
+}
@@ -0,0 +1,123 @@
+/*
+Decodes the binary measurement stream of one or more MiniCO2s ('serial_format binary' on the console) to CSV or JSON
+lines on stdout. Inputs are serial ports or captured files, read in parallel. Lost and garbage frames are reported
+on stderr when all inputs end, or on Ctrl-C.
+
+Build:  c++ -std=c++17 -O2 -o serial_decode serial_decode.cpp
+Run:    ./serial_decode [-f csv|json] /dev/ttyACM0 /dev/ttyACM1 > samples.csv
+*/
+
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+#include "serial_stream.hpp"
+
+static volatile sig_atomic_t interrupted = 0;
+
+static void on_sigint(int)
+{
+    interrupted = 1;
+}
+
+// Puts a serial port in raw mode, so that no bytes of the frames are translated
+static void make_raw(int fd)
+{
+    termios tio;
+    if (!isatty(fd) || tcgetattr(fd, &tio) != 0){return;}
+    cfmakeraw(&tio);
+    tcsetattr(fd, TCSANOW, &tio);
+}
+
+static void print_record(bool json, const serial_record &r)
+{
+    if (json){
+        printf("{\"device\":\"%08x\",\"seq\":%u,\"uptime_ms\":%u,\"co2\":%u,\"temp_c\":%.2f,\"hum_pct\":%.2f}\n",
+               r.device_id, r.seq, r.uptime_ms, r.co2, r.temp_cdeg / 100.0, r.hum_cpct / 100.0);
+    } else {
+        printf("%08x,%u,%u,%u,%.2f,%.2f\n", r.device_id, r.seq, r.uptime_ms, r.co2, r.temp_cdeg / 100.0,
+               r.hum_cpct / 100.0);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    bool json = false;
+    int opt;
+    while ((opt = getopt(argc, argv, "f:")) != -1){
+        if (opt == 'f' && (strcmp(optarg, "csv") == 0 || strcmp(optarg, "json") == 0)){
+            json = strcmp(optarg, "json") == 0;
+        } else {
+            fprintf(stderr, "Usage: %s [-f csv|json] <port or file>...\n", argv[0]);
+            return 1;
+        }
+    }
+    if (optind == argc){
+        fprintf(stderr, "Usage: %s [-f csv|json] <port or file>...\n", argv[0]);
+        return 1;
+    }
+
+    std::vector<pollfd> fds;
+    std::vector<std::string> names;
+    std::vector<minico2::StreamDecoder> decoders;
+    for (int i = optind; i < argc; i++){
+        int fd = open(argv[i], O_RDONLY | O_NOCTTY);
+        if (fd < 0){
+            perror(argv[i]);
+            return 1;
+        }
+        make_raw(fd);
+        fds.push_back({fd, POLLIN, 0});
+        names.push_back(argv[i]);
+        decoders.emplace_back([json](const serial_record &r, uint32_t lost){
+            if (lost > 0){
+                fprintf(stderr, "%08x: %u frames lost before seq %u\n", r.device_id, lost, r.seq);
+            }
+            print_record(json, r);
+        });
+    }
+
+    signal(SIGINT, on_sigint);
+    if (!json){
+        printf("device,seq,uptime_ms,co2,temp_c,hum_pct\n");
+    }
+
+    size_t open_inputs = fds.size();
+    uint8_t buf[4096];
+    while (open_inputs > 0 && !interrupted){
+        if (poll(fds.data(), fds.size(), -1) < 0){
+            if (errno == EINTR){continue;}
+            perror("poll");
+            break;
+        }
+        for (size_t i = 0; i < fds.size(); i++){
+            if (fds[i].fd < 0 || fds[i].revents == 0){continue;}
+            ssize_t n = read(fds[i].fd, buf, sizeof(buf));
+            if (n > 0){
+                decoders[i].feed(buf, n);
+                fflush(stdout);
+            } else if (n == 0 || errno != EINTR){
+                close(fds[i].fd);
+                fds[i].fd = -1;  // Ignored by poll from now on
+                open_inputs--;
+            }
+        }
+    }
+
+    for (size_t i = 0; i < decoders.size(); i++){
+        fprintf(stderr, "%s: %llu garbage frames\n", names[i].c_str(), (unsigned long long)decoders[i].garbage());
+        for (const auto &device : decoders[i].devices()){
+            const minico2::DeviceStats &s = device.second;
+            fprintf(stderr, "  device %08x: %llu records, %llu lost (%.2f%%)\n", device.first,
+                    (unsigned long long)s.records, (unsigned long long)s.lost,
+                    s.records + s.lost ? 100.0 * s.lost / (s.records + s.lost) : 0.0);
+        }
+    }
+    return 0;
+}
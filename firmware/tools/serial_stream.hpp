@@ -0,0 +1,91 @@
+/*
+Decoder for the binary measurement stream of the MiniCO2 serial port (see main/serial/serial_format.h). Bytes are fed
+in as they arrive. Complete records are passed to a callback, and frame losses are counted per device.
+
+Log text on the port ends up in frames that fail to decode. These are counted as garbage, not as lost records.
+*/
+
+#ifndef _SERIAL_STREAM_HPP
+#define _SERIAL_STREAM_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <vector>
+extern "C" {
+#include "../main/serial/serial_format.h"
+}
+
+namespace minico2 {
+
+struct DeviceStats {
+    uint64_t records = 0;  // Valid records received
+    uint64_t lost = 0;     // Records missing from the sequence
+    uint16_t last_seq = 0;
+};
+
+class StreamDecoder {
+public:
+    // Called for every valid record, with the number of records lost right before it
+    using RecordCallback = std::function<void(const serial_record &record, uint32_t lost_before)>;
+
+    explicit StreamDecoder(RecordCallback callback) : callback(std::move(callback)) {}
+
+    void feed(const uint8_t *data, size_t len) {
+        for (size_t i = 0; i < len; i++){
+            if (data[i] != 0){
+                // A frame can never be longer than this. Longer runs are log text.
+                if (frame.size() < max_encoded_len){
+                    frame.push_back(data[i]);
+                } else {
+                    overflow = true;
+                }
+                continue;
+            }
+            end_frame();
+        }
+    }
+
+    const std::map<uint32_t, DeviceStats> &devices() const {return device_stats;}
+    uint64_t garbage() const {return garbage_frames;}
+
+private:
+    static constexpr size_t max_encoded_len = SERIAL_FRAME_MAX_LEN - 2;
+
+    void end_frame() {
+        if (frame.empty()){return;}  // Delimiters of adjacent frames
+        uint8_t decoded[max_encoded_len];
+        serial_record record;
+        size_t len = overflow ? 0 : serial_cobs_decode(frame.data(), frame.size(), decoded);
+        frame.clear();
+        overflow = false;
+        if (len == 0 || !serial_record_unpack(decoded, len, &record)){
+            garbage_frames++;
+            return;
+        }
+
+        auto inserted = device_stats.emplace(record.device_id, DeviceStats{});
+        DeviceStats &stats = inserted.first->second;
+        uint32_t lost = 0;
+        if (!inserted.second){
+            // A device that rebooted starts again from 0, which is not counted as a loss
+            uint16_t gap = record.seq - stats.last_seq - 1;
+            lost = record.seq == 0 ? 0 : gap;
+        }
+        stats.records++;
+        stats.lost += lost;
+        stats.last_seq = record.seq;
+        callback(record, lost);
+    }
+
+    RecordCallback callback;
+    std::vector<uint8_t> frame;
+    bool overflow = false;
+    uint64_t garbage_frames = 0;
+    std::map<uint32_t, DeviceStats> device_stats;
+};
+
+}  // namespace minico2
+
+#endif
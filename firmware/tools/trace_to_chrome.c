@@ -0,0 +1,157 @@
+/*
+Converts the output of the 'trace' console command to Chrome trace JSON, which can be opened in Perfetto 
+(ui.perfetto.dev) or chrome://tracing. Lines that are not part of the trace, such as log output, are skipped.
+
+Build:  cc -O2 -o trace_to_chrome trace_to_chrome.c
+Run:    ./trace_to_chrome console.log > trace.json
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include "../main/trace/trace_format.h"
+
+#define MAX_TASKS 64
+
+// Tracks with a fixed thread id in the output. Tasks use their own id.
+#define TID_I2C 1
+#define TID_BLE 2
+#define TID_NVS 3
+#define TID_QUEUES 4
+
+static struct {
+    uint32_t id;
+    char name[32];
+} tasks[MAX_TASKS];
+static int n_tasks = 0;
+
+static const char *task_name(uint32_t id)
+{
+    for (int i = 0; i < n_tasks; i++){
+        if (tasks[i].id == id){return tasks[i].name;}
+    }
+    return NULL;
+}
+
+static void thread_name(uint32_t tid, const char *name, int *first)
+{
+    printf("%s\n{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":%" PRIu32 ",\"args\":{\"name\":\"%s\"}}", 
+           *first ? "" : ",", tid, name);
+    *first = 0;
+}
+
+int main(int argc, char **argv)
+{
+    FILE *f = argc > 1 ? fopen(argv[1], "r") : stdin;
+    if (f == NULL){
+        perror(argv[1]);
+        return 1;
+    }
+
+    char line[256];
+    int in_trace = 0, first = 1;
+    unsigned cpu_mhz = 160;
+    uint32_t prev_cycles = 0;
+    int64_t cycles = 0;            // Unwrapped cycle count since the first record
+    uint32_t running = 0;          // Task that is running
+    double running_since = -1;
+    uint32_t records = 0;
+
+    printf("{\"traceEvents\":[");
+    thread_name(TID_I2C, "I2C", &first);
+    thread_name(TID_BLE, "BLE GAP", &first);
+    thread_name(TID_NVS, "NVS", &first);
+    thread_name(TID_QUEUES, "Queues", &first);
+
+    while (fgets(line, sizeof(line), f) != NULL){
+        if (strncmp(line, "=== TRACE BEGIN", 15) == 0){
+            sscanf(line, "=== TRACE BEGIN cpu_mhz=%u", &cpu_mhz);
+            in_trace = 1;
+            records = 0;
+            continue;
+        }
+        if (!in_trace){continue;}
+        if (strncmp(line, "=== TRACE END", 13) == 0){
+            break;
+        }
+
+        if (line[0] == 'T' && n_tasks < MAX_TASKS){
+            char name[32];
+            uint32_t id;
+            if (sscanf(line, "T %" SCNx32 " %31s", &id, name) == 2){
+                tasks[n_tasks].id = id;
+                strcpy(tasks[n_tasks].name, name);
+                thread_name(id, name, &first);
+                n_tasks++;
+            }
+            continue;
+        }
+        if (line[0] != 'R'){continue;}
+
+        struct trace_record r;
+        if (sscanf(line, "R %8" SCNx32 "%8" SCNx32, &r.cycles, &r.event_arg) != 2){continue;}
+
+        // The cycle counter wraps every few seconds. Records can be slightly out of order when an ISR interrupts
+        // a record being written, so the difference to the previous record is taken as signed.
+        if (records > 0){cycles += (int32_t)(r.cycles - prev_cycles);}
+        prev_cycles = r.cycles;
+        records++;
+        double ts = (double)cycles / cpu_mhz;
+        uint32_t arg = trace_arg(&r);
+        const char *sep = first ? "" : ",";
+        first = 0;
+
+        switch (trace_event(&r))
+        {
+        case TRACE_TASK_SWITCHED_IN:
+            // A task's slice ends when the next task is switched in
+            if (running_since >= 0){
+                printf("%s\n{\"ph\":\"X\",\"name\":\"%s\",\"pid\":1,\"tid\":%" PRIu32 ",\"ts\":%.3f,\"dur\":%.3f}", sep,
+                       task_name(running) ? task_name(running) : "task", running, running_since, ts - running_since);
+            } else {
+                printf("%s\n{\"ph\":\"i\",\"name\":\"trace_start\",\"pid\":1,\"tid\":%" PRIu32 ",\"ts\":%.3f,\"s\":\"g\"}", sep, arg, ts);
+            }
+            running = arg;
+            running_since = ts;
+            break;
+        case TRACE_QUEUE_SEND:
+        case TRACE_QUEUE_RECEIVE:
+        case TRACE_QUEUE_SEND_FROM_ISR:
+        case TRACE_QUEUE_RECEIVE_FROM_ISR:
+            printf("%s\n{\"ph\":\"i\",\"name\":\"%s\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"s\":\"t\",\"args\":{\"queue\":\"%06" PRIx32 "\",\"task\":\"%06" PRIx32 "\"}}",
+                   sep, trace_event_to_str(trace_event(&r)), TID_QUEUES, ts, arg, running);
+            break;
+        case TRACE_I2C_WRITE_BEGIN:
+            printf("%s\n{\"ph\":\"B\",\"name\":\"write 0x%04" PRIx32 "\",\"pid\":1,\"tid\":%d,\"ts\":%.3f}", sep, arg, TID_I2C, ts);
+            break;
+        case TRACE_I2C_READ_BEGIN:
+            printf("%s\n{\"ph\":\"B\",\"name\":\"read %" PRIu32 " bytes\",\"pid\":1,\"tid\":%d,\"ts\":%.3f}", sep, arg, TID_I2C, ts);
+            break;
+        case TRACE_I2C_END:
+            printf("%s\n{\"ph\":\"E\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"args\":{\"err\":%" PRIu32 "}}", sep, TID_I2C, ts, arg);
+            break;
+        case TRACE_GAP_ADV_START:
+        case TRACE_GAP_ADV_STARTED:
+        case TRACE_GAP_ADV_STOP:
+        case TRACE_GAP_ADV_STOPPED:
+            printf("%s\n{\"ph\":\"i\",\"name\":\"%s\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"s\":\"t\",\"args\":{\"status\":%" PRIu32 "}}",
+                   sep, trace_event_to_str(trace_event(&r)), TID_BLE, ts, arg);
+            break;
+        case TRACE_NVS_COMMIT_BEGIN:
+            printf("%s\n{\"ph\":\"B\",\"name\":\"nvs_commit\",\"pid\":1,\"tid\":%d,\"ts\":%.3f}", sep, TID_NVS, ts);
+            break;
+        case TRACE_NVS_COMMIT_END:
+            printf("%s\n{\"ph\":\"E\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"args\":{\"err\":%" PRIu32 "}}", sep, TID_NVS, ts, arg);
+            break;
+        default:
+            printf("%s\n{\"ph\":\"i\",\"name\":\"event_%" PRIu32 "\",\"pid\":1,\"tid\":0,\"ts\":%.3f,\"s\":\"g\"}", sep, trace_event(&r), ts);
+            break;
+        }
+    }
+    printf("\n]}\n");
+
+    fprintf(stderr, "%" PRIu32 " records, %d tasks, %.3f ms\n", records, n_tasks, (double)cycles / cpu_mhz / 1000);
+    if (f != stdin){fclose(f);}
+    return 0;
+}
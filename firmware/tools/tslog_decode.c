@@ -0,0 +1,75 @@
+/*
+Decodes a raw image of the 'tslog' flash partition to CSV on stdout, oldest sample first.
+
+Build:  cc -O2 -o tslog_decode tslog_decode.c
+Dump:   esptool.py read_flash <tslog offset> <tslog size> tslog.bin
+Run:    ./tslog_decode tslog.bin > log.csv
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include "../main/tslog/tslog_format.h"
+
+int main(int argc, char **argv)
+{
+    if (argc != 2){
+        fprintf(stderr, "Usage: %s <partition image>\n", argv[0]);
+        return 1;
+    }
+
+    FILE *f = fopen(argv[1], "rb");
+    if (f == NULL){
+        perror(argv[1]);
+        return 1;
+    }
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    uint32_t n_pages = size / TSLOG_PAGE_SIZE;
+    uint8_t *image = malloc(size > 0 ? size : 1);
+    if (image == NULL || fread(image, 1, size, f) != (size_t)size){
+        fprintf(stderr, "Reading %s failed\n", argv[1]);
+        return 1;
+    }
+    fclose(f);
+
+    // Pages are filled in order around the partition, so the oldest page follows the one with the highest seq
+    int32_t last = -1;
+    uint32_t max_seq = 0;
+    for (uint32_t page = 0; page < n_pages; page++){
+        const struct tslog_page_header *h = (const struct tslog_page_header *)&image[page * TSLOG_PAGE_SIZE];
+        if (tslog_header_valid(h) && (last < 0 || h->seq > max_seq)){
+            last = page;
+            max_seq = h->seq;
+        }
+    }
+
+    uint32_t samples = 0, bytes = 0, pages_used = 0;
+    printf("time_s,co2_ppm,temp_c,hum_pct\n");
+    for (uint32_t i = 1; last >= 0 && i <= n_pages; i++){
+        uint32_t page = (last + i) % n_pages;
+        const uint8_t *p = &image[page * TSLOG_PAGE_SIZE];
+        const struct tslog_page_header *h = (const struct tslog_page_header *)p;
+        if (!tslog_header_valid(h)){continue;}
+
+        struct tslog_cursor c;
+        struct tslog_sample s = h->first;
+        uint32_t off = sizeof(*h);
+        size_t n = 1;
+        tslog_cursor_init(&c, h);
+        while (n > 0){
+            printf("%" PRIu32 ",%u,%.1f,%.1f\n", s.time_s, s.co2, s.temp_dc / 10.0, s.hum_dpct / 10.0);
+            samples++;
+            n = tslog_decode(&p[off], TSLOG_PAGE_SIZE - off, &c, &s);
+            off += n;
+        }
+        bytes += off;
+        pages_used++;
+    }
+
+    fprintf(stderr, "%" PRIu32 " samples in %" PRIu32 " of %" PRIu32 " pages, %.2f bytes per sample\n", 
+            samples, pages_used, n_pages, samples ? (double)bytes / samples : 0.0);
+    free(image);
+    return 0;
+}